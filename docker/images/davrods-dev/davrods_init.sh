@@ -69,8 +69,12 @@ progress_update "Building Davrods complete"
 # Install built DavRODS version
 before_update "Installing DavRODS"
 make install
-chown www-data:www-data /var/lib/davrods
-chmod 0700 /var/lib/davrods
+mkdir -p /var/lib/davrods/junk
+chown www-data:www-data /var/lib/davrods /var/lib/davrods/junk
+chmod 0700 /var/lib/davrods /var/lib/davrods/junk
+mkdir -p /var/cache/davrods/index
+chown www-data:www-data /var/cache/davrods/index
+chmod 0700 /var/cache/davrods/index
 progress_update "Installing Davrods complete"
 
 # Restoring Docker setup specific Vhost files
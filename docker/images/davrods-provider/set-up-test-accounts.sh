@@ -1,8 +1,46 @@
 #!/bin/bash
 # Override test user passwords with user-defined values
-for user in researcher
+for user in researcher viewer
 do usermod -p "$TEST_USER_PASSWORD_HASH" "$user"
   # Ignore failures in case accounts already exist
   sudo -iu irods iadmin mkuser "$user" rodsuser || true
 done
 sudo -iu irods ichmod read researcher /tempZone/home
+sudo -iu irods ichmod read viewer /tempZone/home
+
+# The service account of the proxied location
+sudo -iu irods iadmin mkuser davrods-proxy rodsadmin || true
+sudo -iu irods iadmin moduser davrods-proxy password proxytest
+
+# A collection with more members than fit on a page of a paged listing, one
+# of which has a second replica
+sudo -iu irods iadmin mkresc pagedResc unixfilesystem provider.davrods:/var/lib/irods/pagedResc || true
+sudo -iu irods bash -c '
+  imkdir -p /tempZone/home/rods/paged/sub-a /tempZone/home/rods/paged/sub-b /tempZone/home/rods/paged/sub-c
+  for name in a b c d e
+  do echo "paged data $name" > /tmp/paged-$name.txt
+    iput -f /tmp/paged-$name.txt /tempZone/home/rods/paged/paged-$name.txt
+  done
+  irepl -R pagedResc /tempZone/home/rods/paged/paged-c.txt || true
+  ichmod -r read researcher /tempZone/home/rods/paged
+'
+
+# Collections that test users can only read with a ticket
+for name in a b
+do sudo -iu irods bash -c "
+    imkdir -p /tempZone/home/rods/ticket-$name
+    echo 'ticket data' > /tmp/ticket-$name.txt
+    iput -f /tmp/ticket-$name.txt /tempZone/home/rods/ticket-$name/ticket-$name.txt
+    iticket create read /tempZone/home/rods/ticket-$name davrods-test-ticket-$name || true
+  "
+done
+
+# Data objects with and without a checksum
+sudo -iu irods bash -c '
+  imkdir -p /tempZone/home/rods/checksums
+  echo "checksum data" > /tmp/with-checksum.txt
+  echo "no checksum data" > /tmp/without-checksum.txt
+  iput -f -k /tmp/with-checksum.txt /tempZone/home/rods/checksums/with-checksum.txt
+  iput -f /tmp/without-checksum.txt /tempZone/home/rods/checksums/without-checksum.txt
+  ichmod -r read researcher /tempZone/home/rods/checksums
+'
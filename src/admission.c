@@ -0,0 +1,450 @@
+/**
+ * \file
+ * \brief     Admission control for iRODS connections.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "admission.h"
+#include "config.h"
+#include "stats.h"
+
+#include <apr_global_mutex.h>
+#include <apr_shm.h>
+#include <ap_mpm.h>
+#include <mod_status.h>
+#include <util_mutex.h>
+
+#include <unistd.h>
+
+#include <irods/rodsClient.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* Every session that holds an iRODS connection pins an iRODS agent process
+ * on the provider. A single client opening many HTTP connections at once
+ * could otherwise use up all agents. This module caps the number of
+ * connections held by sessions, in total and per user.
+ *
+ * Permits are counted in anonymous shared memory, guarded by a global mutex,
+ * so that the caps hold across all child processes. There is no
+ * cross-process condition variable in APR, so queued requests poll for a
+ * free permit with increasing intervals.
+ *
+ * Idle connections in the connection pool do not hold a permit. Their
+ * number is bounded by DavrodsConnectionPoolSize.
+ *
+ * Permits are returned by pool cleanups, which do not run when a child
+ * process crashes or is killed. Every permit and queued request is therefore
+ * recorded together with the pid of its child process, and the parent
+ * process reclaims the records of children that exit.
+ */
+
+#define ADMISSION_MUTEX_TYPE "davrods-admission"
+
+/// Max. number of users that can hold connections at the same time.
+/// Users beyond this number are subject to the total cap only.
+#define ADMISSION_USER_SLOTS 1024
+
+/// Max. number of permits and queued requests that are recorded with their
+/// child process. Permits beyond this number cannot be reclaimed if their
+/// child process dies.
+#define ADMISSION_HOLDER_SLOTS 4096
+
+#define ADMISSION_POLL_MIN apr_time_from_msec(5)
+#define ADMISSION_POLL_MAX apr_time_from_msec(100)
+
+typedef struct {
+  char username[NAME_LEN];
+  apr_uint32_t active; // A slot with no active connections is free.
+} admission_user_t;
+
+typedef struct {
+  pid_t pid;   // 0 if the slot is free.
+  int user;    // Index of the user slot, -1 if none.
+  bool queued; // Waiting in the queue rather than holding a permit.
+} admission_holder_t;
+
+typedef struct {
+  apr_uint32_t active;  // Permits held.
+  apr_uint32_t waiting; // Requests in the queue.
+  admission_user_t users[ADMISSION_USER_SLOTS];
+  admission_holder_t holders[ADMISSION_HOLDER_SLOTS];
+} admission_table_t;
+
+static struct {
+  server_rec *server;
+  pid_t pid;                // Of this child process.
+  admission_table_t *table; // NULL if admission control is disabled.
+  apr_global_mutex_t *lock;
+  int limit;          // 0 for no total cap.
+  int limit_per_user; // 0 for no per-user cap.
+  int queue_size;
+  apr_interval_time_t queue_timeout;
+} admission;
+
+static bool admission_lock(server_rec *s) {
+  apr_status_t status = apr_global_mutex_lock(admission.lock);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not lock the admission mutex");
+    return false;
+  }
+  return true;
+}
+
+static void admission_unlock(server_rec *s) {
+  apr_status_t status = apr_global_mutex_unlock(admission.lock);
+  if (status != APR_SUCCESS)
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not unlock the admission mutex");
+}
+
+/**
+ * \brief Find the slot of a user, or a free slot for them.
+ *
+ * Must be called with the admission lock held.
+ *
+ * \return a user slot, or NULL if all slots are taken by other users.
+ */
+static admission_user_t *find_user(const char *username) {
+  admission_user_t *free_slot = NULL;
+
+  for (int i = 0; i < ADMISSION_USER_SLOTS; ++i) {
+    admission_user_t *user = &admission.table->users[i];
+    if (!user->active) {
+      if (!free_slot)
+        free_slot = user;
+    } else if (!strncmp(user->username, username, sizeof(user->username))) {
+      return user;
+    }
+  }
+
+  if (free_slot)
+    apr_cpystrn(free_slot->username, username, sizeof(free_slot->username));
+  return free_slot;
+}
+
+/**
+ * \brief Record a permit or queued request of this child process.
+ *
+ * Must be called with the admission lock held.
+ *
+ * \return the holder slot, or -1 if all slots are taken.
+ */
+static int add_holder(int user, bool queued) {
+  for (int i = 0; i < ADMISSION_HOLDER_SLOTS; ++i) {
+    admission_holder_t *holder = &admission.table->holders[i];
+    if (!holder->pid) {
+      holder->pid = admission.pid;
+      holder->user = user;
+      holder->queued = queued;
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * \brief Find a permit of this child process that was granted to a user.
+ *
+ * Must be called with the admission lock held.
+ *
+ * \return the holder slot, or NULL if the permit was not recorded.
+ */
+static admission_holder_t *find_permit(int user) {
+  admission_holder_t *unassigned = NULL;
+
+  for (int i = 0; i < ADMISSION_HOLDER_SLOTS; ++i) {
+    admission_holder_t *holder = &admission.table->holders[i];
+    if (holder->pid != admission.pid || holder->queued)
+      continue;
+    if (holder->user == user)
+      return holder;
+    // The user may have had no slot when the permit was granted.
+    if (holder->user < 0 && !unassigned)
+      unassigned = holder;
+  }
+  return unassigned;
+}
+
+static int refuse(request_rec *r) {
+  apr_int64_t retry_after = apr_time_sec(admission.queue_timeout);
+  apr_table_setn(r->err_headers_out, "Retry-After",
+                 apr_psprintf(r->pool, "%" APR_INT64_T_FMT,
+                              retry_after > 0 ? retry_after : 1));
+  apr_table_setn(r->notes, "davrods-admission-refused", "1");
+  davrods_stats_inc(DAVRODS_STAT_ADMISSION_REFUSED);
+  return HTTP_SERVICE_UNAVAILABLE;
+}
+
+int davrods_admission_acquire(request_rec *r, const char *username) {
+  if (!admission.table)
+    return OK;
+
+  apr_time_t start = apr_time_now();
+  apr_interval_time_t delay = ADMISSION_POLL_MIN;
+  bool queued = false;
+  int slot = -1; // Our holder slot, if recorded.
+
+  for (;;) {
+    if (!admission_lock(r->server))
+      return OK; // Fail open, the caps are not essential.
+
+    admission_user_t *user = find_user(username);
+    bool admitted =
+        (!admission.limit ||
+         admission.table->active < (apr_uint32_t)admission.limit) &&
+        (!admission.limit_per_user || !user ||
+         user->active < (apr_uint32_t)admission.limit_per_user);
+    bool full = !queued && !admitted &&
+                admission.table->waiting >= (apr_uint32_t)admission.queue_size;
+    bool timed_out = queued && !admitted &&
+                     apr_time_now() - start >= admission.queue_timeout;
+
+    if (admitted) {
+      admission.table->active++;
+      if (user)
+        user->active++;
+    }
+    if (queued && (admitted || timed_out))
+      admission.table->waiting--;
+    if (!queued && !admitted && !full)
+      admission.table->waiting++;
+
+    // Keep the record of this request in line with the counts above.
+    if (admitted || (!queued && !full)) {
+      int user_index = admitted && user ? (int)(user - admission.table->users)
+                                        : -1;
+      if (slot < 0) {
+        slot = add_holder(user_index, !admitted);
+      } else {
+        admission.table->holders[slot].user = user_index;
+        admission.table->holders[slot].queued = false;
+      }
+    } else if (timed_out && slot >= 0) {
+      admission.table->holders[slot].pid = 0;
+    }
+
+    admission_unlock(r->server);
+
+    if (queued && (admitted || timed_out))
+      davrods_stats_add(DAVRODS_STAT_ADMISSION_WAIT_MSEC,
+                        (apr_uint32_t)apr_time_as_msec(apr_time_now() - start));
+
+    if (admitted)
+      return OK;
+
+    if (full || timed_out) {
+      ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, r,
+                    "Refusing iRODS connection for user '%s': %s", username,
+                    full ? "too many requests are waiting for a connection"
+                         : "timed out waiting for a connection");
+      return refuse(r);
+    }
+
+    if (!queued) {
+      ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                    "Connection limit reached, queueing request of user '%s'",
+                    username);
+      davrods_stats_inc(DAVRODS_STAT_ADMISSION_QUEUED);
+      queued = true;
+    }
+
+    apr_sleep(delay);
+    delay = delay * 2 > ADMISSION_POLL_MAX ? ADMISSION_POLL_MAX : delay * 2;
+  }
+}
+
+void davrods_admission_release(const char *username) {
+  if (!admission.table)
+    return;
+
+  if (!admission_lock(admission.server))
+    return;
+
+  admission_user_t *user = find_user(username);
+  admission_holder_t *holder =
+      find_permit(user ? (int)(user - admission.table->users) : -1);
+
+  if (holder) {
+    if (holder->user >= 0 && admission.table->users[holder->user].active)
+      admission.table->users[holder->user].active--;
+    holder->pid = 0;
+  } else if (user && user->active) {
+    user->active--;
+  }
+  if (admission.table->active)
+    admission.table->active--;
+
+  admission_unlock(admission.server);
+}
+
+bool davrods_admission_refused(request_rec *r) {
+  return apr_table_get(r->notes, "davrods-admission-refused") != NULL;
+}
+
+static int admission_status_hook(request_rec *r, int flags) {
+  if (!admission.table)
+    return OK;
+
+  // Racy reads are good enough for monitoring.
+  apr_uint32_t active = admission.table->active;
+  apr_uint32_t waiting = admission.table->waiting;
+
+  if (flags & AP_STATUS_SHORT) {
+    ap_rprintf(r, "DavrodsConnectionsAdmitted: %u\n", active);
+    ap_rprintf(r, "DavrodsConnectionsQueued: %u\n", waiting);
+  } else {
+    ap_rputs("<h2>Davrods connection admission</h2>\n<table>\n", r);
+    ap_rprintf(r, "<tr><td>ConnectionsAdmitted</td><td>%u</td></tr>\n",
+               active);
+    ap_rprintf(r, "<tr><td>ConnectionsQueued</td><td>%u</td></tr>\n",
+               waiting);
+    ap_rputs("</table>\n", r);
+  }
+
+  return OK;
+}
+
+/**
+ * \brief Return the permits of a child process that exited without returning
+ *        them, e.g. because it crashed.
+ *
+ * Runs in the parent process.
+ */
+static void admission_child_status(server_rec *s, pid_t pid,
+                                   ap_generation_t gen, int slot,
+                                   mpm_child_status status) {
+  if (!admission.table || status != MPM_CHILD_EXITED)
+    return;
+
+  if (!admission_lock(s))
+    return;
+
+  int permits = 0;
+  int queued = 0;
+  for (int i = 0; i < ADMISSION_HOLDER_SLOTS; ++i) {
+    admission_holder_t *holder = &admission.table->holders[i];
+    if (holder->pid != pid)
+      continue;
+
+    if (holder->queued) {
+      if (admission.table->waiting)
+        admission.table->waiting--;
+      ++queued;
+    } else {
+      if (holder->user >= 0 && admission.table->users[holder->user].active)
+        admission.table->users[holder->user].active--;
+      if (admission.table->active)
+        admission.table->active--;
+      ++permits;
+    }
+    holder->pid = 0;
+  }
+
+  admission_unlock(s);
+
+  if (permits || queued)
+    ap_log_error(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, s,
+                 "Reclaimed %d iRODS connection permit(s) and %d queued "
+                 "request(s) of exited child process %" APR_PID_T_FMT,
+                 permits, queued, pid);
+}
+
+static int admission_pre_config(apr_pool_t *pconf, apr_pool_t *plog,
+                                apr_pool_t *ptemp) {
+  apr_status_t status = ap_mutex_register(pconf, ADMISSION_MUTEX_TYPE, NULL,
+                                          APR_LOCK_DEFAULT, 0);
+  if (status != APR_SUCCESS) {
+    ap_log_perror(APLOG_MARK, APLOG_CRIT, status, plog,
+                  "Could not register the admission mutex type");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  return OK;
+}
+
+static int admission_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+                                 apr_pool_t *ptemp, server_rec *s) {
+  admission.table = NULL;
+  admission.lock = NULL;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(s->module_config, &davrods_module);
+  assert(conf);
+
+  int limit = DAVRODS_SERVER_CONF(conf, conn_limit);
+  int limit_per_user = DAVRODS_SERVER_CONF(conf, conn_limit_per_user);
+  int queue_size = DAVRODS_SERVER_CONF(conf, conn_queue_size);
+
+  admission.limit = limit > 0 ? limit : 0;
+  admission.limit_per_user = limit_per_user > 0 ? limit_per_user : 0;
+  admission.queue_size = queue_size > 0 ? queue_size : 0;
+  admission.queue_timeout =
+      apr_time_from_sec(DAVRODS_SERVER_CONF(conf, conn_queue_timeout));
+
+  if (!admission.limit && !admission.limit_per_user)
+    return OK;
+
+  apr_shm_t *shm = NULL;
+  apr_status_t status =
+      apr_shm_create(&shm, sizeof(admission_table_t), NULL, pconf);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not create shared memory for connection admission");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  status = ap_global_mutex_create(&admission.lock, NULL, ADMISSION_MUTEX_TYPE,
+                                  NULL, s, pconf, 0);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not create admission mutex");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  admission.table = apr_shm_baseaddr_get(shm);
+  memset(admission.table, 0, sizeof(admission_table_t));
+
+  return OK;
+}
+
+static void admission_child_init(apr_pool_t *p, server_rec *s) {
+  admission.server = s;
+  admission.pid = getpid();
+
+  if (!admission.lock)
+    return;
+
+  apr_status_t status = apr_global_mutex_child_init(
+      &admission.lock, apr_global_mutex_lockfile(admission.lock), p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_CRIT, status, s,
+                 "Could not attach to admission mutex, iRODS connections "
+                 "will not be capped");
+    admission.table = NULL;
+  }
+}
+
+void davrods_admission_register(apr_pool_t *p) {
+  ap_hook_pre_config(admission_pre_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_post_config(admission_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_child_init(admission_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_child_status(admission_child_status, NULL, NULL, APR_HOOK_MIDDLE);
+  APR_OPTIONAL_HOOK(ap, status_hook, admission_status_hook, NULL, NULL,
+                    APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,56 @@
+/**
+ * \file
+ * \brief     Admission control for iRODS connections.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_ADMISSION_H
+#define _DAVRODS_ADMISSION_H
+
+#include "mod_davrods.h"
+
+/**
+ * \brief Obtain permission to hold an iRODS connection for a user.
+ *
+ * With DavrodsConnectionLimit and/or DavrodsConnectionLimitPerUser, the
+ * number of iRODS connections held by sessions is capped across all child
+ * processes. When a cap is reached, the caller waits in a bounded queue
+ * (DavrodsConnectionQueue) for another session to release its connection.
+ *
+ * If no permit can be obtained, a Retry-After header is set on the
+ * response and the request is marked as refused (see
+ * davrods_admission_refused()).
+ *
+ * \return OK, or HTTP_SERVICE_UNAVAILABLE if the queue is full or the wait
+ *         timed out.
+ */
+int davrods_admission_acquire(request_rec *r, const char *username);
+
+/**
+ * \brief Return a permit obtained with davrods_admission_acquire().
+ */
+void davrods_admission_release(const char *username);
+
+/**
+ * \brief Check whether admission was refused during this request.
+ */
+bool davrods_admission_refused(request_rec *r);
+
+void davrods_admission_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_ADMISSION_H */
@@ -20,9 +20,23 @@
  * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "auth.h"
+#include "admission.h"
+#include "authcache.h"
 #include "common.h"
 #include "config.h"
-
+#include "connpool.h"
+#include "env.h"
+#include "multiplex.h"
+#include "servers.h"
+#include "session.h"
+#include "socket.h"
+#include "tls.h"
+
+#include <stdlib.h>
+
+#include <apr_base64.h>
+#include <apr_general.h>
+#include <apr_md5.h>
 #include <http_request.h>
 #include <mod_auth.h>
 
@@ -33,26 +47,13 @@
 APLOG_USE_MODULE(davrods);
 #endif
 
-/**
- * \brief iRODS connection cleanup function.
- *
- * \param mem a pointer to a rcComm_t struct.
- */
-static apr_status_t rods_conn_cleanup(void *mem) {
-  rcComm_t *rods_conn = (rcComm_t *)mem;
-  WHISPER("Closing iRODS connection at %p\n", rods_conn);
-
-  if (rods_conn)
-    rcDisconnect(rods_conn);
-
-  WHISPER("iRODS connection CLOSED\n");
-  return APR_SUCCESS;
-}
+// Provided by mod_authn_socache, if loaded.
+static APR_OPTIONAL_FN_TYPE(ap_authn_cache_store) *authn_cache_store = NULL;
 
 /**
  * \brief Perform an iRODS PAM login, return a temporary password.
  *
- * \param[in]  r            request record
+ * \param[in]  login        login context
  * \param[in]  rods_conn
  * \param[in]  password
  * \param[in]  ttl          temporary password ttl
@@ -60,28 +61,28 @@ static apr_status_t rods_conn_cleanup(void *mem) {
  *
  * \return an iRODS status code (0 on success)
  */
-static int do_rods_login_pam(request_rec *r, rcComm_t *rods_conn,
-                             const char *password, int ttl,
-                             char **tmp_password) {
+static int do_rods_login_pam(const davrods_login_t *login,
+                             rcComm_t *rods_conn, const char *password,
+                             int ttl, char **tmp_password) {
 
   // Perform a PAM login. The connection must be encrypted at this point.
 
   pamAuthRequestInp_t auth_req_params = {
-      .pamPassword = apr_pstrdup(r->pool, password),
-      .pamUser = apr_pstrdup(r->pool, rods_conn->proxyUser.userName),
+      .pamPassword = apr_pstrdup(login->pool, password),
+      .pamUser = apr_pstrdup(login->pool, rods_conn->proxyUser.userName),
       .timeToLive = ttl};
 
   pamAuthRequestOut_t *auth_req_result = NULL;
   int status = rcPamAuthRequest(rods_conn, &auth_req_params, &auth_req_result);
   if (status) {
-    ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, r,
-                  "rcPamAuthRequest failed: %d = %s", status,
-                  get_rods_error_msg(status));
+    ap_log_error(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, login->server,
+                 "rcPamAuthRequest failed: %d = %s", status,
+                 get_rods_error_msg(status));
     sslEnd(rods_conn);
     return status;
   }
 
-  *tmp_password = apr_pstrdup(r->pool, auth_req_result->irodsPamPassword);
+  *tmp_password = apr_pstrdup(login->pool, auth_req_result->irodsPamPassword);
 
   // Who owns auth_req_result? I guess that's us.
   // Better not forget to free its contents too.
@@ -96,71 +97,87 @@ static int do_rods_login_pam(request_rec *r, rcComm_t *rods_conn,
 /**
  * \brief Connect to iRODS and attempt to login.
  *
- * \param[in]  r         request record
+ * \param[in]  login        login context
+ * \param[in]  server       the iRODS server to connect to
  * \param[in]  username
  * \param[in]  password
+ * \param[in]  tmp_password a cached PAM temporary password to log in with
+ *                          instead of performing a PAM exchange, or NULL
  * \param[out] rods_conn will be filled with the new iRODS connection, if auth
  * is successful.
+ * \param[out] rejected  set to whether a denial was caused by the
+ *                       credentials (see davrods_is_credential_error())
  *
  * \return An authn status code, AUTH_GRANTED if successful.
+ *         AUTH_GENERAL_ERROR means that the server could not be reached.
  */
-static authn_status rods_login(request_rec *r, const char *username,
-                               const char *password, rcComm_t **rods_conn) {
+static authn_status rods_login(const davrods_login_t *login,
+                               const davrods_server_t *server,
+                               const char *username, const char *password,
+                               const char *tmp_password, rcComm_t **rods_conn,
+                               bool *rejected) {
+  *rejected = false;
+
   // Verify credentials lengths
 
   if (strlen(username) > 63) {
     // This is the NAME_LEN and DB_USERNAME_LEN limit set by iRODS.
-    ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
-                  "Username exceeded max name length (63)");
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "Username exceeded max name length (63)");
     return HTTP_INTERNAL_SERVER_ERROR;
   }
 
   if (strlen(password) > 63) {
-    ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
-                  "Password exceeds length limits (%lu vs 63)",
-                  strlen(password));
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "Password exceeds length limits (%lu vs 63)",
+                 strlen(password));
     return HTTP_INTERNAL_SERVER_ERROR;
   }
 
   // Get config.
-  davrods_dir_conf_t *conf =
-      ap_get_module_config(r->per_dir_config, &davrods_module);
-  assert(conf);
+  const davrods_dir_conf_t *conf = login->conf;
 
-  ap_log_rerror(
-      APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+  ap_log_error(
+      APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
       "Connecting to iRODS using address <%s:%d>, username <%s> and zone <%s>",
-      DAVRODS_CONF(conf, rods_host), DAVRODS_CONF(conf, rods_port), username,
-      DAVRODS_CONF(conf, rods_zone));
+      server->host, server->port, username, DAVRODS_CONF(conf, rods_zone));
 
   authn_status result = AUTH_USER_NOT_FOUND;
 
-  // Point the iRODS client library to the webserver's iRODS env file.
-  // setenv("IRODS_ENVIRONMENT_FILE", "/dev/null", 1);
-  setenv("IRODS_ENVIRONMENT_FILE", DAVRODS_CONF(conf, rods_env_file), 1);
-
-  // Set spOption variable so that the connection will be labelled as
-  // a Davrods connection in ips.
-  setenv("spOption", "Davrods", 1);
-
-  ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
-                "Using iRODS env file at <%s>",
-                getenv("IRODS_ENVIRONMENT_FILE"));
+  // The iRODS env file (see env.c) has been made active by our caller.
+  ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+               "Using iRODS env file at <%s>",
+               DAVRODS_CONF(conf, rods_env_file));
 
   rErrMsg_t rods_errmsg;
-  *rods_conn =
-      rcConnect(DAVRODS_CONF(conf, rods_host), DAVRODS_CONF(conf, rods_port),
-                username, DAVRODS_CONF(conf, rods_zone), 0, &rods_errmsg);
+  apr_time_t connect_start = apr_time_now();
+  *rods_conn = rcConnect(server->host, server->port, username,
+                         DAVRODS_CONF(conf, rods_zone), 0, &rods_errmsg);
 
   if (*rods_conn) {
-    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
-                  "Successfully connected to iRODS zone '%s'",
-                  DAVRODS_CONF(conf, rods_zone));
-    miscSvrInfo_t *server_info = NULL;
-    rcGetMiscSvrInfo(*rods_conn, &server_info);
+    davrods_servers_connected(server, apr_time_now() - connect_start);
+    davrods_socket_tune(login, *rods_conn);
+
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Successfully connected to iRODS zone '%s'",
+                 DAVRODS_CONF(conf, rods_zone));
+
+    // Server info is only used for logging, ask for it once per server.
+    char version[NAME_LEN];
+    if (!davrods_servers_get_version(server, version, sizeof(version))) {
+      miscSvrInfo_t *server_info = NULL;
+      int status = rcGetMiscSvrInfo(*rods_conn, &server_info);
+      if (status >= 0 && server_info) {
+        apr_cpystrn(version, server_info->relVersion, sizeof(version));
+        davrods_servers_set_version(server, version);
+      } else {
+        strcpy(version, "unknown");
+      }
+      free(server_info);
+    }
 
-    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r, "Server version: %s",
-                  server_info->relVersion);
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Server version: %s", version);
 
     // Whether to use SSL for the entire connection.
     // Note: SSL is always in effect during PAM auth, regardless of negotiation
@@ -174,18 +191,18 @@ static authn_status rods_login(request_rec *r, const char *username,
       // Negotiation was disabled or resulted in CS_NEG_USE_TCP (i.e. no SSL).
     }
 
-    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
-                  "SSL negotiation result: <%s>: %s",
-                  (*rods_conn)->negotiation_results,
-                  use_ssl ? "will use SSL for the entire connection"
-                          : "will NOT use SSL (if using PAM, SSL will only be "
-                            "used during auth)");
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "SSL negotiation result: <%s>: %s",
+                 (*rods_conn)->negotiation_results,
+                 use_ssl ? "will use SSL for the entire connection"
+                         : "will NOT use SSL (if using PAM, SSL will only be "
+                           "used during auth)");
 
-    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
-                  "Is SSL currently on? (ssl* = %d, ssl_on = %d)"
-                  " (ignore ssl_on, it seems 4.x does not update it after SSL "
-                  "is turned on automatically during rcConnect)",
-                  (*rods_conn)->ssl ? 1 : 0, (*rods_conn)->ssl_on);
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Is SSL currently on? (ssl* = %d, ssl_on = %d)"
+                 " (ignore ssl_on, it seems 4.x does not update it after SSL "
+                 "is turned on automatically during rcConnect)",
+                 (*rods_conn)->ssl ? 1 : 0, (*rods_conn)->ssl_on);
 
     if (use_ssl) {
       // Verify that SSL is in effect in compliance with the
@@ -193,65 +210,79 @@ static authn_status rods_login(request_rec *r, const char *username,
       // information (password or data) to be sent in the clear.
 
       if (!(*rods_conn)->ssl) {
-        ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
-                      "SSL should have been turned on at this point "
-                      "(negotiation result was <%s>)."
-                      " Aborting for security reasons.",
-                      (*rods_conn)->negotiation_results);
+        ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                     "SSL should have been turned on at this point "
+                     "(negotiation result was <%s>)."
+                     " Aborting for security reasons.",
+                     (*rods_conn)->negotiation_results);
         return HTTP_INTERNAL_SERVER_ERROR;
       }
     }
 
     // If the negotiation result requires plain TCP, but we are
     // using the PAM auth scheme, we need to turn on SSL during
-    // auth.
-    if (!use_ssl && DAVRODS_CONF(conf, rods_auth_scheme) == DAVRODS_AUTH_PAM) {
+    // auth. A cached temporary password is sent like a native password.
+    if (!use_ssl && DAVRODS_CONF(conf, rods_auth_scheme) == DAVRODS_AUTH_PAM &&
+        !tmp_password) {
       if ((*rods_conn)->ssl) {
         // This should not happen.
         // In this situation we don't know if we should stop
         // SSL after PAM auth or keep it on, so we fail
         // instead.
-        ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
-                      "SSL should NOT have been turned on at this point "
-                      "(negotiation result was <%s>). Aborting.",
-                      (*rods_conn)->negotiation_results);
+        ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                     "SSL should NOT have been turned on at this point "
+                     "(negotiation result was <%s>). Aborting.",
+                     (*rods_conn)->negotiation_results);
 
         return HTTP_INTERNAL_SERVER_ERROR;
       }
-      ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
-                    "Enabling SSL for PAM auth");
+      ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                   "Enabling SSL for PAM auth");
 
-      int status = sslStart(*rods_conn);
+      int status = davrods_tls_start(login, *rods_conn);
       if (status) {
-        ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
-                      "sslStart for PAM failed: %d = %s", status,
-                      get_rods_error_msg(status));
+        ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                     "Starting SSL for PAM failed: %d = %s", status,
+                     get_rods_error_msg(status));
 
         return HTTP_INTERNAL_SERVER_ERROR;
       }
     }
 
-    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r, "Logging in");
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Logging in");
 
     // clientLoginWithPassword()'s signature specifies a WRITABLE password
     // parameter. I don't expect it to actually write to this field, but we'll
     // play it safe and pass it a temporary buffer.
     //
     // This password field will be destroyed at the end of the HTTP request.
-    char *password_buf = apr_pstrdup(r->pool, password);
+    char *password_buf = apr_pstrdup(login->pool, password);
 
     int status = 0;
 
-    if (DAVRODS_CONF(conf, rods_auth_scheme) == DAVRODS_AUTH_PAM) {
-      char *tmp_password = NULL;
-      status =
-          do_rods_login_pam(r, *rods_conn, password_buf,
-                            DAVRODS_CONF(conf, rods_auth_ttl), &tmp_password);
+    if (DAVRODS_CONF(conf, rods_auth_scheme) == DAVRODS_AUTH_PAM &&
+        tmp_password) {
+      ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                   "Using cached PAM temporary password");
+      password_buf = apr_pstrdup(login->pool, tmp_password);
+      status = clientLoginWithPassword(*rods_conn, password_buf);
+
+    } else if (DAVRODS_CONF(conf, rods_auth_scheme) == DAVRODS_AUTH_PAM) {
+      char *new_tmp_password = NULL;
+      status = do_rods_login_pam(login, *rods_conn, password_buf,
+                                 DAVRODS_CONF(conf, rods_auth_ttl),
+                                 &new_tmp_password);
       if (!status) {
-        password_buf = apr_pstrdup(r->pool, tmp_password);
+        password_buf = apr_pstrdup(login->pool, new_tmp_password);
 
         // Login using the received temporary password.
         status = clientLoginWithPassword(*rods_conn, password_buf);
+
+        // Save the temporary password for later logins.
+        if (!status)
+          davrods_authcache_put_pam_password(login, username, password,
+                                             new_tmp_password);
       }
 
     } else if (DAVRODS_CONF(conf, rods_auth_scheme) == DAVRODS_AUTH_NATIVE) {
@@ -262,55 +293,181 @@ static authn_status rods_login(request_rec *r, const char *username,
     }
 
     if (status) {
-      ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
-                    "Login failed: %d = %s", status,
-                    get_rods_error_msg(status));
+      ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                   "Login failed: %d = %s", status,
+                   get_rods_error_msg(status));
       result = AUTH_DENIED;
+      *rejected = davrods_is_credential_error(status);
 
-      rcDisconnect(*rods_conn);
+      davrods_servers_disconnect(*rods_conn);
       *rods_conn = NULL;
 
     } else {
-      ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
-                    "Login successful");
+      ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                   "Login successful");
       result = AUTH_GRANTED;
 
       // Disable SSL if it was in effect during auth but negotiation (or lack
       // thereof) demanded plain TCP for the rest of the connection.
       if (!use_ssl && (*rods_conn)->ssl) {
-        ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
-                      "Disabling SSL (was used for PAM only)");
+        ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                     "Disabling SSL (was used for PAM only)");
 
         if (DAVRODS_CONF(conf, rods_auth_scheme) != DAVRODS_AUTH_PAM) {
           // This should not happen.
-          ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, r,
-                        "SSL was turned on, but not for PAM."
-                        " This conflicts with the negotiation result (%s)!",
-                        (*rods_conn)->negotiation_results);
+          ap_log_error(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, login->server,
+                       "SSL was turned on, but not for PAM."
+                       " This conflicts with the negotiation result (%s)!",
+                       (*rods_conn)->negotiation_results);
         }
         status = sslEnd(*rods_conn);
         if (status) {
-          ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
-                        "sslEnd failed after PAM auth: %d = %s", status,
-                        get_rods_error_msg(status));
+          ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                       "sslEnd failed after PAM auth: %d = %s", status,
+                       get_rods_error_msg(status));
 
           return HTTP_INTERNAL_SERVER_ERROR;
         }
       }
     }
   } else {
-    ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
-                  "Could not connect to iRODS using address <%s:%d>,"
-                  " username <%s> and zone <%s>. iRODS says: '%s'",
-                  DAVRODS_CONF(conf, rods_host), DAVRODS_CONF(conf, rods_port),
-                  username, DAVRODS_CONF(conf, rods_zone), rods_errmsg.msg);
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "Could not connect to iRODS using address <%s:%d>,"
+                 " username <%s> and zone <%s>. iRODS says: '%s'",
+                 server->host, server->port, username,
+                 DAVRODS_CONF(conf, rods_zone), rods_errmsg.msg);
+
+    davrods_servers_connect_failed(server);
+    return AUTH_GENERAL_ERROR;
+  }
 
-    return HTTP_INTERNAL_SERVER_ERROR;
+  return result;
+}
+
+/**
+ * \brief Log in, using a cached PAM temporary password if possible.
+ *
+ * When iRODS rejects a cached temporary password (e.g. because it was revoked
+ * or the iRODS server was reset), it is dropped from the cache and a full PAM
+ * login is performed instead.
+ *
+ * See rods_login() for parameters.
+ */
+static authn_status rods_login_cached(const davrods_login_t *login,
+                                      const davrods_server_t *server,
+                                      const char *username,
+                                      const char *password,
+                                      rcComm_t **rods_conn, bool *rejected) {
+  const davrods_dir_conf_t *conf = login->conf;
+
+  char *tmp_password = NULL;
+  if (DAVRODS_CONF(conf, rods_auth_scheme) != DAVRODS_AUTH_PAM ||
+      !davrods_authcache_get_pam_password(login, username, password,
+                                          &tmp_password))
+    return rods_login(login, server, username, password, NULL, rods_conn,
+                      rejected);
+
+  authn_status result = rods_login(login, server, username, password,
+                                   tmp_password, rods_conn, rejected);
+
+  if (result == AUTH_DENIED) {
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Cached PAM temporary password was rejected, performing a "
+                 "full PAM login");
+    davrods_authcache_remove_pam_password(login, username, password);
+    result = rods_login(login, server, username, password, NULL, rods_conn,
+                        rejected);
   }
 
   return result;
 }
 
+/**
+ * \brief Connect to iRODS as the proxy mode service account, on behalf of a
+ *        user.
+ *
+ * The user's credentials must have been verified beforehand. iRODS performs
+ * all operations on the resulting connection as the client user, with the
+ * service account (which must be a rodsadmin) acting as proxy user.
+ *
+ * \param[in]  login     login context
+ * \param[in]  server    the iRODS server to connect to
+ * \param[in]  username  the client user
+ * \param[out] rods_conn will be filled with the new iRODS connection, if auth
+ * is successful.
+ *
+ * \return An authn status code, AUTH_GRANTED if successful.
+ */
+static authn_status rods_login_proxy(const davrods_login_t *login,
+                                     const davrods_server_t *server,
+                                     const char *username,
+                                     rcComm_t **rods_conn) {
+  const davrods_dir_conf_t *conf = login->conf;
+
+  const char *proxy_username = DAVRODS_CONF(conf, proxy_auth_username);
+  if (!strlen(proxy_username)) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "Proxy mode is enabled, but no proxy login is configured");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+               "Connecting to iRODS as proxy user <%s> for client user <%s>",
+               proxy_username, username);
+
+  rErrMsg_t rods_errmsg;
+  apr_time_t connect_start = apr_time_now();
+  *rods_conn = _rcConnect(server->host, server->port, proxy_username,
+                          DAVRODS_CONF(conf, rods_zone), username,
+                          DAVRODS_CONF(conf, rods_zone), &rods_errmsg, 0, 0);
+
+  if (!*rods_conn) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "Could not connect to iRODS using address <%s:%d>,"
+                 " proxy user <%s> and zone <%s>. iRODS says: '%s'",
+                 server->host, server->port, proxy_username,
+                 DAVRODS_CONF(conf, rods_zone), rods_errmsg.msg);
+    davrods_servers_connect_failed(server);
+    return AUTH_GENERAL_ERROR;
+  }
+
+  davrods_servers_connected(server, apr_time_now() - connect_start);
+  davrods_socket_tune(login, *rods_conn);
+
+  // As in rods_login(): never send the password in the clear when
+  // negotiation demanded SSL.
+  if (!strcmp((*rods_conn)->negotiation_results, "CS_NEG_USE_SSL") &&
+      !(*rods_conn)->ssl) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "SSL should have been turned on at this point "
+                 "(negotiation result was <%s>)."
+                 " Aborting for security reasons.",
+                 (*rods_conn)->negotiation_results);
+    davrods_servers_disconnect(*rods_conn);
+    *rods_conn = NULL;
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  // The service account always uses native authentication.
+  char *password_buf =
+      apr_pstrdup(login->pool, DAVRODS_CONF(conf, proxy_auth_password));
+
+  int status = clientLoginWithPassword(*rods_conn, password_buf);
+  if (status) {
+    // This is a configuration problem, not something the user can fix.
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "Proxy login as <%s> failed: %d = %s", proxy_username,
+                 status, get_rods_error_msg(status));
+    davrods_servers_disconnect(*rods_conn);
+    *rods_conn = NULL;
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+               "Proxy login successful");
+  return AUTH_GRANTED;
+}
+
 // Check whether an open iRODS connection from a previous request can be reused
 // by a HTTP keepalive request.
 // For this to be permissible, we require that the current Davrods
@@ -319,7 +476,8 @@ static authn_status rods_login(request_rec *r, const char *username,
 //
 // 1. We must be using the same iRODS authentication scheme
 // 2. Our anonymous mode switches must be the same
-// 3. We must be using the same username with the same password
+// 3. Our proxy mode switches must be the same
+// 4. We must be using the same username with the same password
 //
 // This function is called in the following situations:
 // - From `check_rods` during HTTP basic auth when an existing connection is
@@ -347,12 +505,8 @@ bool davrods_user_can_reuse_connection(request_rec *r, const char *username,
   if (status || !pool)
     return false; // No pool yet.
 
-  rcComm_t *rods_conn = NULL;
-  status = apr_pool_userdata_get(&m, "rods_conn", pool);
-  rods_conn = (rcComm_t *)m;
-
-  if (status || !rods_conn)
-    return false; // No iRODS connection set up yet.
+  if (!davrods_session_get(pool))
+    return false; // No iRODS session set up yet.
 
   davrods_session_parameters_t *session_params = NULL;
   status =
@@ -367,6 +521,10 @@ bool davrods_user_can_reuse_connection(request_rec *r, const char *username,
     return false; // Disallow reusing a PAM authed connection for
                   // Native authed access and vice versa.
 
+  if (session_params->proxy_mode != DAVRODS_CONF(conf, proxy_mode))
+    return false; // Disallow reusing a proxied connection in a location
+                  // that does not allow proxying and vice versa.
+
   char *current_username = NULL;
   status = apr_pool_userdata_get((void **)&current_username, "username", pool);
   assert(!status && current_username);
@@ -385,6 +543,65 @@ bool davrods_user_can_reuse_connection(request_rec *r, const char *username,
   return true;
 }
 
+bool davrods_auth_use_proxy(const davrods_login_t *login, const char *username,
+                            const char *password) {
+  const davrods_dir_conf_t *conf = login->conf;
+
+  // In proxy mode, users whose credentials were recently accepted by iRODS
+  // are served through the service account, without a login of their own.
+  return DAVRODS_CONF(conf, proxy_mode) == DAVRODS_PROXY_MODE_ON &&
+         davrods_authcache_check_verified(login, username, password);
+}
+
+authn_status davrods_auth_connect(const davrods_login_t *login,
+                                  const char *username,
+                                  const char *password, bool proxy,
+                                  rcComm_t **rods_conn, bool *rejected) {
+  const davrods_dir_conf_t *conf = login->conf;
+  authn_status result = AUTH_USER_NOT_FOUND;
+  *rods_conn = NULL;
+
+  bool rejected_buf = false;
+  if (!rejected)
+    rejected = &rejected_buf;
+  *rejected = false;
+
+  // Try another server if the chosen one cannot be reached.
+  const davrods_server_t *failed_server = NULL;
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    const davrods_server_t *server =
+        davrods_servers_pick(login, username, failed_server);
+    if (!server)
+      break;
+
+    davrods_env_acquire(login);
+    if (proxy)
+      result = rods_login_proxy(login, server, username, rods_conn);
+    else
+      result = rods_login_cached(login, server, username, password, rods_conn,
+                                 rejected);
+    davrods_env_release(login);
+
+    if (result != AUTH_GENERAL_ERROR)
+      break;
+    failed_server = server;
+  }
+
+  // Some failures occur after the connection was set up.
+  if (result != AUTH_GRANTED && *rods_conn) {
+    davrods_servers_disconnect(*rods_conn);
+    *rods_conn = NULL;
+  }
+
+  if (result == AUTH_GRANTED && !proxy &&
+      DAVRODS_CONF(conf, proxy_mode) == DAVRODS_PROXY_MODE_ON)
+    davrods_authcache_set_verified(
+        login, username, password,
+        apr_time_from_sec(DAVRODS_CONF(conf, proxy_verify_ttl)));
+
+  return result;
+}
+
 authn_status check_rods(request_rec *r, const char *username,
                         const char *password, bool is_basic_auth) {
   int status;
@@ -410,6 +627,8 @@ authn_status check_rods(request_rec *r, const char *username,
   if (status || !pool) {
     // We create a davrods pool as a child of the connection pool.
     // iRODS sessions last at most as long as the client's TCP connection.
+    // When the session ends, its iRODS connection is handed to the
+    // connection pool (see connpool.c) for reuse by later sessions.
     //
     // Using our own pool ensures that we can easily clear it (= close the
     // iRODS connection and free related resources) when a client reuses
@@ -432,13 +651,11 @@ authn_status check_rods(request_rec *r, const char *username,
                           r->connection->pool);
   }
 
-  // We have a pool, now try to extract its iRODS connection.
+  // We have a pool, now check whether it holds an iRODS session.
   rcComm_t *rods_conn = NULL;
-  status = apr_pool_userdata_get(&m, "rods_conn", pool);
-  rods_conn = (rcComm_t *)m;
 
-  if (!status && rods_conn) {
-    // We have an open iRODS connection with an authenticated user.
+  if (davrods_session_get(pool)) {
+    // We have an iRODS session with an authenticated user.
     // Can we safely reuse it for this request?
     bool can_reuse = davrods_user_can_reuse_connection(r, username, password);
 
@@ -471,34 +688,91 @@ authn_status check_rods(request_rec *r, const char *username,
                     "Closing existing iRODS connection for user '%s'"
                     " (need new connection for user '%s')",
                     current_username, username);
-      // This should run the cleanup function for rods_conn, rcDisconnect.
+      // This runs the cleanup function of the session, which hands the
+      // connection to the connection pool.
       apr_pool_clear(pool);
-      rods_conn = NULL;
     }
-  } else {
-    rods_conn = NULL;
   }
 
   if (result == AUTH_USER_NOT_FOUND) {
     // User is not yet authenticated.
 
-    result = rods_login(r, username, password, &rods_conn);
+    // Recently rejected, don't bother iRODS (and PAM) again. This is checked
+    // first, so that a refused client does not hold an admission permit or
+    // a pooled connection, nor wait for one.
+    if (is_basic_auth &&
+        davrods_authcache_login_blocked(r, username, password))
+      return AUTH_DENIED;
+
+    davrods_login_t login;
+    davrods_login_from_request(&login, r);
+
+    bool proxy = davrods_auth_use_proxy(&login, username, password);
+
+    // Look for a connection that an earlier HTTP connection authenticated
+    // with the same parameters.
+    davrods_connpool_key_t key;
+    davrods_connpool_make_key(&login, username, proxy ? NULL : password,
+                              &key);
+
+    // The iRODS env is parsed once at startup and shared by all sessions.
+    rodsEnv *env = davrods_env_get(conf);
+    if (!env) {
+      ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, r,
+                    "iRODS env file at <%s> could not be loaded",
+                    DAVRODS_CONF(conf, rods_env_file));
+      return HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    // Other HTTP/2 streams of this client may have a connection to spare.
+    // It comes with an admission permit.
+    davrods_multiplex_t *multiplex = davrods_multiplex_get(r->connection);
+    if (multiplex)
+      rods_conn = davrods_multiplex_checkout(r, multiplex, &key);
+
+    if (!rods_conn) {
+      // The new session will hold an iRODS connection, wait for our turn.
+      status = davrods_admission_acquire(r, username);
+      if (status != OK) {
+        if (multiplex)
+          davrods_multiplex_cancel(multiplex);
+        // Have mod_auth_basic answer with our status (503) instead of 500.
+        r->status = status;
+        return AUTH_HANDLED;
+      }
+      rods_conn = davrods_connpool_checkout(r, &key);
+    }
+
+    if (rods_conn) {
+      result = AUTH_GRANTED;
+    } else {
+      // Only count logins that iRODS refused because of the credentials.
+      // Failures of e.g. a PAM backend must not lock out users.
+      bool rejected = false;
+      result = davrods_auth_connect(&login, username, password, proxy,
+                                    &rods_conn, &rejected);
+      if (result == AUTH_DENIED && rejected && is_basic_auth)
+        davrods_authcache_login_failed(r, username, password);
+    }
+
+    if (result != AUTH_GRANTED) {
+      davrods_admission_release(username);
+      if (multiplex)
+        davrods_multiplex_cancel(multiplex);
+    }
+
     if (result == AUTH_GRANTED) {
       assert(rods_conn);
 
       char *username_buf = apr_pstrdup(pool, username);
       char *password_buf = apr_pstrdup(pool, password);
 
-      apr_pool_userdata_set(rods_conn, "rods_conn", rods_conn_cleanup, pool);
+      davrods_session_create(r, pool, &key, username, rods_conn);
       apr_pool_userdata_set(username_buf, "username", apr_pool_cleanup_null,
                             pool);
       apr_pool_userdata_set(password_buf, "password", apr_pool_cleanup_null,
                             pool);
 
-      // Get iRODS env and store it.
-      rodsEnv *env = apr_palloc(pool, sizeof(rodsEnv));
-      assert((status = getRodsEnv(env)) >= 0);
-
       apr_pool_userdata_set(env, "env", apr_pool_cleanup_null, pool);
 
       // Store authentication info.
@@ -507,6 +781,7 @@ authn_status check_rods(request_rec *r, const char *username,
       assert(session_params);
       session_params->auth_scheme = DAVRODS_CONF(conf, rods_auth_scheme);
       session_params->anon_mode = DAVRODS_CONF(conf, anonymous_mode);
+      session_params->proxy_mode = DAVRODS_CONF(conf, proxy_mode);
       apr_pool_userdata_set(session_params, "session_params",
                             apr_pool_cleanup_null, pool);
 
@@ -523,15 +798,54 @@ authn_status check_rods(request_rec *r, const char *username,
   return result;
 }
 
+/**
+ * \brief Offer verified credentials to mod_authn_socache.
+ *
+ * With "AuthnCacheProvideFor irods", later requests with the same
+ * credentials are then authenticated without running our provider at all.
+ * The iRODS connection is set up only when it is needed (see
+ * get_davrods_pool() in repo.c).
+ */
+static void cache_credentials(request_rec *r, const char *username,
+                              const char *password) {
+  if (!authn_cache_store)
+    return;
+
+  // mod_authn_socache validates cached passwords with apr_password_validate,
+  // so we hand it a salted MD5-crypt hash.
+  unsigned char salt_bytes[6];
+  if (apr_generate_random_bytes(salt_bytes, sizeof(salt_bytes)) !=
+      APR_SUCCESS)
+    return;
+
+  char salt[9];
+  apr_base64_encode(salt, (const char *)salt_bytes, sizeof(salt_bytes));
+
+  char hash[120];
+  if (apr_md5_encode(password, salt, hash, sizeof(hash)) != APR_SUCCESS)
+    return;
+
+  authn_cache_store(r, "irods", username, NULL, hash);
+}
+
 authn_status basic_auth_irods(request_rec *r, const char *username,
                               const char *password) {
-  return check_rods(r, username, password, true);
+  authn_status result = check_rods(r, username, password, true);
+  if (result == AUTH_GRANTED)
+    cache_credentials(r, username, password);
+  return result;
 }
 
 static const authn_provider authn_rods_provider = {&basic_auth_irods, NULL};
 
+static void auth_optional_fn_retrieve(void) {
+  authn_cache_store = APR_RETRIEVE_OPTIONAL_FN(ap_authn_cache_store);
+}
+
 void davrods_auth_register(apr_pool_t *p) {
   ap_register_auth_provider(p, AUTHN_PROVIDER_GROUP, "irods",
                             AUTHN_PROVIDER_VERSION, &authn_rods_provider,
                             AP_AUTH_INTERNAL_PER_CONF);
+  ap_hook_optional_fn_retrieve(auth_optional_fn_retrieve, NULL, NULL,
+                               APR_HOOK_MIDDLE);
 }
@@ -23,11 +23,42 @@
 #define _DAVRODS_AUTH_H
 
 #include "mod_davrods.h"
+#include "config.h"
 #include <mod_auth.h>
 
+#include <irods/rodsClient.h>
+
 authn_status check_rods(request_rec *r, const char *username,
                         const char *password, bool is_basic_auth);
 
+/**
+ * \brief Check whether a user's session should be served through the proxy
+ *        mode service account.
+ */
+bool davrods_auth_use_proxy(const davrods_login_t *login, const char *username,
+                            const char *password);
+
+/**
+ * \brief Open and authenticate a new iRODS connection, bypassing the
+ *        connection pool.
+ *
+ * \param[in]  login
+ * \param[in]  username
+ * \param[in]  password
+ * \param[in]  proxy     whether to log in through the proxy mode service
+ *                       account (see davrods_auth_use_proxy())
+ * \param[out] rods_conn the new connection, if auth is successful
+ * \param[out] rejected  if not NULL, set to whether iRODS refused the login
+ *                       because of the credentials (as opposed to e.g. a
+ *                       PAM backend failure)
+ *
+ * \return An authn status code, AUTH_GRANTED if successful.
+ */
+authn_status davrods_auth_connect(const davrods_login_t *login,
+                                  const char *username, const char *password,
+                                  bool proxy,
+                                  rcComm_t **rods_conn, bool *rejected);
+
 bool davrods_user_can_reuse_connection(request_rec *r, const char *username,
                                        const char *password);
 
@@ -0,0 +1,626 @@
+/**
+ * \file
+ * \brief     Shared cache of authentication results.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "authcache.h"
+#include "config.h"
+#include "stats.h"
+
+#include <ap_provider.h>
+#include <ap_socache.h>
+#include <apr_general.h>
+#include <apr_global_mutex.h>
+#include <util_mutex.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* A PAM login (rcPamAuthRequest) yields a temporary iRODS password that stays
+ * valid for the configured auth TTL. Normally it is used for a single login
+ * only. This cache keeps temporary passwords in shared memory (through
+ * mod_socache), so that later logins of the same user, from any child
+ * process, can skip the SSL upgrade and PAM exchange until the temporary
+ * password nears expiry.
+ *
+ * Entries are looked up by a salted hash of the login parameters, and their
+ * contents are encrypted with a key derived from the user's PAM password.
+ * Reading a temporary password from the cache therefore requires knowing the
+ * real password.
+ *
+ * In proxy mode, the same cache also records which credentials were recently
+ * accepted by iRODS. Such entries store a salted hash of the password only.
+ *
+ * Finally, the cache records failed logins, so that clients that keep
+ * retrying a wrong password are refused locally instead of costing an iRODS
+ * connection and a PAM exchange per attempt. Failure counters are updated
+ * without a lock if the provider is MP-safe. Concurrent failures may then be
+ * undercounted, which only makes the limits slightly more lenient.
+ */
+
+#define AUTHCACHE_MUTEX_TYPE "davrods-authcache"
+
+#define AUTHCACHE_IV_LEN 12
+#define AUTHCACHE_TAG_LEN 16
+#define AUTHCACHE_MAX_PASSWORD_LEN 128
+#define AUTHCACHE_DIGEST_LEN 32 // SHA-256.
+
+static struct {
+  const ap_socache_provider_t *provider;
+  ap_socache_instance_t *instance;
+  apr_global_mutex_t *lock; // Only for providers that are not MP-safe.
+  unsigned char salt[16];
+} authcache;
+
+// Hashing and encryption {{{
+
+/**
+ * \brief Derive a digest from the login parameters for the given purpose.
+ *
+ * Different purposes ("id", "key") yield unrelated digests, so that cache
+ * entry ids cannot be used to decrypt cache entries.
+ */
+static bool derive(const davrods_login_t *login, const char *purpose,
+                   const char *username, const char *password,
+                   unsigned char digest[AUTHCACHE_DIGEST_LEN]) {
+  const davrods_dir_conf_t *conf = login->conf;
+
+  const char *fields[] = {
+      purpose,
+      DAVRODS_CONF(conf, rods_host),
+      apr_itoa(login->pool, DAVRODS_CONF(conf, rods_port)),
+      DAVRODS_CONF(conf, rods_zone),
+      username,
+      password,
+  };
+
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  if (!ctx)
+    return false;
+
+  bool ok = EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) &&
+            EVP_DigestUpdate(ctx, authcache.salt, sizeof(authcache.salt));
+
+  // Include NUL terminators so that field boundaries are part of the hash.
+  for (size_t i = 0; ok && i < sizeof(fields) / sizeof(*fields); ++i)
+    ok = EVP_DigestUpdate(ctx, fields[i], strlen(fields[i]) + 1);
+
+  ok = ok && EVP_DigestFinal_ex(ctx, digest, NULL);
+
+  EVP_MD_CTX_free(ctx);
+  return ok;
+}
+
+/**
+ * \brief Encrypt a temporary password with AES-256-GCM.
+ *
+ * \param[out] out  buffer of at least IV + tag + plaintext length bytes,
+ *                  receives the IV, the tag and the ciphertext, in that order
+ *
+ * \return the amount of bytes written to out, or 0 on failure
+ */
+static unsigned int encrypt_password(const unsigned char *key,
+                                     const unsigned char *id,
+                                     const char *tmp_password,
+                                     unsigned char *out) {
+  unsigned char *iv = out;
+  unsigned char *tag = out + AUTHCACHE_IV_LEN;
+  unsigned char *ciphertext = tag + AUTHCACHE_TAG_LEN;
+  int plain_len = (int)strlen(tmp_password);
+
+  if (apr_generate_random_bytes(iv, AUTHCACHE_IV_LEN) != APR_SUCCESS)
+    return 0;
+
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+  if (!ctx)
+    return 0;
+
+  int len = 0;
+  int final_len = 0;
+  // The entry id is authenticated as well, so that an entry cannot be moved
+  // to a different id.
+  bool ok =
+      EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) &&
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, AUTHCACHE_IV_LEN,
+                          NULL) &&
+      EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv) &&
+      EVP_EncryptUpdate(ctx, NULL, &len, id, AUTHCACHE_DIGEST_LEN) &&
+      EVP_EncryptUpdate(ctx, ciphertext, &len,
+                        (const unsigned char *)tmp_password, plain_len) &&
+      EVP_EncryptFinal_ex(ctx, ciphertext + len, &final_len) &&
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AUTHCACHE_TAG_LEN, tag);
+
+  EVP_CIPHER_CTX_free(ctx);
+
+  return ok ? AUTHCACHE_IV_LEN + AUTHCACHE_TAG_LEN + len + final_len : 0;
+}
+
+/**
+ * \brief Decrypt a cache entry created by encrypt_password().
+ *
+ * \return the temporary password allocated from pool, or NULL if the entry
+ *         could not be decrypted (e.g. a different password was used).
+ */
+static char *decrypt_password(apr_pool_t *pool, const unsigned char *key,
+                              const unsigned char *id, unsigned char *data,
+                              unsigned int data_len) {
+  if (data_len <= AUTHCACHE_IV_LEN + AUTHCACHE_TAG_LEN)
+    return NULL;
+
+  unsigned char *iv = data;
+  unsigned char *tag = data + AUTHCACHE_IV_LEN;
+  unsigned char *ciphertext = tag + AUTHCACHE_TAG_LEN;
+  int cipher_len = (int)(data_len - AUTHCACHE_IV_LEN - AUTHCACHE_TAG_LEN);
+
+  char *tmp_password = apr_palloc(pool, cipher_len + 1);
+  assert(tmp_password);
+
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+  if (!ctx)
+    return NULL;
+
+  int len = 0;
+  int final_len = 0;
+  bool ok =
+      EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) &&
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, AUTHCACHE_IV_LEN,
+                          NULL) &&
+      EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) &&
+      EVP_DecryptUpdate(ctx, NULL, &len, id, AUTHCACHE_DIGEST_LEN) &&
+      EVP_DecryptUpdate(ctx, (unsigned char *)tmp_password, &len, ciphertext,
+                        cipher_len) &&
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, AUTHCACHE_TAG_LEN, tag) &&
+      EVP_DecryptFinal_ex(ctx, (unsigned char *)tmp_password + len,
+                          &final_len) > 0;
+
+  EVP_CIPHER_CTX_free(ctx);
+
+  if (!ok)
+    return NULL;
+
+  tmp_password[len + final_len] = '\0';
+  return tmp_password;
+}
+
+// }}}
+// Cache access {{{
+
+static void authcache_lock(server_rec *s) {
+  if (authcache.lock) {
+    apr_status_t status = apr_global_mutex_lock(authcache.lock);
+    if (status != APR_SUCCESS)
+      ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                   "Could not lock the auth cache mutex");
+  }
+}
+
+static void authcache_unlock(server_rec *s) {
+  if (authcache.lock) {
+    apr_status_t status = apr_global_mutex_unlock(authcache.lock);
+    if (status != APR_SUCCESS)
+      ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                   "Could not unlock the auth cache mutex");
+  }
+}
+
+bool davrods_authcache_get_pam_password(const davrods_login_t *login,
+                                        const char *username,
+                                        const char *password,
+                                        char **tmp_password) {
+  if (!authcache.instance)
+    return false;
+
+  unsigned char id[AUTHCACHE_DIGEST_LEN];
+  unsigned char key[AUTHCACHE_DIGEST_LEN];
+  if (!derive(login, "id", username, password, id) ||
+      !derive(login, "key", username, password, key))
+    return false;
+
+  unsigned char data[AUTHCACHE_IV_LEN + AUTHCACHE_TAG_LEN +
+                     AUTHCACHE_MAX_PASSWORD_LEN];
+  unsigned int data_len = sizeof(data);
+
+  authcache_lock(login->server);
+  apr_status_t status =
+      authcache.provider->retrieve(authcache.instance, login->server, id,
+                                   sizeof(id), data, &data_len, login->pool);
+  authcache_unlock(login->server);
+
+  *tmp_password = NULL;
+  if (status == APR_SUCCESS)
+    *tmp_password = decrypt_password(login->pool, key, id, data, data_len);
+
+  if (*tmp_password) {
+    davrods_stats_inc(DAVRODS_STAT_PAM_CACHE_HIT);
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Found cached PAM temporary password for user '%s'",
+                 username);
+    return true;
+  } else {
+    davrods_stats_inc(DAVRODS_STAT_PAM_CACHE_MISS);
+    return false;
+  }
+}
+
+void davrods_authcache_put_pam_password(const davrods_login_t *login,
+                                        const char *username,
+                                        const char *password,
+                                        const char *tmp_password) {
+  if (!authcache.instance)
+    return;
+
+  if (strlen(tmp_password) > AUTHCACHE_MAX_PASSWORD_LEN) {
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Not caching PAM temporary password: too long");
+    return;
+  }
+
+  const davrods_dir_conf_t *conf = login->conf;
+
+  unsigned char id[AUTHCACHE_DIGEST_LEN];
+  unsigned char key[AUTHCACHE_DIGEST_LEN];
+  if (!derive(login, "id", username, password, id) ||
+      !derive(login, "key", username, password, key))
+    return;
+
+  unsigned char data[AUTHCACHE_IV_LEN + AUTHCACHE_TAG_LEN +
+                     AUTHCACHE_MAX_PASSWORD_LEN];
+  unsigned int data_len = encrypt_password(key, id, tmp_password, data);
+  if (!data_len) {
+    ap_log_error(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, login->server,
+                 "Could not encrypt PAM temporary password for caching");
+    return;
+  }
+
+  // Stop using the temporary password after 90% of its lifetime, so that it
+  // does not expire in the middle of a login.
+  apr_time_t expiry =
+      apr_time_now() +
+      apr_time_from_sec((apr_time_t)DAVRODS_CONF(conf, rods_auth_ttl) * 3600) /
+          10 * 9;
+
+  authcache_lock(login->server);
+  apr_status_t status = authcache.provider->store(
+      authcache.instance, login->server, id, sizeof(id), expiry, data,
+      data_len, login->pool);
+  authcache_unlock(login->server);
+
+  if (status != APR_SUCCESS)
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, status, login->server,
+                 "Could not cache PAM temporary password");
+}
+
+void davrods_authcache_remove_pam_password(const davrods_login_t *login,
+                                           const char *username,
+                                           const char *password) {
+  if (!authcache.instance)
+    return;
+
+  unsigned char id[AUTHCACHE_DIGEST_LEN];
+  if (!derive(login, "id", username, password, id))
+    return;
+
+  davrods_stats_inc(DAVRODS_STAT_PAM_CACHE_REJECTED);
+
+  authcache_lock(login->server);
+  authcache.provider->remove(authcache.instance, login->server, id, sizeof(id),
+                             login->pool);
+  authcache_unlock(login->server);
+}
+
+bool davrods_authcache_check_verified(const davrods_login_t *login,
+                                      const char *username,
+                                      const char *password) {
+  if (!authcache.instance)
+    return false;
+
+  unsigned char id[AUTHCACHE_DIGEST_LEN];
+  unsigned char verifier[AUTHCACHE_DIGEST_LEN];
+  if (!derive(login, "verified-id", username, "", id) ||
+      !derive(login, "verified", username, password, verifier))
+    return false;
+
+  unsigned char data[AUTHCACHE_DIGEST_LEN];
+  unsigned int data_len = sizeof(data);
+
+  authcache_lock(login->server);
+  apr_status_t status =
+      authcache.provider->retrieve(authcache.instance, login->server, id,
+                                   sizeof(id), data, &data_len, login->pool);
+  authcache_unlock(login->server);
+
+  // A mismatch means that a different password was verified for this user.
+  // The entry is left alone, so that wrong passwords cannot evict it.
+  bool verified = status == APR_SUCCESS && data_len == sizeof(verifier) &&
+                  !CRYPTO_memcmp(data, verifier, sizeof(verifier));
+
+  davrods_stats_inc(verified ? DAVRODS_STAT_PROXY_VERIFY_HIT
+                             : DAVRODS_STAT_PROXY_VERIFY_MISS);
+  return verified;
+}
+
+void davrods_authcache_set_verified(const davrods_login_t *login,
+                                    const char *username, const char *password,
+                                    apr_interval_time_t ttl) {
+  if (!authcache.instance)
+    return;
+
+  unsigned char id[AUTHCACHE_DIGEST_LEN];
+  unsigned char verifier[AUTHCACHE_DIGEST_LEN];
+  if (!derive(login, "verified-id", username, "", id) ||
+      !derive(login, "verified", username, password, verifier))
+    return;
+
+  authcache_lock(login->server);
+  apr_status_t status = authcache.provider->store(
+      authcache.instance, login->server, id, sizeof(id), apr_time_now() + ttl,
+      verifier, sizeof(verifier), login->pool);
+  authcache_unlock(login->server);
+
+  if (status != APR_SUCCESS)
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, status, login->server,
+                 "Could not cache verified credentials");
+}
+
+typedef struct {
+  apr_uint32_t failures;
+  apr_time_t until; // End of the backoff period or of the counting window.
+} failure_entry_t;
+
+static bool get_failures(const davrods_login_t *login, const unsigned char *id,
+                         failure_entry_t *entry) {
+  unsigned int data_len = sizeof(*entry);
+
+  authcache_lock(login->server);
+  apr_status_t status = authcache.provider->retrieve(
+      authcache.instance, login->server, id, AUTHCACHE_DIGEST_LEN,
+      (unsigned char *)entry, &data_len, login->pool);
+  authcache_unlock(login->server);
+
+  return status == APR_SUCCESS && data_len == sizeof(*entry);
+}
+
+static void put_failures(const davrods_login_t *login, const unsigned char *id,
+                         const failure_entry_t *entry, apr_time_t expiry) {
+  authcache_lock(login->server);
+  authcache.provider->store(authcache.instance, login->server, id,
+                            AUTHCACHE_DIGEST_LEN, expiry,
+                            (unsigned char *)entry, sizeof(*entry),
+                            login->pool);
+  authcache_unlock(login->server);
+}
+
+bool davrods_authcache_login_blocked(request_rec *r, const char *username,
+                                     const char *password) {
+  if (!authcache.instance)
+    return false;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(r->server->module_config, &davrods_module);
+  assert(conf);
+
+  davrods_login_t login;
+  davrods_login_from_request(&login, r);
+
+  apr_time_t now = apr_time_now();
+  unsigned char id[AUTHCACHE_DIGEST_LEN];
+  failure_entry_t entry;
+
+  int limit = DAVRODS_SERVER_CONF(conf, login_source_limit);
+  if (limit > 0 && derive(&login, "failed-source", r->useragent_ip, "", id) &&
+      get_failures(&login, id, &entry) && now < entry.until &&
+      entry.failures >= (apr_uint32_t)limit) {
+    ap_log_rerror(APLOG_MARK, APLOG_INFO, APR_SUCCESS, r,
+                  "Refusing login of user '%s': too many failed logins from "
+                  "this address",
+                  username);
+    davrods_stats_inc(DAVRODS_STAT_LOGIN_SOURCE_LIMITED);
+    return true;
+  }
+
+  if (DAVRODS_SERVER_CONF(conf, login_backoff) > 0 &&
+      derive(&login, "failed-id", username, password, id) &&
+      get_failures(&login, id, &entry) && now < entry.until) {
+    ap_log_rerror(APLOG_MARK, APLOG_INFO, APR_SUCCESS, r,
+                  "Refusing login of user '%s': these credentials were "
+                  "rejected %u time(s) recently",
+                  username, entry.failures);
+    davrods_stats_inc(DAVRODS_STAT_LOGIN_BACKOFF);
+    return true;
+  }
+
+  return false;
+}
+
+void davrods_authcache_login_failed(request_rec *r, const char *username,
+                                    const char *password) {
+  if (!authcache.instance)
+    return;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(r->server->module_config, &davrods_module);
+  assert(conf);
+
+  davrods_login_t login;
+  davrods_login_from_request(&login, r);
+
+  apr_time_t now = apr_time_now();
+  unsigned char id[AUTHCACHE_DIGEST_LEN];
+  failure_entry_t entry;
+
+  // Count failures per client address within a fixed window.
+  int window = DAVRODS_SERVER_CONF(conf, login_source_window);
+  if (DAVRODS_SERVER_CONF(conf, login_source_limit) > 0 &&
+      derive(&login, "failed-source", r->useragent_ip, "", id)) {
+    if (get_failures(&login, id, &entry) && now < entry.until) {
+      entry.failures++;
+    } else {
+      entry.failures = 1;
+      entry.until = now + apr_time_from_sec(window);
+    }
+    put_failures(&login, id, &entry, entry.until);
+  }
+
+  // Refuse the same credentials for a period that doubles with every
+  // failure. The failure count is forgotten after a quiet period.
+  int initial = DAVRODS_SERVER_CONF(conf, login_backoff);
+  int max = DAVRODS_SERVER_CONF(conf, login_backoff_max);
+  if (max < initial)
+    max = initial;
+  if (initial > 0 && derive(&login, "failed-id", username, password, id)) {
+    if (!get_failures(&login, id, &entry))
+      entry.failures = 0;
+    entry.failures++;
+
+    apr_int64_t backoff = initial;
+    for (apr_uint32_t i = 1; i < entry.failures && backoff < max; ++i)
+      backoff *= 2;
+    if (backoff > max)
+      backoff = max;
+
+    entry.until = now + apr_time_from_sec(backoff);
+    put_failures(&login, id, &entry, entry.until + apr_time_from_sec(max));
+  }
+}
+
+// }}}
+// Hooks {{{
+
+static apr_status_t authcache_cleanup(void *data) {
+  server_rec *s = data;
+  if (authcache.instance)
+    authcache.provider->destroy(authcache.instance, s);
+  authcache.instance = NULL;
+  return APR_SUCCESS;
+}
+
+static int authcache_pre_config(apr_pool_t *pconf, apr_pool_t *plog,
+                                apr_pool_t *ptemp) {
+  apr_status_t status = ap_mutex_register(pconf, AUTHCACHE_MUTEX_TYPE, NULL,
+                                          APR_LOCK_DEFAULT, 0);
+  if (status != APR_SUCCESS) {
+    ap_log_perror(APLOG_MARK, APLOG_CRIT, status, plog,
+                  "Could not register the auth cache mutex type");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  return OK;
+}
+
+static int authcache_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+                                 apr_pool_t *ptemp, server_rec *s) {
+  authcache.provider = NULL;
+  authcache.instance = NULL;
+  authcache.lock = NULL;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(s->module_config, &davrods_module);
+  assert(conf);
+
+  if (DAVRODS_SERVER_CONF(conf, auth_cache) != DAVRODS_AUTH_CACHE_ON)
+    return OK;
+
+  // The provider may be followed by provider-specific arguments, e.g.
+  // "shmcb:/run/davrods-authcache(512000)".
+  const char *spec = DAVRODS_SERVER_CONF(conf, auth_cache_provider);
+  const char *sep = strchr(spec, ':');
+  const char *name = sep ? apr_pstrmemdup(ptemp, spec, sep - spec) : spec;
+  const char *args = sep ? sep + 1 : NULL;
+
+  authcache.provider = ap_lookup_provider(AP_SOCACHE_PROVIDER_GROUP, name,
+                                          AP_SOCACHE_PROVIDER_VERSION);
+  if (!authcache.provider) {
+    // Caching is on by default, but mod_socache_shmcb need not be loaded.
+    // Only complain when a provider was configured explicitly.
+    ap_log_error(APLOG_MARK, conf->auth_cache_provider ? APLOG_ERR : APLOG_INFO,
+                 APR_SUCCESS, s,
+                 "Socache provider '%s' is not available (is "
+                 "mod_socache_%s loaded?), not using the auth cache",
+                 name, name);
+    return OK;
+  }
+
+  const char *err =
+      authcache.provider->create(&authcache.instance, args, ptemp, pconf);
+  if (err) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, s,
+                 "Could not create auth cache: %s", err);
+    authcache.instance = NULL;
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  struct ap_socache_hints hints = {
+      .avg_id_len = AUTHCACHE_DIGEST_LEN,
+      .avg_obj_size = AUTHCACHE_IV_LEN + AUTHCACHE_TAG_LEN + 32,
+      .expiry_interval = apr_time_from_sec(60),
+  };
+
+  apr_status_t status = authcache.provider->init(
+      authcache.instance, DAVRODS_PROVIDER_NAME "-authcache", &hints, s, pconf);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not initialize auth cache");
+    authcache.instance = NULL;
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  apr_pool_cleanup_register(pconf, s, authcache_cleanup, apr_pool_cleanup_null);
+
+  if (authcache.provider->flags & AP_SOCACHE_FLAG_NOTMPSAFE) {
+    status = ap_global_mutex_create(&authcache.lock, NULL, AUTHCACHE_MUTEX_TYPE,
+                                    NULL, s, pconf, 0);
+    if (status != APR_SUCCESS) {
+      ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                   "Could not create auth cache mutex");
+      return HTTP_INTERNAL_SERVER_ERROR;
+    }
+  }
+
+  // All child processes share this salt, as they share the cache.
+  status = apr_generate_random_bytes(authcache.salt, sizeof(authcache.salt));
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not generate auth cache salt");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  return OK;
+}
+
+static void authcache_child_init(apr_pool_t *p, server_rec *s) {
+  if (!authcache.lock)
+    return;
+
+  apr_status_t status = apr_global_mutex_child_init(
+      &authcache.lock, apr_global_mutex_lockfile(authcache.lock), p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_CRIT, status, s,
+                 "Could not attach to auth cache mutex, disabling the auth "
+                 "cache");
+    authcache.instance = NULL;
+  }
+}
+
+void davrods_authcache_register(apr_pool_t *p) {
+  ap_hook_pre_config(authcache_pre_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_post_config(authcache_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_child_init(authcache_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
+
+// }}}
@@ -0,0 +1,101 @@
+/**
+ * \file
+ * \brief     Shared cache of authentication results.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_AUTHCACHE_H
+#define _DAVRODS_AUTHCACHE_H
+
+#include "config.h"
+#include "mod_davrods.h"
+
+/**
+ * \brief Look up a cached iRODS PAM temporary password.
+ *
+ * \param[in]  login
+ * \param[in]  username
+ * \param[in]  password     the user's PAM password
+ * \param[out] tmp_password will be set to the temporary password, allocated
+ *                          from login->pool
+ *
+ * \return whether a usable temporary password was found
+ */
+bool davrods_authcache_get_pam_password(const davrods_login_t *login,
+                                        const char *username,
+                                        const char *password,
+                                        char **tmp_password);
+
+/**
+ * \brief Store an iRODS PAM temporary password.
+ *
+ * The entry expires somewhat before the temporary password itself does,
+ * based on the auth TTL of the login's directory config.
+ */
+void davrods_authcache_put_pam_password(const davrods_login_t *login,
+                                        const char *username,
+                                        const char *password,
+                                        const char *tmp_password);
+
+/**
+ * \brief Remove a temporary password that was rejected by iRODS.
+ */
+void davrods_authcache_remove_pam_password(const davrods_login_t *login,
+                                           const char *username,
+                                           const char *password);
+
+/**
+ * \brief Check whether credentials were recently verified by iRODS.
+ *
+ * \return true if davrods_authcache_set_verified() was called for exactly
+ *         these credentials, and the entry has not yet expired
+ */
+bool davrods_authcache_check_verified(const davrods_login_t *login,
+                                      const char *username,
+                                      const char *password);
+
+/**
+ * \brief Remember that iRODS accepted the given credentials.
+ *
+ * \param ttl how long the credentials may be trusted without asking iRODS
+ */
+void davrods_authcache_set_verified(const davrods_login_t *login,
+                                    const char *username, const char *password,
+                                    apr_interval_time_t ttl);
+
+/**
+ * \brief Check whether a login attempt must be refused without asking iRODS.
+ *
+ * This is the case when the same credentials were rejected recently (with
+ * exponential backoff for repeated failures), or when the client's address
+ * has exceeded the failed login limit.
+ *
+ * \return true if the login must be refused
+ */
+bool davrods_authcache_login_blocked(request_rec *r, const char *username,
+                                     const char *password);
+
+/**
+ * \brief Remember that iRODS rejected the given credentials.
+ */
+void davrods_authcache_login_failed(request_rec *r, const char *username,
+                                    const char *password);
+
+void davrods_authcache_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_AUTHCACHE_H */
@@ -520,7 +520,12 @@ dav_error *davrods_byterange_deliver_file(const dav_resource *resource,
                            ? core_conf->max_reversals
                            : AP_DEFAULT_MAX_REVERSALS);
 
-  size_t obj_length = resource->info->stat->objSize;
+  const rodsObjStat_t *stat;
+  dav_error *err = davrods_get_stat(resource, &stat);
+  if (err)
+    return err;
+
+  size_t obj_length = stat->objSize;
 
   // Parse a Range header, if it exists.
   apr_array_header_t *indexes;
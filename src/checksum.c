@@ -0,0 +1,254 @@
+/**
+ * \file
+ * \brief     Checksum-based ETags.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "checksum.h"
+
+#include <apr_hash.h>
+#include <apr_strings.h>
+#include <apr_thread_mutex.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* ETags made of size and modification time are not reliable: iRODS
+ * timestamps have a resolution of one second, so a data object may change
+ * without its ETag changing. The catalog checksum of a data object makes a
+ * strong ETag, which clients can trust for If-Range and If-None-Match.
+ *
+ * rcObjStat() returns the checksum along with the rest of the stat result,
+ * and the stat memo and stat cache keep it. Collection listings do not
+ * include checksums, so checksums are also cached per process, along with
+ * the modification time and size they belong to, and queried from the
+ * catalog on a miss.
+ */
+
+/// When the cache holds this many checksums, it is emptied.
+#define CHECKSUM_CACHE_SIZE 4096
+
+typedef struct {
+  char modify_time[TIME_LEN];
+  rodsLong_t size;
+  char checksum[NAME_LEN]; // Empty if the data object has none.
+} checksum_entry_t;
+
+static struct {
+  apr_pool_t *pool;      // Guarded by lock, cleared along with checksums.
+  apr_hash_t *checksums; // Server and path -> checksum_entry_t.
+#if APR_HAS_THREADS
+  apr_thread_mutex_t *lock;
+#endif
+} cache;
+
+static void checksum_lock(void) {
+#if APR_HAS_THREADS
+  apr_thread_mutex_lock(cache.lock);
+#endif
+}
+
+static void checksum_unlock(void) {
+#if APR_HAS_THREADS
+  apr_thread_mutex_unlock(cache.lock);
+#endif
+}
+
+static const char *checksum_key(const dav_resource *resource,
+                                const char *path) {
+  return apr_pstrcat(resource->pool,
+                     DAVRODS_CONF(resource->info->conf, rods_host), "\n", path,
+                     NULL);
+}
+
+static void checksum_put(const dav_resource *resource,
+                         const rodsObjStat_t *stat, const char *checksum) {
+  if (!cache.checksums || strlen(checksum) >= NAME_LEN)
+    return;
+
+  const char *key = checksum_key(resource, resource->info->rods_path);
+
+  checksum_lock();
+  checksum_entry_t *entry =
+      apr_hash_get(cache.checksums, key, APR_HASH_KEY_STRING);
+  if (!entry) {
+    if (apr_hash_count(cache.checksums) >= CHECKSUM_CACHE_SIZE) {
+      apr_hash_clear(cache.checksums);
+      apr_pool_clear(cache.pool);
+    }
+    entry = apr_palloc(cache.pool, sizeof(checksum_entry_t));
+    apr_hash_set(cache.checksums, apr_pstrdup(cache.pool, key),
+                 APR_HASH_KEY_STRING, entry);
+  }
+  memcpy(entry->modify_time, stat->modifyTime, TIME_LEN);
+  entry->size = stat->objSize;
+  strcpy(entry->checksum, checksum);
+  checksum_unlock();
+}
+
+/**
+ * \brief Find a cached checksum for the version of a data object described
+ *        by stat.
+ *
+ * \return the checksum, "" if it has none, or NULL if it is not cached
+ */
+static const char *checksum_find(const dav_resource *resource,
+                                 const rodsObjStat_t *stat) {
+  if (!cache.checksums)
+    return NULL;
+
+  const char *key = checksum_key(resource, resource->info->rods_path);
+  const char *checksum = NULL;
+
+  checksum_lock();
+  checksum_entry_t *entry =
+      apr_hash_get(cache.checksums, key, APR_HASH_KEY_STRING);
+  if (entry && entry->size == stat->objSize &&
+      !strncmp(entry->modify_time, stat->modifyTime, TIME_LEN))
+    checksum = apr_pstrdup(resource->pool, entry->checksum);
+  checksum_unlock();
+
+  return checksum;
+}
+
+/**
+ * \brief Look up the checksum of a good replica in the catalog.
+ *
+ * \return the checksum, "" if there is none, or NULL on error
+ */
+static const char *checksum_query(const dav_resource *resource) {
+  const char *path = resource->info->rods_path;
+  const char *slash = strrchr(path, '/');
+
+  // Conditions are passed to iRODS as quoted SQL strings.
+  if (!slash || strchr(path, '\''))
+    return NULL;
+
+  const char *coll = slash == path
+                         ? "/"
+                         : apr_pstrmemdup(resource->pool, path, slash - path);
+
+  genQueryInp_t query = {0};
+  genQueryOut_t *out = NULL;
+
+  query.maxRows = 1;
+  addInxIval(&query.selectInp, COL_D_DATA_CHECKSUM, 1);
+  addInxVal(&query.sqlCondInp, COL_COLL_NAME,
+            apr_pstrcat(resource->pool, "= '", coll, "'", NULL));
+  addInxVal(&query.sqlCondInp, COL_DATA_NAME,
+            apr_pstrcat(resource->pool, "= '", slash + 1, "'", NULL));
+  addInxVal(&query.sqlCondInp, COL_D_REPL_STATUS, "= '1'");
+
+  const char *checksum = NULL;
+  int status = rcGenQuery(resource->info->rods_conn, &query, &out);
+
+  if (status >= 0 && out && out->rowCnt > 0) {
+    sqlResult_t *result = getSqlResultByInx(out, COL_D_DATA_CHECKSUM);
+    checksum = apr_pstrdup(resource->pool, result ? result->value : "");
+  } else if (status == CAT_NO_ROWS_FOUND) {
+    checksum = "";
+  } else {
+    ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, resource->info->r,
+                  "Could not query the checksum of <%s>: %s", path,
+                  get_rods_error_msg(status));
+  }
+
+  if (out && out->continueInx > 0) {
+    // Close the query on the server side.
+    query.maxRows = 0;
+    query.continueInx = out->continueInx;
+    freeGenQueryOut(&out);
+    rcGenQuery(resource->info->rods_conn, &query, &out);
+  }
+
+  freeGenQueryOut(&out);
+  clearGenQueryInp(&query);
+
+  return checksum;
+}
+
+const char *davrods_checksum_get(const dav_resource *resource) {
+  dav_resource_private *res_private = resource->info;
+
+  if (DAVRODS_CONF(res_private->conf, checksum_etags) !=
+          DAVRODS_CHECKSUM_ETAGS_ON ||
+      !resource->exists || resource->collection || res_private->junk)
+    return NULL;
+
+  const rodsObjStat_t *stat;
+  if (davrods_get_stat(resource, &stat))
+    return NULL;
+
+  const char *checksum = NULL;
+
+  if (!res_private->listed) {
+    // The stat result includes the checksum, if there is one.
+    checksum = stat->chksum;
+    checksum_put(resource, stat, checksum);
+  } else {
+    checksum = checksum_find(resource, stat);
+    if (!checksum) {
+      checksum = checksum_query(resource);
+      if (!checksum)
+        return NULL;
+      checksum_put(resource, stat, checksum);
+    }
+  }
+
+  return *checksum ? checksum : NULL;
+}
+
+void davrods_checksum_invalidate(const dav_resource *resource,
+                                 const char *path) {
+  if (!cache.checksums)
+    return;
+
+  const char *key = checksum_key(resource, path);
+
+  checksum_lock();
+  apr_hash_set(cache.checksums, key, APR_HASH_KEY_STRING, NULL);
+  checksum_unlock();
+}
+
+static apr_status_t checksum_cleanup(void *data) {
+  checksum_lock();
+  cache.checksums = NULL;
+  checksum_unlock();
+  return APR_SUCCESS;
+}
+
+static void checksum_child_init(apr_pool_t *p, server_rec *s) {
+#if APR_HAS_THREADS
+  apr_status_t status =
+      apr_thread_mutex_create(&cache.lock, APR_THREAD_MUTEX_DEFAULT, p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not create checksum cache mutex, checksums will not "
+                 "be cached");
+    return;
+  }
+#endif
+
+  apr_pool_create(&cache.pool, p);
+  cache.checksums = apr_hash_make(p);
+
+  apr_pool_cleanup_register(p, NULL, checksum_cleanup, apr_pool_cleanup_null);
+}
+
+void davrods_checksum_register(apr_pool_t *p) {
+  ap_hook_child_init(checksum_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,47 @@
+/**
+ * \file
+ * \brief     Checksum-based ETags.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_CHECKSUM_H
+#define _DAVRODS_CHECKSUM_H
+
+#include "repo.h"
+
+/**
+ * \brief Get the catalog checksum of a data object.
+ *
+ * The checksum is taken from the resource's stat result, unless that came
+ * from a collection listing. Then it is looked up in a per-process cache,
+ * and queried from the catalog on a miss.
+ *
+ * \return the checksum, or NULL if checksum ETags are disabled, or if the
+ *         data object has no checksum
+ */
+const char *davrods_checksum_get(const dav_resource *resource);
+
+/**
+ * \brief Forget the cached checksum of a data object that is being modified.
+ */
+void davrods_checksum_invalidate(const dav_resource *resource,
+                                 const char *path);
+
+void davrods_checksum_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_CHECKSUM_H */
@@ -46,6 +46,33 @@ const char *get_rods_error_msg(int rods_error_code) {
   return rodsErrorName(rods_error_code, &submsg);
 }
 
+bool davrods_is_connection_error(int rods_error_code) {
+  // Socket errors carry the system errno in the lower digits.
+  switch (getIrodsErrno(rods_error_code)) {
+  case SYS_HEADER_READ_LEN_ERR:
+  case SYS_HEADER_WRITE_LEN_ERR:
+  case SYS_SOCK_READ_ERR:
+  case SYS_SOCK_READ_TIMEDOUT:
+  case SYS_READ_MSG_BODY_LEN_ERR:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool davrods_is_credential_error(int rods_error_code) {
+  switch (getIrodsErrno(rods_error_code)) {
+  case CAT_INVALID_AUTHENTICATION:
+  case CAT_INVALID_USER:
+  case CAT_INVALID_CLIENT_USER:
+  case CAT_PASSWORD_EXPIRED:
+  case PAM_AUTH_PASSWORD_FAILED:
+    return true;
+  default:
+    return false;
+  }
+}
+
 // }}}
 // DAV provider definition and registration {{{
 
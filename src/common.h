@@ -40,6 +40,23 @@
  */
 const char *get_rods_error_msg(int rods_error_code);
 
+/**
+ * \brief Check whether an iRODS status code indicates a broken connection,
+ *        e.g. because the iRODS agent or a firewall timed it out.
+ *
+ * \param rods_error_code
+ */
+bool davrods_is_connection_error(int rods_error_code);
+
+/**
+ * \brief Check whether an iRODS status code indicates that a login was
+ *        refused because of the credentials, as opposed to e.g. an agent,
+ *        network or PAM backend failure.
+ *
+ * \param rods_error_code
+ */
+bool davrods_is_credential_error(int rods_error_code);
+
 void davrods_dav_register(apr_pool_t *p);
 
 #endif /* _DAVRODS_COMMON_H_ */
@@ -20,8 +20,12 @@
  * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "config.h"
+#include "env.h"
 
+#include <apr_fnmatch.h>
+#include <apr_lib.h>
 #include <apr_strings.h>
+#include <http_core.h>
 
 APLOG_USE_MODULE(davrods);
 
@@ -51,6 +55,8 @@ const davrods_dir_conf_t default_config = {
     // directives 'AuthBasicProvider irods' and 'Dav irods'.
     .rods_host = "localhost",
     .rods_port = 1247,
+    .rods_servers = NULL,
+    .rods_server_selection = DAVRODS_SERVER_SELECTION_LEAST_CONNECTIONS,
     .rods_zone = "tempZone",
     .rods_default_resource = "",
     .rods_auth_scheme = DAVRODS_AUTH_NATIVE,
@@ -73,6 +79,16 @@ const davrods_dir_conf_t default_config = {
     .rods_tx_buffer_size = 4 * 1024 * 1024,
     .rods_rx_buffer_size = 4 * 1024 * 1024,
 
+    // Leave socket options to the kernel and the iRODS client library.
+    .socket_buffers = DAVRODS_SOCKET_BUFFERS_OFF,
+    .socket_sndbuf = 0,
+    .socket_rcvbuf = 0,
+    .socket_bandwidth = 1000, // In Mbit/s.
+    .socket_nodelay = DAVRODS_SOCKET_NODELAY_OFF,
+    .socket_keepalive_idle = -1,
+    .socket_keepalive_interval = 0,
+    .socket_keepalive_count = 0,
+
     .tmpfile_rollback = DAVRODS_TMPFILE_ROLLBACK_OFF,
     .locallock_lockdb_path = "/var/lib/davrods/lockdb_locallock",
 
@@ -80,11 +96,15 @@ const davrods_dir_conf_t default_config = {
     .anonymous_auth_username = "anonymous",
     .anonymous_auth_password = "",
 
-    // Use the minimum PAM temporary password TTL. We
-    // re-authenticate using PAM on every new HTTP connection, so
-    // there's no use keeping the temporary password around for
-    // longer than the maximum keepalive time. (We don't ever use
-    // a temporary password more than once).
+    .proxy_mode = DAVRODS_PROXY_MODE_OFF,
+    .proxy_auth_username = "",
+    .proxy_auth_password = "",
+    .proxy_verify_ttl = 300, // In seconds.
+
+    // The PAM temporary password TTL. The auth cache reuses a temporary
+    // password for new logins until 90% of this TTL has passed, so it also
+    // bounds how long a user whose PAM account was disabled can still log
+    // in. An hour keeps PAM exchanges rare while keeping that window short.
     .rods_auth_ttl = 1, // In hours.
 
     .ticket_mode = DAVRODS_TICKET_MODE_OFF,
@@ -95,6 +115,85 @@ const davrods_dir_conf_t default_config = {
     .html_header = "",
     .html_footer = "",
     .force_download = DAVRODS_FORCE_DOWNLOAD_OFF,
+
+    // Remember stat results of a session for a short while, so that the
+    // same path is not looked up repeatedly within a request, or in quick
+    // succession.
+    .stat_memo_ttl = 2, // In seconds.
+
+    .checksum_etags = DAVRODS_CHECKSUM_ETAGS_OFF,
+
+    // Collection change tags cost two catalog queries per collection.
+    .collection_tag_ttl = -1,
+
+    .junk_writes = DAVRODS_JUNK_WRITES_REFUSE,
+    .junk_max_size = 1024 * 1024,
+    .junk_expiry = 7 * 24 * 3600,
+
+    .metaindex_freshness = -1,
+    .paged_listing_rows = -1,
+
+    .coalesce_lookups = DAVRODS_COALESCE_LOOKUPS_ON,
+};
+
+/// Default values for server-wide options.
+const davrods_server_conf_t default_server_config = {
+    // Keep a small number of authenticated iRODS connections around after
+    // their HTTP connection closes, so that clients that open many short-lived
+    // connections do not need to log in to iRODS every time.
+    .conn_pool = DAVRODS_CONN_POOL_ON,
+    .conn_pool_size = 8,
+    .conn_pool_idle_timeout = 30, // In seconds.
+
+    // Opening connections ahead of time is opt-in. Warm connections are
+    // pinged when they have been idle for this long.
+    .conn_pool_prewarm = 0,
+    .conn_pool_ping_interval = 60, // In seconds.
+
+    // Check that a connection is still alive before reusing it after it has
+    // been idle for this long.
+    .conn_probe_after = 30, // In seconds.
+
+    // Also keep a few connections with an activated session ticket, for
+    // clients that switch between tickets.
+    .ticket_pool_size = 8,
+
+    // Keep-alive sessions hold on to their iRODS connection until the client
+    // disconnects.
+    .session_idle_timeout = 0,
+
+    // Streams of one HTTP/2 connection share a few iRODS connections.
+    .h2_connections = 4,
+
+    // Share one TLS context per child process, and resume TLS sessions when
+    // SSL is turned on for PAM authentication.
+    .tls_session_cache = DAVRODS_TLS_SESSION_CACHE_ON,
+
+    // The number of iRODS connections held by sessions is not capped by
+    // default. When it is, requests over the cap wait for a while before
+    // being refused.
+    .conn_limit = 0,
+    .conn_limit_per_user = 0,
+    .conn_queue_size = 100,
+    .conn_queue_timeout = 10, // In seconds.
+
+    // Share authentication results (e.g. PAM temporary passwords) between
+    // logins, if mod_socache_shmcb is available.
+    .auth_cache = DAVRODS_AUTH_CACHE_ON,
+    .auth_cache_provider = "shmcb",
+
+    // Stat results are not shared between child processes by default.
+    .stat_cache = DAVRODS_STAT_CACHE_OFF,
+    .stat_cache_provider = "shmcb",
+    .stat_cache_ttl = 10, // In seconds.
+
+    // Refuse credentials that were just rejected for a while. Requires the
+    // auth cache. Refusing all logins from a client address that keeps
+    // failing is opt-in: behind a proxy or NAT, many users share an address.
+    .login_backoff = 1,        // In seconds.
+    .login_backoff_max = 300,  // In seconds.
+    .login_source_limit = -1,  // Failures per window.
+    .login_source_window = 60, // In seconds.
 };
 
 void *davrods_create_dir_config(apr_pool_t *p, char *dir) {
@@ -117,6 +216,8 @@ void *davrods_merge_dir_config(apr_pool_t *p, void *_parent, void *_child) {
 
   MERGE(rods_host);
   MERGE(rods_port);
+  MERGE(rods_servers);
+  MERGE(rods_server_selection);
   MERGE(rods_zone);
   MERGE(rods_default_resource);
   MERGE(rods_env_file);
@@ -129,6 +230,14 @@ void *davrods_merge_dir_config(apr_pool_t *p, void *_parent, void *_child) {
 
   MERGE(rods_tx_buffer_size);
   MERGE(rods_rx_buffer_size);
+  MERGE(socket_buffers);
+  MERGE(socket_sndbuf);
+  MERGE(socket_rcvbuf);
+  MERGE(socket_bandwidth);
+  MERGE(socket_nodelay);
+  MERGE(socket_keepalive_idle);
+  MERGE(socket_keepalive_interval);
+  MERGE(socket_keepalive_count);
 
   MERGE(tmpfile_rollback);
   MERGE(locallock_lockdb_path);
@@ -136,10 +245,14 @@ void *davrods_merge_dir_config(apr_pool_t *p, void *_parent, void *_child) {
   MERGE(anonymous_mode);
   MERGE(anonymous_auth_username);
   MERGE(anonymous_auth_password);
+  MERGE(proxy_mode);
+  MERGE(proxy_auth_username);
+  MERGE(proxy_auth_password);
+  MERGE(proxy_verify_ttl);
 
   MERGE(rods_auth_ttl);
 
-  {
+  if (exposed_root) {
     int ret = set_exposed_root(conf, exposed_root);
     assert(ret >= 0);
   }
@@ -152,26 +265,140 @@ void *davrods_merge_dir_config(apr_pool_t *p, void *_parent, void *_child) {
   MERGE(html_footer);
 
   MERGE(force_download);
+  MERGE(stat_memo_ttl);
+  MERGE(checksum_etags);
+  MERGE(collection_tag_ttl);
+
+  MERGE(junk_paths);
+  MERGE(junk_writes);
+  MERGE(junk_store_dir);
+  MERGE(junk_max_size);
+  MERGE(junk_expiry);
+
+  MERGE(metaindex_dir);
+  MERGE(metaindex_freshness);
+  MERGE(paged_listing_rows);
+  MERGE(coalesce_lookups);
 
 #undef MERGE
 
   return conf;
 }
 
-// Config setters {{{
+void *davrods_create_server_config(apr_pool_t *p, server_rec *s) {
+  // As with directory config, zeroed means default.
+  return apr_pcalloc(p, sizeof(davrods_server_conf_t));
+}
 
-static const char *cmd_davrodsserver(cmd_parms *cmd, void *config,
-                                     const char *arg1, const char *arg2) {
-  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+void *davrods_merge_server_config(apr_pool_t *p, void *_parent, void *_child) {
+  davrods_server_conf_t *parent = _parent;
+  davrods_server_conf_t *child = _child;
+  davrods_server_conf_t *conf = davrods_create_server_config(p, NULL);
+
+#define MERGE(_prop)                                                           \
+  conf->_prop = child->_prop    ? child->_prop                                 \
+                : parent->_prop ? parent->_prop                                \
+                                : conf->_prop
+
+  MERGE(conn_pool);
+  MERGE(conn_pool_size);
+  MERGE(conn_pool_idle_timeout);
+  MERGE(conn_pool_prewarm);
+  MERGE(conn_pool_ping_interval);
+  MERGE(conn_probe_after);
+  MERGE(ticket_pool_size);
+  MERGE(session_idle_timeout);
+  MERGE(h2_connections);
+  MERGE(tls_session_cache);
+  MERGE(conn_limit);
+  MERGE(conn_limit_per_user);
+  MERGE(conn_queue_size);
+  MERGE(conn_queue_timeout);
+  MERGE(auth_cache);
+  MERGE(auth_cache_provider);
+  MERGE(stat_cache);
+  MERGE(stat_cache_provider);
+  MERGE(stat_cache_ttl);
+  MERGE(login_backoff);
+  MERGE(login_backoff_max);
+  MERGE(login_source_limit);
+  MERGE(login_source_window);
 
-  conf->rods_host = arg1;
+#undef MERGE
 
+  return conf;
+}
+
+void davrods_login_from_request(davrods_login_t *login, request_rec *r) {
+  login->server = r->server;
+  login->pool = r->pool;
+  login->conf = ap_get_module_config(r->per_dir_config, &davrods_module);
+  assert(login->conf);
+}
+
+/**
+ * \brief Check whether a Location section applies to the given path.
+ *
+ * Mirrors the matching done by the core's location walk.
+ */
+static bool location_matches(const core_dir_config *section,
+                             const char *path) {
+  if (section->r)
+    return !ap_regexec(section->r, path, 0, NULL, 0);
+  if (section->d_is_fnmatch)
+    return !apr_fnmatch(section->d, path, APR_FNM_PATHNAME);
+
+  size_t len = strlen(section->d);
+  return !strncmp(section->d, path, len) &&
+         (!len || section->d[len - 1] == '/' || path[len] == '/' ||
+          path[len] == '\0');
+}
+
+void davrods_config_walk_locations(apr_pool_t *p, server_rec *s,
+                                   davrods_location_fn_t *fn, void *data) {
+  // Unset options are zero, see davrods_create_dir_config().
+  static const davrods_dir_conf_t unset;
+
+  for (server_rec *server = s; server; server = server->next) {
+    core_server_config *core =
+        ap_get_core_module_config(server->module_config);
+    ap_conf_vector_t **sections = (ap_conf_vector_t **)core->sec_url->elts;
+    int count = core->sec_url->nelts;
+
+    davrods_dir_conf_t *base =
+        ap_get_module_config(server->lookup_defaults, &davrods_module);
+
+    for (int i = 0; i < count; ++i) {
+      const core_dir_config *location =
+          ap_get_core_module_config(sections[i]);
+
+      // Merge, in configuration order, every section that a request for the
+      // location's own path would pass through. The path of a regex section
+      // cannot be requested, so it is only merged with the server config.
+      davrods_dir_conf_t *conf = base;
+      for (int j = 0; j < count; ++j) {
+        const core_dir_config *section =
+            ap_get_core_module_config(sections[j]);
+        if (j == i || (!location->r && location_matches(section, location->d)))
+          conf = davrods_merge_dir_config(
+              p, conf, ap_get_module_config(sections[j], &davrods_module));
+      }
+
+      if (memcmp(conf, &unset, sizeof(unset)))
+        fn(data, server, location->d, conf);
+    }
+  }
+}
+
+// Config setters {{{
+
+static const char *parse_port(const char *arg, uint16_t *port) {
 #define DAVRODS_MIN(x, y) ((x) <= (y) ? (x) : (y))
 #define DAVRODS_MAX(x, y) ((x) >= (y) ? (x) : (y))
 
-  apr_int64_t port = apr_atoi64(arg2);
-  if (port == DAVRODS_MIN(65535, DAVRODS_MAX(1, port))) {
-    conf->rods_port = port;
+  apr_int64_t value = apr_atoi64(arg);
+  if (value == DAVRODS_MIN(65535, DAVRODS_MAX(1, value))) {
+    *port = value;
     return NULL;
   } else {
     return "iRODS server port out of range (1-65535)";
@@ -181,6 +408,66 @@ static const char *cmd_davrodsserver(cmd_parms *cmd, void *config,
 #undef DAVRODS_MAX
 }
 
+static const char *cmd_davrodsserver(cmd_parms *cmd, void *config, int argc,
+                                     char *const argv[]) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (argc < 1)
+    return "Specify an iRODS host and port, or one or more host:port pairs";
+
+  apr_array_header_t *servers =
+      apr_array_make(cmd->pool, argc, sizeof(davrods_server_t));
+
+  if (argc == 2 && apr_isdigit(argv[1][0]) && !strchr(argv[0], ':')) {
+    // Traditional "host port" form.
+    davrods_server_t *server = apr_array_push(servers);
+    server->host = argv[0];
+    const char *err = parse_port(argv[1], &server->port);
+    if (err)
+      return err;
+  } else {
+    // One or more "host[:port]" arguments.
+    for (int i = 0; i < argc; ++i) {
+      davrods_server_t *server = apr_array_push(servers);
+      const char *sep = strrchr(argv[i], ':');
+      if (sep) {
+        server->host = apr_pstrmemdup(cmd->pool, argv[i], sep - argv[i]);
+        const char *err = parse_port(sep + 1, &server->port);
+        if (err)
+          return err;
+      } else {
+        server->host = argv[i];
+        server->port = default_config.rods_port;
+      }
+      if (!strlen(server->host))
+        return "iRODS server host must not be empty";
+    }
+  }
+
+  davrods_server_t *first = &APR_ARRAY_IDX(servers, 0, davrods_server_t);
+  conf->rods_host = first->host;
+  conf->rods_port = first->port;
+  conf->rods_servers = servers;
+
+  return NULL;
+}
+
+static const char *cmd_davrodsserverselection(cmd_parms *cmd, void *config,
+                                              const char *arg1) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "leastconnections")) {
+    conf->rods_server_selection = DAVRODS_SERVER_SELECTION_LEAST_CONNECTIONS;
+  } else if (!strcasecmp(arg1, "userhash")) {
+    conf->rods_server_selection = DAVRODS_SERVER_SELECTION_USER_HASH;
+  } else {
+    return "This directive accepts only 'LeastConnections' and 'UserHash' "
+           "values";
+  }
+
+  return NULL;
+}
+
 static const char *cmd_davrodsauthscheme(cmd_parms *cmd, void *config,
                                          const char *arg1) {
   davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
@@ -235,6 +522,7 @@ static const char *cmd_davrodsenvfile(cmd_parms *cmd, void *config,
                                       const char *arg1) {
   davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
   conf->rods_env_file = arg1;
+  davrods_env_add_file(cmd->pool, arg1);
   return NULL;
 }
 
@@ -281,6 +569,84 @@ static const char *cmd_davrodsrxbufferkbs(cmd_parms *cmd, void *config,
   return NULL;
 }
 
+static const char *cmd_davrodssocketbuffers(cmd_parms *cmd, void *config,
+                                            const char *arg1,
+                                            const char *arg2) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "off") && !arg2) {
+    conf->socket_buffers = DAVRODS_SOCKET_BUFFERS_OFF;
+    return NULL;
+  }
+
+  if (!strcasecmp(arg1, "auto")) {
+    conf->socket_buffers = DAVRODS_SOCKET_BUFFERS_AUTO;
+    if (arg2) {
+      apr_int64_t mbits = apr_atoi64(arg2);
+      if (mbits <= 0 || mbits > 1000000 || errno == ERANGE)
+        return "The link bandwidth must be a number of Mbit/s from 1 to "
+               "1000000";
+      conf->socket_bandwidth = (int)mbits;
+    }
+    return NULL;
+  }
+
+  apr_int64_t snd_kb = apr_atoi64(arg1);
+  apr_int64_t rcv_kb = arg2 ? apr_atoi64(arg2) : snd_kb;
+  if (snd_kb <= 0 || snd_kb > 1024 * 1024 || rcv_kb <= 0 ||
+      rcv_kb > 1024 * 1024 || errno == ERANGE)
+    return "Socket buffer sizes must be a number of KiBs from 1 to 1048576, "
+           "'Auto' optionally followed by the link bandwidth in Mbit/s, or "
+           "'Off'";
+
+  conf->socket_buffers = DAVRODS_SOCKET_BUFFERS_FIXED;
+  conf->socket_sndbuf = (int)snd_kb * 1024;
+  conf->socket_rcvbuf = (int)rcv_kb * 1024;
+  return NULL;
+}
+
+static const char *cmd_davrodssocketnodelay(cmd_parms *cmd, void *config,
+                                            const char *arg1) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "on")) {
+    conf->socket_nodelay = DAVRODS_SOCKET_NODELAY_ON;
+  } else if (!strcasecmp(arg1, "off")) {
+    conf->socket_nodelay = DAVRODS_SOCKET_NODELAY_OFF;
+  } else {
+    return "This directive accepts only 'On' and 'Off' values";
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodssocketkeepalive(cmd_parms *cmd, void *config,
+                                              const char *arg1,
+                                              const char *arg2,
+                                              const char *arg3) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "off") && !arg2) {
+    conf->socket_keepalive_idle = -1;
+    return NULL;
+  }
+
+  apr_int64_t idle = apr_atoi64(arg1);
+  apr_int64_t interval = arg2 ? apr_atoi64(arg2) : 0;
+  apr_int64_t count = arg3 ? apr_atoi64(arg3) : 0;
+  if (idle <= 0 || idle > 86400 || interval < 0 || interval > 86400 ||
+      (arg2 && !interval) || count < 0 || count > 127 || (arg3 && !count) ||
+      errno == ERANGE)
+    return "TCP keepalive must be 'Off', or the idle time in seconds, "
+           "optionally followed by the probe interval in seconds and the "
+           "number of probes";
+
+  conf->socket_keepalive_idle = (int)idle;
+  conf->socket_keepalive_interval = (int)interval;
+  conf->socket_keepalive_count = (int)count;
+  return NULL;
+}
+
 static const char *cmd_davrodstmpfilerollback(cmd_parms *cmd, void *config,
                                               const char *arg1) {
   davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
@@ -340,6 +706,46 @@ static const char *cmd_davrodsanonymouslogin(cmd_parms *cmd, void *config,
   return NULL;
 }
 
+static const char *cmd_davrodsproxymode(cmd_parms *cmd, void *config,
+                                        const char *arg1) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "on")) {
+    conf->proxy_mode = DAVRODS_PROXY_MODE_ON;
+  } else if (!strcasecmp(arg1, "off")) {
+    conf->proxy_mode = DAVRODS_PROXY_MODE_OFF;
+  } else {
+    return "This directive accepts only 'On' and 'Off' values";
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsproxylogin(cmd_parms *cmd, void *config,
+                                         const char *arg1, const char *arg2) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strlen(arg1))
+    return "Username must not be empty";
+
+  conf->proxy_auth_username = arg1;
+  conf->proxy_auth_password = arg2;
+
+  return NULL;
+}
+
+static const char *cmd_davrodsproxyverifyttl(cmd_parms *cmd, void *config,
+                                             const char *arg1) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  apr_int64_t ttl = apr_atoi64(arg1);
+  if (ttl <= 0 || errno == ERANGE || ttl >> 31)
+    return "The proxy verify TTL must be a positive number of seconds";
+
+  conf->proxy_verify_ttl = (int)ttl;
+  return NULL;
+}
+
 static const char *cmd_davrodstickets(cmd_parms *cmd, void *config,
                                       const char *arg1) {
   davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
@@ -430,11 +836,614 @@ static const char *cmd_davrodsforcedownload(cmd_parms *cmd, void *config,
   return NULL;
 }
 
+static const char *cmd_davrodsstatmemo(cmd_parms *cmd, void *config,
+                                       const char *arg1) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "off")) {
+    conf->stat_memo_ttl = -1;
+    return NULL;
+  }
+
+  apr_int64_t ttl = apr_atoi64(arg1);
+  if (ttl <= 0 || ttl > 3600 || errno == ERANGE)
+    return "The stat memo TTL must be 'Off' or a number of seconds from 1 to "
+           "3600";
+
+  conf->stat_memo_ttl = (int)ttl;
+  return NULL;
+}
+
+static const char *cmd_davrodschecksumetags(cmd_parms *cmd, void *config,
+                                            const char *arg1) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "on")) {
+    conf->checksum_etags = DAVRODS_CHECKSUM_ETAGS_ON;
+  } else if (!strcasecmp(arg1, "off")) {
+    conf->checksum_etags = DAVRODS_CHECKSUM_ETAGS_OFF;
+  } else {
+    return "This directive accepts only 'On' and 'Off' values";
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodscollectiontags(cmd_parms *cmd, void *config,
+                                             const char *arg1) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "off")) {
+    conf->collection_tag_ttl = -1;
+    return NULL;
+  } else if (!strcasecmp(arg1, "on")) {
+    conf->collection_tag_ttl = 10;
+    return NULL;
+  }
+
+  apr_int64_t ttl = apr_atoi64(arg1);
+  if (ttl <= 0 || ttl > 3600 || errno == ERANGE)
+    return "This directive accepts only 'On', 'Off', or a number of seconds "
+           "from 1 to 3600";
+
+  conf->collection_tag_ttl = (int)ttl;
+  return NULL;
+}
+
+static const char *cmd_davrodsjunkpaths(cmd_parms *cmd, void *config,
+                                        int argc, char *const argv[]) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (argc < 1)
+    return "Specify one or more file name patterns, or Off";
+
+  conf->junk_paths = apr_array_make(cmd->pool, argc, sizeof(const char *));
+
+  if (argc == 1 && !strcasecmp(argv[0], "off"))
+    return NULL;
+
+  for (int i = 0; i < argc; ++i) {
+    if (strchr(argv[i], '/'))
+      return "Junk path patterns match file names and must not contain a "
+             "'/'";
+    APR_ARRAY_PUSH(conf->junk_paths, const char *) = argv[i];
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsjunkwrites(cmd_parms *cmd, void *config,
+                                         const char *arg1, const char *arg2) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "store")) {
+    if (!arg2)
+      return "Specify a directory in which to store junk files";
+    conf->junk_writes = DAVRODS_JUNK_WRITES_STORE;
+    conf->junk_store_dir = ap_server_root_relative(cmd->pool, arg2);
+    if (!conf->junk_store_dir)
+      return apr_pstrcat(cmd->pool, "Invalid junk store directory: ", arg2,
+                         NULL);
+    return NULL;
+  }
+
+  if (arg2)
+    return "Only 'Store' takes a directory argument";
+
+  if (!strcasecmp(arg1, "refuse")) {
+    conf->junk_writes = DAVRODS_JUNK_WRITES_REFUSE;
+  } else if (!strcasecmp(arg1, "discard")) {
+    conf->junk_writes = DAVRODS_JUNK_WRITES_DISCARD;
+  } else {
+    return "This directive accepts only 'Refuse', 'Discard' and "
+           "'Store <directory>' values";
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsjunkstorelimits(cmd_parms *cmd, void *config,
+                                              const char *arg1,
+                                              const char *arg2) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  apr_int64_t kb = apr_atoi64(arg1);
+  if (kb <= 0 || kb > 1024 * 1024 || errno == ERANGE)
+    return "The junk file size limit must be a number of kilobytes from 1 to "
+           "1048576";
+  conf->junk_max_size = (apr_off_t)kb * 1024;
+
+  if (arg2) {
+    apr_int64_t expiry = apr_atoi64(arg2);
+    if (expiry <= 0 || expiry > 365 * 24 * 3600 || errno == ERANGE)
+      return "The junk file expiry must be a number of seconds from 1 to "
+             "31536000";
+    conf->junk_expiry = (int)expiry;
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsmetadataindex(cmd_parms *cmd, void *config,
+                                            const char *arg1,
+                                            const char *arg2) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "off")) {
+    if (arg2)
+      return "'Off' takes no further arguments";
+    conf->metaindex_freshness = -1;
+    return NULL;
+  }
+
+  conf->metaindex_dir = ap_server_root_relative(cmd->pool, arg1);
+  if (!conf->metaindex_dir)
+    return apr_pstrcat(cmd->pool, "Invalid metadata index directory: ", arg1,
+                       NULL);
+
+  conf->metaindex_freshness = 60;
+  if (arg2) {
+    apr_int64_t freshness = apr_atoi64(arg2);
+    if (freshness <= 0 || freshness > 86400 || errno == ERANGE)
+      return "The freshness bound must be a number of seconds from 1 to 86400";
+    conf->metaindex_freshness = (int)freshness;
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodspagedlistings(cmd_parms *cmd, void *config,
+                                            const char *arg1) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "off")) {
+    conf->paged_listing_rows = -1;
+    return NULL;
+  } else if (!strcasecmp(arg1, "on")) {
+    conf->paged_listing_rows = MAX_SQL_ROWS;
+    return NULL;
+  }
+
+  // iRODS does not return more than MAX_SQL_ROWS rows per page.
+  apr_int64_t rows = apr_atoi64(arg1);
+  if (rows <= 0 || rows > MAX_SQL_ROWS || errno == ERANGE)
+    return apr_psprintf(cmd->pool,
+                        "This directive accepts only 'On', 'Off', or a number "
+                        "of rows from 1 to %d",
+                        MAX_SQL_ROWS);
+
+  conf->paged_listing_rows = (int)rows;
+  return NULL;
+}
+
+static const char *cmd_davrodscoalescelookups(cmd_parms *cmd, void *config,
+                                              const char *arg1) {
+  davrods_dir_conf_t *conf = (davrods_dir_conf_t *)config;
+
+  if (!strcasecmp(arg1, "on")) {
+    conf->coalesce_lookups = DAVRODS_COALESCE_LOOKUPS_ON;
+  } else if (!strcasecmp(arg1, "off")) {
+    conf->coalesce_lookups = DAVRODS_COALESCE_LOOKUPS_OFF;
+  } else {
+    return "This directive accepts only 'On' and 'Off' values";
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsconnectionpool(cmd_parms *cmd, void *config,
+                                             const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!strcasecmp(arg1, "on")) {
+    conf->conn_pool = DAVRODS_CONN_POOL_ON;
+  } else if (!strcasecmp(arg1, "off")) {
+    conf->conn_pool = DAVRODS_CONN_POOL_OFF;
+  } else {
+    return "This directive accepts only 'On' and 'Off' values";
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsconnectionpoolsize(cmd_parms *cmd, void *config,
+                                                 const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  apr_int64_t size = apr_atoi64(arg1);
+  if (size < 1 || size > 1024)
+    return "The connection pool size must be between 1 and 1024";
+
+  conf->conn_pool_size = (int)size;
+  return NULL;
+}
+
+static const char *cmd_davrodsconnectionpoolidletimeout(cmd_parms *cmd,
+                                                        void *config,
+                                                        const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  apr_int64_t timeout = apr_atoi64(arg1);
+  if (timeout <= 0 || errno == ERANGE || timeout >> 31)
+    return "The connection pool idle timeout must be a positive number of "
+           "seconds";
+
+  conf->conn_pool_idle_timeout = (int)timeout;
+  return NULL;
+}
+
+static const char *cmd_davrodsconnectionpoolprewarm(cmd_parms *cmd,
+                                                    void *config,
+                                                    const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  apr_int64_t count = apr_atoi64(arg1);
+  if (count < 0 || count > 1024)
+    return "The amount of prewarmed connections must be between 0 and 1024";
+
+  conf->conn_pool_prewarm = (int)count;
+  return NULL;
+}
+
+static const char *cmd_davrodsconnectionpoolpinginterval(cmd_parms *cmd,
+                                                         void *config,
+                                                         const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  apr_int64_t interval = apr_atoi64(arg1);
+  if (interval <= 0 || errno == ERANGE || interval >> 31)
+    return "The connection pool ping interval must be a positive number of "
+           "seconds";
+
+  conf->conn_pool_ping_interval = (int)interval;
+  return NULL;
+}
+
+static const char *cmd_davrodsconnectionprobeafter(cmd_parms *cmd,
+                                                   void *config,
+                                                   const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  apr_int64_t seconds = apr_atoi64(arg1);
+  if (seconds <= 0 || errno == ERANGE || seconds >> 31)
+    return "The connection probe time must be a positive number of seconds";
+
+  conf->conn_probe_after = (int)seconds;
+  return NULL;
+}
+
+static const char *cmd_davrodsticketpoolsize(cmd_parms *cmd, void *config,
+                                             const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!strcasecmp(arg1, "off")) {
+    conf->ticket_pool_size = -1;
+    return NULL;
+  }
+
+  apr_int64_t size = apr_atoi64(arg1);
+  if (size <= 0 || size > 1024 || errno == ERANGE)
+    return "The ticket pool size must be 'Off' or a number from 1 to 1024";
+
+  conf->ticket_pool_size = (int)size;
+  return NULL;
+}
+
+static const char *cmd_davrodssessionidletimeout(cmd_parms *cmd, void *config,
+                                                 const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!strcasecmp(arg1, "off")) {
+    conf->session_idle_timeout = 0;
+    return NULL;
+  }
+
+  apr_int64_t timeout = apr_atoi64(arg1);
+  if (timeout <= 0 || errno == ERANGE || timeout >> 31)
+    return "The session idle timeout must be 'Off' or a positive number of "
+           "seconds";
+
+  conf->session_idle_timeout = (int)timeout;
+  return NULL;
+}
+
+static const char *cmd_davrodsstatcache(cmd_parms *cmd, void *config,
+                                        const char *arg1, const char *arg2) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!strcasecmp(arg1, "off") && !arg2) {
+    conf->stat_cache = DAVRODS_STAT_CACHE_OFF;
+    return NULL;
+  } else if (!strcasecmp(arg1, "on")) {
+    conf->stat_cache = DAVRODS_STAT_CACHE_ON;
+  } else if (strlen(arg1) && arg1[0] != ':' && strcasecmp(arg1, "off")) {
+    conf->stat_cache = DAVRODS_STAT_CACHE_ON;
+    conf->stat_cache_provider = arg1;
+  } else {
+    return "This directive accepts 'On', 'Off' or a socache provider name, "
+           "optionally followed by ':' and provider arguments, and then "
+           "optionally by the TTL in seconds";
+  }
+
+  if (arg2) {
+    apr_int64_t ttl = apr_atoi64(arg2);
+    if (ttl <= 0 || ttl > 86400 || errno == ERANGE)
+      return "The stat cache TTL must be a number of seconds from 1 to 86400";
+    conf->stat_cache_ttl = (int)ttl;
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsfailedloginbackoff(cmd_parms *cmd, void *config,
+                                                 const char *arg1,
+                                                 const char *arg2) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!arg2 && !strcasecmp(arg1, "off")) {
+    conf->login_backoff = -1;
+    return NULL;
+  }
+
+  apr_int64_t initial = apr_atoi64(arg1);
+  if (initial <= 0 || errno == ERANGE || initial >> 31)
+    return "The failed login backoff must be 'Off' or a positive number of "
+           "seconds, optionally followed by the maximum backoff in seconds";
+
+  conf->login_backoff = (int)initial;
+
+  if (arg2) {
+    apr_int64_t max = apr_atoi64(arg2);
+    if (max < initial || errno == ERANGE || max >> 31)
+      return "The maximum failed login backoff must be a number of seconds "
+             "no smaller than the initial backoff";
+
+    conf->login_backoff_max = (int)max;
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsfailedloginlimit(cmd_parms *cmd, void *config,
+                                               const char *arg1,
+                                               const char *arg2) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!arg2 && !strcasecmp(arg1, "off")) {
+    conf->login_source_limit = -1;
+    return NULL;
+  }
+
+  apr_int64_t limit = apr_atoi64(arg1);
+  if (limit <= 0 || errno == ERANGE || limit >> 31)
+    return "The failed login limit must be 'Off' or a positive number of "
+           "failures, optionally followed by a window in seconds";
+
+  conf->login_source_limit = (int)limit;
+
+  if (arg2) {
+    apr_int64_t window = apr_atoi64(arg2);
+    if (window <= 0 || errno == ERANGE || window >> 31)
+      return "The failed login window must be a positive number of seconds";
+
+    conf->login_source_window = (int)window;
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodshttp2connections(cmd_parms *cmd, void *config,
+                                               const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!strcasecmp(arg1, "off")) {
+    conf->h2_connections = -1;
+    return NULL;
+  }
+
+  apr_int64_t count = apr_atoi64(arg1);
+  if (count <= 0 || count > 256 || errno == ERANGE)
+    return "The number of iRODS connections per HTTP/2 connection must be "
+           "'Off' or a number from 1 to 256";
+
+  conf->h2_connections = (int)count;
+  return NULL;
+}
+
+static const char *cmd_davrodstlssessioncache(cmd_parms *cmd, void *config,
+                                              const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!strcasecmp(arg1, "on")) {
+    conf->tls_session_cache = DAVRODS_TLS_SESSION_CACHE_ON;
+  } else if (!strcasecmp(arg1, "off")) {
+    conf->tls_session_cache = DAVRODS_TLS_SESSION_CACHE_OFF;
+  } else {
+    return "This directive accepts only 'On' and 'Off' values";
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsconnectionlimit(cmd_parms *cmd, void *config,
+                                              const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!strcasecmp(arg1, "off")) {
+    conf->conn_limit = -1;
+    return NULL;
+  }
+
+  apr_int64_t limit = apr_atoi64(arg1);
+  if (limit <= 0 || errno == ERANGE || limit >> 31)
+    return "The connection limit must be 'Off' or a positive number";
+
+  conf->conn_limit = (int)limit;
+  return NULL;
+}
+
+static const char *cmd_davrodsconnectionlimitperuser(cmd_parms *cmd,
+                                                     void *config,
+                                                     const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!strcasecmp(arg1, "off")) {
+    conf->conn_limit_per_user = -1;
+    return NULL;
+  }
+
+  apr_int64_t limit = apr_atoi64(arg1);
+  if (limit <= 0 || errno == ERANGE || limit >> 31)
+    return "The per-user connection limit must be 'Off' or a positive number";
+
+  conf->conn_limit_per_user = (int)limit;
+  return NULL;
+}
+
+static const char *cmd_davrodsconnectionqueue(cmd_parms *cmd, void *config,
+                                              const char *arg1,
+                                              const char *arg2) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!arg2 && !strcasecmp(arg1, "off")) {
+    conf->conn_queue_size = -1;
+    return NULL;
+  }
+
+  apr_int64_t size = apr_atoi64(arg1);
+  if (size <= 0 || errno == ERANGE || size >> 31)
+    return "The connection queue size must be 'Off' or a positive number, "
+           "optionally followed by a timeout in seconds";
+
+  conf->conn_queue_size = (int)size;
+
+  if (arg2) {
+    apr_int64_t timeout = apr_atoi64(arg2);
+    if (timeout <= 0 || errno == ERANGE || timeout >> 31)
+      return "The connection queue timeout must be a positive number of "
+             "seconds";
+
+    conf->conn_queue_timeout = (int)timeout;
+  }
+
+  return NULL;
+}
+
+static const char *cmd_davrodsauthcache(cmd_parms *cmd, void *config,
+                                        const char *arg1) {
+  const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+  if (err)
+    return err;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(cmd->server->module_config, &davrods_module);
+
+  if (!strcasecmp(arg1, "off")) {
+    conf->auth_cache = DAVRODS_AUTH_CACHE_OFF;
+  } else if (!strcasecmp(arg1, "on")) {
+    conf->auth_cache = DAVRODS_AUTH_CACHE_ON;
+  } else if (strlen(arg1) && arg1[0] != ':') {
+    conf->auth_cache = DAVRODS_AUTH_CACHE_ON;
+    conf->auth_cache_provider = arg1;
+  } else {
+    return "This directive accepts 'On', 'Off' or a socache provider name, "
+           "optionally followed by ':' and provider arguments";
+  }
+
+  return NULL;
+}
+
 // }}}
 
 const command_rec davrods_directives[] = {
-    AP_INIT_TAKE2(DAVRODS_CONFIG_PREFIX "Server", cmd_davrodsserver, NULL,
-                  ACCESS_CONF, "iRODS host and port to connect to"),
+    AP_INIT_TAKE_ARGV(DAVRODS_CONFIG_PREFIX "Server", cmd_davrodsserver, NULL,
+                      ACCESS_CONF,
+                      "iRODS host and port to connect to, or a list of "
+                      "host:port pairs"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ServerSelection",
+                  cmd_davrodsserverselection, NULL, ACCESS_CONF,
+                  "How to choose between multiple iRODS servers: "
+                  "LeastConnections or UserHash"),
     AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "AuthScheme", cmd_davrodsauthscheme,
                   NULL, ACCESS_CONF,
                   "iRODS authentication scheme to use (either Native or PAM)"),
@@ -462,6 +1471,19 @@ const command_rec davrods_directives[] = {
         DAVRODS_CONFIG_PREFIX "RxBufferKbs", cmd_davrodsrxbufferkbs, NULL,
         ACCESS_CONF,
         "Amount of file KiBs to download from iRODS at a time on GETs"),
+    AP_INIT_TAKE12(DAVRODS_CONFIG_PREFIX "SocketBuffers",
+                   cmd_davrodssocketbuffers, NULL, ACCESS_CONF,
+                   "Send and receive buffer sizes in KiB of iRODS connection "
+                   "sockets, 'Auto' optionally followed by the link "
+                   "bandwidth in Mbit/s, or Off"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "SocketNoDelay",
+                  cmd_davrodssocketnodelay, NULL, ACCESS_CONF,
+                  "On/Off switch for TCP_NODELAY on iRODS connections"),
+    AP_INIT_TAKE123(DAVRODS_CONFIG_PREFIX "SocketKeepAlive",
+                    cmd_davrodssocketkeepalive, NULL, ACCESS_CONF,
+                    "TCP keepalive idle time in seconds for iRODS "
+                    "connections, optionally followed by the probe interval "
+                    "and count, or Off"),
     AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "TmpfileRollback",
                   cmd_davrodstmpfilerollback, NULL, ACCESS_CONF,
                   "Support PUT rollback through the use of temporary files on "
@@ -475,6 +1497,18 @@ const command_rec davrods_directives[] = {
     AP_INIT_TAKE_ARGV(DAVRODS_CONFIG_PREFIX "AnonymousLogin",
                       cmd_davrodsanonymouslogin, NULL, ACCESS_CONF,
                       "Anonymous mode username and optional password"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ProxyMode", cmd_davrodsproxymode,
+                  NULL, ACCESS_CONF,
+                  "When On, iRODS connections are opened by a service account "
+                  "on behalf of users with recently verified credentials"),
+    AP_INIT_TAKE2(DAVRODS_CONFIG_PREFIX "ProxyLogin", cmd_davrodsproxylogin,
+                  NULL, ACCESS_CONF,
+                  "Proxy mode service account (rodsadmin) username and "
+                  "password"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ProxyVerifyTTL",
+                  cmd_davrodsproxyverifyttl, NULL, ACCESS_CONF,
+                  "Seconds for which verified user credentials are trusted in "
+                  "proxy mode"),
     AP_INIT_TAKE1(
         DAVRODS_CONFIG_PREFIX "HtmlHead", cmd_davrodshtmlhead, NULL,
         ACCESS_CONF,
@@ -498,5 +1532,116 @@ const command_rec davrods_directives[] = {
     AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ForceDownload",
                   cmd_davrodsforcedownload, NULL, ACCESS_CONF,
                   "When On, prevents inline display of files in web browsers"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "StatMemo", cmd_davrodsstatmemo, NULL,
+                  ACCESS_CONF,
+                  "Seconds for which iRODS stat results are reused within a "
+                  "session, or Off"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ChecksumETags",
+                  cmd_davrodschecksumetags, NULL, ACCESS_CONF,
+                  "When On, catalog checksums are used as data object ETags"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "CollectionTags",
+                  cmd_davrodscollectiontags, NULL, ACCESS_CONF,
+                  "Seconds for which collection change tags are reused, On "
+                  "(10 seconds), or Off"),
+    AP_INIT_TAKE_ARGV(DAVRODS_CONFIG_PREFIX "JunkPaths", cmd_davrodsjunkpaths,
+                      NULL, ACCESS_CONF,
+                      "File name patterns of client metadata files that are "
+                      "answered without asking iRODS, or Off"),
+    AP_INIT_TAKE12(DAVRODS_CONFIG_PREFIX "JunkWrites", cmd_davrodsjunkwrites,
+                   NULL, ACCESS_CONF,
+                   "What to do with uploaded junk files: Refuse, Discard, or "
+                   "Store <directory>"),
+    AP_INIT_TAKE12(DAVRODS_CONFIG_PREFIX "JunkStoreLimits",
+                   cmd_davrodsjunkstorelimits, NULL, ACCESS_CONF,
+                   "Largest stored junk file in kilobytes (default 1024), "
+                   "and seconds after which unmodified ones are removed "
+                   "(default 604800)"),
+    AP_INIT_TAKE12(DAVRODS_CONFIG_PREFIX "MetadataIndex",
+                   cmd_davrodsmetadataindex, NULL, ACCESS_CONF,
+                   "Directory for a local index of collection listings, and "
+                   "for how many seconds its listings are used without asking "
+                   "iRODS (default 60), or Off"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "PagedListings",
+                  cmd_davrodspagedlistings, NULL, ACCESS_CONF,
+                  "List collections for PROPFIND and HTML listings with paged "
+                  "catalog queries: On, Off, or a number of rows per page"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "CoalesceLookups",
+                  cmd_davrodscoalescelookups, NULL, ACCESS_CONF,
+                  "When On, concurrent identical stat and collection lookups "
+                  "share a single iRODS call"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ConnectionPool",
+                  cmd_davrodsconnectionpool, NULL, RSRC_CONF,
+                  "When On, authenticated iRODS connections are kept open "
+                  "after their HTTP connection closes, for reuse by later "
+                  "connections of the same user"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ConnectionPoolSize",
+                  cmd_davrodsconnectionpoolsize, NULL, RSRC_CONF,
+                  "Maximum amount of idle iRODS connections kept per Apache "
+                  "child process"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ConnectionPoolIdleTimeout",
+                  cmd_davrodsconnectionpoolidletimeout, NULL, RSRC_CONF,
+                  "Seconds after which an idle pooled iRODS connection is "
+                  "closed"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ConnectionPoolPrewarm",
+                  cmd_davrodsconnectionpoolprewarm, NULL, RSRC_CONF,
+                  "Amount of iRODS connections opened ahead of time per "
+                  "anonymous mode location and Apache child process"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ConnectionPoolPingInterval",
+                  cmd_davrodsconnectionpoolpinginterval, NULL, RSRC_CONF,
+                  "Seconds after which an idle prewarmed iRODS connection is "
+                  "pinged to keep it open"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ConnectionProbeAfter",
+                  cmd_davrodsconnectionprobeafter, NULL, RSRC_CONF,
+                  "Seconds of idleness after which an iRODS connection is "
+                  "checked to be alive before it is reused"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "TicketPoolSize",
+                  cmd_davrodsticketpoolsize, NULL, RSRC_CONF,
+                  "Max. number of idle iRODS connections with an active "
+                  "session ticket kept per child process, or Off"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "SessionIdleTimeout",
+                  cmd_davrodssessionidletimeout, NULL, RSRC_CONF,
+                  "Seconds after which the iRODS connection of an idle HTTP "
+                  "keep-alive connection is closed, or Off"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "Http2Connections",
+                  cmd_davrodshttp2connections, NULL, RSRC_CONF,
+                  "Number of iRODS connections shared by the streams of an "
+                  "HTTP/2 connection, or Off to give every stream its own "
+                  "session"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "TlsSessionCache",
+                  cmd_davrodstlssessioncache, NULL, RSRC_CONF,
+                  "On or Off, whether to resume TLS sessions when SSL is "
+                  "turned on for PAM authentication"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ConnectionLimit",
+                  cmd_davrodsconnectionlimit, NULL, RSRC_CONF,
+                  "Max. number of iRODS connections held by sessions, across "
+                  "all child processes, or Off"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "ConnectionLimitPerUser",
+                  cmd_davrodsconnectionlimitperuser, NULL, RSRC_CONF,
+                  "Max. number of iRODS connections held by sessions of a "
+                  "single user, across all child processes, or Off"),
+    AP_INIT_TAKE12(DAVRODS_CONFIG_PREFIX "ConnectionQueue",
+                   cmd_davrodsconnectionqueue, NULL, RSRC_CONF,
+                   "Max. number of requests waiting for an iRODS connection "
+                   "when a connection limit is reached, optionally followed "
+                   "by the max. wait in seconds, or Off"),
+    AP_INIT_TAKE1(DAVRODS_CONFIG_PREFIX "AuthCache", cmd_davrodsauthcache, NULL,
+                  RSRC_CONF,
+                  "On, Off, or the socache provider (e.g. 'shmcb:path(size)') "
+                  "used to share authentication results between logins"),
+    AP_INIT_TAKE12(DAVRODS_CONFIG_PREFIX "StatCache", cmd_davrodsstatcache,
+                   NULL, RSRC_CONF,
+                   "On, Off, or the socache provider used to share iRODS stat "
+                   "results between child processes, optionally followed by "
+                   "the TTL in seconds"),
+    AP_INIT_TAKE12(DAVRODS_CONFIG_PREFIX "FailedLoginBackoff",
+                   cmd_davrodsfailedloginbackoff, NULL, RSRC_CONF,
+                   "Seconds for which rejected credentials are refused "
+                   "without asking iRODS, optionally followed by the maximum "
+                   "after repeated failures, or Off"),
+    AP_INIT_TAKE12(DAVRODS_CONFIG_PREFIX "FailedLoginLimit",
+                   cmd_davrodsfailedloginlimit, NULL, RSRC_CONF,
+                   "Failed logins after which a client address is refused, "
+                   "optionally followed by the counting window in seconds, "
+                   "or Off"),
 
     {NULL}};
@@ -36,9 +36,28 @@ typedef enum davrods_anon_mode_t {
   DAVRODS_ANONYMOUS_MODE_ON,
 } davrods_anon_mode_t;
 
+typedef enum davrods_proxy_mode_t {
+  DAVRODS_PROXY_MODE_OFF = 1,
+  DAVRODS_PROXY_MODE_ON,
+} davrods_proxy_mode_t;
+
+typedef enum davrods_server_selection_t {
+  DAVRODS_SERVER_SELECTION_LEAST_CONNECTIONS = 1,
+  DAVRODS_SERVER_SELECTION_USER_HASH,
+} davrods_server_selection_t;
+
+/**
+ * \brief An iRODS server that Davrods may connect to.
+ */
+typedef struct davrods_server_t {
+  const char *host;
+  uint16_t port;
+} davrods_server_t;
+
 typedef struct davrods_session_parameters_t {
   davrods_auth_scheme_t auth_scheme;
   davrods_anon_mode_t anon_mode;
+  davrods_proxy_mode_t proxy_mode;
 } davrods_session_parameters_t;
 
 // }}}
@@ -48,8 +67,13 @@ typedef struct davrods_session_parameters_t {
  */
 typedef struct {
   // A zero / NULL value indicates an unset option.
-  const char *rods_host;
+  const char *rods_host; // The first configured server.
   uint16_t rods_port;
+
+  // All configured servers (davrods_server_t), NULL if only rods_host and
+  // rods_port are set.
+  apr_array_header_t *rods_servers;
+  davrods_server_selection_t rods_server_selection;
   const char *rods_zone;
   const char *rods_default_resource;
   const char *rods_env_file;
@@ -58,6 +82,25 @@ typedef struct {
   size_t rods_tx_buffer_size;
   size_t rods_rx_buffer_size;
 
+  // Socket options of iRODS connections.
+  enum {
+    DAVRODS_SOCKET_BUFFERS_OFF = 1, // Keep the kernel's defaults.
+    DAVRODS_SOCKET_BUFFERS_FIXED,
+    DAVRODS_SOCKET_BUFFERS_AUTO, // Sized to the bandwidth-delay product.
+  } socket_buffers;
+  int socket_sndbuf;    // In bytes.
+  int socket_rcvbuf;    // In bytes.
+  int socket_bandwidth; // In Mbit/s, for automatic sizing.
+
+  enum {
+    DAVRODS_SOCKET_NODELAY_OFF = 1,
+    DAVRODS_SOCKET_NODELAY_ON,
+  } socket_nodelay;
+
+  int socket_keepalive_idle;     // In seconds, -1 to keep the default.
+  int socket_keepalive_interval; // In seconds, 0 for the kernel's default.
+  int socket_keepalive_count;    // 0 for the kernel's default.
+
   enum {
     // Need to have something other than a bool to recognize the 'unset' state.
     DAVRODS_TMPFILE_ROLLBACK_OFF = 1,
@@ -75,6 +118,15 @@ typedef struct {
 
   int rods_auth_ttl; // In hours.
 
+  // In proxy mode, a service account logs in on behalf of users whose
+  // credentials were recently verified.
+  davrods_proxy_mode_t proxy_mode;
+
+  const char *proxy_auth_username;
+  const char *proxy_auth_password;
+
+  int proxy_verify_ttl; // In seconds.
+
   enum {
     //                               rods_exposed_root conf value => actual path
     //                               used
@@ -109,16 +161,169 @@ typedef struct {
     DAVRODS_FORCE_DOWNLOAD_ON,
   } force_download;
 
+  int stat_memo_ttl; // In seconds, -1 to not memoize stat results.
+
+  enum {
+    DAVRODS_CHECKSUM_ETAGS_OFF = 1,
+    DAVRODS_CHECKSUM_ETAGS_ON, // Use catalog checksums as data object ETags.
+  } checksum_etags;
+
+  // How long to remember collection change tags, in seconds. -1 disables
+  // change tags.
+  int collection_tag_ttl;
+
+  // File name patterns (const char *) of files that clients create for
+  // themselves, such as .DS_Store. Requests for these are answered without
+  // asking iRODS. Empty when none are configured.
+  apr_array_header_t *junk_paths;
+
+  enum {
+    DAVRODS_JUNK_WRITES_REFUSE = 1,
+    DAVRODS_JUNK_WRITES_DISCARD,
+    DAVRODS_JUNK_WRITES_STORE, // In junk_store_dir on the local filesystem.
+  } junk_writes;
+  const char *junk_store_dir;
+  // Largest stored junk file in bytes, and after how many seconds without
+  // modification stored junk files are removed.
+  apr_off_t junk_max_size;
+  int junk_expiry;
+
+  // Directory of the local metadata index (see metaindex.h), and for how
+  // many seconds its listings are used without asking iRODS. -1 disables the
+  // index.
+  const char *metaindex_dir;
+  int metaindex_freshness;
+
+  // Rows per catalog query page when listing collections for PROPFIND and
+  // HTML listings. -1 to list them with rclOpenCollection() instead.
+  int paged_listing_rows;
+
+  enum {
+    DAVRODS_COALESCE_LOOKUPS_OFF = 1,
+    DAVRODS_COALESCE_LOOKUPS_ON, // Share concurrent identical lookups.
+  } coalesce_lookups;
+
 } davrods_dir_conf_t;
 
+/**
+ * \brief Davrods per-server config structure.
+ *
+ * These options configure resources that are shared by all requests handled
+ * by an Apache child process, such as the iRODS connection pool. They can only
+ * be set in the global server context.
+ */
+typedef struct {
+  // A zero / NULL value indicates an unset option.
+
+  enum {
+    DAVRODS_CONN_POOL_OFF = 1,
+    DAVRODS_CONN_POOL_ON,
+  } conn_pool;
+
+  int conn_pool_size;          // Max. idle connections per child process.
+  int ticket_pool_size;        // Same, with a session ticket. -1 for none.
+  int conn_pool_idle_timeout;  // In seconds.
+  int conn_pool_prewarm;       // Per anonymous location and child process.
+  int conn_pool_ping_interval; // In seconds.
+  int conn_probe_after;        // In seconds.
+
+  int session_idle_timeout; // In seconds, 0 to keep idle sessions connected.
+  int h2_connections; // Shared by the streams of an HTTP/2 connection.
+
+  enum {
+    DAVRODS_TLS_SESSION_CACHE_OFF = 1,
+    DAVRODS_TLS_SESSION_CACHE_ON,
+  } tls_session_cache;
+
+  // Admission control. -1 means disabled.
+  int conn_limit;          // Max. connections held by sessions.
+  int conn_limit_per_user; // Max. connections held by sessions per user.
+  int conn_queue_size;     // Max. requests waiting for a connection.
+  int conn_queue_timeout;  // In seconds.
+
+  enum {
+    DAVRODS_AUTH_CACHE_OFF = 1,
+    DAVRODS_AUTH_CACHE_ON,
+  } auth_cache;
+
+  const char *auth_cache_provider; // Socache provider name and arguments.
+
+  enum {
+    DAVRODS_STAT_CACHE_OFF = 1,
+    DAVRODS_STAT_CACHE_ON,
+  } stat_cache;
+
+  const char *stat_cache_provider; // Socache provider name and arguments.
+  int stat_cache_ttl;              // In seconds.
+
+  // Failed login throttling. -1 means disabled.
+  int login_backoff;       // In seconds, doubled after every failure.
+  int login_backoff_max;   // In seconds.
+  int login_source_limit;  // Max. failures per client address and window.
+  int login_source_window; // In seconds.
+
+} davrods_server_conf_t;
+
 extern const davrods_dir_conf_t default_config;
+extern const davrods_server_conf_t default_server_config;
 
 // Access configuration. Fall back to default config if a value is 0/NULL.
 #define DAVRODS_CONF(x, y) ((x)->y ? (x)->y : default_config.y)
+#define DAVRODS_SERVER_CONF(x, y) ((x)->y ? (x)->y : default_server_config.y)
+
+/**
+ * \brief What the login code needs to know about a location.
+ *
+ * iRODS connections are normally opened on behalf of a request, but also by
+ * the prewarm thread (see prewarm.c), outside of any request. The login code
+ * therefore takes its configuration, pool and server from this structure
+ * rather than from a request.
+ */
+typedef struct {
+  server_rec *server; // For logging and shared caches.
+  apr_pool_t *pool;   // For allocations that last until the login is done.
+  const davrods_dir_conf_t *conf;
+} davrods_login_t;
+
+/**
+ * \brief Set up the login context of a request.
+ */
+void davrods_login_from_request(davrods_login_t *login, request_rec *r);
 
 extern const command_rec davrods_directives[];
 
 void *davrods_create_dir_config(apr_pool_t *p, char *dir);
 void *davrods_merge_dir_config(apr_pool_t *p, void *base, void *overrides);
 
+void *davrods_create_server_config(apr_pool_t *p, server_rec *s);
+void *davrods_merge_server_config(apr_pool_t *p, void *base, void *overrides);
+
+/**
+ * \brief Callback for davrods_config_walk_locations().
+ *
+ * \param data the data pointer passed to davrods_config_walk_locations()
+ * \param s    the (virtual) server the location belongs to
+ * \param path the location's path (or pattern)
+ * \param conf the location's merged directory config
+ */
+typedef void davrods_location_fn_t(void *data, server_rec *s,
+                                   const char *path,
+                                   const davrods_dir_conf_t *conf);
+
+/**
+ * \brief Call fn for every Location section that Davrods options apply to.
+ *
+ * Meant for post_config hooks, which have no request to take configuration
+ * from. The config passed to fn is merged like it would be for a request to
+ * the location's own path, including options inherited from the server
+ * config and from enclosing Location sections.
+ *
+ * \param p    pool to allocate merged configs from
+ * \param s    the main server
+ * \param fn   the callback
+ * \param data passed to fn
+ */
+void davrods_config_walk_locations(apr_pool_t *p, server_rec *s,
+                                   davrods_location_fn_t *fn, void *data);
+
 #endif /* _DAVRODS_CONFIG_H_ */
@@ -0,0 +1,446 @@
+/**
+ * \file
+ * \brief     Process-wide pool of authenticated iRODS connections.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "connpool.h"
+#include "common.h"
+#include "config.h"
+#include "servers.h"
+#include "socket.h"
+#include "stats.h"
+
+#include <apr_general.h>
+#include <apr_thread_mutex.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* iRODS sessions normally live as long as the client's TCP connection (see
+ * check_rods() in auth.c). Clients that open many short-lived connections
+ * would then have to log in to iRODS for every connection. To prevent this,
+ * the session of a closing HTTP connection hands its iRODS connection to this
+ * pool, from where it can be picked up by a later HTTP connection that
+ * authenticates with exactly the same parameters.
+ *
+ * The pool is a small fixed array of slots per child process, protected by a
+ * mutex so that it can be used from threaded MPMs.
+ *
+ * Connections opened ahead of time by prewarm.c are marked as warm. They are
+ * not closed when idle, but pinged periodically instead, so that neither
+ * iRODS nor a firewall drops them in the meantime.
+ *
+ * Connections with an activated session ticket are pooled as well, but only
+ * handed out to sessions that want to use the same ticket. This saves the
+ * ticket API call when clients interleave requests for different tickets
+ * (e.g. shared links). They have their own share of slots
+ * (DavrodsTicketPoolSize), so that they cannot push out plain connections.
+ */
+
+typedef struct {
+  rcComm_t *rods_conn; // NULL for an empty slot.
+  davrods_connpool_key_t key;
+  char ticket[NAME_LEN]; // Active session ticket, empty if none.
+  char username[NAME_LEN]; // For logging.
+  apr_time_t last_used;
+  bool warm; // Kept open while idle, see davrods_connpool_checkin_warm().
+} connpool_slot_t;
+
+static struct {
+  bool enabled;
+  server_rec *server;
+#if APR_HAS_THREADS
+  apr_thread_mutex_t *lock;
+#endif
+  unsigned char salt[16];
+  connpool_slot_t *slots;
+  int size;        // Total number of slots.
+  int plain_size;  // Max. connections without a session ticket.
+  int ticket_size; // Max. connections with a session ticket.
+  apr_interval_time_t idle_timeout;
+  apr_interval_time_t ping_interval;
+  apr_interval_time_t probe_after;
+} connpool;
+
+static void connpool_lock(void) {
+#if APR_HAS_THREADS
+  if (connpool.lock)
+    apr_thread_mutex_lock(connpool.lock);
+#endif
+}
+
+static void connpool_unlock(void) {
+#if APR_HAS_THREADS
+  if (connpool.lock)
+    apr_thread_mutex_unlock(connpool.lock);
+#endif
+}
+
+static void key_add_field(apr_sha1_ctx_t *ctx, const char *field) {
+  // Include the NUL terminator, so that field boundaries are part of the
+  // hash (user "ab" + zone "c" must not collide with user "a" + zone "bc").
+  apr_sha1_update(ctx, field, strlen(field) + 1);
+}
+
+void davrods_connpool_make_key(const davrods_login_t *login,
+                               const char *username, const char *password,
+                               davrods_connpool_key_t *key) {
+  const davrods_dir_conf_t *conf = login->conf;
+
+  apr_sha1_ctx_t ctx;
+  apr_sha1_init(&ctx);
+  apr_sha1_update_binary(&ctx, connpool.salt, sizeof(connpool.salt));
+
+  // A connection to any of the configured servers will do.
+  int server_count = 0;
+  const davrods_server_t *servers = davrods_servers_get(login, &server_count);
+  for (int i = 0; i < server_count; ++i) {
+    key_add_field(&ctx, servers[i].host);
+    key_add_field(&ctx, apr_itoa(login->pool, servers[i].port));
+  }
+
+  key_add_field(&ctx, apr_psprintf(login->pool, "%d %d",
+                                   DAVRODS_CONF(conf, rods_auth_scheme),
+                                   DAVRODS_CONF(conf, anonymous_mode)));
+  key_add_field(&ctx, DAVRODS_CONF(conf, rods_zone));
+  key_add_field(&ctx, DAVRODS_CONF(conf, rods_env_file));
+  key_add_field(&ctx, davrods_socket_settings(login));
+  key_add_field(&ctx, username);
+
+  if (password) {
+    key_add_field(&ctx, "direct");
+    key_add_field(&ctx, password);
+  } else {
+    // Proxied connection, usable by any verified session of this user.
+    key_add_field(&ctx, "proxy");
+    key_add_field(&ctx, DAVRODS_CONF(conf, proxy_auth_username));
+  }
+
+  apr_sha1_final(key->digest, &ctx);
+}
+
+/**
+ * \brief Close one pooled connection that has been idle for too long.
+ *
+ * \return whether a connection was closed.
+ */
+static bool connpool_reap_one(apr_time_t now) {
+  rcComm_t *expired = NULL;
+  char username[NAME_LEN];
+
+  connpool_lock();
+  for (int i = 0; i < connpool.size; ++i) {
+    connpool_slot_t *slot = &connpool.slots[i];
+    if (slot->rods_conn && !slot->warm &&
+        now - slot->last_used > connpool.idle_timeout) {
+      expired = slot->rods_conn;
+      strcpy(username, slot->username);
+      slot->rods_conn = NULL;
+      break;
+    }
+  }
+  connpool_unlock();
+
+  if (!expired)
+    return false;
+
+  // Disconnect outside of the lock, this involves network traffic.
+  ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, connpool.server,
+               "Closing idle pooled iRODS connection for user '%s'", username);
+  davrods_servers_disconnect(expired);
+  return true;
+}
+
+static void connpool_reap(apr_time_t now) {
+  while (connpool_reap_one(now))
+    ;
+}
+
+rcComm_t *davrods_connpool_checkout(request_rec *r,
+                                    const davrods_connpool_key_t *key) {
+  return davrods_connpool_checkout_ticket(r, key, "");
+}
+
+rcComm_t *davrods_connpool_checkout_ticket(request_rec *r,
+                                           const davrods_connpool_key_t *key,
+                                           const char *ticket) {
+  if (!connpool.enabled || strlen(ticket) >= NAME_LEN)
+    return NULL;
+
+  apr_time_t now = apr_time_now();
+  connpool_reap(now);
+
+  rcComm_t *rods_conn = NULL;
+
+  for (;;) {
+    apr_time_t last_used = 0;
+
+    connpool_lock();
+    // Prefer the most recently used connection, it is least likely to have
+    // been timed out on the iRODS side.
+    connpool_slot_t *best = NULL;
+    for (int i = 0; i < connpool.size; ++i) {
+      connpool_slot_t *slot = &connpool.slots[i];
+      if (slot->rods_conn &&
+          !memcmp(slot->key.digest, key->digest, sizeof(key->digest)) &&
+          !strcmp(slot->ticket, ticket) &&
+          (!best || slot->last_used > best->last_used))
+        best = slot;
+    }
+    if (best) {
+      rods_conn = best->rods_conn;
+      last_used = best->last_used;
+      best->rods_conn = NULL;
+    }
+    connpool_unlock();
+
+    // Make sure that a connection that has not been used for a while is
+    // still alive, handing out a broken one would fail the request.
+    if (!rods_conn || now - last_used <= connpool.probe_after)
+      break;
+
+    int status = davrods_servers_ping(rods_conn);
+    if (status >= 0)
+      break;
+
+    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                  "Discarding broken pooled iRODS connection: %d = %s",
+                  status, get_rods_error_msg(status));
+    davrods_stats_inc(DAVRODS_STAT_STALE_CONNECTION);
+    davrods_servers_disconnect(rods_conn);
+    rods_conn = NULL;
+  }
+
+  if (rods_conn)
+    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                  "Reusing pooled iRODS connection%s",
+                  ticket[0] ? " with active session ticket" : "");
+
+  return rods_conn;
+}
+
+static void connpool_put(const davrods_connpool_key_t *key,
+                         const char *username, const char *ticket,
+                         rcComm_t *rods_conn, bool warm) {
+  if (!connpool.enabled || strlen(ticket) >= NAME_LEN) {
+    davrods_servers_disconnect(rods_conn);
+    return;
+  }
+
+  apr_time_t now = apr_time_now();
+  rcComm_t *evicted = NULL;
+
+  connpool_lock();
+  // Use an empty slot if this kind of connection (with or without a ticket)
+  // has slots to spare, otherwise evict the least recently used connection of
+  // the same kind.
+  int capacity = ticket[0] ? connpool.ticket_size : connpool.plain_size;
+  int used = 0;
+  connpool_slot_t *empty = NULL;
+  connpool_slot_t *lru = NULL;
+  for (int i = 0; i < connpool.size; ++i) {
+    connpool_slot_t *slot = &connpool.slots[i];
+    if (!slot->rods_conn) {
+      if (!empty)
+        empty = slot;
+    } else if (!slot->ticket[0] == !ticket[0]) {
+      used++;
+      if (!lru || slot->last_used < lru->last_used)
+        lru = slot;
+    }
+  }
+  connpool_slot_t *target = used < capacity ? empty : lru;
+
+  if (target) {
+    evicted = target->rods_conn;
+    target->rods_conn = rods_conn;
+    target->key = *key;
+    target->last_used = now;
+    target->warm = warm;
+    apr_cpystrn(target->ticket, ticket, sizeof(target->ticket));
+    apr_cpystrn(target->username, username, sizeof(target->username));
+  }
+  connpool_unlock();
+
+  if (!target) {
+    // No slots for this kind of connection at all.
+    davrods_servers_disconnect(rods_conn);
+    return;
+  }
+
+  ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, connpool.server,
+               "Returned %siRODS connection for user '%s' to the pool%s%s",
+               warm ? "warm " : "", username,
+               ticket[0] ? " with active session ticket" : "",
+               evicted ? " (evicted the least recently used one)" : "");
+
+  if (evicted)
+    davrods_servers_disconnect(evicted);
+
+  connpool_reap(now);
+}
+
+void davrods_connpool_checkin(const davrods_connpool_key_t *key,
+                              const char *username, rcComm_t *rods_conn) {
+  connpool_put(key, username, "", rods_conn, false);
+}
+
+void davrods_connpool_checkin_ticket(const davrods_connpool_key_t *key,
+                                     const char *username, const char *ticket,
+                                     rcComm_t *rods_conn) {
+  connpool_put(key, username, ticket, rods_conn, false);
+}
+
+void davrods_connpool_checkin_warm(const davrods_connpool_key_t *key,
+                                   const char *username, rcComm_t *rods_conn) {
+  connpool_put(key, username, "", rods_conn, true);
+}
+
+bool davrods_connpool_keeps_tickets(void) {
+  return connpool.enabled && connpool.ticket_size > 0;
+}
+
+int davrods_connpool_count(const davrods_connpool_key_t *key) {
+  int count = 0;
+
+  connpool_lock();
+  for (int i = 0; i < connpool.size; ++i) {
+    connpool_slot_t *slot = &connpool.slots[i];
+    if (slot->rods_conn && !slot->ticket[0] &&
+        !memcmp(slot->key.digest, key->digest, sizeof(key->digest)))
+      count++;
+  }
+  connpool_unlock();
+
+  return count;
+}
+
+/**
+ * \brief Ping one warm connection that has not been used for a while.
+ *
+ * Connections that do not respond are closed.
+ *
+ * \return whether a connection was pinged.
+ */
+static bool connpool_ping_one(apr_time_t now) {
+  connpool_slot_t taken = {0};
+
+  connpool_lock();
+  for (int i = 0; i < connpool.size; ++i) {
+    connpool_slot_t *slot = &connpool.slots[i];
+    if (slot->rods_conn && slot->warm &&
+        now - slot->last_used >= connpool.ping_interval) {
+      taken = *slot;
+      slot->rods_conn = NULL;
+      break;
+    }
+  }
+  connpool_unlock();
+
+  if (!taken.rods_conn)
+    return false;
+
+  int status = davrods_servers_ping(taken.rods_conn);
+  if (status < 0) {
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, connpool.server,
+                 "Closing warm pooled iRODS connection for user '%s': ping "
+                 "failed: %d = %s",
+                 taken.username, status, get_rods_error_msg(status));
+    davrods_servers_disconnect(taken.rods_conn);
+  } else {
+    connpool_put(&taken.key, taken.username, "", taken.rods_conn, true);
+  }
+  return true;
+}
+
+void davrods_connpool_maintain(void) {
+  if (!connpool.enabled)
+    return;
+
+  apr_time_t now = apr_time_now();
+  connpool_reap(now);
+  while (connpool_ping_one(now))
+    ;
+}
+
+static apr_status_t connpool_cleanup(void *data) {
+  connpool_lock();
+  connpool.enabled = false;
+  connpool_unlock();
+
+  for (int i = 0; i < connpool.size; ++i) {
+    if (connpool.slots[i].rods_conn) {
+      davrods_servers_disconnect(connpool.slots[i].rods_conn);
+      connpool.slots[i].rods_conn = NULL;
+    }
+  }
+  return APR_SUCCESS;
+}
+
+static void connpool_child_init(apr_pool_t *p, server_rec *s) {
+  davrods_server_conf_t *conf =
+      ap_get_module_config(s->module_config, &davrods_module);
+  assert(conf);
+
+  connpool.server = s;
+  connpool.enabled =
+      DAVRODS_SERVER_CONF(conf, conn_pool) == DAVRODS_CONN_POOL_ON;
+
+  if (!connpool.enabled)
+    return;
+
+  int ticket_size = DAVRODS_SERVER_CONF(conf, ticket_pool_size);
+  connpool.plain_size = DAVRODS_SERVER_CONF(conf, conn_pool_size);
+  connpool.ticket_size = ticket_size > 0 ? ticket_size : 0;
+  connpool.size = connpool.plain_size + connpool.ticket_size;
+  connpool.idle_timeout =
+      apr_time_from_sec(DAVRODS_SERVER_CONF(conf, conn_pool_idle_timeout));
+  connpool.ping_interval =
+      apr_time_from_sec(DAVRODS_SERVER_CONF(conf, conn_pool_ping_interval));
+  connpool.probe_after =
+      apr_time_from_sec(DAVRODS_SERVER_CONF(conf, conn_probe_after));
+  connpool.slots = apr_pcalloc(p, connpool.size * sizeof(connpool_slot_t));
+  assert(connpool.slots);
+
+  apr_status_t status =
+      apr_generate_random_bytes(connpool.salt, sizeof(connpool.salt));
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not generate a connection pool salt, disabling the "
+                 "iRODS connection pool");
+    connpool.enabled = false;
+    return;
+  }
+
+#if APR_HAS_THREADS
+  status = apr_thread_mutex_create(&connpool.lock, APR_THREAD_MUTEX_DEFAULT, p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not create connection pool mutex, disabling the iRODS "
+                 "connection pool");
+    connpool.enabled = false;
+    return;
+  }
+#endif
+
+  apr_pool_cleanup_register(p, NULL, connpool_cleanup, apr_pool_cleanup_null);
+}
+
+void davrods_connpool_register(apr_pool_t *p) {
+  ap_hook_child_init(connpool_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
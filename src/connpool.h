@@ -0,0 +1,141 @@
+/**
+ * \file
+ * \brief     Process-wide pool of authenticated iRODS connections.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_CONNPOOL_H
+#define _DAVRODS_CONNPOOL_H
+
+#include "config.h"
+#include "mod_davrods.h"
+
+#include <apr_sha1.h>
+
+#include <irods/rodsClient.h>
+
+/**
+ * \brief Identifies the kind of session an iRODS connection was set up for.
+ *
+ * A pooled connection is only handed out to a request with an identical key.
+ * The key is a salted hash over everything that determines whether a
+ * connection can be reused (see davrods_user_can_reuse_connection()): iRODS
+ * server and zone, env file, auth scheme, anonymous mode switch, username and
+ * password.
+ * Passwords therefore never need to be kept in the pool itself.
+ *
+ * Connections opened by the proxy mode service account are keyed on the
+ * service account instead of the user's password.
+ */
+typedef struct davrods_connpool_key_t {
+  unsigned char digest[APR_SHA1_DIGESTSIZE];
+} davrods_connpool_key_t;
+
+/**
+ * \brief Compute the pool key for the given credentials and location config.
+ *
+ * \param[in]  login    the location the connection is for
+ * \param[in]  username
+ * \param[in]  password the user's password, or NULL for a proxied connection
+ * \param[out] key
+ */
+void davrods_connpool_make_key(const davrods_login_t *login,
+                               const char *username, const char *password,
+                               davrods_connpool_key_t *key);
+
+/**
+ * \brief Take an authenticated connection matching key out of the pool.
+ *
+ * The caller becomes the exclusive owner of the returned connection.
+ *
+ * \return an iRODS connection, or NULL if no matching connection is available.
+ */
+rcComm_t *davrods_connpool_checkout(request_rec *r,
+                                    const davrods_connpool_key_t *key);
+
+/**
+ * \brief Take a connection matching key that has the given session ticket
+ *        activated out of the pool.
+ *
+ * \param r
+ * \param key
+ * \param ticket the active session ticket, or "" for a connection without one
+ *
+ * \return an iRODS connection, or NULL if no matching connection is available.
+ */
+rcComm_t *davrods_connpool_checkout_ticket(request_rec *r,
+                                           const davrods_connpool_key_t *key,
+                                           const char *ticket);
+
+/**
+ * \brief Hand an authenticated connection back to the pool.
+ *
+ * The pool takes ownership of the connection. It may decide to disconnect it
+ * immediately, e.g. when pooling is disabled or the pool is full.
+ *
+ * \param key       the key the connection was authenticated for
+ * \param username  used for logging only
+ * \param rods_conn
+ */
+void davrods_connpool_checkin(const davrods_connpool_key_t *key,
+                              const char *username, rcComm_t *rods_conn);
+
+/**
+ * \brief Hand a connection with an active session ticket back to the pool.
+ *
+ * The connection will only be handed out again for the same key and ticket
+ * (see davrods_connpool_checkout_ticket()).
+ */
+void davrods_connpool_checkin_ticket(const davrods_connpool_key_t *key,
+                                     const char *username, const char *ticket,
+                                     rcComm_t *rods_conn);
+
+/**
+ * \brief Check whether connections with a session ticket are pooled at all.
+ */
+bool davrods_connpool_keeps_tickets(void);
+
+/**
+ * \brief Hand a connection that was opened ahead of time to the pool.
+ *
+ * Unlike connections returned by davrods_connpool_checkin(), warm
+ * connections are not closed when idle, but kept alive with periodic pings
+ * (see davrods_connpool_maintain()). A warm connection that is checked out
+ * and later checked in again becomes a normal pooled connection.
+ */
+void davrods_connpool_checkin_warm(const davrods_connpool_key_t *key,
+                                   const char *username, rcComm_t *rods_conn);
+
+/**
+ * \brief Count the pooled connections without a session ticket that match
+ *        key.
+ */
+int davrods_connpool_count(const davrods_connpool_key_t *key);
+
+/**
+ * \brief Close idle connections and ping warm connections that were not used
+ *        during the last ping interval.
+ *
+ * Pings involve network traffic, so this is meant to be called from a
+ * background thread (see prewarm.c).
+ */
+void davrods_connpool_maintain(void);
+
+void davrods_connpool_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_CONNPOOL_H */
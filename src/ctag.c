@@ -0,0 +1,272 @@
+/**
+ * \file
+ * \brief     Collection change tags.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ctag.h"
+
+#include <apr_strings.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* Sync clients compare the ETag (or CalendarServer's getctag property) of
+ * every collection with what they saw on their previous pass, and only list
+ * collections whose tag changed. A collection's own modification time is of
+ * no use for this, as it does not change when something deeper down the tree
+ * does.
+ *
+ * The change tag combines the latest modification time, and the number of
+ * data objects and subcollections, in the collection's subtree. Renames and
+ * modifications update modification times, additions and removals change the
+ * counts.
+ */
+
+/// Tags remembered per session.
+#define CTAG_MEMO_SIZE 32
+
+/// Tags of collections with longer paths are not remembered.
+#define CTAG_MEMO_PATH_LEN 256
+
+typedef struct {
+  char path[CTAG_MEMO_PATH_LEN];
+  char tag[64];
+  apr_time_t time; // 0 for an unused entry.
+} ctag_entry_t;
+
+typedef struct {
+  ctag_entry_t entries[CTAG_MEMO_SIZE];
+  int next; // The entry to replace when all are in use.
+} ctag_memo_t;
+
+static ctag_memo_t *ctag_memo_of(apr_pool_t *davrods_pool, bool create) {
+  ctag_memo_t *memo = NULL;
+  apr_pool_userdata_get((void **)&memo, "ctag_memo", davrods_pool);
+
+  if (!memo && create) {
+    memo = apr_pcalloc(davrods_pool, sizeof(ctag_memo_t));
+    apr_pool_userdata_set(memo, "ctag_memo", apr_pool_cleanup_null,
+                          davrods_pool);
+  }
+  return memo;
+}
+
+static bool is_below(const char *path, const char *coll, size_t coll_len) {
+  return !strncmp(path, coll, coll_len) &&
+         (path[coll_len] == '\0' || path[coll_len] == '/');
+}
+
+/**
+ * \brief Run an aggregate query for the maximum of one column, and the number
+ *        of values of another.
+ *
+ * \param[in]  pool      the pool to allocate results from
+ * \param[in]  rods_conn
+ * \param[in]  max_col
+ * \param[in]  count_col
+ * \param[in]  cond_col  the column that cond applies to
+ * \param[in]  cond      a condition on a collection name
+ * \param[out] max       the maximum, "" if nothing matched
+ * \param[out] count     the number of matching rows
+ *
+ * \return an iRODS status code
+ */
+static int query_max_count(apr_pool_t *pool, rcComm_t *rods_conn, int max_col,
+                           int count_col, int cond_col, const char *cond,
+                           const char **max, const char **count) {
+  genQueryInp_t query = {0};
+  genQueryOut_t *out = NULL;
+
+  query.maxRows = 1;
+  addInxIval(&query.selectInp, max_col, SELECT_MAX);
+  addInxIval(&query.selectInp, count_col, SELECT_COUNT);
+  addInxVal(&query.sqlCondInp, cond_col, cond);
+
+  *max = "";
+  *count = "0";
+
+  int status = rcGenQuery(rods_conn, &query, &out);
+  if (status >= 0 && out && out->rowCnt > 0) {
+    sqlResult_t *max_result = getSqlResultByInx(out, max_col);
+    sqlResult_t *count_result = getSqlResultByInx(out, count_col);
+    if (max_result && count_result) {
+      *max = apr_pstrdup(pool, max_result->value);
+      *count = apr_pstrdup(pool, count_result->value);
+    }
+  } else if (status == CAT_NO_ROWS_FOUND) {
+    status = 0;
+  }
+
+  freeGenQueryOut(&out);
+  clearGenQueryInp(&query);
+
+  return status;
+}
+
+static const char *ctag_query(const dav_resource *resource) {
+  dav_resource_private *res_private = resource->info;
+  apr_pool_t *pool = resource->pool;
+  const char *path = res_private->rods_path;
+
+  // Conditions are passed to iRODS as quoted SQL strings.
+  if (strchr(path, '\''))
+    return NULL;
+
+  // '%' and '_' in path act as wildcards. This can only make the tag change
+  // more often than needed.
+  const char *below = strcmp(path, "/")
+                          ? apr_pstrcat(pool, "like '", path, "/%'", NULL)
+                          : "like '/%'";
+  const char *in_or_below =
+      strcmp(path, "/") ? apr_pstrcat(pool, "= '", path, "' || ", below, NULL)
+                        : below;
+
+  const char *data_time, *data_count, *coll_time, *coll_count;
+
+  int status = query_max_count(pool, res_private->rods_conn, COL_D_MODIFY_TIME,
+                               COL_D_DATA_ID, COL_COLL_NAME, in_or_below,
+                               &data_time, &data_count);
+  if (status >= 0)
+    status = query_max_count(pool, res_private->rods_conn,
+                             COL_COLL_MODIFY_TIME, COL_COLL_ID, COL_COLL_NAME,
+                             below, &coll_time, &coll_count);
+
+  if (status < 0) {
+    ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, res_private->r,
+                  "Could not determine the change tag of <%s>: %s", path,
+                  get_rods_error_msg(status));
+    return NULL;
+  }
+
+  const rodsObjStat_t *stat;
+  if (davrods_get_stat(resource, &stat))
+    return NULL;
+
+  // iRODS timestamps are zero-padded, so they compare as strings.
+  const char *latest = stat->modifyTime;
+  if (strcmp(data_time, latest) > 0)
+    latest = data_time;
+  if (strcmp(coll_time, latest) > 0)
+    latest = coll_time;
+
+  return apr_psprintf(pool, "%s-%s-%s", latest, data_count, coll_count);
+}
+
+const char *davrods_ctag_get(const dav_resource *resource) {
+  dav_resource_private *res_private = resource->info;
+
+  int ttl = DAVRODS_CONF(res_private->conf, collection_tag_ttl);
+  if (ttl <= 0 || !resource->exists || !resource->collection)
+    return NULL;
+
+  const char *path = res_private->rods_path;
+  bool memoizable = strlen(path) < CTAG_MEMO_PATH_LEN;
+  apr_time_t now = apr_time_now();
+
+  ctag_memo_t *memo =
+      memoizable ? ctag_memo_of(res_private->davrods_pool, true) : NULL;
+
+  if (memo) {
+    for (int i = 0; i < CTAG_MEMO_SIZE; ++i) {
+      ctag_entry_t *entry = &memo->entries[i];
+      if (entry->time && now - entry->time <= apr_time_from_sec(ttl) &&
+          !strcmp(entry->path, path)) {
+        WHISPER("Change tag of <%s> memoized\n", path);
+        return apr_pstrdup(resource->pool, entry->tag);
+      }
+    }
+  }
+
+  const char *tag = ctag_query(resource);
+
+  if (memo && tag && strlen(tag) < sizeof(memo->entries[0].tag)) {
+    ctag_entry_t *entry = NULL;
+    for (int i = 0; i < CTAG_MEMO_SIZE && !entry; ++i) {
+      if (now - memo->entries[i].time > apr_time_from_sec(ttl) ||
+          !strcmp(memo->entries[i].path, path))
+        entry = &memo->entries[i];
+    }
+    if (!entry) {
+      entry = &memo->entries[memo->next];
+      memo->next = (memo->next + 1) % CTAG_MEMO_SIZE;
+    }
+
+    strcpy(entry->path, path);
+    strcpy(entry->tag, tag);
+    entry->time = now;
+  }
+
+  return tag;
+}
+
+const char *davrods_ctag_members(const dav_resource *resource,
+                                 const char *path) {
+  dav_resource_private *res_private = resource->info;
+  apr_pool_t *pool = resource->pool;
+
+  if (strchr(path, '\''))
+    return NULL;
+
+  const char *cond = apr_pstrcat(pool, "= '", path, "'", NULL);
+  const char *data_time, *data_count, *coll_time, *coll_count;
+
+  int status = query_max_count(pool, res_private->rods_conn, COL_D_MODIFY_TIME,
+                               COL_D_DATA_ID, COL_COLL_NAME, cond, &data_time,
+                               &data_count);
+  if (status >= 0)
+    status = query_max_count(pool, res_private->rods_conn,
+                             COL_COLL_MODIFY_TIME, COL_COLL_ID,
+                             COL_COLL_PARENT_NAME, cond, &coll_time,
+                             &coll_count);
+
+  if (status < 0) {
+    ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, res_private->r,
+                  "Could not determine the member tag of <%s>: %s", path,
+                  get_rods_error_msg(status));
+    return NULL;
+  }
+
+  const char *latest = strcmp(data_time, coll_time) > 0 ? data_time : coll_time;
+
+  return apr_psprintf(pool, "%s-%s-%s", latest, data_count, coll_count);
+}
+
+void davrods_ctag_invalidate(apr_pool_t *davrods_pool, const char *path) {
+  ctag_memo_t *memo = ctag_memo_of(davrods_pool, false);
+  if (!memo)
+    return;
+
+  size_t len = strlen(path);
+
+  for (int i = 0; i < CTAG_MEMO_SIZE; ++i) {
+    ctag_entry_t *entry = &memo->entries[i];
+    if (!entry->time)
+      continue;
+
+    // Collections that contain path, and those that path contains.
+    if (is_below(path, entry->path, strlen(entry->path)) ||
+        is_below(entry->path, path, len) || !strcmp(entry->path, "/"))
+      entry->time = 0;
+  }
+}
+
+void davrods_ctag_clear(apr_pool_t *davrods_pool) {
+  ctag_memo_t *memo = ctag_memo_of(davrods_pool, false);
+  if (memo)
+    memset(memo, 0, sizeof(ctag_memo_t));
+}
@@ -0,0 +1,66 @@
+/**
+ * \file
+ * \brief     Collection change tags.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_CTAG_H
+#define _DAVRODS_CTAG_H
+
+#include "repo.h"
+
+/**
+ * \brief Get the change tag of a collection.
+ *
+ * Unlike the collection's own modification time, the change tag changes
+ * whenever anything in the collection's subtree is added, removed or
+ * modified. It is computed with aggregate catalog queries, and remembered
+ * in the davrods pool for a short while (DavrodsCollectionTags).
+ *
+ * \return the tag, or NULL if change tags are disabled or could not be
+ *         determined
+ */
+const char *davrods_ctag_get(const dav_resource *resource);
+
+/**
+ * \brief Compute a change tag of the direct members of a collection.
+ *
+ * Like a change tag, but it only covers the data objects and subcollections
+ * directly in the collection, and it is always computed anew.
+ *
+ * \param resource a resource of the session
+ * \param path     the iRODS path of the collection
+ *
+ * \return the tag, or NULL if it could not be determined
+ */
+const char *davrods_ctag_members(const dav_resource *resource,
+                                 const char *path);
+
+/**
+ * \brief Forget the change tags of all collections that contain, or are
+ *        contained in, a path that is being modified.
+ */
+void davrods_ctag_invalidate(apr_pool_t *davrods_pool, const char *path);
+
+/**
+ * \brief Forget all change tags, e.g. when another session ticket is
+ *        activated.
+ */
+void davrods_ctag_clear(apr_pool_t *davrods_pool);
+
+#endif /* _DAVRODS_CTAG_H */
@@ -0,0 +1,244 @@
+/**
+ * \file
+ * \brief     Shared iRODS client environments.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "env.h"
+#include "common.h"
+#include "config.h"
+
+#include <apr_hash.h>
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* The iRODS client library is configured through an environment file whose
+ * path is taken from the IRODS_ENVIRONMENT_FILE process environment variable.
+ * Changing process environment variables is not thread-safe, and parsing the
+ * env file for every login is wasteful. Instead, all env files used by the
+ * configured locations are parsed once after startup, and sessions share the
+ * resulting rodsEnv structures.
+ *
+ * In the common case of a single env file, IRODS_ENVIRONMENT_FILE is set once
+ * before any requests are handled. Only when multiple env files are in use is
+ * the variable switched for logins. The client library reads the file while
+ * a login is in progress, so logins that use different env files take turns:
+ * any number of logins with the active file may run concurrently, and the
+ * file is switched once none of them is left. No lock is held during the
+ * logins themselves.
+ */
+
+typedef struct {
+  const char *path;
+  rodsEnv *env; // NULL if the file could not be loaded.
+} env_entry_t;
+
+static struct {
+  apr_hash_t *entries; // Path => env_entry_t. Lives in pconf.
+  bool switching;      // Whether more than one env file is in use.
+#if APR_HAS_THREADS
+  apr_thread_mutex_t *lock;
+  apr_thread_cond_t *cond;
+#endif
+  const char *active_path;
+  int active_logins;  // Logins in progress with the active env file.
+  int waiting_logins; // Logins waiting for a different env file.
+} env_state;
+
+void davrods_env_add_file(apr_pool_t *pconf, const char *path) {
+  if (!env_state.entries)
+    env_state.entries = apr_hash_make(pconf);
+
+  if (apr_hash_get(env_state.entries, path, APR_HASH_KEY_STRING))
+    return;
+
+  env_entry_t *entry = apr_pcalloc(pconf, sizeof(env_entry_t));
+  assert(entry);
+  entry->path = apr_pstrdup(pconf, path);
+  apr_hash_set(env_state.entries, entry->path, APR_HASH_KEY_STRING, entry);
+}
+
+static env_entry_t *get_entry(const davrods_dir_conf_t *conf) {
+  if (!env_state.entries)
+    return NULL;
+
+  return apr_hash_get(env_state.entries, DAVRODS_CONF(conf, rods_env_file),
+                      APR_HASH_KEY_STRING);
+}
+
+rodsEnv *davrods_env_get(const davrods_dir_conf_t *conf) {
+  env_entry_t *entry = get_entry(conf);
+  return entry ? entry->env : NULL;
+}
+
+void davrods_env_acquire(const davrods_login_t *login) {
+  if (!env_state.switching)
+    return;
+
+  env_entry_t *entry = get_entry(login->conf);
+  assert(entry);
+
+#if APR_HAS_THREADS
+  if (env_state.lock) {
+    apr_thread_mutex_lock(env_state.lock);
+
+    // Wait until the env file can be switched, or until it is ours. Once
+    // another file is wanted, new logins with the active file wait as well,
+    // so that the switch is not postponed forever.
+    bool waiting = false;
+    while (env_state.active_logins &&
+           (env_state.active_path != entry->path ||
+            env_state.waiting_logins > (waiting ? 1 : 0))) {
+      if (!waiting && env_state.active_path != entry->path) {
+        ++env_state.waiting_logins;
+        waiting = true;
+      }
+      apr_thread_cond_wait(env_state.cond, env_state.lock);
+    }
+    if (waiting)
+      --env_state.waiting_logins;
+  }
+#endif
+
+  if (env_state.active_path != entry->path) {
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Switching to iRODS env file at <%s>", entry->path);
+    setenv("IRODS_ENVIRONMENT_FILE", entry->path, 1);
+    env_state.active_path = entry->path;
+  }
+
+#if APR_HAS_THREADS
+  if (env_state.lock) {
+    ++env_state.active_logins;
+    apr_thread_mutex_unlock(env_state.lock);
+  }
+#endif
+}
+
+void davrods_env_release(const davrods_login_t *login) {
+  if (!env_state.switching)
+    return;
+
+#if APR_HAS_THREADS
+  if (env_state.lock) {
+    apr_thread_mutex_lock(env_state.lock);
+    if (!--env_state.active_logins)
+      apr_thread_cond_broadcast(env_state.cond);
+    apr_thread_mutex_unlock(env_state.lock);
+  }
+#endif
+}
+
+static int env_pre_config(apr_pool_t *pconf, apr_pool_t *plog,
+                          apr_pool_t *ptemp) {
+  // pconf is cleared on restart, start with a fresh list of env files.
+  env_state.entries = NULL;
+  env_state.active_path = NULL;
+  env_state.switching = false;
+
+  return OK;
+}
+
+static int env_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+                           apr_pool_t *ptemp, server_rec *s) {
+  // Set spOption variable so that connections will be labelled as
+  // Davrods connections in ips.
+  setenv("spOption", "Davrods", 1);
+
+  // Files set with DavrodsEnvFile have been added while parsing the
+  // configuration. A location that uses Davrods without setting any of its
+  // options cannot be told apart from other locations, so the default is
+  // always loaded. When its file does not exist, no location uses it.
+  davrods_env_add_file(pconf, default_config.rods_env_file);
+
+  unsigned int count = 0;
+  const char *last_path = NULL;
+
+  for (apr_hash_index_t *hi = apr_hash_first(ptemp, env_state.entries); hi;
+       hi = apr_hash_next(hi)) {
+    env_entry_t *entry = NULL;
+    apr_hash_this(hi, NULL, NULL, (void **)&entry);
+
+    setenv("IRODS_ENVIRONMENT_FILE", entry->path, 1);
+
+    rodsEnv *env = apr_pcalloc(pconf, sizeof(rodsEnv));
+    assert(env);
+    int status = getRodsEnv(env);
+    if (status < 0) {
+      // Requests that need this env file will fail, and never switch to it.
+      bool is_default = !strcmp(entry->path, default_config.rods_env_file);
+      ap_log_error(APLOG_MARK, is_default ? APLOG_INFO : APLOG_WARNING,
+                   APR_SUCCESS, s,
+                   "Could not load iRODS env file at <%s>: %d = %s",
+                   entry->path, status, get_rods_error_msg(status));
+      entry->env = NULL;
+      continue;
+    }
+
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, s,
+                 "Loaded iRODS env file at <%s>", entry->path);
+    entry->env = env;
+
+    ++count;
+    last_path = entry->path;
+  }
+
+  env_state.switching = count > 1;
+  env_state.active_path = last_path;
+
+  if (env_state.switching)
+    ap_log_error(APLOG_MARK, APLOG_INFO, APR_SUCCESS, s,
+                 "%u iRODS env files are in use, logins that use different "
+                 "env files will take turns",
+                 count);
+
+  return OK;
+}
+
+static void env_child_init(apr_pool_t *p, server_rec *s) {
+#if APR_HAS_THREADS
+  env_state.lock = NULL;
+  env_state.cond = NULL;
+  env_state.active_logins = 0;
+  env_state.waiting_logins = 0;
+  if (!env_state.switching)
+    return;
+
+  apr_status_t status =
+      apr_thread_mutex_create(&env_state.lock, APR_THREAD_MUTEX_DEFAULT, p);
+  if (status == APR_SUCCESS)
+    status = apr_thread_cond_create(&env_state.cond, p);
+  if (status != APR_SUCCESS) {
+    // Logins can then no longer safely switch env files.
+    ap_log_error(APLOG_MARK, APLOG_CRIT, status, s,
+                 "Could not create iRODS env file mutex");
+    env_state.lock = NULL;
+  }
+#endif
+}
+
+void davrods_env_register(apr_pool_t *p) {
+  ap_hook_pre_config(env_pre_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_post_config(env_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_child_init(env_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
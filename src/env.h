@@ -0,0 +1,68 @@
+/**
+ * \file
+ * \brief     Shared iRODS client environments.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_ENV_H
+#define _DAVRODS_ENV_H
+
+#include "config.h"
+#include "mod_davrods.h"
+
+#include <irods/rodsClient.h>
+
+/**
+ * \brief Remember an iRODS environment file that is referenced by the config.
+ *
+ * Called while parsing the configuration. All registered files, and the
+ * default env file if a location relies on it, are loaded once after the
+ * configuration has been read.
+ *
+ * \param pconf the configuration pool
+ * \param path  path to an irods_environment.json file
+ */
+void davrods_env_add_file(apr_pool_t *pconf, const char *path);
+
+/**
+ * \brief Get the iRODS environment that applies to the given location.
+ *
+ * The returned environment is shared by all requests and must not be
+ * modified.
+ *
+ * \return the parsed environment, or NULL if the env file could not be loaded.
+ */
+rodsEnv *davrods_env_get(const davrods_dir_conf_t *conf);
+
+/**
+ * \brief Make the login's env file the active one for the iRODS client
+ *        library.
+ *
+ * The iRODS client library reads its environment file (e.g. for SSL
+ * settings) while connecting and logging in. When more than one env file is
+ * in use, the active file is switched for the duration of a login, and logins
+ * that need different files take turns. Every call must be paired with a
+ * call to davrods_env_release().
+ */
+void davrods_env_acquire(const davrods_login_t *login);
+
+void davrods_env_release(const davrods_login_t *login);
+
+void davrods_env_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_ENV_H */
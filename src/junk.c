@@ -0,0 +1,470 @@
+/**
+ * \file
+ * \brief     Local handling of client metadata files.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "junk.h"
+#include "stats.h"
+
+#include <apr_file_io.h>
+#include <apr_fnmatch.h>
+#include <apr_sha1.h>
+#include <apr_strings.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* Desktop clients scatter their own bookkeeping over every collection they
+ * visit: Finder looks for ._* and .DS_Store files, Explorer for desktop.ini
+ * and Thumbs.db, and Office creates ~$* owner files next to open documents.
+ * None of these are of use in iRODS, yet every probe costs an iRODS round
+ * trip, and most of them are for files that do not exist.
+ *
+ * Paths whose file name matches one of the DavrodsJunkPaths patterns are
+ * therefore handled here, without asking iRODS. Uploads to such paths are
+ * refused, discarded, or kept in a local directory (DavrodsJunkWrites). Stored
+ * files are named after a hash of the user, the ticket and the iRODS path, so
+ * that neither users nor holders of a ticket see each other's files.
+ *
+ * The store is bounded by DavrodsJunkStoreLimits: larger uploads are refused,
+ * and every Apache child process removes files that were not modified for
+ * the configured time in its maintenance thread (see prewarm.c).
+ */
+
+/// Store directories are scanned for expired files at least this often, in
+/// seconds.
+#define JUNK_SCAN_INTERVAL 3600
+
+typedef struct {
+  server_rec *server;
+  const char *dir;
+  int expiry;           // The shortest of the locations using dir.
+  apr_time_t next_scan; // Per process.
+} junk_dir_t;
+
+static apr_array_header_t *store_dirs; // junk_dir_t. Lives in pconf.
+
+bool davrods_junk_match(const davrods_dir_conf_t *conf,
+                        const char *rods_path) {
+  const apr_array_header_t *patterns = DAVRODS_CONF(conf, junk_paths);
+  if (!patterns || !patterns->nelts)
+    return false;
+
+  const char *name = strrchr(rods_path, '/');
+  name = name ? name + 1 : rods_path;
+  if (!*name)
+    return false;
+
+  for (int i = 0; i < patterns->nelts; ++i) {
+    if (apr_fnmatch(APR_ARRAY_IDX(patterns, i, const char *), name,
+                    APR_FNM_CASE_BLIND) == APR_SUCCESS)
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * \brief Get the local path of a stored junk file.
+ *
+ * \return the path, or NULL if junk files are not stored
+ */
+static const char *junk_store_path(const dav_resource *resource) {
+  const dav_resource_private *res_private = resource->info;
+
+  if (DAVRODS_CONF(res_private->conf, junk_writes) !=
+      DAVRODS_JUNK_WRITES_STORE)
+    return NULL;
+
+  const char *username = NULL;
+  const char *ticket = NULL;
+  apr_pool_userdata_get((void **)&username, "username",
+                        res_private->davrods_pool);
+  apr_pool_userdata_get((void **)&ticket, "active_ticket",
+                        res_private->davrods_pool);
+  if (!username)
+    username = "";
+  if (!ticket)
+    ticket = "";
+
+  // NULs separate the user name, the ticket and the path.
+  apr_sha1_ctx_t sha1;
+  unsigned char digest[APR_SHA1_DIGESTSIZE];
+  apr_sha1_init(&sha1);
+  apr_sha1_update_binary(&sha1, (const unsigned char *)username,
+                         strlen(username) + 1);
+  apr_sha1_update_binary(&sha1, (const unsigned char *)ticket,
+                         strlen(ticket) + 1);
+  apr_sha1_update(&sha1, res_private->rods_path,
+                  strlen(res_private->rods_path));
+  apr_sha1_final(digest, &sha1);
+
+  char name[2 * APR_SHA1_DIGESTSIZE + 1];
+  ap_bin2hex(digest, sizeof(digest), name);
+
+  return apr_pstrcat(resource->pool,
+                     DAVRODS_CONF(res_private->conf, junk_store_dir), "/",
+                     name, NULL);
+}
+
+dav_error *davrods_junk_stat(dav_resource *resource) {
+  dav_resource_private *res_private = resource->info;
+
+  davrods_stats_inc(DAVRODS_STAT_JUNK_PATH);
+
+  resource->exists = 0;
+  resource->collection = 0;
+  res_private->stat = NULL;
+
+  const char *path = junk_store_path(resource);
+  if (!path) {
+    WHISPER("Junk path <%s> does not exist\n", res_private->rods_path);
+    return NULL;
+  }
+
+  apr_finfo_t finfo;
+  apr_status_t status =
+      apr_stat(&finfo, path, APR_FINFO_SIZE | APR_FINFO_MTIME | APR_FINFO_CTIME,
+               resource->pool);
+  if (APR_STATUS_IS_ENOENT(status))
+    return NULL;
+
+  if (status != APR_SUCCESS && status != APR_INCOMPLETE) {
+    ap_log_rerror(APLOG_MARK, APLOG_ERR, status, res_private->r,
+                  "Could not stat stored junk file <%s> for <%s>", path,
+                  res_private->rods_path);
+    return dav_new_error(resource->pool, HTTP_INTERNAL_SERVER_ERROR, 0, status,
+                         "Could not stat object");
+  }
+
+  // Present the file the way iRODS would present a data object.
+  rodsObjStat_t *stat = apr_pcalloc(resource->pool, sizeof(rodsObjStat_t));
+  stat->objType = DATA_OBJ_T;
+  stat->objSize = finfo.size;
+  apr_snprintf(stat->createTime, sizeof(stat->createTime),
+               "%011" APR_TIME_T_FMT, apr_time_sec(finfo.ctime));
+  apr_snprintf(stat->modifyTime, sizeof(stat->modifyTime),
+               "%011" APR_TIME_T_FMT, apr_time_sec(finfo.mtime));
+
+  res_private->stat = stat;
+  resource->exists = 1;
+
+  return NULL;
+}
+
+static dav_error *too_large(const dav_resource *resource) {
+  ap_log_rerror(APLOG_MARK, APLOG_INFO, APR_SUCCESS, resource->info->r,
+                "Refusing upload to junk path <%s> larger than %" APR_OFF_T_FMT
+                " bytes",
+                resource->info->rods_path,
+                DAVRODS_CONF(resource->info->conf, junk_max_size));
+  return dav_new_error(resource->pool, HTTP_REQUEST_ENTITY_TOO_LARGE, 0, 0,
+                       "Client metadata file is too large");
+}
+
+dav_error *davrods_junk_open(const dav_resource *resource, bool seekable,
+                             apr_file_t **file, const char **tmp_path) {
+  request_rec *r = resource->info->r;
+
+  *file = NULL;
+  *tmp_path = NULL;
+
+  int mode = DAVRODS_CONF(resource->info->conf, junk_writes);
+  if (mode == DAVRODS_JUNK_WRITES_REFUSE) {
+    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                  "Refusing upload to junk path <%s>",
+                  resource->info->rods_path);
+    return dav_new_error(resource->pool, HTTP_FORBIDDEN, 0, 0,
+                         "This server does not store client metadata files");
+  } else if (mode == DAVRODS_JUNK_WRITES_DISCARD) {
+    WHISPER("Discarding upload to junk path <%s>\n",
+            resource->info->rods_path);
+    return NULL;
+  }
+
+  // Chunked uploads, and ranges of seekable ones, are checked as they are
+  // written.
+  const char *length = apr_table_get(r->headers_in, "Content-Length");
+  if (length && !seekable &&
+      apr_atoi64(length) > DAVRODS_CONF(resource->info->conf, junk_max_size))
+    return too_large(resource);
+
+  const char *path = junk_store_path(resource);
+  apr_status_t status;
+
+  if (seekable) {
+    // Partial writes go straight into the stored file.
+    status = apr_file_open(
+        file, path, APR_FOPEN_WRITE | APR_FOPEN_CREATE | APR_FOPEN_BINARY,
+        APR_FPROT_OS_DEFAULT, resource->pool);
+  } else {
+    // Replace the stored file only when the upload completes.
+    char *template = apr_pstrcat(resource->pool, path, ".XXXXXX", NULL);
+    status = apr_file_mktemp(file, template,
+                             APR_FOPEN_WRITE | APR_FOPEN_CREATE |
+                                 APR_FOPEN_EXCL | APR_FOPEN_BINARY,
+                             resource->pool);
+    *tmp_path = template;
+  }
+
+  if (status != APR_SUCCESS) {
+    *file = NULL;
+    *tmp_path = NULL;
+    ap_log_rerror(APLOG_MARK, APLOG_ERR, status, r,
+                  "Could not open junk file <%s> for <%s>", path,
+                  resource->info->rods_path);
+    return dav_new_error(resource->pool, HTTP_INTERNAL_SERVER_ERROR, 0, status,
+                         "Could not open destination resource for writing");
+  }
+
+  return NULL;
+}
+
+dav_error *davrods_junk_write(const dav_resource *resource, apr_file_t *file,
+                              const void *buffer, apr_size_t length) {
+  if (!file)
+    return NULL;
+
+  apr_off_t offset = 0;
+  apr_status_t status = apr_file_seek(file, APR_CUR, &offset);
+  if (status == APR_SUCCESS &&
+      offset + (apr_off_t)length >
+          DAVRODS_CONF(resource->info->conf, junk_max_size))
+    return too_large(resource);
+
+  if (status == APR_SUCCESS)
+    status = apr_file_write_full(file, buffer, length, NULL);
+  if (status != APR_SUCCESS)
+    return dav_new_error(resource->pool, HTTP_INTERNAL_SERVER_ERROR, 0, status,
+                         "Could not write to the uploaded resource");
+  return NULL;
+}
+
+dav_error *davrods_junk_close(const dav_resource *resource, apr_file_t *file,
+                              const char *tmp_path, bool commit) {
+  if (!file)
+    return NULL;
+
+  apr_status_t status = apr_file_close(file);
+
+  if (tmp_path) {
+    if (commit && status == APR_SUCCESS)
+      status =
+          apr_file_rename(tmp_path, junk_store_path(resource), resource->pool);
+    if (!commit || status != APR_SUCCESS)
+      apr_file_remove(tmp_path, resource->pool);
+  }
+
+  if (commit && status != APR_SUCCESS) {
+    ap_log_rerror(APLOG_MARK, APLOG_ERR, status, resource->info->r,
+                  "Could not store junk file for <%s>",
+                  resource->info->rods_path);
+    return dav_new_error(resource->pool, HTTP_INTERNAL_SERVER_ERROR, 0, status,
+                         "Could not close the uploaded resource");
+  }
+
+  return NULL;
+}
+
+dav_error *davrods_junk_deliver(const dav_resource *resource,
+                                ap_filter_t *output) {
+  apr_pool_t *pool = resource->pool;
+  const char *path = junk_store_path(resource);
+  assert(path && resource->exists);
+
+  const rodsObjStat_t *stat;
+  dav_error *err = davrods_get_stat(resource, &stat);
+  if (err)
+    return err;
+
+  apr_file_t *file;
+  apr_status_t status =
+      apr_file_open(&file, path, APR_FOPEN_READ | APR_FOPEN_BINARY,
+                    APR_FPROT_OS_DEFAULT, pool);
+  if (status != APR_SUCCESS) {
+    ap_log_rerror(APLOG_MARK, APLOG_ERR, status, resource->info->r,
+                  "Could not open junk file <%s> for <%s>", path,
+                  resource->info->rods_path);
+    return dav_new_error(pool, HTTP_INTERNAL_SERVER_ERROR, 0, status,
+                         "Could not open requested resource for reading");
+  }
+
+  // Range requests are left to the core byterange filter.
+  apr_bucket_brigade *bb = apr_brigade_create(pool, output->c->bucket_alloc);
+  apr_brigade_insert_file(bb, file, 0, stat->objSize, pool);
+  APR_BRIGADE_INSERT_TAIL(bb, apr_bucket_eos_create(output->c->bucket_alloc));
+
+  status = ap_pass_brigade(output, bb);
+  apr_brigade_destroy(bb);
+
+  if (status != APR_SUCCESS)
+    return dav_new_error(pool, HTTP_INTERNAL_SERVER_ERROR, 0, status,
+                         "Could not write contents to filter.");
+
+  return NULL;
+}
+
+dav_error *davrods_junk_remove(dav_resource *resource) {
+  const char *path = junk_store_path(resource);
+  if (path) {
+    apr_status_t status = apr_file_remove(path, resource->pool);
+    if (status != APR_SUCCESS && !APR_STATUS_IS_ENOENT(status)) {
+      ap_log_rerror(APLOG_MARK, APLOG_ERR, status, resource->info->r,
+                    "Could not remove junk file <%s> for <%s>", path,
+                    resource->info->rods_path);
+      return dav_new_error(resource->pool, HTTP_INTERNAL_SERVER_ERROR, 0,
+                           status, "Could not remove file.");
+    }
+  }
+
+  resource->exists = 0;
+
+  return NULL;
+}
+
+dav_error *davrods_junk_copy(const dav_resource *src, dav_resource *dst,
+                             bool move) {
+  const char *src_path = junk_store_path(src);
+  const char *dst_path = junk_store_path(dst);
+  if (!src_path || !dst_path)
+    return dav_new_error(dst->pool, HTTP_FORBIDDEN, 0, 0,
+                         "This server does not store client metadata files");
+
+  apr_status_t status =
+      move ? apr_file_rename(src_path, dst_path, dst->pool)
+           : apr_file_copy(src_path, dst_path, APR_FPROT_FILE_SOURCE_PERMS,
+                           dst->pool);
+  if (status != APR_SUCCESS) {
+    ap_log_rerror(APLOG_MARK, APLOG_ERR, status, dst->info->r,
+                  "Could not %s junk file <%s> to <%s>",
+                  move ? "move" : "copy", src_path, dst_path);
+    return dav_new_error(dst->pool, HTTP_INTERNAL_SERVER_ERROR, 0, status,
+                         move ? "Something went wrong while renaming a "
+                                "resource"
+                              : "Could not copy file.");
+  }
+
+  dst->exists = 1;
+  dst->collection = 0;
+
+  return NULL;
+}
+
+/**
+ * \brief Remove stored files, and leftover partial uploads, that were not
+ *        modified for the directory's expiry time.
+ */
+static void expire_files(apr_pool_t *p, const junk_dir_t *store,
+                         apr_time_t now) {
+  apr_dir_t *dir;
+  apr_status_t status = apr_dir_open(&dir, store->dir, p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_WARNING, status, store->server,
+                 "Could not open junk store directory <%s>", store->dir);
+    return;
+  }
+
+  apr_time_t limit = now - apr_time_from_sec(store->expiry);
+  int removed = 0;
+
+  apr_finfo_t finfo;
+  while (apr_dir_read(&finfo, APR_FINFO_NAME | APR_FINFO_TYPE | APR_FINFO_MTIME,
+                      dir) == APR_SUCCESS) {
+    if (finfo.filetype == APR_REG && finfo.mtime < limit &&
+        apr_file_remove(apr_pstrcat(p, store->dir, "/", finfo.name, NULL),
+                        p) == APR_SUCCESS)
+      ++removed;
+  }
+  apr_dir_close(dir);
+
+  ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, store->server,
+               "Removed %d expired file(s) from junk store directory <%s>",
+               removed, store->dir);
+}
+
+static int scan_interval(const junk_dir_t *store) {
+  return store->expiry < JUNK_SCAN_INTERVAL ? store->expiry
+                                            : JUNK_SCAN_INTERVAL;
+}
+
+void davrods_junk_maintain(apr_pool_t *p) {
+  if (!store_dirs)
+    return;
+
+  apr_time_t now = apr_time_now();
+  junk_dir_t *dirs = (junk_dir_t *)store_dirs->elts;
+
+  for (int i = 0; i < store_dirs->nelts; ++i) {
+    if (now < dirs[i].next_scan)
+      continue;
+    dirs[i].next_scan = now + apr_time_from_sec(scan_interval(&dirs[i]));
+    expire_files(p, &dirs[i], now);
+  }
+}
+
+int davrods_junk_maintain_interval(void) {
+  int interval = 0;
+  const junk_dir_t *dirs =
+      store_dirs ? (const junk_dir_t *)store_dirs->elts : NULL;
+
+  for (int i = 0; store_dirs && i < store_dirs->nelts; ++i) {
+    int dir_interval = scan_interval(&dirs[i]);
+    if (!interval || dir_interval < interval)
+      interval = dir_interval;
+  }
+  return interval;
+}
+
+static void add_location_dir(void *data, server_rec *s, const char *path,
+                             const davrods_dir_conf_t *conf) {
+  if (DAVRODS_CONF(conf, junk_writes) != DAVRODS_JUNK_WRITES_STORE)
+    return;
+
+  const char *dir = DAVRODS_CONF(conf, junk_store_dir);
+  int expiry = DAVRODS_CONF(conf, junk_expiry);
+
+  // Locations may share a directory. Keep files for the shortest of their
+  // expiry times, so that none keeps them longer than configured.
+  junk_dir_t *dirs = (junk_dir_t *)store_dirs->elts;
+  for (int i = 0; i < store_dirs->nelts; ++i) {
+    if (!strcmp(dirs[i].dir, dir)) {
+      if (expiry < dirs[i].expiry)
+        dirs[i].expiry = expiry;
+      return;
+    }
+  }
+
+  junk_dir_t *store = apr_array_push(store_dirs);
+  assert(store);
+  store->server = s;
+  store->dir = dir;
+  store->expiry = expiry;
+  store->next_scan = 0;
+}
+
+static int junk_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+                            apr_pool_t *ptemp, server_rec *s) {
+  // The directory names live in pconf, the merged configs need not.
+  store_dirs = apr_array_make(pconf, 1, sizeof(junk_dir_t));
+  davrods_config_walk_locations(ptemp, s, add_location_dir, NULL);
+  return OK;
+}
+
+void davrods_junk_register(apr_pool_t *p) {
+  ap_hook_post_config(junk_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,113 @@
+/**
+ * \file
+ * \brief     Local handling of client metadata files.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_JUNK_H
+#define _DAVRODS_JUNK_H
+
+#include "repo.h"
+
+/**
+ * \brief Check whether an iRODS path names a file that clients create for
+ *        their own bookkeeping, such as .DS_Store (DavrodsJunkPaths).
+ *
+ * Requests for such paths are answered without asking iRODS: they do not
+ * exist unless they were stored locally (DavrodsJunkWrites Store).
+ */
+bool davrods_junk_match(const davrods_dir_conf_t *conf, const char *rods_path);
+
+/**
+ * \brief Fill in the exists, collection and stat properties of a junk
+ *        resource from the local store.
+ */
+dav_error *davrods_junk_stat(dav_resource *resource);
+
+/**
+ * \brief Open a junk resource for writing.
+ *
+ * \param[in]  resource
+ * \param[in]  seekable whether to write into the stored file in place,
+ *                      rather than replacing it when the stream is closed
+ * \param[out] file     NULL if the data is to be discarded
+ * \param[out] tmp_path the file to move into place on close, or NULL
+ *
+ * \return a 403 error when junk writes are refused, or a 413 error when the
+ *         upload is larger than the size limit
+ */
+dav_error *davrods_junk_open(const dav_resource *resource, bool seekable,
+                             apr_file_t **file, const char **tmp_path);
+
+/**
+ * \brief Write to a stream opened by davrods_junk_open().
+ *
+ * Does nothing if file is NULL.
+ *
+ * \return a 413 error when the file would grow beyond the size limit
+ */
+dav_error *davrods_junk_write(const dav_resource *resource, apr_file_t *file,
+                              const void *buffer, apr_size_t length);
+
+/**
+ * \brief Close a stream opened by davrods_junk_open().
+ *
+ * \param resource
+ * \param file
+ * \param tmp_path
+ * \param commit   whether to keep the written data
+ */
+dav_error *davrods_junk_close(const dav_resource *resource, apr_file_t *file,
+                              const char *tmp_path, bool commit);
+
+/**
+ * \brief Send a stored junk file to the client.
+ */
+dav_error *davrods_junk_deliver(const dav_resource *resource,
+                                ap_filter_t *output);
+
+/**
+ * \brief Remove a stored junk file.
+ */
+dav_error *davrods_junk_remove(dav_resource *resource);
+
+/**
+ * \brief Copy or move a stored junk file to another junk path.
+ */
+dav_error *davrods_junk_copy(const dav_resource *src, dav_resource *dst,
+                             bool move);
+
+/**
+ * \brief Remove expired files from the junk store directories.
+ *
+ * Called periodically by the maintenance thread of every child process.
+ *
+ * \param p pool for temporary allocations
+ */
+void davrods_junk_maintain(apr_pool_t *p);
+
+/**
+ * \brief Get how often the junk store directories need to be cleaned up.
+ *
+ * \return an interval in seconds, or 0 if no location stores junk files
+ */
+int davrods_junk_maintain_interval(void);
+
+void davrods_junk_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_JUNK_H */
@@ -20,7 +20,10 @@
  * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "listing.h"
+#include "metaindex.h"
+#include "pagedlist.h"
 #include "repo.h"
+#include "singleflight.h"
 
 /**
  * \brief Encode a path such that it can be safely used in a URI.
@@ -168,13 +171,34 @@ dav_error *davrods_deliver_directory_listing(const dav_resource *resource,
 
   collHandle_t coll_handle = {0};
 
-  // Open the collection.
+  // Use a stored listing if there is a current one, otherwise open the
+  // collection and store its listing. The listing may also be shared with a
+  // concurrent identical request, or read with paged catalog queries.
   collEnt_t coll_entry;
-  int status =
-      rclOpenCollection(resource->info->rods_conn, resource->info->rods_path,
-                        LONG_METADATA_FG, &coll_handle);
+  davrods_pagedlist_t *paged = NULL;
+  apr_array_header_t *entries = davrods_metaindex_list(resource, true);
+  davrods_metaindex_writer_t *index_writer =
+      entries ? NULL : davrods_metaindex_write_begin(resource, true);
+  int next_entry = 0;
+  int status = 0;
+
+  if (!entries)
+    status = davrods_singleflight_list(resource, LONG_METADATA_FG, &entries);
+
+  if (!entries && status >= 0 && davrods_pagedlist_enabled(resource)) {
+    paged = davrods_pagedlist_open(resource);
+  } else if (!entries && status >= 0) {
+    status = rclOpenCollection(resource->info->rods_conn,
+                               resource->info->rods_path, LONG_METADATA_FG,
+                               &coll_handle);
+    if (status < 0 && davrods_retry_on_broken_connection(resource, status))
+      status = rclOpenCollection(resource->info->rods_conn,
+                                 resource->info->rods_path, LONG_METADATA_FG,
+                                 &coll_handle);
+  }
 
   if (status < 0) {
+    davrods_metaindex_write_end(index_writer, false);
     ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, resource->info->r,
                   "rcOpenCollection failed: %d = %s", status,
                   get_rods_error_msg(status));
@@ -313,13 +337,22 @@ dav_error *davrods_deliver_directory_listing(const dav_resource *resource,
 
   // Actually print the directory listing, one table row at a time.
   do {
-    status =
-        rclReadCollection(resource->info->rods_conn, &coll_handle, &coll_entry);
+    if (paged)
+      status = davrods_pagedlist_next(paged, &coll_entry);
+    else if (!entries)
+      status = rclReadCollection(resource->info->rods_conn, &coll_handle,
+                                 &coll_entry);
+    else if (next_entry < entries->nelts)
+      coll_entry = APR_ARRAY_IDX(entries, next_entry++, collEnt_t);
+    else
+      status = CAT_NO_ROWS_FOUND;
 
     if (status < 0) {
       if (status == CAT_NO_ROWS_FOUND) {
         // End of collection.
+        davrods_metaindex_write_end(index_writer, true);
       } else {
+        davrods_metaindex_write_end(index_writer, false);
         ap_log_rerror(
             APLOG_MARK, APLOG_ERR, APR_SUCCESS, resource->info->r,
             "rcReadCollection failed for collection <%s> with error <%s>",
@@ -332,6 +365,8 @@ dav_error *davrods_deliver_directory_listing(const dav_resource *resource,
             "Could not read a collection entry from a collection.");
       }
     } else {
+      davrods_metaindex_write_entry(index_writer, &coll_entry);
+
       const char *name = coll_entry.objType == DATA_OBJ_T
                              ? coll_entry.dataName
                              : davrods_get_basename(coll_entry.collName);
@@ -0,0 +1,1176 @@
+/**
+ * \file
+ * \brief     Local index of collection listings.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "metaindex.h"
+#include "ctag.h"
+#include "stats.h"
+
+#include <apr_dbm.h>
+#include <apr_file_io.h>
+#include <apr_hash.h>
+#include <apr_sha1.h>
+#include <apr_strings.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* Browsing a large project collection lists the same collections over and
+ * over, and every listing costs catalog queries whose latency grows with the
+ * size of the catalog. With DavrodsMetadataIndex, collection listings read
+ * from iRODS are also stored in a local directory, one DBM file per user and
+ * collection keyed by member name, and later PROPFINDs, HTML listings and
+ * stat lookups of their members are answered from these files. A stat lookup
+ * is a single fetch, whatever the size of the collection.
+ *
+ * A stored listing is used as is within the freshness bound. After that, it
+ * is compared with a change tag of the collection's members, which takes two
+ * aggregate catalog queries. If the tag changed, only the members modified
+ * since the stored tag's latest modification time are read and stored. The
+ * listing is used again if the member counts of the new tag then add up,
+ * which relies on renames updating modification times, as change tags do
+ * (see ctag.c). Otherwise, the collection is listed in full.
+ *
+ * Davrods' own modifications must show up immediately, for every user. As
+ * stored listings are named after a hash, they cannot be found by path.
+ * Instead, modifying a path touches two shared marker files: a "tree" marker
+ * of the path, which covers the path and everything below it, and a "node"
+ * marker of its parent collection. A listing is outdated when the node marker
+ * of its collection, or the tree marker of the collection or any of its
+ * ancestors, is newer than the listing.
+ *
+ * The modifying user's own listing of the parent collection is kept instead:
+ * the modified member is marked unknown in it, and the listing remembers the
+ * node marker time it caused. Unknown members are looked up with a stat call
+ * when the listing is next read. Listings of other users and tickets, and
+ * listings below a modified collection, are still outdated as a whole. A
+ * modification by another process in the moment between the check of a
+ * listing and the touch of the marker is noticed only after the freshness
+ * bound, like modifications made by other iRODS clients.
+ *
+ * Every full listing stores its members under a new generation, and removes
+ * those of older generations when done. A member of a generation other than
+ * the listing's means a concurrent listing overwrote it, and makes the
+ * listing unusable until it is listed again.
+ *
+ * A stored listing is not used more than METAINDEX_EXPIRY_FACTOR times the
+ * freshness bound after it was last checked against the catalog. Every
+ * Apache child process removes such listings from the index directories in
+ * its maintenance thread (see prewarm.c), and markers after twice as long.
+ * A marker is older than every listing it outdates, so such a listing is
+ * always unusable before the marker is removed.
+ */
+
+#define METAINDEX_MAGIC "davrods-metaindex 2"
+
+/// Stored listings are removed after this many freshness bounds.
+#define METAINDEX_EXPIRY_FACTOR 10
+
+/// The key of a listing's header. Member names cannot contain a slash.
+#define METAINDEX_HEADER_KEY "/"
+
+/// Rows per catalog query when reading modified members.
+#define METAINDEX_QUERY_ROWS 256
+
+typedef struct {
+  server_rec *server;
+  const char *dir;
+  int freshness;        // The largest bound of the locations using dir.
+  apr_time_t next_scan; // Per process.
+} metaindex_dir_t;
+
+static apr_array_header_t *index_dirs; // metaindex_dir_t. Lives in pconf.
+
+typedef struct {
+  bool complete; // False while a full listing is being stored.
+  bool owners;   // Whether members include owner names.
+  apr_time_t generation;
+  apr_time_t time;       // When the listing was last known to be current.
+  apr_time_t node_touch; // When the user's own write last touched the node
+                         // marker, which does not outdate the listing.
+  // The member tag at time, see davrods_ctag_members(), with counts adjusted
+  // for own writes.
+  const char *latest;
+  apr_int64_t data_count;
+  apr_int64_t coll_count;
+} listing_header_t;
+
+typedef enum {
+  MEMBER_KNOWN,
+  MEMBER_UNKNOWN, // Modified by the user, to be looked up.
+  MEMBER_INVALID, // Damaged, or of another generation.
+} member_state_t;
+
+struct davrods_metaindex_writer {
+  const dav_resource *resource;
+  apr_dbm_t *db;
+  listing_header_t header;
+  bool failed;
+};
+
+static bool metaindex_enabled(const dav_resource *resource) {
+  const davrods_dir_conf_t *conf = resource->info->conf;
+  return DAVRODS_CONF(conf, metaindex_freshness) > 0 &&
+         DAVRODS_CONF(conf, metaindex_dir);
+}
+
+static apr_time_t expiry_of(const dav_resource *resource) {
+  return METAINDEX_EXPIRY_FACTOR *
+         apr_time_from_sec(
+             DAVRODS_CONF(resource->info->conf, metaindex_freshness));
+}
+
+static apr_datum_t datum_of(const char *str) {
+  apr_datum_t datum = {(char *)str, strlen(str)};
+  return datum;
+}
+
+static void key_add_field(apr_sha1_ctx_t *ctx, const char *field,
+                          apr_size_t len) {
+  // Include a NUL terminator so that field boundaries are part of the key.
+  apr_sha1_update_binary(ctx, (const unsigned char *)field, len);
+  apr_sha1_update_binary(ctx, (const unsigned char *)"", 1);
+}
+
+/**
+ * \brief Get the local path of an index file.
+ *
+ * \param resource
+ * \param coll     an iRODS collection path
+ * \param coll_len the length of coll, which may be that of an ancestor
+ * \param per_user whether the file is a listing, which depends on the
+ *                 session's user and ticket, or a marker shared by all users
+ * \param suffix   appended to the file name
+ */
+static const char *index_file(const dav_resource *resource, const char *coll,
+                              apr_size_t coll_len, bool per_user,
+                              const char *suffix) {
+  const dav_resource_private *res_private = resource->info;
+  const davrods_dir_conf_t *conf = res_private->conf;
+
+  const char *port = apr_itoa(resource->pool, DAVRODS_CONF(conf, rods_port));
+
+  apr_sha1_ctx_t sha1;
+  unsigned char digest[APR_SHA1_DIGESTSIZE];
+  apr_sha1_init(&sha1);
+  key_add_field(&sha1, DAVRODS_CONF(conf, rods_host),
+                strlen(DAVRODS_CONF(conf, rods_host)));
+  key_add_field(&sha1, port, strlen(port));
+  key_add_field(&sha1, DAVRODS_CONF(conf, rods_zone),
+                strlen(DAVRODS_CONF(conf, rods_zone)));
+
+  if (per_user) {
+    const char *username = NULL;
+    const char *ticket = NULL;
+    apr_pool_userdata_get((void **)&username, "username",
+                          res_private->davrods_pool);
+    apr_pool_userdata_get((void **)&ticket, "active_ticket",
+                          res_private->davrods_pool);
+    username = username ? username : "";
+    ticket = ticket ? ticket : "";
+    key_add_field(&sha1, username, strlen(username));
+    key_add_field(&sha1, ticket, strlen(ticket));
+  }
+
+  key_add_field(&sha1, coll, coll_len);
+  apr_sha1_final(digest, &sha1);
+
+  char name[2 * APR_SHA1_DIGESTSIZE + 1];
+  ap_bin2hex(digest, sizeof(digest), name);
+
+  return apr_pstrcat(resource->pool, DAVRODS_CONF(conf, metaindex_dir), "/",
+                     name, suffix, NULL);
+}
+
+static bool marker_newer(const dav_resource *resource, const char *coll,
+                         apr_size_t coll_len, const char *suffix,
+                         apr_time_t time, apr_time_t own_touch) {
+  apr_finfo_t finfo;
+  const char *marker = index_file(resource, coll, coll_len, false, suffix);
+  return apr_stat(&finfo, marker, APR_FINFO_MTIME, resource->pool) ==
+             APR_SUCCESS &&
+         finfo.mtime >= time && finfo.mtime != own_touch;
+}
+
+/**
+ * \brief Check whether Davrods modified anything in a collection since a
+ *        listing of it was current, other than what the listing knows of.
+ */
+static bool changed_since(const dav_resource *resource, const char *coll,
+                          const listing_header_t *header) {
+  apr_size_t len = strlen(coll);
+
+  if (marker_newer(resource, coll, len, ".node", header->time,
+                   header->node_touch))
+    return true;
+
+  // The collection itself and every ancestor, except for the root.
+  for (apr_size_t i = 1; i <= len; ++i) {
+    if ((i == len || coll[i] == '/') &&
+        marker_newer(resource, coll, i, ".tree", header->time, 0))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * \return the modification time given to the marker, or 0 on failure
+ */
+static apr_time_t touch_marker(const dav_resource *resource, const char *path,
+                               apr_size_t len, const char *suffix) {
+  const char *marker = index_file(resource, path, len, false, suffix);
+  apr_time_t now = apr_time_now();
+
+  apr_file_t *file = NULL;
+  apr_status_t status =
+      apr_file_open(&file, marker, APR_FOPEN_WRITE | APR_FOPEN_CREATE,
+                    APR_FPROT_OS_DEFAULT, resource->pool);
+  if (status == APR_SUCCESS) {
+    apr_file_close(file);
+    status = apr_file_mtime_set(marker, now, resource->pool);
+  }
+
+  if (status != APR_SUCCESS) {
+    ap_log_rerror(APLOG_MARK, APLOG_WARNING, status, resource->info->r,
+                  "Could not update metadata index marker <%s>", marker);
+    return 0;
+  }
+  return now;
+}
+
+/**
+ * \brief Split a member tag into its latest modification time and counts.
+ */
+static bool parse_tag(apr_pool_t *pool, const char *tag, const char **latest,
+                      apr_int64_t *data_count, apr_int64_t *coll_count) {
+  const char *coll_dash = strrchr(tag, '-');
+  const char *data_dash = NULL;
+  for (const char *c = tag; c < coll_dash; ++c) {
+    if (*c == '-')
+      data_dash = c;
+  }
+  if (!data_dash)
+    return false;
+
+  *latest = apr_pstrmemdup(pool, tag, data_dash - tag);
+  *data_count = apr_atoi64(data_dash + 1);
+  *coll_count = apr_atoi64(coll_dash + 1);
+  return true;
+}
+
+static bool read_header(apr_dbm_t *db, apr_pool_t *pool,
+                        listing_header_t *header) {
+  apr_datum_t value;
+  if (apr_dbm_fetch(db, datum_of(METAINDEX_HEADER_KEY), &value) !=
+          APR_SUCCESS ||
+      !value.dptr)
+    return false;
+
+  const char *text = apr_pstrmemdup(pool, value.dptr, value.dsize);
+  apr_dbm_freedatum(db, value);
+
+  char state = 0;
+  int owners = 0;
+  int latest_offset = -1;
+  if (sscanf(text,
+             METAINDEX_MAGIC " %c %d %" APR_TIME_T_FMT " %" APR_TIME_T_FMT
+                             " %" APR_TIME_T_FMT " %" APR_INT64_T_FMT
+                             " %" APR_INT64_T_FMT " %n",
+             &state, &owners, &header->generation, &header->time,
+             &header->node_touch, &header->data_count, &header->coll_count,
+             &latest_offset) < 7 ||
+      latest_offset < 0)
+    return false;
+
+  header->complete = state == 'C';
+  header->owners = owners != 0;
+  header->latest = text + latest_offset;
+  return true;
+}
+
+static apr_status_t write_header(apr_dbm_t *db, apr_pool_t *pool,
+                                 const listing_header_t *header) {
+  const char *text = apr_psprintf(
+      pool,
+      METAINDEX_MAGIC " %c %d %" APR_TIME_T_FMT " %" APR_TIME_T_FMT
+                      " %" APR_TIME_T_FMT " %" APR_INT64_T_FMT
+                      " %" APR_INT64_T_FMT " %s",
+      header->complete ? 'C' : 'B', header->owners ? 1 : 0,
+      header->generation, header->time, header->node_touch,
+      header->data_count, header->coll_count, header->latest);
+  return apr_dbm_store(db, datum_of(METAINDEX_HEADER_KEY), datum_of(text));
+}
+
+/**
+ * \brief Format a member as type, size, create time, modify time and owner.
+ */
+static const char *format_member(apr_pool_t *pool, apr_time_t generation,
+                                 const collEnt_t *entry) {
+  return apr_psprintf(pool,
+                      "%" APR_TIME_T_FMT " %c %" DAVRODS_SIZE_T_FMT
+                      " %s %s %s",
+                      generation, entry->objType == COLL_OBJ_T ? 'C' : 'D',
+                      entry->objType == COLL_OBJ_T ? 0 : entry->dataSize,
+                      entry->createTime ? entry->createTime : "",
+                      entry->modifyTime ? entry->modifyTime : "",
+                      entry->ownerName ? entry->ownerName : "");
+}
+
+/**
+ * \brief Parse a stored member.
+ *
+ * \param[in]  pool
+ * \param[in]  value
+ * \param[in]  header the header of the listing
+ * \param[out] entry  the member's details, allocated from pool, for a known
+ *                    member
+ * \param[out] listed for an unknown member, 'C' or 'D' if the member was
+ *                    counted in the header as a collection or data object,
+ *                    and '-' if it was not
+ */
+static member_state_t parse_member(apr_pool_t *pool, apr_datum_t value,
+                                   const listing_header_t *header,
+                                   collEnt_t *entry, char *listed) {
+  char *text = apr_pstrmemdup(pool, value.dptr, value.dsize);
+
+  char *rest = NULL;
+  apr_int64_t generation = apr_strtoi64(text, &rest, 10);
+  if (*rest++ != ' ' || generation != header->generation)
+    return MEMBER_INVALID;
+
+  if (rest[0] == '?') {
+    *listed = rest[1];
+    return MEMBER_UNKNOWN;
+  }
+
+  // Type, size, create time and modify time are separated by single spaces.
+  // The owner takes the remainder.
+  char *fields[4];
+  for (int i = 0; i < 4; ++i) {
+    fields[i] = rest;
+    rest = strchr(rest, ' ');
+    if (!rest)
+      return MEMBER_INVALID;
+    *rest++ = '\0';
+  }
+
+  memset(entry, 0, sizeof(*entry));
+  entry->objType = fields[0][0] == 'C' ? COLL_OBJ_T : DATA_OBJ_T;
+  entry->dataSize = apr_atoi64(fields[1]);
+  entry->createTime = fields[2];
+  entry->modifyTime = fields[3];
+  entry->ownerName = rest;
+
+  return MEMBER_KNOWN;
+}
+
+/**
+ * \brief Open the stored listing of a collection, if it is complete, and
+ *        current apart from the freshness bound.
+ *
+ * \param[in]  resource
+ * \param[in]  coll     an iRODS collection path
+ * \param[in]  mode     APR_DBM_READONLY or APR_DBM_READWRITE
+ * \param[out] header
+ *
+ * \return the listing, or NULL
+ */
+static apr_dbm_t *open_listing(const dav_resource *resource, const char *coll,
+                               apr_int32_t mode, listing_header_t *header) {
+  apr_pool_t *pool = resource->pool;
+  const char *path = index_file(resource, coll, strlen(coll), true, "");
+
+  apr_dbm_t *db = NULL;
+  if (apr_dbm_open(&db, path, mode, APR_OS_DEFAULT, pool) != APR_SUCCESS)
+    return NULL;
+
+  if (!read_header(db, pool, header) || !header->complete ||
+      apr_time_now() - header->time > expiry_of(resource) ||
+      changed_since(resource, coll, header)) {
+    apr_dbm_close(db);
+    return NULL;
+  }
+  return db;
+}
+
+/**
+ * \brief Collect the member names of a listing.
+ *
+ * Keys are copied first, as the listing must not be modified while its keys
+ * are iterated.
+ */
+static apr_array_header_t *member_names(apr_dbm_t *db, apr_pool_t *pool) {
+  apr_array_header_t *names = apr_array_make(pool, 64, sizeof(const char *));
+  apr_datum_t key = {0};
+
+  for (apr_status_t status = apr_dbm_firstkey(db, &key);
+       status == APR_SUCCESS && key.dsize;
+       status = apr_dbm_nextkey(db, &key)) {
+    const char *name = apr_pstrmemdup(pool, key.dptr, key.dsize);
+    if (strcmp(name, METAINDEX_HEADER_KEY))
+      APR_ARRAY_PUSH(names, const char *) = name;
+  }
+  return names;
+}
+
+/**
+ * \brief Look up a member of a collection in iRODS.
+ *
+ * \return 1 and the member's details, 0 if it does not exist, or an iRODS
+ *         error code
+ */
+static int stat_member(const dav_resource *resource, const char *coll,
+                       const char *name, collEnt_t *entry) {
+  apr_pool_t *pool = resource->pool;
+  const char *path = strcmp(coll, "/")
+                         ? apr_pstrcat(pool, coll, "/", name, NULL)
+                         : apr_pstrcat(pool, "/", name, NULL);
+  if (strlen(path) >= MAX_NAME_LEN)
+    return SYS_INVALID_INPUT_PARAM;
+
+  dataObjInp_t obj_inp = {{0}};
+  strcpy(obj_inp.objPath, path);
+
+  rodsObjStat_t *stat = NULL;
+  int status = rcObjStat(resource->info->rods_conn, &obj_inp, &stat);
+  if (status == USER_FILE_DOES_NOT_EXIST)
+    return 0;
+  if (status < 0)
+    return status;
+
+  memset(entry, 0, sizeof(*entry));
+  entry->objType = stat->objType;
+  entry->dataSize = stat->objSize;
+  entry->createTime = apr_pstrdup(pool, stat->createTime);
+  entry->modifyTime = apr_pstrdup(pool, stat->modifyTime);
+  entry->ownerName = apr_pstrdup(pool, stat->ownerName);
+  freeRodsObjStat(stat);
+
+  return entry->objType == COLL_OBJ_T || entry->objType == DATA_OBJ_T
+             ? 1
+             : SYS_INVALID_INPUT_PARAM;
+}
+
+/**
+ * \brief Look up an unknown member, and store what was found.
+ *
+ * The header counts are adjusted for a member that was added or removed.
+ */
+static bool resolve_member(const dav_resource *resource, apr_dbm_t *db,
+                           const char *coll, const char *name, char listed,
+                           listing_header_t *header, collEnt_t *entry,
+                           bool *exists) {
+  int status = stat_member(resource, coll, name, entry);
+  if (status < 0) {
+    ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, resource->info->r,
+                  "Could not look up <%s> in <%s> for the metadata index: %s",
+                  name, coll, get_rods_error_msg(status));
+    return false;
+  }
+
+  if (listed == 'C')
+    --header->coll_count;
+  else if (listed == 'D')
+    --header->data_count;
+
+  *exists = status > 0;
+  if (!*exists)
+    return apr_dbm_delete(db, datum_of(name)) == APR_SUCCESS;
+
+  if (entry->objType == COLL_OBJ_T)
+    ++header->coll_count;
+  else
+    ++header->data_count;
+
+  return apr_dbm_store(db, datum_of(name),
+                       datum_of(format_member(resource->pool,
+                                              header->generation, entry))) ==
+         APR_SUCCESS;
+}
+
+/**
+ * \brief Read all members of a listing, looking up unknown ones.
+ *
+ * \param resource
+ * \param db       a listing opened for writing
+ * \param coll     the collection's path
+ * \param header   the listing's header, updated if unknown members change
+ *                 its counts
+ * \param entries  an array to append collEnt_t members to, or NULL
+ *
+ * \return whether all members could be read
+ */
+static bool read_members(const dav_resource *resource, apr_dbm_t *db,
+                         const char *coll, listing_header_t *header,
+                         apr_array_header_t *entries) {
+  apr_pool_t *pool = resource->pool;
+  apr_array_header_t *names = member_names(db, pool);
+  bool resolved = false;
+
+  for (int i = 0; i < names->nelts; ++i) {
+    const char *name = APR_ARRAY_IDX(names, i, const char *);
+
+    apr_datum_t value;
+    if (apr_dbm_fetch(db, datum_of(name), &value) != APR_SUCCESS ||
+        !value.dptr)
+      return false;
+
+    collEnt_t entry;
+    char listed = '-';
+    member_state_t state = parse_member(pool, value, header, &entry, &listed);
+    apr_dbm_freedatum(db, value);
+
+    bool exists = true;
+    if (state == MEMBER_INVALID)
+      return false;
+    if (state == MEMBER_UNKNOWN) {
+      if (!resolve_member(resource, db, coll, name, listed, header, &entry,
+                          &exists))
+        return false;
+      resolved = true;
+    }
+
+    if (!entries || !exists)
+      continue;
+
+    // Like rclReadCollection(), give data objects a name and collections a
+    // full path.
+    if (entry.objType == COLL_OBJ_T) {
+      entry.collName = strcmp(coll, "/")
+                           ? apr_pstrcat(pool, coll, "/", name, NULL)
+                           : apr_pstrcat(pool, "/", name, NULL);
+    } else {
+      entry.collName = (char *)coll;
+      entry.dataName = (char *)name;
+    }
+    APR_ARRAY_PUSH(entries, collEnt_t) = entry;
+  }
+
+  return !resolved || write_header(db, pool, header) == APR_SUCCESS;
+}
+
+/**
+ * \brief Store the members of a collection that were modified since the
+ *        listing's latest modification time.
+ *
+ * \param[in]  resource
+ * \param[in]  db
+ * \param[in]  coll
+ * \param[in]  header
+ * \param[in]  collections whether to read subcollections or data objects
+ * \param[out] added       the number of rows, as counted by a member tag,
+ *                         of members that were not in the listing
+ *
+ * \return an iRODS status code
+ */
+static int store_modified(const dav_resource *resource, apr_dbm_t *db,
+                          const char *coll, const listing_header_t *header,
+                          bool collections, apr_int64_t *added) {
+  dav_resource_private *res_private = resource->info;
+  apr_pool_t *pool = resource->pool;
+
+  int name_col = collections ? COL_COLL_NAME : COL_DATA_NAME;
+  int create_col = collections ? COL_COLL_CREATE_TIME : COL_D_CREATE_TIME;
+  int modify_col = collections ? COL_COLL_MODIFY_TIME : COL_D_MODIFY_TIME;
+  int owner_col = collections ? COL_COLL_OWNER_NAME : COL_D_OWNER_NAME;
+
+  genQueryInp_t query = {0};
+  genQueryOut_t *out = NULL;
+
+  query.maxRows = METAINDEX_QUERY_ROWS;
+  // Ordered by name, so that replicas of a data object are adjacent.
+  addInxIval(&query.selectInp, name_col, ORDER_BY);
+  addInxIval(&query.selectInp, create_col, 1);
+  addInxIval(&query.selectInp, modify_col, 1);
+  addInxIval(&query.selectInp, owner_col, 1);
+  if (!collections)
+    addInxIval(&query.selectInp, COL_DATA_SIZE, 1);
+  addInxVal(&query.sqlCondInp,
+            collections ? COL_COLL_PARENT_NAME : COL_COLL_NAME,
+            apr_pstrcat(pool, "= '", coll, "'", NULL));
+  addInxVal(&query.sqlCondInp, modify_col,
+            apr_pstrcat(pool, ">= '", header->latest, "'", NULL));
+
+  const char *previous = "";
+  bool previous_added = false;
+  int status;
+
+  *added = 0;
+
+  while ((status = rcGenQuery(res_private->rods_conn, &query, &out)) >= 0) {
+    sqlResult_t *names = getSqlResultByInx(out, name_col);
+    sqlResult_t *create_times = getSqlResultByInx(out, create_col);
+    sqlResult_t *modify_times = getSqlResultByInx(out, modify_col);
+    sqlResult_t *owners = getSqlResultByInx(out, owner_col);
+    sqlResult_t *sizes =
+        collections ? NULL : getSqlResultByInx(out, COL_DATA_SIZE);
+
+    if (!names || !create_times || !modify_times || !owners ||
+        (!collections && !sizes)) {
+      query.continueInx = out->continueInx;
+      status = SYS_INTERNAL_NULL_INPUT_ERR;
+      break;
+    }
+
+    for (int row = 0; row < out->rowCnt && status >= 0; ++row) {
+      const char *value = names->value + row * names->len;
+      if (collections && !strcmp(value, coll))
+        continue; // The root collection is its own parent.
+
+      const char *name =
+          apr_pstrdup(pool, collections ? davrods_get_basename(value) : value);
+
+      // Every replica of a data object has a row of its own, and counts in
+      // the member tag. Only the first one is stored.
+      if (!strcmp(name, previous)) {
+        if (previous_added)
+          ++*added;
+        continue;
+      }
+      previous = name;
+      previous_added = !apr_dbm_exists(db, datum_of(name));
+      if (previous_added)
+        ++*added;
+
+      collEnt_t entry = {0};
+      entry.objType = collections ? COLL_OBJ_T : DATA_OBJ_T;
+      entry.dataSize =
+          collections ? 0 : apr_atoi64(sizes->value + row * sizes->len);
+      entry.createTime = create_times->value + row * create_times->len;
+      entry.modifyTime = modify_times->value + row * modify_times->len;
+      entry.ownerName = owners->value + row * owners->len;
+
+      if (apr_dbm_store(db, datum_of(name),
+                        datum_of(format_member(pool, header->generation,
+                                               &entry))) != APR_SUCCESS)
+        status = SYS_INTERNAL_ERR;
+    }
+
+    query.continueInx = out->continueInx;
+    freeGenQueryOut(&out);
+    if (status < 0 || !query.continueInx)
+      break;
+  }
+
+  if (status == CAT_NO_ROWS_FOUND)
+    status = 0;
+
+  if (status < 0 && query.continueInx > 0) {
+    // Close the query on the server side.
+    query.maxRows = 0;
+    freeGenQueryOut(&out);
+    rcGenQuery(res_private->rods_conn, &query, &out);
+  }
+
+  freeGenQueryOut(&out);
+  clearGenQueryInp(&query);
+
+  return status;
+}
+
+/**
+ * \brief Bring a listing that is older than the freshness bound up to date.
+ *
+ * \return whether the listing is current again
+ */
+static bool revalidate(const dav_resource *resource, apr_dbm_t *db,
+                       const char *coll, listing_header_t *header) {
+  apr_pool_t *pool = resource->pool;
+  apr_time_t now = apr_time_now();
+
+  const char *tag = davrods_ctag_members(resource, coll);
+  const char *latest;
+  apr_int64_t data_count, coll_count;
+  if (!tag || !parse_tag(pool, tag, &latest, &data_count, &coll_count))
+    return false;
+
+  if (strcmp(latest, header->latest) || data_count != header->data_count ||
+      coll_count != header->coll_count) {
+    apr_int64_t data_added = 0;
+    apr_int64_t colls_added = 0;
+
+    if (!read_members(resource, db, coll, header, NULL))
+      return false;
+
+    int status = store_modified(resource, db, coll, header, false, &data_added);
+    if (status >= 0)
+      status = store_modified(resource, db, coll, header, true, &colls_added);
+    if (status < 0) {
+      ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, resource->info->r,
+                    "Could not read modified members of <%s>: %s", coll,
+                    get_rods_error_msg(status));
+      return false;
+    }
+
+    // Members that were removed, or moved in without a newer modification
+    // time, make the counts differ.
+    if (header->data_count + data_added != data_count ||
+        header->coll_count + colls_added != coll_count) {
+      WHISPER("Stored listing of <%s> lost members, listing anew\n", coll);
+      return false;
+    }
+    WHISPER("Stored listing of <%s> updated with modified members\n", coll);
+  } else {
+    WHISPER("Stored listing of <%s> is still current\n", coll);
+  }
+
+  header->time = now;
+  header->latest = latest;
+  header->data_count = data_count;
+  header->coll_count = coll_count;
+  return write_header(db, pool, header) == APR_SUCCESS;
+}
+
+static int compare_entries(const void *a, const void *b) {
+  const collEnt_t *entry_a = a;
+  const collEnt_t *entry_b = b;
+
+  // Collections first, then data objects, each by name, like
+  // rclReadCollection().
+  if (entry_a->objType != entry_b->objType)
+    return entry_a->objType == COLL_OBJ_T ? -1 : 1;
+  return entry_a->objType == COLL_OBJ_T
+             ? strcmp(entry_a->collName, entry_b->collName)
+             : strcmp(entry_a->dataName, entry_b->dataName);
+}
+
+bool davrods_metaindex_stat(const dav_resource *resource,
+                            rodsObjStat_t **stat) {
+  // Requests that modify a resource must see what iRODS sees.
+  int method = resource->info->r->method_number;
+  if (!metaindex_enabled(resource) || (method != M_GET && method != M_PROPFIND))
+    return false;
+
+  apr_pool_t *pool = resource->pool;
+  const char *path = resource->info->rods_path;
+  const char *slash = strrchr(path, '/');
+  if (!slash || !slash[1])
+    return false;
+
+  const char *coll =
+      slash == path ? "/" : apr_pstrmemdup(pool, path, slash - path);
+  listing_header_t header;
+  apr_dbm_t *db = open_listing(resource, coll, APR_DBM_READONLY, &header);
+  if (!db)
+    return false;
+
+  int freshness = DAVRODS_CONF(resource->info->conf, metaindex_freshness);
+  if (apr_time_now() - header.time > apr_time_from_sec(freshness)) {
+    // Checking the listing costs as much as asking iRODS.
+    apr_dbm_close(db);
+    return false;
+  }
+
+  apr_datum_t value;
+  apr_status_t status = apr_dbm_fetch(db, datum_of(slash + 1), &value);
+  collEnt_t entry;
+  char listed = '-';
+  member_state_t state = MEMBER_INVALID;
+
+  if (status == APR_SUCCESS && value.dptr) {
+    state = parse_member(pool, value, &header, &entry, &listed);
+    apr_dbm_freedatum(db, value);
+  }
+  apr_dbm_close(db);
+
+  if (status != APR_SUCCESS ||
+      (value.dptr && state != MEMBER_KNOWN))
+    return false;
+
+  *stat = NULL;
+  if (value.dptr) {
+    *stat = apr_pcalloc(pool, sizeof(rodsObjStat_t));
+    (*stat)->objType = entry.objType;
+    (*stat)->objSize = entry.objType == COLL_OBJ_T ? 0 : entry.dataSize;
+    apr_cpystrn((*stat)->createTime, entry.createTime, TIME_LEN);
+    apr_cpystrn((*stat)->modifyTime, entry.modifyTime, TIME_LEN);
+  }
+
+  WHISPER("Stat of <%s> found in stored listing\n", path);
+  return true;
+}
+
+apr_array_header_t *davrods_metaindex_list(const dav_resource *resource,
+                                           bool owners) {
+  if (!metaindex_enabled(resource))
+    return NULL;
+
+  apr_pool_t *pool = resource->pool;
+  const char *coll = apr_pstrdup(pool, resource->info->rods_path);
+
+  listing_header_t header;
+  apr_dbm_t *db = open_listing(resource, coll, APR_DBM_READWRITE, &header);
+  if (db && owners && !header.owners) {
+    apr_dbm_close(db);
+    db = NULL;
+  }
+  if (!db) {
+    davrods_stats_inc(DAVRODS_STAT_METAINDEX_MISS);
+    return NULL;
+  }
+
+  int freshness = DAVRODS_CONF(resource->info->conf, metaindex_freshness);
+  apr_array_header_t *entries = apr_array_make(pool, 16, sizeof(collEnt_t));
+
+  bool current =
+      (apr_time_now() - header.time <= apr_time_from_sec(freshness) ||
+       revalidate(resource, db, coll, &header)) &&
+      read_members(resource, db, coll, &header, entries);
+  apr_dbm_close(db);
+
+  if (!current) {
+    davrods_stats_inc(DAVRODS_STAT_METAINDEX_MISS);
+    return NULL;
+  }
+
+  qsort(entries->elts, entries->nelts, sizeof(collEnt_t), compare_entries);
+
+  davrods_stats_inc(DAVRODS_STAT_METAINDEX_HIT);
+  return entries;
+}
+
+davrods_metaindex_writer_t *
+davrods_metaindex_write_begin(const dav_resource *resource, bool owners) {
+  if (!metaindex_enabled(resource))
+    return NULL;
+
+  apr_pool_t *pool = resource->pool;
+  const char *coll = resource->info->rods_path;
+  apr_time_t start = apr_time_now();
+
+  // Taken before listing, so that a change during the listing makes the
+  // tag differ on the next check.
+  const char *tag = davrods_ctag_members(resource, coll);
+  listing_header_t header = {.owners = owners,
+                             .generation = start,
+                             .time = start};
+  if (!tag || !parse_tag(pool, tag, &header.latest, &header.data_count,
+                         &header.coll_count))
+    return NULL;
+
+  const char *path = index_file(resource, coll, strlen(coll), true, "");
+  apr_dbm_t *db = NULL;
+  apr_status_t status =
+      apr_dbm_open(&db, path, APR_DBM_RWCREATE, APR_OS_DEFAULT, pool);
+  if (status == APR_SUCCESS)
+    status = write_header(db, pool, &header);
+
+  if (status != APR_SUCCESS) {
+    ap_log_rerror(APLOG_MARK, APLOG_WARNING, status, resource->info->r,
+                  "Could not store a metadata index listing <%s>", path);
+    if (db)
+      apr_dbm_close(db);
+    return NULL;
+  }
+
+  davrods_metaindex_writer_t *writer =
+      apr_pcalloc(pool, sizeof(davrods_metaindex_writer_t));
+  writer->resource = resource;
+  writer->db = db;
+  writer->header = header;
+  return writer;
+}
+
+void davrods_metaindex_write_entry(davrods_metaindex_writer_t *writer,
+                                   const collEnt_t *entry) {
+  if (!writer || writer->failed)
+    return;
+
+  const char *name = entry->objType == DATA_OBJ_T
+                         ? entry->dataName
+                         : davrods_get_basename(entry->collName);
+
+  // A member too large for the DBM fails to store.
+  if (!name || !*name || strchr(name, '/') ||
+      (entry->objType != DATA_OBJ_T && entry->objType != COLL_OBJ_T) ||
+      apr_dbm_store(writer->db, datum_of(name),
+                    datum_of(format_member(writer->resource->pool,
+                                           writer->header.generation,
+                                           entry))) != APR_SUCCESS)
+    writer->failed = true;
+}
+
+/**
+ * \brief Remove the members of other generations from a listing.
+ */
+static void remove_old_members(apr_dbm_t *db, apr_pool_t *pool,
+                               const listing_header_t *header) {
+  apr_array_header_t *names = member_names(db, pool);
+
+  for (int i = 0; i < names->nelts; ++i) {
+    apr_datum_t key = datum_of(APR_ARRAY_IDX(names, i, const char *));
+    apr_datum_t value;
+    if (apr_dbm_fetch(db, key, &value) != APR_SUCCESS || !value.dptr)
+      continue;
+
+    bool old = apr_strtoi64(apr_pstrmemdup(pool, value.dptr, value.dsize),
+                            NULL, 10) != header->generation;
+    apr_dbm_freedatum(db, value);
+    if (old)
+      apr_dbm_delete(db, key);
+  }
+}
+
+void davrods_metaindex_write_end(davrods_metaindex_writer_t *writer,
+                                 bool commit) {
+  if (!writer)
+    return;
+
+  apr_pool_t *pool = writer->resource->pool;
+  listing_header_t current;
+
+  // Of concurrent listings of a collection, the one started last is kept.
+  if (commit && !writer->failed && read_header(writer->db, pool, &current) &&
+      !current.complete &&
+      current.generation == writer->header.generation) {
+    writer->header.complete = true;
+    if (write_header(writer->db, pool, &writer->header) == APR_SUCCESS)
+      remove_old_members(writer->db, pool, &writer->header);
+  }
+
+  apr_dbm_close(writer->db);
+}
+
+void davrods_metaindex_invalidate(const dav_resource *resource,
+                                  const char *path) {
+  if (!metaindex_enabled(resource))
+    return;
+
+  apr_pool_t *pool = resource->pool;
+  apr_size_t len = strlen(path);
+  touch_marker(resource, path, len, ".tree");
+
+  const char *slash = strrchr(path, '/');
+  if (!slash)
+    return;
+
+  apr_size_t coll_len = slash == path ? 1 : slash - path;
+  const char *coll = apr_pstrmemdup(pool, path, coll_len);
+  const char *name = slash + 1;
+
+  // Checked before the marker is touched, see above.
+  listing_header_t header;
+  apr_dbm_t *db =
+      *name ? open_listing(resource, coll, APR_DBM_READWRITE, &header) : NULL;
+
+  apr_time_t touched = touch_marker(resource, path, coll_len, ".node");
+  if (!db)
+    return;
+
+  // Remember whether the member was counted in the header.
+  char listed = '-';
+  apr_datum_t value;
+  if (apr_dbm_fetch(db, datum_of(name), &value) == APR_SUCCESS &&
+      value.dptr) {
+    collEnt_t entry;
+    member_state_t state = parse_member(pool, value, &header, &entry, &listed);
+    apr_dbm_freedatum(db, value);
+
+    if (state == MEMBER_KNOWN)
+      listed = entry.objType == COLL_OBJ_T ? 'C' : 'D';
+    else if (state == MEMBER_INVALID)
+      touched = 0;
+  }
+
+  const char *unknown = apr_psprintf(pool, "%" APR_TIME_T_FMT " ?%c",
+                                     header.generation, listed);
+  if (touched) {
+    header.node_touch = touched;
+    if (apr_dbm_store(db, datum_of(name), datum_of(unknown)) != APR_SUCCESS ||
+        write_header(db, pool, &header) != APR_SUCCESS)
+      touched = 0;
+  }
+
+  // A listing that could not be kept must not outlive the touched marker.
+  if (!touched)
+    apr_dbm_delete(db, datum_of(METAINDEX_HEADER_KEY));
+
+  apr_dbm_close(db);
+}
+
+static bool is_marker(const char *name) {
+  size_t len = strlen(name);
+  return len > 5 && (!strcmp(name + len - 5, ".tree") ||
+                     !strcmp(name + len - 5, ".node"));
+}
+
+/**
+ * \brief Remove a listing if all of its DBM files are older than limit.
+ *
+ * \return the number of files removed
+ */
+static int expire_listing(apr_pool_t *p, const char *base, apr_time_t limit) {
+  const char *files[2] = {NULL, NULL};
+  apr_dbm_get_usednames(p, base, &files[0], &files[1]);
+
+  apr_finfo_t finfo;
+  for (int i = 0; i < 2; ++i) {
+    if (files[i] &&
+        apr_stat(&finfo, files[i], APR_FINFO_MTIME, p) == APR_SUCCESS &&
+        finfo.mtime >= limit)
+      return 0;
+  }
+
+  int removed = 0;
+  for (int i = 0; i < 2; ++i) {
+    if (files[i] && apr_file_remove(files[i], p) == APR_SUCCESS)
+      ++removed;
+  }
+  return removed;
+}
+
+/**
+ * \brief Remove old listings, markers and leftover files from an index
+ *        directory.
+ */
+static void expire_files(apr_pool_t *p, const metaindex_dir_t *index,
+                         apr_time_t now) {
+  apr_time_t expiry =
+      METAINDEX_EXPIRY_FACTOR * apr_time_from_sec(index->freshness);
+
+  apr_dir_t *dir;
+  apr_status_t status = apr_dir_open(&dir, index->dir, p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_WARNING, status, index->server,
+                 "Could not open metadata index directory <%s>", index->dir);
+    return;
+  }
+
+  // Markers are removed only after all old listings are gone.
+  apr_array_header_t *markers = apr_array_make(p, 16, sizeof(const char *));
+  apr_hash_t *listings = apr_hash_make(p);
+  int removed = 0;
+
+  apr_finfo_t finfo;
+  while (apr_dir_read(&finfo, APR_FINFO_NAME | APR_FINFO_TYPE | APR_FINFO_MTIME,
+                      dir) == APR_SUCCESS) {
+    if (finfo.filetype != APR_REG)
+      continue;
+
+    const char *path = apr_pstrcat(p, index->dir, "/", finfo.name, NULL);
+    if (is_marker(finfo.name)) {
+      if (finfo.mtime < now - 2 * expiry)
+        APR_ARRAY_PUSH(markers, const char *) = path;
+      continue;
+    }
+
+    // A listing may consist of several DBM files, which are removed
+    // together. Anything else, e.g. a listing of an older Davrods version,
+    // is removed by itself.
+    const char *base =
+        strlen(finfo.name) > 2 * APR_SHA1_DIGESTSIZE
+            ? apr_pstrcat(p, index->dir, "/",
+                          apr_pstrmemdup(p, finfo.name,
+                                         2 * APR_SHA1_DIGESTSIZE),
+                          NULL)
+            : path;
+    const char *files[2] = {NULL, NULL};
+    apr_dbm_get_usednames(p, base, &files[0], &files[1]);
+
+    if ((files[0] && !strcmp(files[0], path)) ||
+        (files[1] && !strcmp(files[1], path))) {
+      if (!apr_hash_get(listings, base, APR_HASH_KEY_STRING)) {
+        apr_hash_set(listings, base, APR_HASH_KEY_STRING, base);
+        removed += expire_listing(p, base, now - expiry);
+      }
+    } else if (finfo.mtime < now - expiry &&
+               apr_file_remove(path, p) == APR_SUCCESS) {
+      ++removed;
+    }
+  }
+  apr_dir_close(dir);
+
+  for (int i = 0; i < markers->nelts; ++i) {
+    if (apr_file_remove(APR_ARRAY_IDX(markers, i, const char *), p) ==
+        APR_SUCCESS)
+      ++removed;
+  }
+
+  ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, index->server,
+               "Removed %d expired file(s) from metadata index directory "
+               "<%s>",
+               removed, index->dir);
+}
+
+void davrods_metaindex_maintain(apr_pool_t *p) {
+  if (!index_dirs)
+    return;
+
+  apr_time_t now = apr_time_now();
+  metaindex_dir_t *dirs = (metaindex_dir_t *)index_dirs->elts;
+
+  for (int i = 0; i < index_dirs->nelts; ++i) {
+    if (now < dirs[i].next_scan)
+      continue;
+    dirs[i].next_scan =
+        now + METAINDEX_EXPIRY_FACTOR * apr_time_from_sec(dirs[i].freshness);
+    expire_files(p, &dirs[i], now);
+  }
+}
+
+int davrods_metaindex_maintain_interval(void) {
+  int interval = 0;
+  const metaindex_dir_t *dirs =
+      index_dirs ? (const metaindex_dir_t *)index_dirs->elts : NULL;
+
+  for (int i = 0; index_dirs && i < index_dirs->nelts; ++i) {
+    int dir_interval = METAINDEX_EXPIRY_FACTOR * dirs[i].freshness;
+    if (!interval || dir_interval < interval)
+      interval = dir_interval;
+  }
+  return interval;
+}
+
+static void add_location_dir(void *data, server_rec *s, const char *path,
+                             const davrods_dir_conf_t *conf) {
+  int freshness = DAVRODS_CONF(conf, metaindex_freshness);
+  const char *dir = DAVRODS_CONF(conf, metaindex_dir);
+  if (freshness <= 0 || !dir)
+    return;
+
+  // Locations may share a directory. Keep listings for the longest of
+  // their bounds.
+  metaindex_dir_t *dirs = (metaindex_dir_t *)index_dirs->elts;
+  for (int i = 0; i < index_dirs->nelts; ++i) {
+    if (!strcmp(dirs[i].dir, dir)) {
+      if (freshness > dirs[i].freshness)
+        dirs[i].freshness = freshness;
+      return;
+    }
+  }
+
+  metaindex_dir_t *index = apr_array_push(index_dirs);
+  assert(index);
+  index->server = s;
+  index->dir = dir;
+  index->freshness = freshness;
+  index->next_scan = 0;
+}
+
+static int metaindex_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+                                 apr_pool_t *ptemp, server_rec *s) {
+  // The directory names live in pconf, the merged configs need not.
+  index_dirs = apr_array_make(pconf, 1, sizeof(metaindex_dir_t));
+  davrods_config_walk_locations(ptemp, s, add_location_dir, NULL);
+  return OK;
+}
+
+void davrods_metaindex_register(apr_pool_t *p) {
+  ap_hook_post_config(metaindex_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+}
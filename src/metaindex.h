@@ -0,0 +1,124 @@
+/**
+ * \file
+ * \brief     Local index of collection listings.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_METAINDEX_H
+#define _DAVRODS_METAINDEX_H
+
+#include "repo.h"
+
+/**
+ * \brief Look up the stat result of a path in the stored listing of its
+ *        parent collection (DavrodsMetadataIndex).
+ *
+ * Only GET, HEAD and PROPFIND requests are answered this way. Listings that
+ * are older than the freshness bound are not used here, since checking them
+ * costs as much as asking iRODS for the stat result.
+ *
+ * \param[in]  resource the resource whose rods_path to look up
+ * \param[out] stat     a result allocated from the resource's pool, or NULL
+ *                      if the path does not exist
+ *
+ * \return whether a current listing of the parent collection was found
+ */
+bool davrods_metaindex_stat(const dav_resource *resource,
+                            rodsObjStat_t **stat);
+
+/**
+ * \brief Get the stored listing of a collection.
+ *
+ * A listing older than the freshness bound is checked against the catalog
+ * with two aggregate catalog queries. If its members changed, the modified
+ * ones are read from the catalog, and the listing is used if none were
+ * removed. Members that the user modified are looked up again.
+ *
+ * \param resource a collection resource
+ * \param owners   whether owner names are needed
+ *
+ * \return an array of collEnt_t, as returned by rclReadCollection(), or NULL
+ *         if no current listing is stored
+ */
+apr_array_header_t *davrods_metaindex_list(const dav_resource *resource,
+                                           bool owners);
+
+typedef struct davrods_metaindex_writer davrods_metaindex_writer_t;
+
+/**
+ * \brief Start storing the listing of a collection that is about to be read
+ *        from iRODS.
+ *
+ * \param resource a collection resource
+ * \param owners   whether the entries will include owner names
+ *
+ * \return a writer, or NULL if the index is disabled or unavailable
+ */
+davrods_metaindex_writer_t *
+davrods_metaindex_write_begin(const dav_resource *resource, bool owners);
+
+/**
+ * \brief Add an entry read with rclReadCollection() to a listing.
+ *
+ * Does nothing if writer is NULL.
+ */
+void davrods_metaindex_write_entry(davrods_metaindex_writer_t *writer,
+                                   const collEnt_t *entry);
+
+/**
+ * \brief Finish storing a listing.
+ *
+ * \param writer the writer, may be NULL
+ * \param commit whether the complete listing was read, and should replace the
+ *               stored listing
+ */
+void davrods_metaindex_write_end(davrods_metaindex_writer_t *writer,
+                                 bool commit);
+
+/**
+ * \brief Mark the stored listings of path, everything below it, and its
+ *        parent collection as outdated, for all users.
+ *
+ * The session user's current listing of the parent collection is kept, with
+ * the member at path marked for a new lookup. Call this both before and after
+ * modifying path.
+ */
+void davrods_metaindex_invalidate(const dav_resource *resource,
+                                  const char *path);
+
+/**
+ * \brief Remove expired files from the index directories.
+ *
+ * Called periodically by the maintenance thread of every child process.
+ * Each directory is scanned at most once per
+ * davrods_metaindex_maintain_interval().
+ *
+ * \param p pool for temporary allocations
+ */
+void davrods_metaindex_maintain(apr_pool_t *p);
+
+/**
+ * \brief Get how often the index directories need to be cleaned up.
+ *
+ * \return an interval in seconds, or 0 if no location uses an index
+ */
+int davrods_metaindex_maintain_interval(void);
+
+void davrods_metaindex_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_METAINDEX_H */
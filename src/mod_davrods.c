@@ -20,23 +20,53 @@
  * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "mod_davrods.h"
+#include "admission.h"
 #include "auth.h"
+#include "authcache.h"
+#include "checksum.h"
 #include "common.h"
 #include "config.h"
+#include "connpool.h"
+#include "env.h"
+#include "junk.h"
+#include "metaindex.h"
+#include "multiplex.h"
+#include "prewarm.h"
+#include "servers.h"
+#include "session.h"
+#include "singleflight.h"
+#include "statcache.h"
+#include "stats.h"
+#include "tls.h"
 
 APLOG_USE_MODULE(davrods);
 
 static void register_hooks(apr_pool_t *p) {
   davrods_auth_register(p);
+  davrods_servers_register(p); // Must precede connpool, see servers.c.
+  davrods_connpool_register(p);
+  davrods_env_register(p);
+  davrods_session_register(p);
+  davrods_multiplex_register(p);
+  davrods_tls_register(p);
+  davrods_authcache_register(p);
+  davrods_statcache_register(p);
+  davrods_checksum_register(p);
+  davrods_metaindex_register(p);
+  davrods_junk_register(p);
+  davrods_singleflight_register(p);
+  davrods_stats_register(p);
+  davrods_admission_register(p);
+  davrods_prewarm_register(p); // Must follow connpool, env and authcache.
   davrods_dav_register(p);
 }
 
 module AP_MODULE_DECLARE_DATA davrods_module = {
     STANDARD20_MODULE_STUFF,
-    davrods_create_dir_config, // Directory config setup.
-    davrods_merge_dir_config,  //    ..       ..   merge function.
-    NULL,                      // Server config setup.
-    NULL,                      //   ..     ..   merge function.
-    davrods_directives,        // Command table.
-    register_hooks,            // Hook setup.
+    davrods_create_dir_config,    // Directory config setup.
+    davrods_merge_dir_config,     //    ..       ..   merge function.
+    davrods_create_server_config, // Server config setup.
+    davrods_merge_server_config,  //   ..     ..   merge function.
+    davrods_directives,           // Command table.
+    register_hooks,               // Hook setup.
 };
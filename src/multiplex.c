@@ -0,0 +1,284 @@
+/**
+ * \file
+ * \brief     Sharing of iRODS connections between HTTP/2 streams.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "multiplex.h"
+#include "admission.h"
+#include "common.h"
+#include "config.h"
+#include "servers.h"
+#include "stats.h"
+
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* Davrods keeps its session state on the client's connection (see
+ * check_rods() in auth.c). Under mod_http2, that is the secondary connection
+ * of a single stream, so a client that opens many streams at once would
+ * cause just as many iRODS logins.
+ *
+ * Instead, streams of the same client connection share a small set of iRODS
+ * connections. A stream's session holds a connection only while a request is
+ * being handled, after which the connection is returned to the set of the
+ * client (master) connection. The set is capped (DavrodsHttp2Connections):
+ * when it is full, a new stream waits for a while for another stream to
+ * return a connection, and only then logs in anyway.
+ *
+ * Secondary connections are allocated from subpools of the master
+ * connection's pool, so all sessions of the streams are gone when the set is
+ * cleaned up. Idle connections of the set then move to the connection pool.
+ *
+ * Connections with an active session ticket are not shared. Their sessions
+ * hold on to them as on HTTP/1 connections.
+ */
+
+/// How long a stream waits for a connection when the set is full.
+#define MULTIPLEX_MAX_WAIT apr_time_from_sec(5)
+
+typedef struct {
+  rcComm_t *rods_conn;
+  davrods_connpool_key_t key;
+  char username[NAME_LEN];
+  apr_time_t last_used;
+} multiplex_idle_t;
+
+struct davrods_multiplex_t {
+#if APR_HAS_THREADS
+  apr_thread_mutex_t *lock;
+  apr_thread_cond_t *cond;
+#endif
+  int used; // Connections idle or held by streams, and reserved slots.
+  int idle_count;
+  multiplex_idle_t *idle; // Room for sharing.size connections.
+  bool closed;
+};
+
+static struct {
+  bool enabled;
+  int size;
+  apr_interval_time_t probe_after;
+} sharing;
+
+static void multiplex_lock(davrods_multiplex_t *mp) {
+#if APR_HAS_THREADS
+  apr_thread_mutex_lock(mp->lock);
+#endif
+}
+
+static void multiplex_unlock(davrods_multiplex_t *mp) {
+#if APR_HAS_THREADS
+  apr_thread_mutex_unlock(mp->lock);
+#endif
+}
+
+davrods_multiplex_t *davrods_multiplex_get(conn_rec *c) {
+  if (!sharing.enabled || !c->master)
+    return NULL;
+  return ap_get_module_config(c->master->conn_config, &davrods_module);
+}
+
+/**
+ * \brief Hand a connection that leaves the set to the connection pool.
+ */
+static void multiplex_put_away(multiplex_idle_t *entry) {
+  davrods_connpool_checkin(&entry->key, entry->username, entry->rods_conn);
+  davrods_admission_release(entry->username);
+}
+
+rcComm_t *davrods_multiplex_checkout(request_rec *r,
+                                     davrods_multiplex_t *mp,
+                                     const davrods_connpool_key_t *key) {
+  apr_time_t deadline = apr_time_now() + MULTIPLEX_MAX_WAIT;
+  multiplex_idle_t taken = {0};
+  multiplex_idle_t evicted = {0};
+  bool waited = false;
+
+  multiplex_lock(mp);
+  while (!mp->closed) {
+    for (int i = 0; i < mp->idle_count; ++i) {
+      if (!memcmp(mp->idle[i].key.digest, key->digest, sizeof(key->digest))) {
+        taken = mp->idle[i];
+        mp->idle[i] = mp->idle[--mp->idle_count];
+        break;
+      }
+    }
+    if (taken.rods_conn || mp->used < sharing.size)
+      break;
+
+    if (mp->idle_count) {
+      // All idle connections belong to other credentials, make room.
+      evicted = mp->idle[--mp->idle_count];
+      mp->used--;
+      break;
+    }
+
+    apr_interval_time_t left = deadline - apr_time_now();
+    if (left <= 0)
+      break;
+#if APR_HAS_THREADS
+    waited = true;
+    apr_thread_cond_timedwait(mp->cond, mp->lock, left);
+#endif
+  }
+  if (!taken.rods_conn)
+    mp->used++; // Reserve a slot for a new connection.
+  multiplex_unlock(mp);
+
+  if (evicted.rods_conn)
+    multiplex_put_away(&evicted);
+
+  if (waited)
+    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                  "Waited for an iRODS connection shared with other HTTP/2 "
+                  "streams");
+
+  if (!taken.rods_conn)
+    return NULL;
+
+  // Streams may be far apart, make sure the connection is still alive.
+  if (apr_time_now() - taken.last_used > sharing.probe_after) {
+    int status = davrods_servers_ping(taken.rods_conn);
+    if (status < 0) {
+      ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                    "Discarding broken shared iRODS connection: %d = %s",
+                    status, get_rods_error_msg(status));
+      davrods_stats_inc(DAVRODS_STAT_STALE_CONNECTION);
+      davrods_servers_disconnect(taken.rods_conn);
+      // Its slot is now reserved for a new connection.
+      davrods_admission_release(taken.username);
+      return NULL;
+    }
+  }
+
+  ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                "Reusing iRODS connection of another HTTP/2 stream");
+  davrods_stats_inc(DAVRODS_STAT_STREAM_CONNECTION_SHARED);
+  return taken.rods_conn;
+}
+
+void davrods_multiplex_checkin(davrods_multiplex_t *mp,
+                               const davrods_connpool_key_t *key,
+                               const char *username, rcComm_t *rods_conn) {
+  multiplex_idle_t entry = {
+      .rods_conn = rods_conn,
+      .key = *key,
+      .last_used = apr_time_now(),
+  };
+  apr_cpystrn(entry.username, username, sizeof(entry.username));
+
+  multiplex_lock(mp);
+  bool keep = !mp->closed && mp->idle_count < sharing.size;
+  if (keep)
+    mp->idle[mp->idle_count++] = entry;
+  else if (mp->used)
+    mp->used--;
+#if APR_HAS_THREADS
+  apr_thread_cond_signal(mp->cond);
+#endif
+  multiplex_unlock(mp);
+
+  if (!keep)
+    multiplex_put_away(&entry);
+}
+
+void davrods_multiplex_cancel(davrods_multiplex_t *mp) {
+  multiplex_lock(mp);
+  if (mp->used)
+    mp->used--;
+#if APR_HAS_THREADS
+  apr_thread_cond_signal(mp->cond);
+#endif
+  multiplex_unlock(mp);
+}
+
+static apr_status_t multiplex_cleanup(void *data) {
+  davrods_multiplex_t *mp = data;
+
+  multiplex_lock(mp);
+  mp->closed = true;
+  int idle_count = mp->idle_count;
+  mp->idle_count = 0;
+  mp->used = 0;
+  multiplex_unlock(mp);
+
+  for (int i = 0; i < idle_count; ++i)
+    multiplex_put_away(&mp->idle[i]);
+
+  return APR_SUCCESS;
+}
+
+static int multiplex_pre_connection(conn_rec *c, void *csd) {
+  // Only client connections get a set, their streams share it.
+  if (!sharing.enabled || c->master)
+    return OK;
+
+  davrods_multiplex_t *mp = apr_pcalloc(c->pool, sizeof(*mp));
+  assert(mp);
+  mp->idle = apr_pcalloc(c->pool, sharing.size * sizeof(multiplex_idle_t));
+  assert(mp->idle);
+
+#if APR_HAS_THREADS
+  apr_status_t status =
+      apr_thread_mutex_create(&mp->lock, APR_THREAD_MUTEX_DEFAULT, c->pool);
+  if (status == APR_SUCCESS)
+    status = apr_thread_cond_create(&mp->cond, c->pool);
+  if (status != APR_SUCCESS) {
+    ap_log_cerror(APLOG_MARK, APLOG_ERR, status, c,
+                  "Could not create lock for sharing iRODS connections "
+                  "between HTTP/2 streams");
+    return OK;
+  }
+#endif
+
+  apr_pool_cleanup_register(c->pool, mp, multiplex_cleanup,
+                            apr_pool_cleanup_null);
+  ap_set_module_config(c->conn_config, &davrods_module, mp);
+  return OK;
+}
+
+static int multiplex_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+                                 apr_pool_t *ptemp, server_rec *s) {
+  davrods_server_conf_t *conf =
+      ap_get_module_config(s->module_config, &davrods_module);
+  assert(conf);
+
+  int size = DAVRODS_SERVER_CONF(conf, h2_connections);
+  sharing.size = size > 0 ? size : 0;
+  sharing.probe_after =
+      apr_time_from_sec(DAVRODS_SERVER_CONF(conf, conn_probe_after));
+
+  // Streams only exist with mod_http2, don't bother other connections.
+#if APR_HAS_THREADS
+  sharing.enabled =
+      sharing.size > 0 && ap_find_linked_module("mod_http2.c");
+#else
+  sharing.enabled = false;
+#endif
+
+  return OK;
+}
+
+void davrods_multiplex_register(apr_pool_t *p) {
+  ap_hook_post_config(multiplex_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_pre_connection(multiplex_pre_connection, NULL, NULL,
+                         APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,84 @@
+/**
+ * \file
+ * \brief     Sharing of iRODS connections between HTTP/2 streams.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_MULTIPLEX_H
+#define _DAVRODS_MULTIPLEX_H
+
+#include "connpool.h"
+#include "mod_davrods.h"
+
+#include <irods/rodsClient.h>
+
+/**
+ * \brief iRODS connections shared by the streams of one HTTP/2 connection.
+ *
+ * Under mod_http2, every stream is handled on its own secondary connection.
+ * Each stream therefore has its own Davrods session. Streams of the same
+ * client connection return their iRODS connection to a small shared set
+ * when a request is done, from where the next stream picks it up, instead
+ * of logging in to iRODS again.
+ *
+ * Every connection in the set, idle or in use by a stream, holds a slot of
+ * the set and an admission permit (see admission.h).
+ */
+typedef struct davrods_multiplex_t davrods_multiplex_t;
+
+/**
+ * \brief Get the connection set shared by the streams of c's client
+ *        connection.
+ *
+ * \return a connection set, or NULL if c is not an HTTP/2 stream.
+ */
+davrods_multiplex_t *davrods_multiplex_get(conn_rec *c);
+
+/**
+ * \brief Take an idle connection matching key out of the set.
+ *
+ * If the set is full, waits a while for a stream to return one.
+ *
+ * \return an iRODS connection, which comes with a slot of the set and an
+ *         admission permit, or NULL. In the latter case, a slot was
+ *         reserved for a new connection, which must be given up with
+ *         davrods_multiplex_cancel() if no connection is set up after all.
+ */
+rcComm_t *davrods_multiplex_checkout(request_rec *r,
+                                     davrods_multiplex_t *multiplex,
+                                     const davrods_connpool_key_t *key);
+
+/**
+ * \brief Return a connection to the set, along with its slot and admission
+ *        permit.
+ *
+ * The connection must not have an active session ticket.
+ */
+void davrods_multiplex_checkin(davrods_multiplex_t *multiplex,
+                               const davrods_connpool_key_t *key,
+                               const char *username, rcComm_t *rods_conn);
+
+/**
+ * \brief Give up a slot of the set, because its connection was closed or
+ *        handed elsewhere.
+ */
+void davrods_multiplex_cancel(davrods_multiplex_t *multiplex);
+
+void davrods_multiplex_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_MULTIPLEX_H */
@@ -0,0 +1,282 @@
+/**
+ * \file
+ * \brief     Collection listings from paged catalog queries.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "pagedlist.h"
+
+#include <apr_strings.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* rclOpenCollection() and rclReadCollection() hand out one entry per call,
+ * and with LONG_METADATA_FG, as used for HTML listings, one per replica,
+ * with columns that Davrods does not show. For large collections, reading
+ * the members with two plain GenQueries, one for subcollections and one for
+ * data objects, takes fewer and smaller catalog responses. Members are still
+ * handed out one at a time, so that only the current page of a query is held
+ * in memory, however large the collection.
+ *
+ * Special collections (mounted directories, linked collections) are not
+ * described by the catalog, and are still listed with rclOpenCollection().
+ */
+
+bool davrods_pagedlist_enabled(const dav_resource *resource) {
+  const dav_resource_private *res_private = resource->info;
+  int method = res_private->r->method_number;
+
+  if (DAVRODS_CONF(res_private->conf, paged_listing_rows) <= 0 ||
+      (method != M_PROPFIND && method != M_GET))
+    return false;
+
+  // Conditions are passed to iRODS as quoted SQL strings.
+  if (strchr(res_private->rods_path, '\''))
+    return false;
+
+  const rodsObjStat_t *stat;
+  return !davrods_get_stat(resource, &stat) && stat && !stat->specColl;
+}
+
+struct davrods_pagedlist {
+  const dav_resource *resource;
+  rcComm_t *rods_conn;
+  const char *coll;
+
+  // Subcollections are listed first, then data objects.
+  bool collections;
+  genQueryInp_t query;
+
+  // The current page, and its columns.
+  genQueryOut_t *out;
+  int row;
+  sqlResult_t *names;
+  sqlResult_t *create_times;
+  sqlResult_t *modify_times;
+  sqlResult_t *owners;
+  sqlResult_t *sizes;
+
+  // The last data object returned, whose other replicas are skipped.
+  char previous[MAX_NAME_LEN];
+
+  int count;
+  int status; // CAT_NO_ROWS_FOUND at the end, or another error.
+};
+
+/**
+ * \brief Start a query for either the subcollections or the data objects of
+ *        the collection.
+ */
+static void start_query(davrods_pagedlist_t *list, bool collections) {
+  dav_resource_private *res_private = list->resource->info;
+
+  int name_col = collections ? COL_COLL_NAME : COL_DATA_NAME;
+
+  memset(&list->query, 0, sizeof(list->query));
+  list->collections = collections;
+  list->previous[0] = '\0';
+
+  list->query.maxRows = DAVRODS_CONF(res_private->conf, paged_listing_rows);
+  // Ordered by name, so that replicas of a data object are adjacent.
+  addInxIval(&list->query.selectInp, name_col, ORDER_BY);
+  addInxIval(&list->query.selectInp,
+             collections ? COL_COLL_CREATE_TIME : COL_D_CREATE_TIME, 1);
+  addInxIval(&list->query.selectInp,
+             collections ? COL_COLL_MODIFY_TIME : COL_D_MODIFY_TIME, 1);
+  addInxIval(&list->query.selectInp,
+             collections ? COL_COLL_OWNER_NAME : COL_D_OWNER_NAME, 1);
+  if (!collections)
+    addInxIval(&list->query.selectInp, COL_DATA_SIZE, 1);
+  addInxVal(&list->query.sqlCondInp,
+            collections ? COL_COLL_PARENT_NAME : COL_COLL_NAME,
+            apr_pstrcat(list->resource->pool, "= '", list->coll, "'", NULL));
+}
+
+/**
+ * \brief Free the current page, and close the query on the server side if
+ *        it has rows left.
+ */
+static void finish_query(davrods_pagedlist_t *list) {
+  if (list->out) {
+    list->query.continueInx = list->out->continueInx;
+    freeGenQueryOut(&list->out);
+  }
+
+  if (list->query.continueInx > 0) {
+    list->query.maxRows = 0;
+    rcGenQuery(list->rods_conn, &list->query, &list->out);
+    freeGenQueryOut(&list->out);
+    list->query.continueInx = 0;
+  }
+
+  clearGenQueryInp(&list->query);
+}
+
+/**
+ * \brief Replace the current page with the next one of the query.
+ *
+ * \return an iRODS status code, CAT_NO_ROWS_FOUND after the last page
+ */
+static int fetch_page(davrods_pagedlist_t *list) {
+  bool collections = list->collections;
+
+  if (list->out) {
+    list->query.continueInx = list->out->continueInx;
+    freeGenQueryOut(&list->out);
+    if (!list->query.continueInx)
+      return CAT_NO_ROWS_FOUND;
+  }
+
+  list->row = 0;
+  int status = rcGenQuery(list->rods_conn, &list->query, &list->out);
+  if (status < 0)
+    return status;
+
+  list->names = getSqlResultByInx(list->out,
+                                  collections ? COL_COLL_NAME : COL_DATA_NAME);
+  list->create_times = getSqlResultByInx(
+      list->out, collections ? COL_COLL_CREATE_TIME : COL_D_CREATE_TIME);
+  list->modify_times = getSqlResultByInx(
+      list->out, collections ? COL_COLL_MODIFY_TIME : COL_D_MODIFY_TIME);
+  list->owners = getSqlResultByInx(
+      list->out, collections ? COL_COLL_OWNER_NAME : COL_D_OWNER_NAME);
+  list->sizes =
+      collections ? NULL : getSqlResultByInx(list->out, COL_DATA_SIZE);
+
+  if (!list->names || !list->create_times || !list->modify_times ||
+      !list->owners || (!collections && !list->sizes))
+    return SYS_INTERNAL_NULL_INPUT_ERR;
+
+  return status;
+}
+
+davrods_pagedlist_t *davrods_pagedlist_open(const dav_resource *resource) {
+  davrods_pagedlist_t *list =
+      apr_pcalloc(resource->pool, sizeof(davrods_pagedlist_t));
+  assert(list);
+
+  list->resource = resource;
+  list->rods_conn = resource->info->rods_conn;
+  // rods_path may be a buffer that the walker reuses for members.
+  list->coll = apr_pstrdup(resource->pool, resource->info->rods_path);
+  start_query(list, true);
+
+  return list;
+}
+
+int davrods_pagedlist_next(davrods_pagedlist_t *list, collEnt_t *entry) {
+  while (list->status >= 0) {
+    if (!list->out || list->row >= list->out->rowCnt) {
+      int status = fetch_page(list);
+
+      // Nothing was returned yet, so the listing can start over.
+      if (status < 0 && status != CAT_NO_ROWS_FOUND && !list->count &&
+          davrods_retry_on_broken_connection(list->resource, status)) {
+        finish_query(list);
+        list->rods_conn = list->resource->info->rods_conn;
+        start_query(list, list->collections);
+        status = fetch_page(list);
+      }
+
+      if (status == CAT_NO_ROWS_FOUND && list->collections) {
+        finish_query(list);
+        start_query(list, false);
+        continue;
+      }
+
+      if (status < 0) {
+        if (status != CAT_NO_ROWS_FOUND) {
+          ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS,
+                        list->resource->info->r,
+                        "Could not list collection <%s>: %s", list->coll,
+                        get_rods_error_msg(status));
+        } else {
+          WHISPER("Listed %d members of <%s> with paged queries\n",
+                  list->count, list->coll);
+        }
+
+        finish_query(list);
+        list->status = status;
+      }
+      continue;
+    }
+
+    int row = list->row++;
+    char *name = list->names->value + row * list->names->len;
+
+    // The root collection is its own parent, and every replica of a data
+    // object has a row of its own.
+    if (!strcmp(name, list->collections ? list->coll : list->previous))
+      continue;
+
+    memset(entry, 0, sizeof(*entry));
+    entry->objType = list->collections ? COLL_OBJ_T : DATA_OBJ_T;
+    if (list->collections) {
+      entry->collName = name;
+    } else {
+      entry->collName = (char *)list->coll;
+      entry->dataName = name;
+      entry->dataSize =
+          apr_atoi64(list->sizes->value + row * list->sizes->len);
+      apr_cpystrn(list->previous, name, sizeof(list->previous));
+    }
+    entry->createTime =
+        list->create_times->value + row * list->create_times->len;
+    entry->modifyTime =
+        list->modify_times->value + row * list->modify_times->len;
+    entry->ownerName = list->owners->value + row * list->owners->len;
+
+    ++list->count;
+    return 0;
+  }
+
+  return list->status;
+}
+
+void davrods_pagedlist_close(davrods_pagedlist_t *list) {
+  if (list && list->status >= 0) {
+    finish_query(list);
+    list->status = CAT_NO_ROWS_FOUND;
+  }
+}
+
+int davrods_pagedlist_read(const dav_resource *resource,
+                           apr_array_header_t **entries) {
+  apr_array_header_t *result =
+      apr_array_make(resource->pool, 64, sizeof(collEnt_t));
+  davrods_pagedlist_t *list = davrods_pagedlist_open(resource);
+  collEnt_t entry;
+  int status;
+
+  while ((status = davrods_pagedlist_next(list, &entry)) >= 0) {
+    // Entries point into the current page, which the next one replaces.
+    collEnt_t *copy = &APR_ARRAY_PUSH(result, collEnt_t);
+    *copy = entry;
+    copy->collName = apr_pstrdup(resource->pool, entry.collName);
+    copy->dataName = apr_pstrdup(resource->pool, entry.dataName);
+    copy->createTime = apr_pstrdup(resource->pool, entry.createTime);
+    copy->modifyTime = apr_pstrdup(resource->pool, entry.modifyTime);
+    copy->ownerName = apr_pstrdup(resource->pool, entry.ownerName);
+  }
+
+  if (status != CAT_NO_ROWS_FOUND)
+    return status;
+
+  *entries = result;
+  return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * \file
+ * \brief     Collection listings from paged catalog queries.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_PAGEDLIST_H
+#define _DAVRODS_PAGEDLIST_H
+
+#include "repo.h"
+
+/**
+ * \brief Check whether the collection at the resource's rods_path is to be
+ *        listed with paged catalog queries (DavrodsPagedListings).
+ *
+ * This is the case for PROPFIND and GET requests on regular collections.
+ */
+bool davrods_pagedlist_enabled(const dav_resource *resource);
+
+typedef struct davrods_pagedlist davrods_pagedlist_t;
+
+/**
+ * \brief Start listing the collection at the resource's rods_path.
+ *
+ * Subcollections and data objects are each fetched with a paged catalog
+ * query, which selects only the columns that Davrods shows. Only the
+ * current page (DavrodsPagedListings rows) is held in memory.
+ *
+ * \param resource
+ *
+ * \return a listing, allocated from the resource's pool
+ */
+davrods_pagedlist_t *davrods_pagedlist_open(const dav_resource *resource);
+
+/**
+ * \brief Read the next member of a collection, like rclReadCollection().
+ *
+ * Entries are like those returned by rclReadCollection() with
+ * LONG_METADATA_FG, but there is one entry per data object rather than one
+ * per replica. Their strings are valid until the next call.
+ *
+ * The query is closed when the end of the collection or an error is
+ * reached.
+ *
+ * \param[in]  list
+ * \param[out] entry
+ *
+ * \return an iRODS status code, CAT_NO_ROWS_FOUND after the last member
+ */
+int davrods_pagedlist_next(davrods_pagedlist_t *list, collEnt_t *entry);
+
+/**
+ * \brief Stop listing before the end of the collection.
+ *
+ * \param list  a listing, or NULL
+ */
+void davrods_pagedlist_close(davrods_pagedlist_t *list);
+
+/**
+ * \brief Read all members of the collection at the resource's rods_path
+ *        into memory.
+ *
+ * This is only used where a listing must be kept, e.g. to share it with
+ * concurrent requests, as it costs memory in proportion to the size of the
+ * collection.
+ *
+ * \param[in]  resource
+ * \param[out] entries  an array of collEnt_t, allocated from the resource's
+ *                      pool
+ *
+ * \return an iRODS status code
+ */
+int davrods_pagedlist_read(const dav_resource *resource,
+                           apr_array_header_t **entries);
+
+#endif /* _DAVRODS_PAGEDLIST_H */
@@ -0,0 +1,256 @@
+/**
+ * \file
+ * \brief     Connections opened ahead of time for anonymous locations.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "prewarm.h"
+#include "auth.h"
+#include "connpool.h"
+#include "env.h"
+#include "junk.h"
+#include "metaindex.h"
+#include "session.h"
+
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_proc.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* In anonymous mode, every request of a fresh child process would start with
+ * a full iRODS connect and login, which makes the first requests after a
+ * graceful restart or scale-up the slowest ones. With
+ * DavrodsConnectionPoolPrewarm, each child instead starts a background thread
+ * that logs in as the anonymous user of every anonymous mode location and
+ * hands the connections to the connection pool (see connpool.c), where the
+ * first requests find them.
+ *
+ * The same thread periodically tops up these connections, pings the ones
+ * that have not been used for a while, and closes idle pooled connections.
+ * It also runs when only DavrodsSessionIdleTimeout is set, to release the
+ * iRODS connections of idle sessions (see session.c), and when a location
+ * uses DavrodsMetadataIndex, to remove expired index files (see
+ * metaindex.c).
+ */
+
+typedef struct {
+  server_rec *server;
+  const davrods_dir_conf_t *conf; // Merged with enclosing sections.
+} prewarm_location_t;
+
+static struct {
+  apr_array_header_t *locations; // prewarm_location_t. Lives in pconf.
+  int count;                     // Connections to keep per location.
+  apr_interval_time_t interval;  // Time between maintenance rounds.
+  apr_pool_t *pool;              // Used by the prewarm thread only.
+#if APR_HAS_THREADS
+  apr_thread_t *thread;
+  apr_thread_mutex_t *lock;
+  apr_thread_cond_t *cond;
+#endif
+  bool stopping;
+} prewarm;
+
+#if APR_HAS_THREADS
+
+static bool prewarm_stopping(void) {
+  apr_thread_mutex_lock(prewarm.lock);
+  bool stopping = prewarm.stopping;
+  apr_thread_mutex_unlock(prewarm.lock);
+  return stopping;
+}
+
+/**
+ * \brief Open connections for a location until the pool holds enough of them.
+ */
+static void fill_location(apr_pool_t *p, const prewarm_location_t *location) {
+  davrods_login_t login = {
+      .server = location->server,
+      .pool = p,
+      .conf = location->conf,
+  };
+
+  const char *username = DAVRODS_CONF(login.conf, anonymous_auth_username);
+  const char *password = DAVRODS_CONF(login.conf, anonymous_auth_password);
+
+  if (!davrods_env_get(login.conf))
+    return; // Already reported at startup.
+
+  // Use the same key that check_rods() will look for.
+  bool proxy = davrods_auth_use_proxy(&login, username, password);
+  davrods_connpool_key_t key;
+  davrods_connpool_make_key(&login, username, proxy ? NULL : password, &key);
+
+  for (int have = davrods_connpool_count(&key);
+       have < prewarm.count && !prewarm_stopping(); ++have) {
+    rcComm_t *rods_conn = NULL;
+    authn_status result = davrods_auth_connect(&login, username, password,
+                                               proxy, &rods_conn, NULL);
+
+    if (result != AUTH_GRANTED) {
+      ap_log_error(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, login.server,
+                   "Could not open a prewarmed iRODS connection for "
+                   "anonymous user '%s', will retry later",
+                   username);
+      break;
+    }
+    davrods_connpool_checkin_warm(&key, username, rods_conn);
+  }
+}
+
+static void *APR_THREAD_FUNC prewarm_thread(apr_thread_t *thread,
+                                            void *data) {
+  const prewarm_location_t *locations =
+      prewarm.locations ? (const prewarm_location_t *)prewarm.locations->elts
+                        : NULL;
+
+  while (!prewarm_stopping()) {
+    for (int i = 0; prewarm.count && i < prewarm.locations->nelts; ++i) {
+      fill_location(prewarm.pool, &locations[i]);
+      apr_pool_clear(prewarm.pool);
+    }
+
+    davrods_connpool_maintain();
+    davrods_session_release_idle();
+    davrods_metaindex_maintain(prewarm.pool);
+    davrods_junk_maintain(prewarm.pool);
+    apr_pool_clear(prewarm.pool);
+
+    apr_thread_mutex_lock(prewarm.lock);
+    if (!prewarm.stopping)
+      apr_thread_cond_timedwait(prewarm.cond, prewarm.lock, prewarm.interval);
+    apr_thread_mutex_unlock(prewarm.lock);
+  }
+
+  apr_thread_exit(thread, APR_SUCCESS);
+  return NULL;
+}
+
+static apr_status_t prewarm_cleanup(void *data) {
+  apr_thread_mutex_lock(prewarm.lock);
+  prewarm.stopping = true;
+  apr_thread_cond_signal(prewarm.cond);
+  apr_thread_mutex_unlock(prewarm.lock);
+
+  apr_status_t thread_status;
+  apr_thread_join(&thread_status, prewarm.thread);
+  return APR_SUCCESS;
+}
+
+#endif /* APR_HAS_THREADS */
+
+static int prewarm_pre_config(apr_pool_t *pconf, apr_pool_t *plog,
+                              apr_pool_t *ptemp) {
+  // pconf is cleared on restart, start with a fresh list of locations.
+  prewarm.locations = NULL;
+  return OK;
+}
+
+static void add_location(void *data, server_rec *s, const char *path,
+                         const davrods_dir_conf_t *conf) {
+  if (DAVRODS_CONF(conf, anonymous_mode) != DAVRODS_ANONYMOUS_MODE_ON)
+    return;
+
+  prewarm_location_t *location = apr_array_push(prewarm.locations);
+  assert(location);
+  location->server = s;
+  location->conf = conf;
+}
+
+static int prewarm_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+                               apr_pool_t *ptemp, server_rec *s) {
+  // Log in with the settings that requests to the location get, including
+  // those inherited from the server and from enclosing sections.
+  prewarm.locations = apr_array_make(pconf, 4, sizeof(prewarm_location_t));
+  davrods_config_walk_locations(pconf, s, add_location, NULL);
+  return OK;
+}
+
+static void prewarm_child_init(apr_pool_t *p, server_rec *s) {
+  davrods_server_conf_t *conf =
+      ap_get_module_config(s->module_config, &davrods_module);
+  assert(conf);
+
+  prewarm.count = 0;
+  if (prewarm.locations && prewarm.locations->nelts &&
+      DAVRODS_SERVER_CONF(conf, conn_pool) == DAVRODS_CONN_POOL_ON)
+    prewarm.count = DAVRODS_SERVER_CONF(conf, conn_pool_prewarm);
+
+  // More would only evict each other.
+  if (prewarm.count > DAVRODS_SERVER_CONF(conf, conn_pool_size))
+    prewarm.count = DAVRODS_SERVER_CONF(conf, conn_pool_size);
+
+  // Wake up twice per ping interval (or session idle timeout, or metadata
+  // index or junk store cleanup interval), so that no connection stays
+  // unattended for much longer than the configured time.
+  int periods[] = {
+      prewarm.count ? DAVRODS_SERVER_CONF(conf, conn_pool_ping_interval) : 0,
+      DAVRODS_SERVER_CONF(conf, session_idle_timeout),
+      davrods_metaindex_maintain_interval(),
+      davrods_junk_maintain_interval(),
+  };
+  int period = 0;
+  for (size_t i = 0; i < sizeof(periods) / sizeof(periods[0]); ++i) {
+    if (periods[i] > 0 && (!period || periods[i] < period))
+      period = periods[i];
+  }
+  if (!period)
+    return;
+  prewarm.interval = apr_time_from_sec(period) / 2;
+
+#if APR_HAS_THREADS
+  prewarm.stopping = false;
+
+  apr_status_t status = apr_pool_create(&prewarm.pool, p);
+  if (status == APR_SUCCESS)
+    status =
+        apr_thread_mutex_create(&prewarm.lock, APR_THREAD_MUTEX_DEFAULT, p);
+  if (status == APR_SUCCESS)
+    status = apr_thread_cond_create(&prewarm.cond, p);
+  if (status == APR_SUCCESS)
+    status = apr_thread_create(&prewarm.thread, NULL, prewarm_thread, NULL, p);
+
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not start the iRODS connection maintenance thread");
+    return;
+  }
+
+  // The thread must be stopped before the child pool destroys its
+  // subpools, and before the connection pool is torn down.
+  apr_pool_pre_cleanup_register(p, NULL, prewarm_cleanup);
+
+  if (prewarm.count)
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, s,
+                 "Prewarming %d iRODS connection(s) for %d anonymous "
+                 "location(s)",
+                 prewarm.count, prewarm.locations->nelts);
+#else
+  ap_log_error(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, s,
+               "DavrodsConnectionPoolPrewarm, DavrodsSessionIdleTimeout, "
+               "and metadata index and junk store cleanup require thread "
+               "support, ignoring them");
+#endif
+}
+
+void davrods_prewarm_register(apr_pool_t *p) {
+  ap_hook_pre_config(prewarm_pre_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_post_config(prewarm_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_child_init(prewarm_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,30 @@
+/**
+ * \file
+ * \brief     Connections opened ahead of time for anonymous locations.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_PREWARM_H
+#define _DAVRODS_PREWARM_H
+
+#include "config.h"
+#include "mod_davrods.h"
+
+void davrods_prewarm_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_PREWARM_H */
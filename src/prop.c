@@ -36,12 +36,9 @@ static int prop_is_writable(const dav_resource *resource, int propid) {
 }
 
 const char *const davrods_namespace_uris[] = {
-    "DAV:",
+    "DAV:", "http://calendarserver.org/ns/",
     NULL // Sentinel.
 };
-enum {
-  DAVRODS_URI_DAV = 0, // The DAV: namespace URI.
-};
 
 static dav_error *prop_patch_validate(const dav_resource *resource,
                                       const apr_xml_elem *elem, int operation,
@@ -84,6 +81,9 @@ const dav_liveprop_spec davrods_props[] = {
     {DAVRODS_URI_DAV, "getetag", DAV_PROPID_getetag, 0},
     {DAVRODS_URI_DAV, "getlastmodified", DAV_PROPID_getlastmodified, 0},
 
+    // Collection change tag, see ctag.h.
+    {DAVRODS_URI_CS, "getctag", DAVRODS_PROPID_getctag, 0},
+
     {0} // Sentinel.
 };
 
@@ -30,4 +30,14 @@ extern const dav_liveprop_spec davrods_props[];
 extern const dav_liveprop_group davrods_liveprop_group;
 extern const size_t DAVRODS_PROP_COUNT;
 
+enum {
+  DAVRODS_URI_DAV = 0, // The DAV: namespace URI.
+  DAVRODS_URI_CS,      // CalendarServer's namespace, for getctag.
+};
+
+enum {
+  // Property IDs of our own properties.
+  DAVRODS_PROPID_getctag = 1,
+};
+
 #endif /* _DAVRODS_PROP_H_ */
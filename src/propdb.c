@@ -20,6 +20,7 @@
  * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "propdb.h"
+#include "ctag.h"
 #include "prop.h"
 #include "repo.h"
 
@@ -49,9 +50,8 @@ static dav_error *dav_propdb_open(apr_pool_t *pool,
 static void dav_propdb_close(dav_db *db) { free(db); }
 
 static dav_error *dav_propdb_define_namespaces(dav_db *db, dav_xmlns_info *xi) {
-  // TODO: Implementation, if needed.
-  ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, db->resource->info->r,
-                "Unimplemented define namespaces request");
+  // The DAV: namespace is always defined.
+  dav_xmlns_add(xi, "CS", davrods_namespace_uris[DAVRODS_URI_CS]);
   return NULL;
 }
 
@@ -82,8 +82,17 @@ static dav_error *dav_propdb_output_value(dav_db *db, const dav_prop_name *name,
 
   if (db->resource->exists) {
     if (strcmp(name->ns, "DAV:") == 0) {
+      const rodsObjStat_t *stat = NULL;
+      if (strcmp(name->name, "creationdate") == 0 ||
+          strcmp(name->name, "getcontentlength") == 0 ||
+          strcmp(name->name, "getlastmodified") == 0) {
+        dav_error *err = davrods_get_stat(db->resource, &stat);
+        if (err)
+          return err;
+      }
+
       if (strcmp(name->name, "creationdate") == 0) {
-        uint64_t timestamp = atoll(db->resource->info->stat->createTime);
+        uint64_t timestamp = atoll(stat->createTime);
         char date_str[APR_RFC822_DATE_LEN] = {0};
         int status = apr_rfc822_date(date_str, timestamp * 1000 * 1000);
         dav_append_prop(
@@ -94,10 +103,10 @@ static dav_error *dav_propdb_output_value(dav_db *db, const dav_prop_name *name,
         if (db->resource->collection) {
           WHISPER("404-ing Content length request for collection\n");
         } else {
-          dav_append_prop(db->pool, "D:", name->name,
-                          apr_psprintf(db->pool, "%" DAVRODS_SIZE_T_FMT,
-                                       db->resource->info->stat->objSize),
-                          phdr);
+          dav_append_prop(
+              db->pool, "D:", name->name,
+              apr_psprintf(db->pool, "%" DAVRODS_SIZE_T_FMT, stat->objSize),
+              phdr);
           *found = 1;
         }
       } else if (strcmp(name->name, "getetag") == 0) {
@@ -107,7 +116,7 @@ static dav_error *dav_propdb_output_value(dav_db *db, const dav_prop_name *name,
           *found = 1;
         }
       } else if (strcmp(name->name, "getlastmodified") == 0) {
-        uint64_t timestamp = atoll(db->resource->info->stat->modifyTime);
+        uint64_t timestamp = atoll(stat->modifyTime);
         char date_str[APR_RFC822_DATE_LEN] = {0};
         int status = apr_rfc822_date(date_str, timestamp * 1000 * 1000);
         dav_append_prop(
@@ -119,6 +128,13 @@ static dav_error *dav_propdb_output_value(dav_db *db, const dav_prop_name *name,
       } else {
         WHISPER("PROP request for unknown DAV: prop <%s>!\n", name->name);
       }
+    } else if (strcmp(name->ns, davrods_namespace_uris[DAVRODS_URI_CS]) == 0 &&
+               strcmp(name->name, "getctag") == 0) {
+      const char *ctag = davrods_ctag_get(db->resource);
+      if (ctag) {
+        dav_append_prop(db->pool, "CS:", name->name, ctag, phdr);
+        *found = 1;
+      }
     } else {
       WHISPER("404-ing Prop request for unsupported prop ns <%s>\n", name->ns);
     }
@@ -212,6 +228,13 @@ static dav_error *dav_propdb_next_name(dav_db *db, dav_prop_name *pname) {
       // This property is not available for collections, skip it.
       db->prop_iter++;
       return dav_propdb_next_name(db, pname);
+    } else if (davrods_props[db->prop_iter].ns == DAVRODS_URI_CS &&
+               (!db->resource->collection ||
+                DAVRODS_CONF(db->resource->info->conf, collection_tag_ttl) <=
+                    0)) {
+      // Only collections have change tags, and only if they are enabled.
+      db->prop_iter++;
+      return dav_propdb_next_name(db, pname);
     } else {
       pname->ns = davrods_namespace_uris[davrods_props[db->prop_iter].ns];
       pname->name = davrods_props[db->prop_iter].name;
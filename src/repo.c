@@ -20,9 +20,20 @@
  * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "repo.h"
+#include "admission.h"
 #include "auth.h" // For anonymous access.
 #include "byterange.h"
+#include "checksum.h"
+#include "ctag.h"
+#include "junk.h"
 #include "listing.h"
+#include "metaindex.h"
+#include "pagedlist.h"
+#include "session.h"
+#include "singleflight.h"
+#include "statcache.h"
+#include "statmemo.h"
+#include "stats.h"
 
 #include <http_protocol.h>
 #include <http_request.h>
@@ -73,9 +84,13 @@ const char *davrods_get_basename(const char *path) {
  * Called by get_resource, which is a sort of entrypoint into repo.c functions.
  *
  * If Davrods is running with HTTP Basic auth enabled, then the pool
- * and the iRODS connection are set up by auth.c before we ever enter
+ * and the iRODS connection are usually set up by auth.c before we ever enter
  * repo.c. We can then simply return the pool from the connection.
  *
+ * When the credentials were instead accepted from a cache such as
+ * mod_authn_socache, our auth provider did not run, and the iRODS
+ * connection is set up here, on first use.
+ *
  * Otherwise, if Basic auth is disabled, then the first time this
  * function is entered in a HTTP connection, the pool and iRODS
  * connection do not yet exist. If in that case AnonymousMode is
@@ -115,11 +130,8 @@ static dav_error *get_davrods_pool(request_rec *r, apr_pool_t **pool) {
   if (!status && *pool) {
     // We have a pool.
 
-    rcComm_t *rods_conn = NULL;
-    status = apr_pool_userdata_get((void **)&rods_conn, "rods_conn", *pool);
-
-    if (!status && rods_conn) {
-      // We have a rods_conn.
+    if (davrods_session_get(*pool)) {
+      // We have a session, its rods_conn is set up on first use.
 
       if (DAVRODS_CONF(conf, anonymous_mode) == DAVRODS_ANONYMOUS_MODE_ON) {
         // Anonymous mode. The existing rods_conn must have been opened
@@ -199,6 +211,10 @@ static dav_error *get_davrods_pool(request_rec *r, apr_pool_t **pool) {
       // That was easy!
       return NULL;
 
+    } else if (davrods_admission_refused(r)) {
+      return dav_new_error(r->pool, HTTP_SERVICE_UNAVAILABLE, 0, 0,
+                           "Too many iRODS connections, try again later");
+
     } else {
       // No valid anonymous mode credentials.
       //
@@ -214,6 +230,48 @@ static dav_error *get_davrods_pool(request_rec *r, apr_pool_t **pool) {
           "and the configured auth scheme (option DavrodsAuthScheme).");
     }
 
+  } else if (r->user) {
+
+    // The user was authenticated without our auth provider having run, e.g.
+    // by mod_authn_socache. Log in to iRODS (or reuse the session's
+    // connection) with the request's Basic auth credentials.
+
+    request_rec *main_req = r->main ? r->main : r;
+    const char *username = NULL;
+    const char *password = NULL;
+
+    if (ap_get_basic_auth_components(main_req, &username, &password) ||
+        strcmp(username, r->user))
+      return dav_new_error(
+          r->pool, HTTP_INTERNAL_SERVER_ERROR, 0, 0,
+          "iRODS connection could not be set up: the request was "
+          "authenticated, but not with Basic auth credentials. "
+          "Davrods requires AuthType Basic or anonymous mode.");
+
+    authn_status result = check_rods(r, username, password, true);
+
+    if (result == AUTH_GRANTED) {
+      int status = apr_pool_userdata_get((void **)pool, "davrods_pool",
+                                         r->connection->pool);
+      assert(status == 0 && *pool);
+      return NULL;
+
+    } else if (result == AUTH_DENIED) {
+      // The cached credentials are no longer accepted by iRODS, e.g. because
+      // the password has been changed in the meantime.
+      ap_note_basic_auth_failure(r);
+      return dav_new_error(r->pool, HTTP_UNAUTHORIZED, 0, 0,
+                           "iRODS rejected the supplied credentials");
+
+    } else if (davrods_admission_refused(r)) {
+      return dav_new_error(r->pool, HTTP_SERVICE_UNAVAILABLE, 0, 0,
+                           "Too many iRODS connections, try again later");
+
+    } else {
+      return dav_new_error(r->pool, HTTP_INTERNAL_SERVER_ERROR, 0, 0,
+                           "Could not log in to iRODS");
+    }
+
   } else {
 
     // No basic auth and no anonymous mode either.
@@ -234,6 +292,7 @@ struct dav_repo_walker_private {
   const dav_walk_params *params;
   dav_walk_resource wres;
   char uri_buffer[MAX_NAME_LEN + 2];
+  char rods_path_buffer[MAX_NAME_LEN];
   dav_resource resource;
 };
 
@@ -251,6 +310,10 @@ struct dav_stream {
   char *container;
   size_t container_size;
   size_t container_off;
+
+  // Used instead of the above for junk resources. NULL when discarding.
+  apr_file_t *junk_file;
+  const char *junk_tmp_path;
 };
 
 static dav_error *set_rods_path_from_uri(dav_resource *resource) {
@@ -276,12 +339,13 @@ static dav_error *set_rods_path_from_uri(dav_resource *resource) {
 
   resource->info->relative_uri = uri;
 
+  // Both the prefixed path and the parsed path live on the stack, only the
+  // result is copied into the request pool.
   const char *rods_root = resource->info->rods_root;
-  char *prefixed_path = rods_root
-                            ? apr_pstrcat(resource->pool, rods_root, uri, NULL)
-                            : apr_pstrdup(resource->pool, uri);
+  size_t root_len = rods_root ? strlen(rods_root) : 0;
+  size_t uri_len = strlen(uri);
 
-  if (strlen(prefixed_path) >= MAX_NAME_LEN) {
+  if (root_len + uri_len >= MAX_NAME_LEN) {
     ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, resource->info->r,
                   "Generated an iRODS path exceeding iRODS path length limits "
                   "for URI <%s>",
@@ -290,8 +354,14 @@ static dav_error *set_rods_path_from_uri(dav_resource *resource) {
                          "Request URI too long");
   }
 
-  int status = parseRodsPathStr(prefixed_path, resource->info->rods_env,
-                                resource->info->rods_path);
+  char prefixed_path[MAX_NAME_LEN];
+  if (root_len)
+    memcpy(prefixed_path, rods_root, root_len);
+  memcpy(prefixed_path + root_len, uri, uri_len + 1);
+
+  char rods_path[MAX_NAME_LEN];
+  int status =
+      parseRodsPathStr(prefixed_path, resource->info->rods_env, rods_path);
   if (status < 0) {
     ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, resource->info->r,
                   "Could not translate URI <%s> to an iRODS path: %s", uri,
@@ -300,6 +370,9 @@ static dav_error *set_rods_path_from_uri(dav_resource *resource) {
                          "Could not parse URI.");
   }
 
+  resource->info->rods_path =
+      apr_pstrmemdup(resource->pool, rods_path, strlen(rods_path));
+
   ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, resource->info->r,
                 "Mapped URI <%s> to rods path <%s>", uri,
                 resource->info->rods_path);
@@ -319,28 +392,37 @@ static dav_error *set_rods_path_from_uri(dav_resource *resource) {
 static void copy_resource_context(dav_resource_private *dest,
                                   const dav_resource_private *src) {
   *dest = *src;
-  dest->rods_path[0] = '\0';
+  dest->rods_path = NULL;
   dest->stat = NULL;
+  dest->listed = false;
+  dest->junk = false;
 }
 
 /**
  * \brief Determine the exposed iRODS root collection for a given request.
  *
  * Root can vary based on the logged in user and zone.
+ *
+ * The root is built in a stack buffer and kept in the davrods pool the first
+ * time it is determined for a session, so that keep-alive requests do not
+ * allocate from the long-lived davrods pool. A root that differs from the
+ * memoized one (e.g. for a COPY destination in another Davrods location) is
+ * copied into the request pool instead.
  */
 static const char *get_rods_root(apr_pool_t *davrods_pool, request_rec *r) {
   davrods_dir_conf_t *conf =
       ap_get_module_config(r->per_dir_config, &davrods_module);
   assert(conf);
 
-  const char *root = NULL;
+  const char *zone = DAVRODS_CONF(conf, rods_zone);
+  char buffer[MAX_NAME_LEN];
+  apr_size_t len = 0;
 
   if (DAVRODS_CONF(conf, rods_exposed_root_type) == DAVRODS_ROOT_ZONE_DIR) {
-    root = apr_pstrcat(davrods_pool, "/", DAVRODS_CONF(conf, rods_zone), NULL);
+    len = apr_snprintf(buffer, sizeof(buffer), "/%s", zone);
   } else if (DAVRODS_CONF(conf, rods_exposed_root_type) ==
              DAVRODS_ROOT_HOME_DIR) {
-    root = apr_pstrcat(davrods_pool, "/", DAVRODS_CONF(conf, rods_zone),
-                       "/home", NULL);
+    len = apr_snprintf(buffer, sizeof(buffer), "/%s/home", zone);
   } else if (DAVRODS_CONF(conf, rods_exposed_root_type) ==
              DAVRODS_ROOT_USER_DIR) {
     const char *username = NULL;
@@ -348,10 +430,22 @@ static const char *get_rods_root(apr_pool_t *davrods_pool, request_rec *r) {
         apr_pool_userdata_get((void **)&username, "username", davrods_pool);
     assert(status == 0 && username);
 
-    root = apr_pstrcat(davrods_pool, "/", DAVRODS_CONF(conf, rods_zone),
-                       "/home/", username, NULL);
+    len = apr_snprintf(buffer, sizeof(buffer), "/%s/home/%s", zone, username);
   } else {
-    root = DAVRODS_CONF(conf, rods_exposed_root);
+    // Configured paths live as long as the server config, nothing to build.
+    return DAVRODS_CONF(conf, rods_exposed_root);
+  }
+
+  char *root = NULL;
+  int status = apr_pool_userdata_get((void **)&root, "rods_root", davrods_pool);
+
+  if (status == 0 && root) {
+    if (strcmp(root, buffer))
+      root = apr_pstrmemdup(r->pool, buffer, len);
+  } else {
+    root = apr_pstrmemdup(davrods_pool, buffer, len);
+    apr_pool_userdata_set(root, "rods_root", apr_pool_cleanup_null,
+                          davrods_pool);
   }
 
   WHISPER("Determined rods root to be <%s> for this user (conf said <%s>)\n",
@@ -366,6 +460,35 @@ static apr_status_t rods_stat_cleanup(void *mem) {
   return 0;
 }
 
+/**
+ * \brief Forget memoized stat results for a path we are about to modify, or
+ * have just modified.
+ */
+static void forget_stat(const dav_resource *resource, const char *path) {
+  davrods_statmemo_invalidate(resource->info->davrods_pool, path);
+  davrods_statcache_invalidate(path);
+  davrods_ctag_invalidate(resource->info->davrods_pool, path);
+  davrods_checksum_invalidate(resource, path);
+  davrods_metaindex_invalidate(resource, path);
+  davrods_singleflight_invalidate(resource, path);
+}
+
+/**
+ * \brief Count an rcObjStat call that was answered from the session's memo or
+ * the shared stat cache.
+ *
+ * Per request, the count is kept in the "davrods-stat-calls-avoided" note of
+ * the main request, which can be logged with LogFormat's %{...}n.
+ */
+static void count_avoided_stat(request_rec *r) {
+  request_rec *main_req = r->main ? r->main : r;
+  const char *avoided =
+      apr_table_get(main_req->notes, "davrods-stat-calls-avoided");
+  apr_table_set(main_req->notes, "davrods-stat-calls-avoided",
+                apr_itoa(main_req->pool, (avoided ? atoi(avoided) : 0) + 1));
+  davrods_stats_inc(DAVRODS_STAT_STAT_CALL_AVOIDED);
+}
+
 /**
  * \brief Returns the active session ticket for the current iRODS connection.
  *
@@ -406,8 +529,33 @@ static void set_session_ticket(const dav_resource *resource,
 
   if (strcmp(active_ticket, ticket)) {
 
+    // Clients that interleave requests with different tickets would make us
+    // toggle tickets on every request. Rather switch to a pooled connection
+    // that has the ticket activated already.
+    davrods_session_t *session =
+        davrods_session_get(resource->info->davrods_pool);
+    assert(session);
+    bool activated = false;
+    rcComm_t *rods_conn = davrods_session_swap_for_ticket(
+        resource->info->r, session, active_ticket, ticket, &activated);
+    if (rods_conn)
+      resource->info->rods_conn = rods_conn;
+
+    // The ticket changes what we may see.
+    davrods_statmemo_clear(resource->info->davrods_pool);
+    davrods_ctag_clear(resource->info->davrods_pool);
+
+    if (activated) {
+      davrods_stats_inc(DAVRODS_STAT_TICKET_CONNECTION_REUSED);
+      apr_pool_userdata_set(apr_pstrdup(resource->info->davrods_pool, ticket),
+                            "active_ticket", NULL,
+                            resource->info->davrods_pool);
+      return;
+    }
+
     ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, resource->info->r,
                   "%s session ticket", ticket[0] ? "Setting new" : "Clearing");
+    davrods_stats_inc(DAVRODS_STAT_TICKET_SUBMITTED);
 
     int status = rcTicketAdmin(resource->info->rods_conn,
                                &(ticketAdminInp_t){.arg1 = "session",
@@ -430,6 +578,34 @@ static void set_session_ticket(const dav_resource *resource,
   }
 }
 
+bool davrods_retry_on_broken_connection(const dav_resource *resource,
+                                        int status) {
+  dav_resource_private *res_private = resource->info;
+
+  if (!davrods_is_connection_error(status))
+    return false;
+
+  ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, res_private->r,
+                "Lost iRODS connection (%d = %s), reconnecting to retry",
+                status, get_rods_error_msg(status));
+
+  davrods_session_t *session = davrods_session_get(res_private->davrods_pool);
+  assert(session);
+  rcComm_t *rods_conn = davrods_session_reconnect(res_private->r, session,
+                                                  res_private->rods_conn);
+  if (!rods_conn)
+    return false;
+
+  res_private->rods_conn = rods_conn;
+
+  if (DAVRODS_CONF(res_private->conf, ticket_mode) != DAVRODS_TICKET_MODE_OFF)
+    set_session_ticket(resource, apr_table_get(res_private->r->subprocess_env,
+                                               DAVRODS_TICKET_VAR));
+
+  davrods_stats_inc(DAVRODS_STAT_OPERATION_RETRIED);
+  return true;
+}
+
 /**
  * When Davrods is configured for ticket support in read-only mode
  * ('DavrodsTickets ReadOnly'), and a ticket is submitted by a client along
@@ -474,11 +650,51 @@ static dav_error *get_dav_resource_rods_info(dav_resource *resource) {
   if (err)
     return err;
 
-  dataObjInp_t obj_in = {{0}};
+  res_private->junk =
+      davrods_junk_match(res_private->conf, res_private->rods_path);
+  if (res_private->junk)
+    return davrods_junk_stat(resource);
+
   rodsObjStat_t *stat_out = NULL;
+  int status = 0;
+
+  // Ask the session's memo, then the cache shared with other processes, then
+  // the local metadata index, and finally iRODS.
+  if (davrods_statmemo_get(r, res_private->davrods_pool,
+                           res_private->rods_path, &stat_out)) {
+    count_avoided_stat(r);
+    status = stat_out ? 0 : USER_FILE_DOES_NOT_EXIST;
+
+  } else if (davrods_statcache_get(r, res_private->davrods_pool,
+                                   res_private->rods_path, &stat_out)) {
+    count_avoided_stat(r);
+    status = stat_out ? 0 : USER_FILE_DOES_NOT_EXIST;
+    davrods_statmemo_put(r, res_private->davrods_pool, res_private->rods_path,
+                         stat_out);
+
+  } else if (davrods_metaindex_stat(resource, &stat_out)) {
+    // Like stat results from a walk, this one lacks a checksum. It is not
+    // memoized, as memoized results are assumed to include one.
+    count_avoided_stat(r);
+    status = stat_out ? 0 : USER_FILE_DOES_NOT_EXIST;
+    res_private->listed = true;
 
-  strcpy(obj_in.objPath, res_private->rods_path);
-  int status = rcObjStat(res_private->rods_conn, &obj_in, &stat_out);
+  } else {
+    apr_uint32_t epoch = davrods_statcache_epoch(res_private->rods_path);
+
+    status = davrods_singleflight_stat(resource, &stat_out);
+
+    if (status >= 0)
+      apr_pool_cleanup_register(resource->pool, stat_out, rods_stat_cleanup,
+                                apr_pool_cleanup_null);
+    if (status >= 0 || status == USER_FILE_DOES_NOT_EXIST) {
+      const rodsObjStat_t *result = status >= 0 ? stat_out : NULL;
+      davrods_statmemo_put(r, res_private->davrods_pool,
+                           res_private->rods_path, result);
+      davrods_statcache_put(r, res_private->davrods_pool,
+                            res_private->rods_path, epoch, result);
+    }
+  }
 
   if (status < 0) {
     ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
@@ -493,8 +709,6 @@ static dav_error *get_dav_resource_rods_info(dav_resource *resource) {
     }
   } else {
     res_private->stat = stat_out;
-    apr_pool_cleanup_register(resource->pool, stat_out, rods_stat_cleanup,
-                              apr_pool_cleanup_null);
 
     ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
                   "Object <%s> is a %s and has size %" DAVRODS_SIZE_T_FMT,
@@ -524,6 +738,66 @@ static dav_error *get_dav_resource_rods_info(dav_resource *resource) {
   return NULL;
 }
 
+dav_error *davrods_get_stat(const dav_resource *resource,
+                            const rodsObjStat_t **stat) {
+  dav_resource_private *res_private = resource->info;
+  *stat = res_private->stat;
+  if (res_private->stat || !resource->exists)
+    return NULL;
+
+  WHISPER("Looking up postponed stat of <%s>\n", res_private->rods_path);
+
+  // Only the stat result is of interest here, leave the resource itself
+  // untouched.
+  dav_resource lookup = *resource;
+  dav_error *err = get_dav_resource_rods_info(&lookup);
+  if (err)
+    return err;
+
+  if (!res_private->stat) {
+    ap_log_rerror(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, res_private->r,
+                  "Object <%s> was removed after it was modified",
+                  res_private->rods_path);
+    return dav_new_error(resource->pool, HTTP_NOT_FOUND, 0, 0,
+                         "Object no longer exists");
+  }
+
+  *stat = res_private->stat;
+  return NULL;
+}
+
+static const char *dav_repo_getetag(const dav_resource *resource);
+
+/**
+ * \brief Answer a conditional PROPFIND of a collection whose change tag
+ * still matches with 304 Not Modified.
+ *
+ * mod_dav's own precondition checks only allow 412 for methods other than
+ * GET, but sync clients use If-None-Match to skip unchanged subtrees.
+ */
+static dav_error *check_collection_not_modified(const dav_resource *resource) {
+  request_rec *r = resource->info->r;
+
+  if (r->method_number != M_PROPFIND || !resource->exists ||
+      !resource->collection)
+    return NULL;
+
+  const char *if_none_match = apr_table_get(r->headers_in, "If-None-Match");
+  if (!if_none_match || !davrods_ctag_get(resource))
+    return NULL;
+
+  const char *etag = dav_repo_getetag(resource);
+  if (!ap_find_list_item(r->pool, if_none_match, etag))
+    return NULL;
+
+  WHISPER("Collection <%s> not modified\n", resource->info->rods_path);
+
+  // Error responses only carry err_headers_out.
+  apr_table_setn(r->err_headers_out, "ETag", etag);
+  return dav_new_error(r->pool, HTTP_NOT_MODIFIED, 0, 0,
+                       "Collection not modified");
+}
+
 /**
  * \brief Create a DAV resource struct for the given request URI.
  *
@@ -568,13 +842,20 @@ static dav_error *dav_repo_get_resource(request_rec *r, const char *root_dir,
   if (err)
     return err;
 
-  // Obtain iRODS connection.
-  int status = apr_pool_userdata_get((void **)&res_private->rods_conn,
-                                     "rods_conn", res_private->davrods_pool);
-  assert(status == 0 && res_private->rods_conn);
+  // Obtain iRODS connection. The session may have released it for
+  // idleness, in which case we log in again.
+  davrods_session_t *session = davrods_session_get(res_private->davrods_pool);
+  assert(session);
+  res_private->rods_conn = davrods_session_acquire(r, session);
+  if (!res_private->rods_conn && davrods_admission_refused(r))
+    return dav_new_error(r->pool, HTTP_SERVICE_UNAVAILABLE, 0, 0,
+                         "Too many iRODS connections, try again later");
+  else if (!res_private->rods_conn)
+    return dav_new_error(r->pool, HTTP_INTERNAL_SERVER_ERROR, 0, 0,
+                         "Could not log in to iRODS");
 
   // Obtain iRODS environment.
-  status = apr_pool_userdata_get((void **)&res_private->rods_env, "env",
+  int status = apr_pool_userdata_get((void **)&res_private->rods_env, "env",
                                  res_private->davrods_pool);
   assert(status == 0 && res_private->rods_env);
 
@@ -633,6 +914,10 @@ static dav_error *dav_repo_get_resource(request_rec *r, const char *root_dir,
   if (err)
     return err;
 
+  err = check_collection_not_modified(resource);
+  if (err)
+    return err;
+
   // }}}
 
   *result_resource = resource;
@@ -737,6 +1022,17 @@ static dav_error *dav_repo_open_stream(const dav_resource *resource,
   stream->pool = resource->pool;
   stream->resource = resource;
 
+  if (resource->info->junk) {
+    dav_error *err =
+        davrods_junk_open(resource, mode == DAV_MODE_WRITE_SEEKABLE,
+                          &stream->junk_file, &stream->junk_tmp_path);
+    if (err)
+      return err;
+
+    *result_stream = stream;
+    return NULL;
+  }
+
   if (mode == DAV_MODE_WRITE_SEEKABLE ||
       (mode == DAV_MODE_WRITE_TRUNC &&
        DAVRODS_CONF(resource->info->conf, tmpfile_rollback) ==
@@ -754,24 +1050,18 @@ static dav_error *dav_repo_open_stream(const dav_resource *resource,
     for (const char *c = resource->uri; c; c++)
       cheapsum += 1 << *c;
 
-    // Get the path to the parent directory.
-    // TODO: Statting the parent collection is overkill, create a separate
-    // function for this.
-    dav_resource *parent;
-    dav_error *err = dav_repo_get_parent_resource(resource, &parent);
-    if (err) {
-      ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, resource->info->r,
-                    "Getting parent resource of <%s> failed in open_stream()",
-                    resource->uri);
-      return err;
-    }
+    // Get the path to the parent collection. The iRODS path is canonical, so
+    // there is no need to ask iRODS about it.
+    const char *rods_path = resource->info->rods_path;
+    const char *slash = strrchr(rods_path, '/');
+    assert(slash);
 
     // XXX:  This assumes we have write access to the collection containing
     //       the resource, not just the data object itself, which may not
     //       always be the case.
-    stream->write_path =
-        apr_psprintf(stream->pool, "%s/.davrods-tx-%04x-%08lx",
-                     parent->info->rods_path, getpid(), time(NULL) ^ cheapsum);
+    stream->write_path = apr_psprintf(
+        stream->pool, "%.*s/.davrods-tx-%04x-%08lx", (int)(slash - rods_path),
+        rods_path, getpid(), time(NULL) ^ cheapsum);
   } else {
     // No other modes exist in mod_dav at this time.
     assert("Unimplemented open_stream mode" && 0);
@@ -863,6 +1153,8 @@ static dav_error *dav_repo_open_stream(const dav_resource *resource,
                 "Will write using %luK chunks",
                 DAVRODS_CONF(resource->info->conf, rods_tx_buffer_size) / 1024);
 
+  forget_stat(resource, stream->write_path);
+
   *result_stream = stream;
 
   return 0;
@@ -928,6 +1220,10 @@ static dav_error *dav_repo_write_stream(dav_stream *stream,
   // difference in performance (ex. from 36s to 0.8s for a 100M file when
   // switching to a 4M buffer).
 
+  if (stream->resource->info->junk)
+    return davrods_junk_write(stream->resource, stream->junk_file,
+                              input_buffer, input_buffer_size);
+
   if (!stream->container) {
     // Initialize the container.
     stream->container_size =
@@ -969,6 +1265,10 @@ static dav_error *dav_repo_write_stream(dav_stream *stream,
 }
 
 static dav_error *dav_repo_close_stream(dav_stream *stream, int commit) {
+  if (stream->resource->info->junk)
+    return davrods_junk_close(stream->resource, stream->junk_file,
+                              stream->junk_tmp_path, commit);
+
   // Flush the container.
   dav_error *err = stream_ship_container(stream);
   if (err)
@@ -983,6 +1283,12 @@ static dav_error *dav_repo_close_stream(dav_stream *stream, int commit) {
   close_params.l1descInx = stream->data_obj.l1descInx;
 
   int status = rcDataObjClose(resource->info->rods_conn, &close_params);
+
+  // Whatever happens below, the object's size and checksum have changed.
+  forget_stat(resource, stream->write_path);
+  forget_stat(resource, resource->info->rods_path);
+  resource->info->stat = NULL;
+
   if (status < 0) {
     ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, resource->info->r,
                   "rcDataObjClose failed: %d = %s", status,
@@ -1047,6 +1353,7 @@ static dav_error *dav_repo_close_stream(dav_stream *stream, int commit) {
               "Something went wrong while renaming the uploaded resource");
         }
       }
+      forget_stat(resource, resource->info->rods_path);
     } else {
       // We were already writing to the destination object, so we're done here.
     }
@@ -1103,6 +1410,16 @@ static dav_error *dav_repo_close_stream(dav_stream *stream, int commit) {
 }
 
 static dav_error *dav_repo_seek_stream(dav_stream *stream, apr_off_t abs_pos) {
+  if (stream->resource->info->junk) {
+    apr_status_t status = stream->junk_file ? apr_file_seek(stream->junk_file,
+                                                            APR_SET, &abs_pos)
+                                            : APR_SUCCESS;
+    if (status != APR_SUCCESS)
+      return dav_new_error(stream->pool, HTTP_INTERNAL_SERVER_ERROR, 0, status,
+                           "Could not seek file for partial upload or resume");
+    return NULL;
+  }
+
   openedDataObjInp_t seek_inp = {0};
   seek_inp.l1descInx = stream->data_obj.l1descInx;
   seek_inp.offset = abs_pos;
@@ -1126,8 +1443,6 @@ static dav_error *dav_repo_seek_stream(dav_stream *stream, apr_off_t abs_pos) {
   }
 }
 
-static const char *dav_repo_getetag(const dav_resource *resource);
-
 static dav_error *dav_repo_set_headers(request_rec *r,
                                        const dav_resource *resource) {
   // Set response headers for GET requests.
@@ -1147,9 +1462,14 @@ static dav_error *dav_repo_set_headers(request_rec *r,
     apr_table_setn(r->headers_out, "Accept-Ranges", "none");
 
   } else {
+    const rodsObjStat_t *stat;
+    dav_error *err = davrods_get_stat(resource, &stat);
+    if (err)
+      return err;
+
     char *date_str = apr_pcalloc(r->pool, APR_RFC822_DATE_LEN);
     assert(date_str);
-    uint64_t timestamp = atoll(resource->info->stat->modifyTime);
+    uint64_t timestamp = atoll(stat->modifyTime);
     int status = apr_rfc822_date(date_str, timestamp * 1000 * 1000);
 
     apr_table_setn(r->headers_out, "Last-Modified",
@@ -1164,7 +1484,7 @@ static dav_error *dav_repo_set_headers(request_rec *r,
 
     // This will be overwritten in byterange.c if the request turns out to be
     // a valid range request.
-    ap_set_content_length(r, resource->info->stat->objSize);
+    ap_set_content_length(r, stat->objSize);
 
     davrods_dir_conf_t *conf =
         ap_get_module_config(r->per_dir_config, &davrods_module);
@@ -1194,9 +1514,11 @@ static dav_error *deliver_file(const dav_resource *resource,
   open_params.openFlags = O_RDONLY;
   strcpy(open_params.objPath, resource->info->rods_path);
 
-  int status;
+  int status = rcDataObjOpen(resource->info->rods_conn, &open_params);
+  if (status < 0 && davrods_retry_on_broken_connection(resource, status))
+    status = rcDataObjOpen(resource->info->rods_conn, &open_params);
 
-  if ((status = rcDataObjOpen(resource->info->rods_conn, &open_params)) < 0) {
+  if (status < 0) {
     apr_brigade_destroy(bb);
 
     ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, resource->info->r,
@@ -1259,6 +1581,8 @@ static dav_error *dav_repo_deliver(const dav_resource *resource,
 
   if (resource->collection)
     return davrods_deliver_directory_listing(resource, output);
+  else if (resource->info->junk)
+    return davrods_junk_deliver(resource, output);
   else
     return deliver_file(resource, output);
 }
@@ -1270,6 +1594,10 @@ static dav_error *dav_repo_create_collection(dav_resource *resource) {
   // Possibly reject the operation when a ticket is used for a write action.
   RETURN_ERROR_IF_TICKET_ACTIVE_AND_READONLY(resource);
 
+  if (resource->info->junk)
+    return dav_new_error(resource->pool, HTTP_FORBIDDEN, 0, 0,
+                         "Cannot create a collection with this name");
+
   dav_resource *parent;
   dav_error *err = dav_repo_get_parent_resource(resource, &parent);
   if (err) {
@@ -1289,6 +1617,7 @@ static dav_error *dav_repo_create_collection(dav_resource *resource) {
   strcpy(coll_inp.collName, resource->info->rods_path);
 
   int status = rcCollCreate(resource->info->rods_conn, &coll_inp);
+  forget_stat(resource, resource->info->rods_path);
   if (status < 0) {
     ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, resource->info->r,
                   "rcCollCreate failed: %d = %s", status,
@@ -1298,9 +1627,11 @@ static dav_error *dav_repo_create_collection(dav_resource *resource) {
                          "Could not create a collection at the given path");
   }
 
-  // Update resource stat info.
-  err = get_dav_resource_rods_info(resource);
-  assert(err == NULL);
+  // Update resource stat info. The details are looked up only if they are
+  // needed, see davrods_get_stat().
+  resource->exists = 1;
+  resource->collection = 1;
+  resource->info->stat = NULL;
 
   return 0;
 }
@@ -1374,12 +1705,41 @@ static dav_error *walker(struct dav_repo_walker_private *ctx, int depth) {
   collHandle_t coll_handle;
   collEnt_t coll_entry;
 
+  // PROPFINDs may be answered from the local metadata index. Other walks,
+  // e.g. for COPY, always ask iRODS. The listing may also be shared with a
+  // concurrent identical walk, in which case its entries are read in
+  // advance. Otherwise, it is read one entry at a time, either with paged
+  // catalog queries or with rclReadCollection().
+  apr_array_header_t *entries = NULL;
+  davrods_pagedlist_t *paged = NULL;
+  davrods_metaindex_writer_t *index_writer = NULL;
+  int next_entry = 0;
+  int status = 0;
+
+  if (ctx->resource.info->r->method_number == M_PROPFIND) {
+    entries = davrods_metaindex_list(&ctx->resource, false);
+    if (!entries)
+      index_writer = davrods_metaindex_write_begin(&ctx->resource, false);
+  }
+
   WHISPER("Opening iRODS collection <%s> \n", ctx->resource.info->rods_path);
 
-  int status =
-      rclOpenCollection(ctx->resource.info->rods_conn,
-                        ctx->resource.info->rods_path, 0, &coll_handle);
+  if (!entries)
+    status = davrods_singleflight_list(&ctx->resource, 0, &entries);
+
+  if (!entries && status >= 0 && davrods_pagedlist_enabled(&ctx->resource)) {
+    paged = davrods_pagedlist_open(&ctx->resource);
+  } else if (!entries && status >= 0) {
+    status = rclOpenCollection(ctx->resource.info->rods_conn,
+                               ctx->resource.info->rods_path, 0, &coll_handle);
+    if (status < 0 &&
+        davrods_retry_on_broken_connection(&ctx->resource, status))
+      status =
+          rclOpenCollection(ctx->resource.info->rods_conn,
+                            ctx->resource.info->rods_path, 0, &coll_handle);
+  }
   if (status < 0) {
+    davrods_metaindex_write_end(index_writer, false);
     ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, ctx->resource.info->r,
                   "rcOpenCollection failed: %d = %s", status,
                   get_rods_error_msg(status));
@@ -1399,14 +1759,23 @@ static dav_error *walker(struct dav_repo_walker_private *ctx, int depth) {
           ctx->resource.info->rods_path);
 
   do {
-    status = rclReadCollection(ctx->resource.info->rods_conn, &coll_handle,
-                               &coll_entry);
+    if (paged)
+      status = davrods_pagedlist_next(paged, &coll_entry);
+    else if (!entries)
+      status = rclReadCollection(ctx->resource.info->rods_conn, &coll_handle,
+                                 &coll_entry);
+    else if (next_entry < entries->nelts)
+      coll_entry = APR_ARRAY_IDX(entries, next_entry++, collEnt_t);
+    else
+      status = CAT_NO_ROWS_FOUND;
 
     if (status < 0) {
       if (status == CAT_NO_ROWS_FOUND) {
         WHISPER("Reached end of collection <%s>.\n",
                 ctx->resource.info->rods_path);
+        davrods_metaindex_write_end(index_writer, true);
       } else {
+        davrods_metaindex_write_end(index_writer, false);
         ap_log_rerror(
             APLOG_MARK, APLOG_ERR, APR_SUCCESS, ctx->resource.info->r,
             "rcReadCollection failed for collection <%s> with error <%s>",
@@ -1434,10 +1803,14 @@ static dav_error *walker(struct dav_repo_walker_private *ctx, int depth) {
         ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, ctx->resource.info->r,
                       "Generated an uri or iRODS path exceeding iRODS path "
                       "length limits");
+        davrods_metaindex_write_end(index_writer, false);
+        davrods_pagedlist_close(paged);
         return dav_new_error(ctx->resource.pool, HTTP_INTERNAL_SERVER_ERROR, 0,
                              0, "Path name too long");
       }
 
+      davrods_metaindex_write_entry(index_writer, &coll_entry);
+
       // Transform resource struct into child resource struct.
       // Perform the same path translation on both rods_path and uri.
 
@@ -1465,6 +1838,8 @@ static dav_error *walker(struct dav_repo_walker_private *ctx, int depth) {
               sizeof(ctx->resource.info->stat->modifyTime));
       strncpy(ctx->resource.info->stat->createTime, coll_entry.createTime,
               sizeof(ctx->resource.info->stat->createTime));
+      ctx->resource.info->stat->chksum[0] = '\0';
+      ctx->resource.info->listed = true;
 
       walker_push_seen_path(ctx->resource.pool, &seen_resource,
                             ctx->resource.info->rods_path);
@@ -1593,8 +1968,12 @@ static dav_error *dav_repo_walk(const dav_walk_params *params, int depth,
 
   // LockNull related walks can encounter non-existent resources.
   // Stat will be NULL for such resources.
-  if (ctx.params->root->info->stat)
-    *ctx_res_private->stat = *ctx.params->root->info->stat;
+  const rodsObjStat_t *root_stat;
+  dav_error *err = davrods_get_stat(ctx.params->root, &root_stat);
+  if (err)
+    return err;
+  if (root_stat)
+    *ctx_res_private->stat = *root_stat;
 
   // We need to use a writable URI buffer in ctx because dav_resource's uri
   // property is const.
@@ -1618,10 +1997,15 @@ static dav_error *dav_repo_walk(const dav_walk_params *params, int depth,
   ctx.resource.pool = ctx_res_private->r->pool;
   ctx.resource.info = ctx_res_private;
 
-  dav_error *err = set_rods_path_from_uri(&ctx.resource);
+  err = set_rods_path_from_uri(&ctx.resource);
   if (err)
     return err;
 
+  // The walker extends rods_path in place for each child, so it needs a
+  // buffer of the maximum size rather than the exactly allocated path.
+  strcpy(ctx.rods_path_buffer, ctx_res_private->rods_path);
+  ctx_res_private->rods_path = ctx.rods_path_buffer;
+
   ctx.wres.walk_ctx = params->walk_ctx;
   ctx.wres.pool = params->pool;
   ctx.wres.resource = &ctx.resource;
@@ -1731,6 +2115,13 @@ static dav_error *dav_repo_copy_resource(const dav_resource *src,
   // Possibly reject the operation when a ticket is used for a write action.
   RETURN_ERROR_IF_TICKET_ACTIVE_AND_READONLY(dst);
 
+  if (src->info->junk || dst->info->junk)
+    return src->info->junk && dst->info->junk
+               ? davrods_junk_copy(src, dst, false)
+               : dav_new_error(dst->pool, HTTP_FORBIDDEN, 0, 0,
+                               "Client metadata files cannot be copied into "
+                               "or out of iRODS");
+
   dav_resource *dst_parent;
 
   dav_error *err = dav_repo_get_parent_resource(dst, &dst_parent);
@@ -1757,6 +2148,13 @@ static dav_error *dav_repo_copy_resource(const dav_resource *src,
                                  .lockdb = NULL};
 
   err = dav_repo_walk(&walk_params, depth, response);
+  forget_stat(dst, dst->info->rods_path);
+
+  if (!err) {
+    dst->exists = 1;
+    dst->collection = src->collection;
+    dst->info->stat = NULL;
+  }
 
   return err;
 }
@@ -1768,6 +2166,18 @@ static dav_error *dav_repo_move_resource(dav_resource *src, dav_resource *dst,
   // Possibly reject the operation when a ticket is used for a write action.
   RETURN_ERROR_IF_TICKET_ACTIVE_AND_READONLY(dst);
 
+  if (src->info->junk || dst->info->junk) {
+    if (!src->info->junk || !dst->info->junk)
+      return dav_new_error(dst->pool, HTTP_FORBIDDEN, 0, 0,
+                           "Client metadata files cannot be moved into or "
+                           "out of iRODS");
+
+    dav_error *err = davrods_junk_copy(src, dst, true);
+    if (!err)
+      src->exists = 0;
+    return err;
+  }
+
   // Yes, the rename function takes a copyInp struct as its input.
   dataObjCopyInp_t rename_params = {{{0}}};
 
@@ -1778,6 +2188,8 @@ static dav_error *dav_repo_move_resource(dav_resource *src, dav_resource *dst,
   strcpy(rename_params.destDataObjInp.objPath, dst->info->rods_path);
 
   int status = rcDataObjRename(src->info->rods_conn, &rename_params);
+  forget_stat(src, src->info->rods_path);
+  forget_stat(dst, dst->info->rods_path);
   if (status < 0) {
     ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, src->info->r,
                   "rcDataObjRename failed: %d = %s", status,
@@ -1821,8 +2233,10 @@ static dav_error *dav_repo_move_resource(dav_resource *src, dav_resource *dst,
   }
 
   src->exists = 0;
+  src->info->stat = NULL;
   dst->exists = 1;
   dst->collection = src->collection;
+  dst->info->stat = NULL;
 
   return 0;
 }
@@ -1836,6 +2250,11 @@ static dav_error *dav_repo_remove_resource(dav_resource *resource,
 
   request_rec *r = resource->info->r;
 
+  if (resource->info->junk)
+    return davrods_junk_remove(resource);
+
+  forget_stat(resource, resource->info->rods_path);
+
   if (resource->collection) {
     ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
                   "Removing collection <%s>", resource->info->rods_path);
@@ -1883,25 +2302,33 @@ static dav_error *dav_repo_remove_resource(dav_resource *resource,
     resource->exists = 0;
   }
 
+  // A concurrent request may have looked it up since it was forgotten above.
+  forget_stat(resource, resource->info->rods_path);
+
   return NULL;
 }
 
 static const char *dav_repo_getetag(const dav_resource *resource) {
   // This mimics dav_fs repo's getetag.
 
-  dav_resource_private *res_private = resource->info;
-
-  if (!resource->exists) {
+  const rodsObjStat_t *stat;
+  if (!resource->exists || davrods_get_stat(resource, &stat))
     return "";
 
-  } else if (resource->collection) {
+  if (resource->collection) {
+    // Prefer a tag that changes along with the collection's contents.
+    const char *ctag = davrods_ctag_get(resource);
     return apr_psprintf(resource->pool, "\"%s\"",
-                        res_private->stat->modifyTime);
-  } else {
-    return apr_psprintf(resource->pool, "\"%" APR_UINT64_T_HEX_FMT "-%s\"",
-                        (apr_uint64_t)res_private->stat->objSize,
-                        res_private->stat->modifyTime);
+                        ctag ? ctag : stat->modifyTime);
   }
+
+  // A checksum changes whenever the contents do, which makes a strong ETag.
+  const char *checksum = davrods_checksum_get(resource);
+  if (checksum)
+    return apr_psprintf(resource->pool, "\"%s\"", checksum);
+
+  return apr_psprintf(resource->pool, "\"%" APR_UINT64_T_HEX_FMT "-%s\"",
+                      (apr_uint64_t)stat->objSize, stat->modifyTime);
 }
 
 static request_rec *dav_repo_get_request_rec(const dav_resource *resource) {
@@ -49,8 +49,9 @@ struct dav_resource_private {
   // }}}
   // Information specific to the DAV resource {{{
 
-  // This is `MAX_NAME_LEN` as specified by iRODS.
-  char rods_path[MAX_NAME_LEN]; // Currently 1024 + 64.
+  // Allocated at its exact length. Shorter than `MAX_NAME_LEN` as specified
+  // by iRODS (currently 1024 + 64).
+  char *rods_path;
 
   // relative_uri is resource->uri with the root_dir chopped off.
   // i.e. with a Davrods in <Location /abc/def/>,
@@ -58,9 +59,19 @@ struct dav_resource_private {
   // while relative_uri will be just /some_file.txt.
   const char *relative_uri;
 
+  // NULL if the resource does not exist, or if Davrods knows that it exists
+  // but has not looked it up yet. Use davrods_get_stat().
   rodsObjStat_t *stat;
   const char *root_dir;
 
+  // Whether stat was filled in from a collection listing, which does not
+  // include checksums.
+  bool listed;
+
+  // Whether this is a client metadata file that is handled without asking
+  // iRODS (see junk.h).
+  bool junk;
+
   // }}}
 };
 
@@ -68,4 +79,37 @@ extern const dav_hooks_repository davrods_hooks_repository;
 
 const char *davrods_get_basename(const char *path);
 
+/**
+ * \brief Get the iRODS stat result of an existing resource.
+ *
+ * When Davrods creates or renames a resource, it knows that the resource
+ * exists and what type it is. The details are only looked up when something
+ * asks for them.
+ *
+ * \param[in]  resource
+ * \param[out] stat     the stat result, NULL if the resource does not exist
+ *                      or the lookup failed
+ *
+ * \return NULL on success, a 404 error if the resource was removed in the
+ *         meantime, or a 500 error if iRODS could not be asked
+ */
+dav_error *davrods_get_stat(const dav_resource *resource,
+                            const rodsObjStat_t **stat);
+
+/**
+ * \brief Prepare to retry an idempotent iRODS operation that failed because
+ *        the connection was lost.
+ *
+ * If status indicates a broken connection, the resource's session is
+ * reconnected, and its session ticket (if any) is submitted again.
+ * Operations must be retried at most once.
+ *
+ * \param resource
+ * \param status   the iRODS status code returned by the failed operation
+ *
+ * \return whether the operation should be retried
+ */
+bool davrods_retry_on_broken_connection(const dav_resource *resource,
+                                        int status);
+
 #endif /* _DAVRODS_REPO_H */
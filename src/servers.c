@@ -0,0 +1,311 @@
+/**
+ * \file
+ * \brief     iRODS server selection and health tracking.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "servers.h"
+
+#include <stdlib.h>
+
+#include <apr_hash.h>
+#include <apr_thread_mutex.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* DavrodsServer may list multiple iRODS servers, e.g. several catalog
+ * consumers of the same zone. For every new iRODS connection, one of them is
+ * chosen, either the one with the fewest open connections from this child
+ * process, or one based on a hash of the username (so that a user's
+ * connections stick to the same server while it is healthy).
+ *
+ * Health is tracked passively, per child process: servers that fail to
+ * accept connections several times in a row, or whose connection setup time
+ * is consistently high, are skipped for a while.
+ */
+
+// Consecutive connection failures after which a server is ejected.
+#define SERVERS_MAX_FAILURES 3
+
+// Average connection setup time above which a server is ejected.
+#define SERVERS_SLOW_LATENCY apr_time_from_sec(2)
+
+// How long an ejected server is skipped.
+#define SERVERS_EJECT_TIME apr_time_from_sec(30)
+
+typedef struct {
+  int active;                  // Open connections from this child.
+  int failures;                // Consecutive connection failures.
+  apr_interval_time_t latency; // Moving average of connection setup time.
+  apr_time_t ejected_until;    // 0 if not ejected.
+  char version[NAME_LEN];      // iRODS release version, empty until known.
+} server_health_t;
+
+static struct {
+  server_rec *server;
+  apr_pool_t *pool;
+  apr_hash_t *health; // "host:port" => server_health_t.
+#if APR_HAS_THREADS
+  apr_thread_mutex_t *lock;
+#endif
+} servers;
+
+static void servers_lock(void) {
+#if APR_HAS_THREADS
+  if (servers.lock)
+    apr_thread_mutex_lock(servers.lock);
+#endif
+}
+
+static void servers_unlock(void) {
+#if APR_HAS_THREADS
+  if (servers.lock)
+    apr_thread_mutex_unlock(servers.lock);
+#endif
+}
+
+/**
+ * \brief Get the health record of a server. Must be called with the lock held.
+ *
+ * \return a health record, or NULL if health is not tracked in this process.
+ */
+static server_health_t *get_health(const char *host, int port) {
+  if (!servers.health)
+    return NULL;
+
+  char name[NAME_LEN + 8];
+  int len = snprintf(name, sizeof(name), "%s:%d", host, port);
+
+  server_health_t *health = apr_hash_get(servers.health, name, len);
+  if (!health) {
+    health = apr_pcalloc(servers.pool, sizeof(server_health_t));
+    assert(health);
+    apr_hash_set(servers.health, apr_pstrmemdup(servers.pool, name, len), len,
+                 health);
+  }
+  return health;
+}
+
+const davrods_server_t *davrods_servers_get(const davrods_login_t *login,
+                                            int *count) {
+  const davrods_dir_conf_t *conf = login->conf;
+
+  apr_array_header_t *list = DAVRODS_CONF(conf, rods_servers);
+  if (list) {
+    *count = list->nelts;
+    return (const davrods_server_t *)list->elts;
+  }
+
+  davrods_server_t *server =
+      apr_palloc(login->pool, sizeof(davrods_server_t));
+  assert(server);
+  server->host = DAVRODS_CONF(conf, rods_host);
+  server->port = DAVRODS_CONF(conf, rods_port);
+  *count = 1;
+  return server;
+}
+
+// FNV-1a, used for rendezvous hashing of usernames onto servers.
+static uint32_t hash_str(uint32_t hash, const char *str) {
+  for (const char *c = str; *c; ++c) {
+    hash ^= (unsigned char)*c;
+    hash *= 16777619u;
+  }
+  // Mix in the terminator as well, so that field boundaries matter.
+  hash *= 16777619u;
+  return hash;
+}
+
+static bool same_server(const davrods_server_t *a, const davrods_server_t *b) {
+  return a && b && a->port == b->port && !strcmp(a->host, b->host);
+}
+
+const davrods_server_t *davrods_servers_pick(const davrods_login_t *login,
+                                             const char *username,
+                                             const davrods_server_t *exclude) {
+  const davrods_dir_conf_t *conf = login->conf;
+
+  int count = 0;
+  const davrods_server_t *list = davrods_servers_get(login, &count);
+
+  if (count == 1)
+    return same_server(list, exclude) ? NULL : list;
+
+  bool by_user = DAVRODS_CONF(conf, rods_server_selection) ==
+                 DAVRODS_SERVER_SELECTION_USER_HASH;
+  apr_time_t now = apr_time_now();
+
+  const davrods_server_t *best = NULL;
+  int best_active = 0;
+  apr_interval_time_t best_latency = 0;
+  uint32_t best_score = 0;
+
+  // Stands in for the health records when health is not tracked.
+  server_health_t untracked = {0};
+
+  // Fallback for when all servers are ejected: the one that comes back first.
+  const davrods_server_t *fallback = NULL;
+  apr_time_t fallback_until = 0;
+
+  servers_lock();
+  for (int i = 0; i < count; ++i) {
+    const davrods_server_t *server = &list[i];
+    if (same_server(server, exclude))
+      continue;
+
+    server_health_t *health = get_health(server->host, server->port);
+    if (!health)
+      health = &untracked;
+
+    if (health->ejected_until) {
+      if (now < health->ejected_until) {
+        if (!fallback || health->ejected_until < fallback_until) {
+          fallback = server;
+          fallback_until = health->ejected_until;
+        }
+        continue;
+      }
+      // Give the server a fresh chance.
+      health->ejected_until = 0;
+      health->failures = 0;
+      health->latency = 0;
+    }
+
+    if (by_user) {
+      uint32_t score = hash_str(hash_str(2166136261u, username), server->host);
+      score = hash_str(score, apr_itoa(login->pool, server->port));
+      if (!best || score > best_score) {
+        best = server;
+        best_score = score;
+      }
+    } else if (!best || health->active < best_active ||
+               (health->active == best_active &&
+                health->latency < best_latency)) {
+      best = server;
+      best_active = health->active;
+      best_latency = health->latency;
+    }
+  }
+  servers_unlock();
+
+  if (!best)
+    best = fallback;
+
+  if (best)
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Selected iRODS server <%s:%d>", best->host, best->port);
+
+  return best;
+}
+
+static void eject(const davrods_server_t *server, server_health_t *health,
+                  const char *reason) {
+  health->ejected_until = apr_time_now() + SERVERS_EJECT_TIME;
+  ap_log_error(APLOG_MARK, APLOG_WARNING, APR_SUCCESS, servers.server,
+               "Temporarily not using iRODS server <%s:%d>: %s", server->host,
+               server->port, reason);
+}
+
+void davrods_servers_connected(const davrods_server_t *server,
+                               apr_interval_time_t elapsed) {
+  servers_lock();
+  server_health_t *health = get_health(server->host, server->port);
+  if (health) {
+    health->active++;
+    health->failures = 0;
+    // Exponentially weighted moving average, alpha = 1/4.
+    health->latency = health->latency
+                          ? health->latency + (elapsed - health->latency) / 4
+                          : elapsed;
+    if (health->latency > SERVERS_SLOW_LATENCY && !health->ejected_until)
+      eject(server, health, "connection setup is too slow");
+  }
+  servers_unlock();
+}
+
+void davrods_servers_connect_failed(const davrods_server_t *server) {
+  servers_lock();
+  server_health_t *health = get_health(server->host, server->port);
+  if (health && ++health->failures >= SERVERS_MAX_FAILURES &&
+      !health->ejected_until)
+    eject(server, health, "repeated connection failures");
+  servers_unlock();
+}
+
+bool davrods_servers_get_version(const davrods_server_t *server, char *buf,
+                                 size_t size) {
+  servers_lock();
+  server_health_t *health = get_health(server->host, server->port);
+  bool known = health && *health->version;
+  if (known)
+    apr_cpystrn(buf, health->version, size);
+  servers_unlock();
+  return known;
+}
+
+void davrods_servers_set_version(const davrods_server_t *server,
+                                 const char *version) {
+  servers_lock();
+  server_health_t *health = get_health(server->host, server->port);
+  if (health)
+    apr_cpystrn(health->version, version, sizeof(health->version));
+  servers_unlock();
+}
+
+int davrods_servers_ping(rcComm_t *rods_conn) {
+  miscSvrInfo_t *server_info = NULL;
+  int status = rcGetMiscSvrInfo(rods_conn, &server_info);
+  free(server_info);
+  return status;
+}
+
+void davrods_servers_disconnect(rcComm_t *rods_conn) {
+  servers_lock();
+  server_health_t *health = get_health(rods_conn->host, rods_conn->portNum);
+  if (health && health->active > 0)
+    health->active--;
+  servers_unlock();
+
+  rcDisconnect(rods_conn);
+}
+
+static void servers_child_init(apr_pool_t *p, server_rec *s) {
+  // This must run before the connection pool's child_init, so that our
+  // mutex is still alive when the pool disconnects its connections through
+  // davrods_servers_disconnect() during child exit (cleanups run in reverse
+  // order of registration).
+  servers.server = s;
+  servers.pool = p;
+
+#if APR_HAS_THREADS
+  apr_status_t status =
+      apr_thread_mutex_create(&servers.lock, APR_THREAD_MUTEX_DEFAULT, p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not create server health mutex, iRODS server health "
+                 "will not be tracked");
+    return;
+  }
+#endif
+
+  servers.health = apr_hash_make(p);
+}
+
+void davrods_servers_register(apr_pool_t *p) {
+  ap_hook_child_init(servers_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,111 @@
+/**
+ * \file
+ * \brief     iRODS server selection and health tracking.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_SERVERS_H
+#define _DAVRODS_SERVERS_H
+
+#include "config.h"
+#include "mod_davrods.h"
+
+#include <irods/rodsClient.h>
+
+/**
+ * \brief Get the list of iRODS servers configured for a location.
+ *
+ * \param[in]  login
+ * \param[out] count the amount of servers, at least 1
+ *
+ * \return an array of servers
+ */
+const davrods_server_t *davrods_servers_get(const davrods_login_t *login,
+                                            int *count);
+
+/**
+ * \brief Choose an iRODS server to connect to.
+ *
+ * Servers that recently failed or responded slowly are skipped, unless no
+ * other server is available.
+ *
+ * \param login
+ * \param username used for the UserHash selection method
+ * \param exclude  a server that must not be chosen (e.g. because connecting
+ *                 to it just failed), or NULL
+ *
+ * \return a server, or NULL if no server other than exclude is configured
+ */
+const davrods_server_t *davrods_servers_pick(const davrods_login_t *login,
+                                             const char *username,
+                                             const davrods_server_t *exclude);
+
+/**
+ * \brief Record a successful connection attempt.
+ *
+ * \param server
+ * \param elapsed time taken to set up the connection
+ */
+void davrods_servers_connected(const davrods_server_t *server,
+                               apr_interval_time_t elapsed);
+
+/**
+ * \brief Record a failed connection attempt.
+ */
+void davrods_servers_connect_failed(const davrods_server_t *server);
+
+/**
+ * \brief Get the release version of a server, if it was seen before.
+ *
+ * Server info is requested once per server and child process, rather than
+ * for every login.
+ *
+ * \param[in]  server
+ * \param[out] buf    receives the version string
+ * \param[in]  size   size of buf
+ *
+ * \return whether the version is known
+ */
+bool davrods_servers_get_version(const davrods_server_t *server, char *buf,
+                                 size_t size);
+
+/**
+ * \brief Remember the release version of a server.
+ */
+void davrods_servers_set_version(const davrods_server_t *server,
+                                 const char *version);
+
+/**
+ * \brief Check that an iRODS connection is still alive, with a cheap API
+ *        call that does not touch the catalog.
+ *
+ * \return an iRODS status code, negative if the connection is broken
+ */
+int davrods_servers_ping(rcComm_t *rods_conn);
+
+/**
+ * \brief Close an iRODS connection, and update its server's statistics.
+ *
+ * Use this instead of rcDisconnect() for connections that were reported
+ * through davrods_servers_connected().
+ */
+void davrods_servers_disconnect(rcComm_t *rods_conn);
+
+void davrods_servers_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_SERVERS_H */
@@ -0,0 +1,521 @@
+/**
+ * \file
+ * \brief     iRODS connections owned by HTTP sessions.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "session.h"
+#include "admission.h"
+#include "auth.h"
+#include "common.h"
+#include "config.h"
+#include "multiplex.h"
+#include "servers.h"
+#include "stats.h"
+
+#include <apr_thread_mutex.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* iRODS sessions last as long as the client's TCP connection (see
+ * check_rods() in auth.c). An idle HTTP keep-alive connection would then pin
+ * an iRODS agent process for its entire lifetime.
+ *
+ * With DavrodsSessionIdleTimeout, sessions are kept in a per-child registry,
+ * and a background thread closes the iRODS connections of sessions that
+ * have not handled a request for a while. Sessions keep their credentials
+ * (in the davrods pool), so that their next request can log in again without
+ * bothering the client.
+ *
+ * A session holds an admission permit (see admission.c) for as long as it
+ * holds an iRODS connection, including while it replaces a broken one.
+ *
+ * Sessions of HTTP/2 streams hold their iRODS connection only while handling
+ * a request, and otherwise leave it to the other streams of the same client
+ * connection (see multiplex.c). The permit moves along with the connection.
+ *
+ * The registry lock protects the rods_conn, admitted, busy and last_active
+ * fields of registered sessions, which the background thread inspects. All
+ * other session state is only touched by the thread that handles the
+ * client's requests.
+ */
+
+struct davrods_session_t {
+  rcComm_t *rods_conn; // NULL while released for idleness.
+  bool admitted;       // Whether the session holds an admission permit.
+  davrods_connpool_key_t key;
+  davrods_multiplex_t *multiplex; // Set for HTTP/2 streams only.
+  const char *username;
+  apr_pool_t *davrods_pool;
+
+  int busy;               // Requests currently using rods_conn.
+  apr_time_t last_active; // When the last request finished.
+
+  bool registered;
+  struct davrods_session_t *prev;
+  struct davrods_session_t *next;
+};
+
+static struct {
+  server_rec *server;
+  apr_interval_time_t idle_timeout; // 0 if idle release is disabled.
+  apr_interval_time_t probe_after;
+  davrods_session_t *head;
+#if APR_HAS_THREADS
+  apr_thread_mutex_t *lock;
+#endif
+} sessions;
+
+static void sessions_lock(void) {
+#if APR_HAS_THREADS
+  if (sessions.lock)
+    apr_thread_mutex_lock(sessions.lock);
+#endif
+}
+
+static void sessions_unlock(void) {
+#if APR_HAS_THREADS
+  if (sessions.lock)
+    apr_thread_mutex_unlock(sessions.lock);
+#endif
+}
+
+/**
+ * \brief Give up the session's admission permit, and its slot in the
+ *        connection set of its HTTP/2 connection (if any).
+ */
+static void session_give_up_permit(davrods_session_t *session) {
+  davrods_admission_release(session->username);
+  if (session->multiplex)
+    davrods_multiplex_cancel(session->multiplex);
+}
+
+/**
+ * \brief Session cleanup function.
+ *
+ * Runs when the session's davrods pool is cleared or destroyed. Rather than
+ * disconnecting, the connection is handed to the connection pool so that a
+ * later HTTP connection for the same user can skip the iRODS login.
+ *
+ * \param mem a pointer to a davrods_session_t struct.
+ */
+static apr_status_t session_cleanup(void *mem) {
+  davrods_session_t *session = (davrods_session_t *)mem;
+
+  sessions_lock();
+  if (session->registered) {
+    if (session->prev)
+      session->prev->next = session->next;
+    else
+      sessions.head = session->next;
+    if (session->next)
+      session->next->prev = session->prev;
+    session->registered = false;
+  }
+  rcComm_t *rods_conn = session->rods_conn;
+  bool admitted = session->admitted;
+  session->rods_conn = NULL;
+  session->admitted = false;
+  sessions_unlock();
+
+  WHISPER("Releasing iRODS connection at %p\n", rods_conn);
+
+  if (admitted)
+    session_give_up_permit(session);
+
+  if (!rods_conn)
+    return APR_SUCCESS;
+
+  // Connections with an active session ticket carry extra permissions (or
+  // restrictions) that were not part of the login, so they may only be
+  // handed to sessions that want to use the same ticket.
+  const char *active_ticket = NULL;
+  apr_pool_userdata_get((void **)&active_ticket, "active_ticket",
+                        session->davrods_pool);
+
+  if (active_ticket && active_ticket[0])
+    davrods_connpool_checkin_ticket(&session->key, session->username,
+                                    active_ticket, rods_conn);
+  else
+    davrods_connpool_checkin(&session->key, session->username, rods_conn);
+
+  WHISPER("iRODS connection RELEASED\n");
+  return APR_SUCCESS;
+}
+
+davrods_session_t *davrods_session_create(request_rec *r,
+                                          apr_pool_t *davrods_pool,
+                                          const davrods_connpool_key_t *key,
+                                          const char *username,
+                                          rcComm_t *rods_conn) {
+  davrods_session_t *session = apr_pcalloc(davrods_pool, sizeof(*session));
+  assert(session);
+  session->rods_conn = rods_conn;
+  session->admitted = true;
+  session->key = *key;
+  session->multiplex = davrods_multiplex_get(r->connection);
+  session->username = apr_pstrdup(davrods_pool, username);
+  session->davrods_pool = davrods_pool;
+  session->last_active = apr_time_now();
+
+  apr_pool_userdata_set(session, "session", apr_pool_cleanup_null,
+                        davrods_pool);
+  apr_pool_cleanup_register(davrods_pool, session, session_cleanup,
+                            apr_pool_cleanup_null);
+
+  if (sessions.idle_timeout) {
+    sessions_lock();
+    session->next = sessions.head;
+    if (sessions.head)
+      sessions.head->prev = session;
+    sessions.head = session;
+    session->registered = true;
+    sessions_unlock();
+  }
+
+  return session;
+}
+
+davrods_session_t *davrods_session_get(apr_pool_t *davrods_pool) {
+  davrods_session_t *session = NULL;
+  int status =
+      apr_pool_userdata_get((void **)&session, "session", davrods_pool);
+  return status ? NULL : session;
+}
+
+static apr_status_t session_request_done(void *mem) {
+  davrods_session_t *session = (davrods_session_t *)mem;
+
+  const char *active_ticket = NULL;
+  if (session->multiplex)
+    apr_pool_userdata_get((void **)&active_ticket, "active_ticket",
+                          session->davrods_pool);
+
+  rcComm_t *shared = NULL;
+
+  sessions_lock();
+  session->busy--;
+  session->last_active = apr_time_now();
+  // Let other streams of the client connection use our connection until
+  // this stream's next request.
+  if (session->multiplex && !session->busy && session->rods_conn &&
+      !(active_ticket && active_ticket[0])) {
+    shared = session->rods_conn;
+    session->rods_conn = NULL;
+    session->admitted = false;
+  }
+  sessions_unlock();
+
+  if (shared)
+    davrods_multiplex_checkin(session->multiplex, &session->key,
+                              session->username, shared);
+
+  return APR_SUCCESS;
+}
+
+/**
+ * \brief Log in again with the session's credentials.
+ *
+ * \return a new iRODS connection, or NULL on failure.
+ */
+static rcComm_t *session_reconnect(request_rec *r,
+                                   davrods_session_t *session) {
+  const char *password = NULL;
+  int status = apr_pool_userdata_get((void **)&password, "password",
+                                     session->davrods_pool);
+  assert(!status && password);
+
+  ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                "Reconnecting session of user '%s' to iRODS",
+                session->username);
+
+  davrods_login_t login;
+  davrods_login_from_request(&login, r);
+
+  bool proxy = davrods_auth_use_proxy(&login, session->username, password);
+  davrods_connpool_key_t key;
+  davrods_connpool_make_key(&login, session->username,
+                            proxy ? NULL : password, &key);
+
+  rcComm_t *rods_conn = davrods_connpool_checkout(r, &key);
+  if (!rods_conn &&
+      davrods_auth_connect(&login, session->username, password, proxy,
+                           &rods_conn, NULL) != AUTH_GRANTED)
+    return NULL;
+
+  session->key = key;
+
+  // Session tickets do not carry over to the new connection.
+  apr_pool_userdata_set("", "active_ticket", NULL, session->davrods_pool);
+
+  return rods_conn;
+}
+
+/**
+ * \brief Give a session without an iRODS connection a new one.
+ *
+ * \return the session's connection, or NULL if reconnecting failed.
+ */
+static rcComm_t *session_attach(request_rec *r, davrods_session_t *session) {
+  sessions_lock();
+  rcComm_t *current = session->rods_conn;
+  bool admitted = session->admitted;
+  sessions_unlock();
+
+  if (current)
+    return current;
+
+  // A session whose connection was released for idleness (or given to other
+  // HTTP/2 streams) gave up its permit. One that is replacing a broken
+  // connection still has it.
+  bool new_permit = false;
+  if (!admitted && session->multiplex) {
+    rcComm_t *shared =
+        davrods_multiplex_checkout(r, session->multiplex, &session->key);
+    if (shared) {
+      sessions_lock();
+      session->rods_conn = shared;
+      session->admitted = true;
+      sessions_unlock();
+
+      // Shared connections have no session ticket activated.
+      apr_pool_userdata_set("", "active_ticket", NULL, session->davrods_pool);
+      return shared;
+    }
+    // A slot was reserved for us, it is given up along with the permit.
+  }
+  if (!admitted) {
+    if (davrods_admission_acquire(r, session->username) != OK) {
+      if (session->multiplex)
+        davrods_multiplex_cancel(session->multiplex);
+      return NULL;
+    }
+    new_permit = true;
+  }
+
+  rcComm_t *rods_conn = session_reconnect(r, session);
+
+  sessions_lock();
+  current = session->rods_conn;
+  if (!current && rods_conn) {
+    session->rods_conn = rods_conn;
+    session->admitted = true;
+    new_permit = false;
+  }
+  // Don't hold on to a permit without a connection.
+  bool drop_permit = !session->rods_conn && session->admitted;
+  if (drop_permit)
+    session->admitted = false;
+  sessions_unlock();
+
+  if (new_permit)
+    session_give_up_permit(session);
+  if (drop_permit)
+    session_give_up_permit(session);
+
+  if (current && rods_conn) {
+    // A concurrent request of the same session reconnected first.
+    davrods_servers_disconnect(rods_conn);
+  }
+  return current ? current : rods_conn;
+}
+
+rcComm_t *davrods_session_acquire(request_rec *r, davrods_session_t *session) {
+  sessions_lock();
+  bool first = !session->busy++;
+  rcComm_t *rods_conn = session->rods_conn;
+  apr_time_t last_active = session->last_active;
+  sessions_unlock();
+
+  apr_pool_cleanup_register(r->pool, session, session_request_done,
+                            apr_pool_cleanup_null);
+
+  // A connection that has been idle for a while may have been timed out by
+  // iRODS or a firewall in the meantime. If no other request of this session
+  // is using it, it can still be replaced without anyone noticing.
+  if (rods_conn && first &&
+      apr_time_now() - last_active > sessions.probe_after) {
+    int status = davrods_servers_ping(rods_conn);
+    if (status < 0) {
+      ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                    "iRODS connection of session for user '%s' is broken: "
+                    "%d = %s",
+                    session->username, status, get_rods_error_msg(status));
+      davrods_stats_inc(DAVRODS_STAT_STALE_CONNECTION);
+
+      sessions_lock();
+      session->rods_conn = NULL;
+      sessions_unlock();
+      davrods_servers_disconnect(rods_conn);
+      return session_attach(r, session);
+    }
+  }
+
+  if (rods_conn)
+    return rods_conn;
+
+  // Streams give up their connection after every request, that is not
+  // worth counting.
+  if (!session->multiplex)
+    davrods_stats_inc(DAVRODS_STAT_SESSION_RESUMED);
+  return session_attach(r, session);
+}
+
+rcComm_t *davrods_session_swap_for_ticket(request_rec *r,
+                                         davrods_session_t *session,
+                                         const char *active_ticket,
+                                         const char *ticket, bool *activated) {
+  if (!davrods_connpool_keeps_tickets())
+    return NULL;
+
+  // Other requests (or resources) using the current connection may depend
+  // on its ticket, only swap it if we are its only user.
+  sessions_lock();
+  rcComm_t *current = session->rods_conn;
+  bool alone = session->busy == 1;
+  sessions_unlock();
+
+  if (!current || !alone)
+    return NULL;
+
+  rcComm_t *rods_conn =
+      davrods_connpool_checkout_ticket(r, &session->key, ticket);
+  *activated = rods_conn != NULL;
+
+  // Otherwise, keep the current ticket's connection for later, and set the
+  // new ticket on a pooled plain connection instead.
+  if (!rods_conn && active_ticket[0] && ticket[0])
+    rods_conn = davrods_connpool_checkout_ticket(r, &session->key, "");
+
+  if (!rods_conn)
+    return NULL;
+
+  sessions_lock();
+  session->rods_conn = rods_conn;
+  sessions_unlock();
+
+  davrods_connpool_checkin_ticket(&session->key, session->username,
+                                  active_ticket, current);
+  return rods_conn;
+}
+
+static apr_status_t broken_conn_cleanup(void *mem) {
+  davrods_servers_disconnect((rcComm_t *)mem);
+  return APR_SUCCESS;
+}
+
+rcComm_t *davrods_session_reconnect(request_rec *r, davrods_session_t *session,
+                                    rcComm_t *broken) {
+  sessions_lock();
+  bool detached = session->rods_conn == broken;
+  if (detached)
+    session->rods_conn = NULL;
+  sessions_unlock();
+
+  // Other resources of this request may still refer to the broken
+  // connection, so it is closed only when the request is done. If it was
+  // already detached, another resource has taken care of that.
+  if (detached) {
+    request_rec *main_req = r;
+    while (main_req->main)
+      main_req = main_req->main;
+    apr_pool_cleanup_register(main_req->pool, broken, broken_conn_cleanup,
+                              apr_pool_cleanup_null);
+  }
+
+  return session_attach(r, session);
+}
+
+void davrods_session_release_idle(void) {
+  if (!sessions.idle_timeout)
+    return;
+
+  apr_time_t now = apr_time_now();
+
+  for (;;) {
+    rcComm_t *rods_conn = NULL;
+    bool admitted = false;
+    char username[NAME_LEN];
+
+    sessions_lock();
+    for (davrods_session_t *session = sessions.head; session;
+         session = session->next) {
+      if (session->rods_conn && !session->busy &&
+          now - session->last_active > sessions.idle_timeout) {
+        rods_conn = session->rods_conn;
+        admitted = session->admitted;
+        apr_cpystrn(username, session->username, sizeof(username));
+        session->rods_conn = NULL;
+        session->admitted = false;
+        // The session may be gone as soon as we let go of the lock.
+        if (admitted && session->multiplex)
+          davrods_multiplex_cancel(session->multiplex);
+        break;
+      }
+    }
+    sessions_unlock();
+
+    if (!rods_conn)
+      break;
+
+    if (admitted)
+      davrods_admission_release(username);
+
+    // Disconnect outside of the lock, this involves network traffic.
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, sessions.server,
+                 "Closing iRODS connection of idle session for user '%s'",
+                 username);
+    davrods_servers_disconnect(rods_conn);
+    davrods_stats_inc(DAVRODS_STAT_SESSION_RELEASED);
+  }
+}
+
+static void session_child_init(apr_pool_t *p, server_rec *s) {
+  sessions.server = s;
+  sessions.head = NULL;
+  sessions.idle_timeout = 0;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(s->module_config, &davrods_module);
+  assert(conf);
+
+  sessions.probe_after =
+      apr_time_from_sec(DAVRODS_SERVER_CONF(conf, conn_probe_after));
+
+#if APR_HAS_THREADS
+  // Idle sessions are released by the background thread in prewarm.c.
+  int idle_timeout = DAVRODS_SERVER_CONF(conf, session_idle_timeout);
+  if (!idle_timeout)
+    return;
+
+  apr_status_t status =
+      apr_thread_mutex_create(&sessions.lock, APR_THREAD_MUTEX_DEFAULT, p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not create session registry mutex, idle iRODS "
+                 "connections will not be released");
+    return;
+  }
+
+  sessions.idle_timeout = apr_time_from_sec(idle_timeout);
+#endif
+}
+
+void davrods_session_register(apr_pool_t *p) {
+  ap_hook_child_init(session_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,133 @@
+/**
+ * \file
+ * \brief     iRODS connections owned by HTTP sessions.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_SESSION_H
+#define _DAVRODS_SESSION_H
+
+#include "connpool.h"
+#include "mod_davrods.h"
+
+#include <irods/rodsClient.h>
+
+/**
+ * \brief An authenticated Davrods session, bound to a client's TCP
+ *        connection.
+ *
+ * A session owns an iRODS connection. When idle release is enabled
+ * (DavrodsSessionIdleTimeout), the iRODS connection of a session that has
+ * been idle for a while is closed, while the session itself, and therefore
+ * the client's login, stays intact. The next request of the session then
+ * reconnects transparently.
+ */
+typedef struct davrods_session_t davrods_session_t;
+
+/**
+ * \brief Create a session for a newly authenticated iRODS connection.
+ *
+ * The session is stored as userdata in the davrods pool, and takes
+ * ownership of the connection, as well as of the admission permit the
+ * caller obtained for it (see admission.h). When the davrods pool is
+ * cleared or destroyed, the connection is handed to the connection pool.
+ *
+ * \param r            the request that authenticated the session
+ * \param davrods_pool the session's davrods pool
+ * \param key          the connection pool key the connection was set up for
+ * \param username
+ * \param rods_conn
+ */
+davrods_session_t *davrods_session_create(request_rec *r,
+                                          apr_pool_t *davrods_pool,
+                                          const davrods_connpool_key_t *key,
+                                          const char *username,
+                                          rcComm_t *rods_conn);
+
+/**
+ * \brief Get the session stored in a davrods pool.
+ *
+ * \return a session, or NULL if the pool has no authenticated session yet.
+ */
+davrods_session_t *davrods_session_get(apr_pool_t *davrods_pool);
+
+/**
+ * \brief Get the session's iRODS connection for use by a request.
+ *
+ * The connection will not be released for idleness while r is active. If it
+ * was released before, or it turns out to be broken after a period of
+ * inactivity (DavrodsConnectionProbeAfter), a new connection is set up with
+ * the session's credentials.
+ *
+ * \return an iRODS connection, or NULL if reconnecting failed or was not
+ *         admitted (see davrods_admission_refused()).
+ */
+rcComm_t *davrods_session_acquire(request_rec *r, davrods_session_t *session);
+
+/**
+ * \brief Replace a session's broken iRODS connection.
+ *
+ * Used to retry idempotent operations that failed because the connection
+ * was lost. The broken connection is closed when the request is done, as
+ * other resources of the request may still refer to it.
+ *
+ * \param r
+ * \param session
+ * \param broken  the connection that failed
+ *
+ * \return the session's new iRODS connection, or NULL if reconnecting failed.
+ */
+rcComm_t *davrods_session_reconnect(request_rec *r, davrods_session_t *session,
+                                    rcComm_t *broken);
+
+/**
+ * \brief Swap the session's iRODS connection for a pooled one, to switch
+ *        session tickets.
+ *
+ * Preferably, the new connection already has the wanted ticket activated.
+ * Otherwise, a plain pooled connection is used, so that the current
+ * connection keeps its ticket for later requests. The current connection
+ * is handed to the connection pool.
+ *
+ * Nothing is swapped if another request is using the session's connection.
+ *
+ * \param      r
+ * \param      session
+ * \param      active_ticket the ticket active on the current connection, or ""
+ * \param      ticket        the wanted ticket, or "" for none
+ * \param[out] activated     whether the new connection has ticket activated
+ *
+ * \return the session's new iRODS connection, or NULL if nothing was swapped.
+ */
+rcComm_t *davrods_session_swap_for_ticket(request_rec *r,
+                                         davrods_session_t *session,
+                                         const char *active_ticket,
+                                         const char *ticket, bool *activated);
+
+/**
+ * \brief Close the iRODS connections of sessions that have been idle for
+ *        longer than DavrodsSessionIdleTimeout.
+ *
+ * This involves network traffic, and is meant to be called from a background
+ * thread (see prewarm.c).
+ */
+void davrods_session_release_idle(void);
+
+void davrods_session_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_SESSION_H */
@@ -0,0 +1,381 @@
+/**
+ * \file
+ * \brief     Coalescing of concurrent identical iRODS lookups.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "singleflight.h"
+#include "pagedlist.h"
+#include "stats.h"
+
+#include <ap_mpm.h>
+#include <apr_hash.h>
+#include <apr_strings.h>
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* When many users open a popular shared collection at once, the threads of a
+ * child process all stat and list the same paths at the same moment. Instead
+ * of sending each of these lookups to the catalog, the first thread makes the
+ * iRODS call (the "flight"), and threads that want the same result, with the
+ * same user, ticket and server, wait for it to land and take a copy.
+ *
+ * A flight lives on the stack of the thread that makes the call. That thread
+ * waits until every follower has copied the result before it returns, so
+ * that the result, allocated from its request pool, stays valid for as long
+ * as it is needed.
+ *
+ * Only successful results, and "does not exist", are shared. After any other
+ * error, followers repeat the call on their own connection. A modification
+ * through Davrods removes the flights of affected paths, so that lookups
+ * which start after it do not take a result from before it.
+ */
+
+typedef struct {
+  const char *path;
+  bool done;
+  int waiters; // Followers that have yet to copy the result.
+  int status;
+  const rodsObjStat_t *stat;         // For stat lookups.
+  const apr_array_header_t *entries; // For listings.
+} flight_t;
+
+static struct {
+  apr_hash_t *flights; // Key -> flight_t. NULL if lookups are not coalesced.
+#if APR_HAS_THREADS
+  apr_thread_mutex_t *lock;
+  apr_thread_cond_t *changed; // A flight landed, or a follower left one.
+#endif
+} sf;
+
+static void flight_lock(void) {
+#if APR_HAS_THREADS
+  apr_thread_mutex_lock(sf.lock);
+#endif
+}
+
+static void flight_unlock(void) {
+#if APR_HAS_THREADS
+  apr_thread_mutex_unlock(sf.lock);
+#endif
+}
+
+static void flight_wait(void) {
+#if APR_HAS_THREADS
+  apr_thread_cond_wait(sf.changed, sf.lock);
+#endif
+}
+
+static void flight_broadcast(void) {
+#if APR_HAS_THREADS
+  apr_thread_cond_broadcast(sf.changed);
+#endif
+}
+
+static bool coalescing(const dav_resource *resource) {
+  return sf.flights && DAVRODS_CONF(resource->info->conf, coalesce_lookups) ==
+                           DAVRODS_COALESCE_LOOKUPS_ON;
+}
+
+static bool is_below(const char *path, const char *coll, size_t coll_len) {
+  return !strncmp(path, coll, coll_len) &&
+         (path[coll_len] == '\0' || path[coll_len] == '/');
+}
+
+/**
+ * \brief Compute the key of a lookup of the resource's rods_path with the
+ *        session's identity.
+ */
+static const char *flight_key(const dav_resource *resource, const char *kind) {
+  const dav_resource_private *res_private = resource->info;
+  const davrods_dir_conf_t *conf = res_private->conf;
+
+  const char *username = NULL;
+  const char *ticket = NULL;
+  apr_pool_userdata_get((void **)&username, "username",
+                        res_private->davrods_pool);
+  apr_pool_userdata_get((void **)&ticket, "active_ticket",
+                        res_private->davrods_pool);
+
+  return apr_pstrcat(
+      resource->pool, DAVRODS_CONF(conf, rods_host), "\n",
+      apr_itoa(resource->pool, DAVRODS_CONF(conf, rods_port)), "\n",
+      DAVRODS_CONF(conf, rods_zone), "\n", username ? username : "", "\n",
+      ticket ? ticket : "", "\n", kind, "\n", res_private->rods_path, NULL);
+}
+
+/**
+ * \brief Join the in-flight lookup with the given key, or start one.
+ *
+ * \return the joined flight, once it has landed, or NULL if the caller is to
+ *         make the lookup and land its own flight
+ */
+static flight_t *flight_join(const char *key, flight_t *own,
+                             const char *path) {
+  flight_lock();
+
+  flight_t *flight = apr_hash_get(sf.flights, key, APR_HASH_KEY_STRING);
+  if (flight) {
+    ++flight->waiters;
+    while (!flight->done)
+      flight_wait();
+    flight_unlock();
+    return flight;
+  }
+
+  own->path = path;
+  apr_hash_set(sf.flights, key, APR_HASH_KEY_STRING, own);
+
+  flight_unlock();
+  return NULL;
+}
+
+/**
+ * \brief Signal that a follower is done with the result of a flight.
+ */
+static void flight_leave(flight_t *flight) {
+  flight_lock();
+  --flight->waiters;
+  flight_broadcast();
+  flight_unlock();
+}
+
+/**
+ * \brief Publish the result of a flight, and wait for all followers to take
+ *        it.
+ */
+static void flight_land(const char *key, flight_t *own) {
+  flight_lock();
+
+  // The flight may have been removed already by a modification.
+  if (apr_hash_get(sf.flights, key, APR_HASH_KEY_STRING) == own)
+    apr_hash_set(sf.flights, key, APR_HASH_KEY_STRING, NULL);
+
+  own->done = true;
+  flight_broadcast();
+  while (own->waiters)
+    flight_wait();
+
+  flight_unlock();
+}
+
+static int stat_lookup(const dav_resource *resource, rodsObjStat_t **stat) {
+  dataObjInp_t obj_in = {{0}};
+  strcpy(obj_in.objPath, resource->info->rods_path);
+
+  int status = rcObjStat(resource->info->rods_conn, &obj_in, stat);
+  if (status < 0 && davrods_retry_on_broken_connection(resource, status))
+    status = rcObjStat(resource->info->rods_conn, &obj_in, stat);
+  return status;
+}
+
+int davrods_singleflight_stat(const dav_resource *resource,
+                              rodsObjStat_t **stat) {
+  if (!coalescing(resource))
+    return stat_lookup(resource, stat);
+
+  const char *key = flight_key(resource, "stat");
+  flight_t own = {0};
+  flight_t *flight = flight_join(key, &own, resource->info->rods_path);
+
+  if (!flight) {
+    own.status = stat_lookup(resource, stat);
+    own.stat = own.status >= 0 ? *stat : NULL;
+    flight_land(key, &own);
+    return own.status;
+  }
+
+  // Special collections carry data that rcObjStat() allocated separately,
+  // which cannot be shared.
+  int status = flight->status;
+  bool shared = (status >= 0 && !flight->stat->specColl) ||
+                status == USER_FILE_DOES_NOT_EXIST;
+
+  if (shared && status >= 0) {
+    // Allocated like rcObjStat() results, to be freed the same way.
+    *stat = malloc(sizeof(rodsObjStat_t));
+    if (*stat)
+      **stat = *flight->stat;
+    else
+      shared = false;
+  }
+
+  flight_leave(flight);
+
+  if (!shared)
+    return stat_lookup(resource, stat);
+
+  WHISPER("Took stat of <%s> from a concurrent lookup\n",
+          resource->info->rods_path);
+  davrods_stats_inc(DAVRODS_STAT_LOOKUP_COALESCED);
+  return status;
+}
+
+/**
+ * \brief Copy the parts of a collection entry that Davrods uses.
+ */
+static collEnt_t copy_entry(apr_pool_t *pool, const collEnt_t *entry) {
+  collEnt_t copy = {0};
+  copy.objType = entry->objType;
+  copy.dataSize = entry->dataSize;
+  copy.collName = apr_pstrdup(pool, entry->collName);
+  copy.dataName = apr_pstrdup(pool, entry->dataName);
+  copy.createTime = apr_pstrdup(pool, entry->createTime);
+  copy.modifyTime = apr_pstrdup(pool, entry->modifyTime);
+  copy.ownerName = apr_pstrdup(pool, entry->ownerName);
+  return copy;
+}
+
+static int list_lookup(const dav_resource *resource, int flags,
+                       apr_array_header_t **entries) {
+  if (davrods_pagedlist_enabled(resource))
+    return davrods_pagedlist_read(resource, entries);
+
+  dav_resource_private *res_private = resource->info;
+  collHandle_t coll_handle = {0};
+
+  int status = rclOpenCollection(res_private->rods_conn,
+                                 res_private->rods_path, flags, &coll_handle);
+  if (status < 0 && davrods_retry_on_broken_connection(resource, status))
+    status = rclOpenCollection(res_private->rods_conn, res_private->rods_path,
+                               flags, &coll_handle);
+  if (status < 0)
+    return status;
+
+  apr_array_header_t *result =
+      apr_array_make(resource->pool, 16, sizeof(collEnt_t));
+  collEnt_t coll_entry;
+
+  while ((status = rclReadCollection(res_private->rods_conn, &coll_handle,
+                                     &coll_entry)) >= 0)
+    APR_ARRAY_PUSH(result, collEnt_t) = copy_entry(resource->pool, &coll_entry);
+
+  rclCloseCollection(&coll_handle);
+
+  if (status != CAT_NO_ROWS_FOUND) {
+    ap_log_rerror(APLOG_MARK, APLOG_ERR, APR_SUCCESS, res_private->r,
+                  "rcReadCollection failed for collection <%s> with error <%s>",
+                  res_private->rods_path, get_rods_error_msg(status));
+    return status;
+  }
+
+  *entries = result;
+  return 0;
+}
+
+int davrods_singleflight_list(const dav_resource *resource, int flags,
+                              apr_array_header_t **entries) {
+  *entries = NULL;
+  if (!coalescing(resource))
+    return 0;
+
+  const char *key =
+      flight_key(resource, apr_psprintf(resource->pool, "list %d", flags));
+  flight_t own = {0};
+  flight_t *flight = flight_join(key, &own, resource->info->rods_path);
+
+  if (!flight) {
+    own.status = list_lookup(resource, flags, entries);
+    own.entries = *entries;
+    flight_land(key, &own);
+    return own.status;
+  }
+
+  if (flight->status >= 0) {
+    const apr_array_header_t *shared = flight->entries;
+    *entries = apr_array_make(resource->pool, shared->nelts, sizeof(collEnt_t));
+    for (int i = 0; i < shared->nelts; ++i)
+      APR_ARRAY_PUSH(*entries, collEnt_t) =
+          copy_entry(resource->pool, &APR_ARRAY_IDX(shared, i, collEnt_t));
+  }
+
+  flight_leave(flight);
+
+  if (!*entries)
+    return list_lookup(resource, flags, entries);
+
+  WHISPER("Took listing of <%s> from a concurrent lookup\n",
+          resource->info->rods_path);
+  davrods_stats_inc(DAVRODS_STAT_LOOKUP_COALESCED);
+  return 0;
+}
+
+void davrods_singleflight_invalidate(const dav_resource *resource,
+                                     const char *path) {
+  if (!sf.flights)
+    return;
+
+  size_t len = strlen(path);
+  const char *slash = strrchr(path, '/');
+  size_t parent_len = !slash ? 0 : slash == path ? 1 : slash - path;
+
+  flight_lock();
+  for (apr_hash_index_t *hi = apr_hash_first(NULL, sf.flights); hi;
+       hi = apr_hash_next(hi)) {
+    const void *key = NULL;
+    void *val = NULL;
+    apr_hash_this(hi, &key, NULL, &val);
+
+    const flight_t *flight = val;
+    if (is_below(flight->path, path, len) ||
+        (parent_len && strlen(flight->path) == parent_len &&
+         !strncmp(flight->path, path, parent_len)))
+      apr_hash_set(sf.flights, key, APR_HASH_KEY_STRING, NULL);
+  }
+  flight_unlock();
+}
+
+static apr_status_t singleflight_cleanup(void *data) {
+  flight_lock();
+  sf.flights = NULL;
+  flight_unlock();
+  return APR_SUCCESS;
+}
+
+static void singleflight_child_init(apr_pool_t *p, server_rec *s) {
+#if APR_HAS_THREADS
+  // Without threads, a process handles one request at a time, and there is
+  // nothing to coalesce.
+  int threaded = AP_MPMQ_NOT_SUPPORTED;
+  if (ap_mpm_query(AP_MPMQ_IS_THREADED, &threaded) != APR_SUCCESS ||
+      threaded == AP_MPMQ_NOT_SUPPORTED)
+    return;
+
+  apr_status_t status =
+      apr_thread_mutex_create(&sf.lock, APR_THREAD_MUTEX_DEFAULT, p);
+  if (status == APR_SUCCESS)
+    status = apr_thread_cond_create(&sf.changed, p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not create lookup coalescing mutex, concurrent "
+                 "lookups will not be coalesced");
+    return;
+  }
+
+  sf.flights = apr_hash_make(p);
+
+  apr_pool_cleanup_register(p, NULL, singleflight_cleanup,
+                            apr_pool_cleanup_null);
+#endif
+}
+
+void davrods_singleflight_register(apr_pool_t *p) {
+  ap_hook_child_init(singleflight_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,66 @@
+/**
+ * \file
+ * \brief     Coalescing of concurrent identical iRODS lookups.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_SINGLEFLIGHT_H
+#define _DAVRODS_SINGLEFLIGHT_H
+
+#include "repo.h"
+
+/**
+ * \brief Stat the resource's rods_path, sharing the rcObjStat() call with
+ *        identical lookups that other threads of this process are making
+ *        (DavrodsCoalesceLookups).
+ *
+ * \param[in]  resource
+ * \param[out] stat     the result, to be freed with freeRodsObjStat()
+ *
+ * \return an iRODS status code, as returned by rcObjStat()
+ */
+int davrods_singleflight_stat(const dav_resource *resource,
+                              rodsObjStat_t **stat);
+
+/**
+ * \brief Read all entries of the collection at the resource's rods_path,
+ *        sharing the catalog queries with identical concurrent listings.
+ *
+ * \param[in]  resource
+ * \param[in]  flags    flags for rclOpenCollection()
+ * \param[out] entries  an array of collEnt_t allocated from the resource's
+ *                      pool, or NULL if lookups are not coalesced, and the
+ *                      caller should read the collection itself, with
+ *                      rclOpenCollection() or page by page (see
+ *                      pagedlist.h)
+ *
+ * \return an iRODS status code
+ */
+int davrods_singleflight_list(const dav_resource *resource, int flags,
+                              apr_array_header_t **entries);
+
+/**
+ * \brief Stop sharing in-flight lookups of path, its parent collection and
+ *        everything below it, as their results may predate a modification.
+ */
+void davrods_singleflight_invalidate(const dav_resource *resource,
+                                     const char *path);
+
+void davrods_singleflight_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_SINGLEFLIGHT_H */
@@ -0,0 +1,149 @@
+/**
+ * \file
+ * \brief     Socket options for iRODS connections.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "socket.h"
+#include "config.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* Default socket buffers are sized for a local network. Across datacenters,
+ * a round trip of a few milliseconds limits every rcDataObjRead() and
+ * rcDataObjWrite() to one window per round trip, unless the buffers hold
+ * the bandwidth-delay product.
+ *
+ * With DavrodsSocketBuffers Auto, the buffers are sized from the round trip
+ * time that the kernel measured while rcConnect() set up the connection,
+ * before the login, and the configured link bandwidth. Note that on Linux,
+ * setting a buffer size turns off the kernel's automatic tuning of that
+ * buffer.
+ */
+
+/// Bounds for automatically sized socket buffers.
+#define SOCKET_BUFFER_MIN (64 * 1024)
+#define SOCKET_BUFFER_MAX (64 * 1024 * 1024)
+
+/**
+ * \brief Get the smoothed round trip time of a connected TCP socket.
+ *
+ * \return the round trip time in microseconds, or 0 if unknown
+ */
+static apr_uint32_t socket_rtt(int sock) {
+#ifdef TCP_INFO
+  struct tcp_info info;
+  socklen_t len = sizeof(info);
+  if (!getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &len))
+    return info.tcpi_rtt;
+#endif
+  return 0;
+}
+
+static void socket_set(const davrods_login_t *login, int sock, int level,
+                       int option, const char *name, int value) {
+  if (setsockopt(sock, level, option, &value, sizeof(value)))
+    ap_log_error(APLOG_MARK, APLOG_WARNING, APR_FROM_OS_ERROR(errno),
+                 login->server, "Could not set %s to %d on iRODS connection",
+                 name, value);
+}
+
+void davrods_socket_tune(const davrods_login_t *login, rcComm_t *rods_conn) {
+  const davrods_dir_conf_t *conf = login->conf;
+
+  int sock = rods_conn->sock;
+  if (sock < 0)
+    return;
+
+  if (DAVRODS_CONF(conf, socket_nodelay) == DAVRODS_SOCKET_NODELAY_ON)
+    socket_set(login, sock, IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY", 1);
+
+  int idle = DAVRODS_CONF(conf, socket_keepalive_idle);
+  if (idle > 0) {
+    socket_set(login, sock, SOL_SOCKET, SO_KEEPALIVE, "SO_KEEPALIVE", 1);
+#ifdef TCP_KEEPIDLE
+    int interval = DAVRODS_CONF(conf, socket_keepalive_interval);
+    int count = DAVRODS_CONF(conf, socket_keepalive_count);
+    socket_set(login, sock, IPPROTO_TCP, TCP_KEEPIDLE, "TCP_KEEPIDLE", idle);
+    if (interval > 0)
+      socket_set(login, sock, IPPROTO_TCP, TCP_KEEPINTVL, "TCP_KEEPINTVL",
+                 interval);
+    if (count > 0)
+      socket_set(login, sock, IPPROTO_TCP, TCP_KEEPCNT, "TCP_KEEPCNT", count);
+#endif
+  }
+
+  int sndbuf = 0;
+  int rcvbuf = 0;
+
+  switch (DAVRODS_CONF(conf, socket_buffers)) {
+  case DAVRODS_SOCKET_BUFFERS_FIXED:
+    sndbuf = DAVRODS_CONF(conf, socket_sndbuf);
+    rcvbuf = DAVRODS_CONF(conf, socket_rcvbuf);
+    break;
+
+  case DAVRODS_SOCKET_BUFFERS_AUTO: {
+    apr_uint32_t rtt = socket_rtt(sock);
+    if (!rtt) {
+      ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                   "Round trip time of iRODS connection unknown, keeping "
+                   "default socket buffers");
+      break;
+    }
+    // Mbit/s * us / 8 = bytes in flight.
+    apr_uint64_t bdp =
+        (apr_uint64_t)DAVRODS_CONF(conf, socket_bandwidth) * rtt / 8;
+    if (bdp < SOCKET_BUFFER_MIN)
+      bdp = SOCKET_BUFFER_MIN;
+    if (bdp > SOCKET_BUFFER_MAX)
+      bdp = SOCKET_BUFFER_MAX;
+    sndbuf = rcvbuf = (int)bdp;
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+                 "Round trip time of iRODS connection is %u us, using %d "
+                 "byte socket buffers",
+                 rtt, sndbuf);
+    break;
+  }
+
+  default:
+    break;
+  }
+
+  if (sndbuf > 0)
+    socket_set(login, sock, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", sndbuf);
+  if (rcvbuf > 0)
+    socket_set(login, sock, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", rcvbuf);
+}
+
+const char *davrods_socket_settings(const davrods_login_t *login) {
+  const davrods_dir_conf_t *conf = login->conf;
+
+  return apr_psprintf(login->pool, "%d %d %d %d %d %d %d %d",
+                      DAVRODS_CONF(conf, socket_buffers),
+                      DAVRODS_CONF(conf, socket_sndbuf),
+                      DAVRODS_CONF(conf, socket_rcvbuf),
+                      DAVRODS_CONF(conf, socket_bandwidth),
+                      DAVRODS_CONF(conf, socket_nodelay),
+                      DAVRODS_CONF(conf, socket_keepalive_idle),
+                      DAVRODS_CONF(conf, socket_keepalive_interval),
+                      DAVRODS_CONF(conf, socket_keepalive_count));
+}
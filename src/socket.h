@@ -0,0 +1,47 @@
+/**
+ * \file
+ * \brief     Socket options for iRODS connections.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_SOCKET_H
+#define _DAVRODS_SOCKET_H
+
+#include "config.h"
+#include "mod_davrods.h"
+
+#include <irods/rodsClient.h>
+
+/**
+ * \brief Apply the socket options of the login's location to a new iRODS
+ *        connection.
+ *
+ * Called right after connecting. Options that cannot be set are logged and
+ * otherwise ignored.
+ */
+void davrods_socket_tune(const davrods_login_t *login, rcComm_t *rods_conn);
+
+/**
+ * \brief Describe the socket options of the login's location.
+ *
+ * Pooled connections keep the options they were opened with, so this is part
+ * of the connection pool key.
+ */
+const char *davrods_socket_settings(const davrods_login_t *login);
+
+#endif /* _DAVRODS_SOCKET_H */
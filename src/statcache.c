@@ -0,0 +1,361 @@
+/**
+ * \file
+ * \brief     Stat results shared between child processes.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "statcache.h"
+#include "config.h"
+#include "stats.h"
+
+#include <ap_provider.h>
+#include <ap_socache.h>
+#include <apr_atomic.h>
+#include <apr_general.h>
+#include <apr_global_mutex.h>
+#include <apr_hash.h>
+#include <apr_sha1.h>
+#include <apr_shm.h>
+#include <util_mutex.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* Requests of one user are spread over all child processes, and each child
+ * would otherwise stat the paths that others just looked up. This cache
+ * shares stat results through mod_socache.
+ *
+ * Cached entries cannot be enumerated, so they are invalidated through
+ * epochs instead: counters in shared memory, indexed by a hash of a path.
+ * Modifying a path bumps its "tree" counter, which covers the path and
+ * everything below it, and the "node" counter of its parent collection,
+ * which covers that collection only. An entry records the sum of its node
+ * counter and the tree counters of the path and all its ancestors, and is
+ * current only while that sum is unchanged. Counters only grow, so any
+ * relevant modification changes the sum. Hash collisions merely cause an
+ * unnecessary cache miss.
+ */
+
+#define STATCACHE_MUTEX_TYPE "davrods-statcache"
+
+/// Counters per kind (tree or node). Must be a power of two.
+#define STATCACHE_EPOCHS 8192
+
+typedef struct {
+  apr_uint32_t epoch;
+  int type; // objType_t, or 0 if the path does not exist.
+  rodsLong_t size;
+  char create_time[TIME_LEN];
+  char modify_time[TIME_LEN];
+  char checksum[NAME_LEN];
+} statcache_entry_t;
+
+static struct {
+  const ap_socache_provider_t *provider;
+  ap_socache_instance_t *instance;
+  apr_global_mutex_t *lock; // Only for providers that are not MP-safe.
+  unsigned char salt[16];
+  volatile apr_uint32_t *tree; // Both in anonymous shared memory.
+  volatile apr_uint32_t *node;
+} statcache;
+
+static apr_uint32_t epoch_index(const char *path, apr_ssize_t len) {
+  return apr_hashfunc_default(path, &len) & (STATCACHE_EPOCHS - 1);
+}
+
+apr_uint32_t davrods_statcache_epoch(const char *path) {
+  if (!statcache.instance)
+    return 0;
+
+  apr_ssize_t len = strlen(path);
+  apr_uint32_t epoch =
+      apr_atomic_read32(&statcache.node[epoch_index(path, len)]);
+
+  // The path itself and every ancestor collection, except for the root.
+  for (apr_ssize_t i = 1; i <= len; ++i) {
+    if (i == len || path[i] == '/')
+      epoch += apr_atomic_read32(&statcache.tree[epoch_index(path, i)]);
+  }
+  return epoch;
+}
+
+void davrods_statcache_invalidate(const char *path) {
+  if (!statcache.instance)
+    return;
+
+  apr_ssize_t len = strlen(path);
+  apr_atomic_inc32(&statcache.tree[epoch_index(path, len)]);
+
+  const char *slash = strrchr(path, '/');
+  if (slash)
+    apr_atomic_inc32(
+        &statcache.node[epoch_index(path, slash == path ? 1 : slash - path)]);
+}
+
+static void statcache_lock(request_rec *r) {
+  if (statcache.lock) {
+    apr_status_t status = apr_global_mutex_lock(statcache.lock);
+    if (status != APR_SUCCESS)
+      ap_log_rerror(APLOG_MARK, APLOG_ERR, status, r,
+                    "Could not lock the stat cache mutex");
+  }
+}
+
+static void statcache_unlock(request_rec *r) {
+  if (statcache.lock) {
+    apr_status_t status = apr_global_mutex_unlock(statcache.lock);
+    if (status != APR_SUCCESS)
+      ap_log_rerror(APLOG_MARK, APLOG_ERR, status, r,
+                    "Could not unlock the stat cache mutex");
+  }
+}
+
+static void key_add_field(apr_sha1_ctx_t *ctx, const char *field) {
+  // Include the NUL terminator so that field boundaries are part of the key.
+  apr_sha1_update_binary(ctx, (const unsigned char *)field, strlen(field) + 1);
+}
+
+/**
+ * \brief Compute the cache key of path for the session's user, zone and
+ *        ticket.
+ */
+static void make_key(request_rec *r, apr_pool_t *davrods_pool,
+                     const char *path,
+                     unsigned char key[APR_SHA1_DIGESTSIZE]) {
+  davrods_dir_conf_t *conf =
+      ap_get_module_config(r->per_dir_config, &davrods_module);
+  assert(conf);
+
+  const char *username = NULL;
+  const char *ticket = NULL;
+  apr_pool_userdata_get((void **)&username, "username", davrods_pool);
+  apr_pool_userdata_get((void **)&ticket, "active_ticket", davrods_pool);
+
+  apr_sha1_ctx_t ctx;
+  apr_sha1_init(&ctx);
+  apr_sha1_update_binary(&ctx, statcache.salt, sizeof(statcache.salt));
+  key_add_field(&ctx, DAVRODS_CONF(conf, rods_host));
+  key_add_field(&ctx, apr_itoa(r->pool, DAVRODS_CONF(conf, rods_port)));
+  key_add_field(&ctx, DAVRODS_CONF(conf, rods_zone));
+  key_add_field(&ctx, username ? username : "");
+  key_add_field(&ctx, ticket ? ticket : "");
+  key_add_field(&ctx, path);
+  apr_sha1_final(key, &ctx);
+}
+
+bool davrods_statcache_get(request_rec *r, apr_pool_t *davrods_pool,
+                           const char *path, rodsObjStat_t **stat) {
+  if (!statcache.instance)
+    return false;
+
+  unsigned char key[APR_SHA1_DIGESTSIZE];
+  make_key(r, davrods_pool, path, key);
+
+  statcache_entry_t entry;
+  unsigned int entry_len = sizeof(entry);
+
+  statcache_lock(r);
+  apr_status_t status = statcache.provider->retrieve(
+      statcache.instance, r->server, key, sizeof(key),
+      (unsigned char *)&entry, &entry_len, r->pool);
+  statcache_unlock(r);
+
+  if (status != APR_SUCCESS || entry_len != sizeof(entry) ||
+      entry.epoch != davrods_statcache_epoch(path)) {
+    davrods_stats_inc(DAVRODS_STAT_STAT_CACHE_MISS);
+    return false;
+  }
+
+  davrods_stats_inc(DAVRODS_STAT_STAT_CACHE_HIT);
+
+  if (!entry.type) {
+    *stat = NULL;
+    return true;
+  }
+
+  *stat = apr_pcalloc(r->pool, sizeof(rodsObjStat_t));
+  (*stat)->objType = entry.type;
+  (*stat)->objSize = entry.size;
+  memcpy((*stat)->createTime, entry.create_time, TIME_LEN);
+  memcpy((*stat)->modifyTime, entry.modify_time, TIME_LEN);
+  memcpy((*stat)->chksum, entry.checksum, NAME_LEN);
+  return true;
+}
+
+void davrods_statcache_put(request_rec *r, apr_pool_t *davrods_pool,
+                           const char *path, apr_uint32_t epoch,
+                           const rodsObjStat_t *stat) {
+  if (!statcache.instance || (stat && stat->specColl))
+    return;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(r->server->module_config, &davrods_module);
+  assert(conf);
+
+  statcache_entry_t entry = {.epoch = epoch};
+  if (stat) {
+    entry.type = stat->objType;
+    entry.size = stat->objSize;
+    memcpy(entry.create_time, stat->createTime, TIME_LEN);
+    memcpy(entry.modify_time, stat->modifyTime, TIME_LEN);
+    memcpy(entry.checksum, stat->chksum, NAME_LEN);
+  }
+
+  unsigned char key[APR_SHA1_DIGESTSIZE];
+  make_key(r, davrods_pool, path, key);
+
+  apr_time_t expiry =
+      apr_time_now() +
+      apr_time_from_sec(DAVRODS_SERVER_CONF(conf, stat_cache_ttl));
+
+  statcache_lock(r);
+  apr_status_t status = statcache.provider->store(
+      statcache.instance, r->server, key, sizeof(key), expiry,
+      (unsigned char *)&entry, sizeof(entry), r->pool);
+  statcache_unlock(r);
+
+  if (status != APR_SUCCESS)
+    ap_log_rerror(APLOG_MARK, APLOG_DEBUG, status, r,
+                  "Could not cache stat result of <%s>", path);
+}
+
+static apr_status_t statcache_cleanup(void *data) {
+  server_rec *s = data;
+  if (statcache.instance)
+    statcache.provider->destroy(statcache.instance, s);
+  statcache.instance = NULL;
+  return APR_SUCCESS;
+}
+
+static int statcache_pre_config(apr_pool_t *pconf, apr_pool_t *plog,
+                                apr_pool_t *ptemp) {
+  apr_status_t status = ap_mutex_register(pconf, STATCACHE_MUTEX_TYPE, NULL,
+                                          APR_LOCK_DEFAULT, 0);
+  if (status != APR_SUCCESS) {
+    ap_log_perror(APLOG_MARK, APLOG_CRIT, status, plog,
+                  "Could not register the stat cache mutex type");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  return OK;
+}
+
+static int statcache_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+                                 apr_pool_t *ptemp, server_rec *s) {
+  statcache.provider = NULL;
+  statcache.instance = NULL;
+  statcache.lock = NULL;
+
+  davrods_server_conf_t *conf =
+      ap_get_module_config(s->module_config, &davrods_module);
+  assert(conf);
+
+  if (DAVRODS_SERVER_CONF(conf, stat_cache) != DAVRODS_STAT_CACHE_ON)
+    return OK;
+
+  // As with DavrodsAuthCache, e.g. "shmcb:/run/davrods-statcache(1024000)".
+  const char *spec = DAVRODS_SERVER_CONF(conf, stat_cache_provider);
+  const char *sep = strchr(spec, ':');
+  const char *name = sep ? apr_pstrmemdup(ptemp, spec, sep - spec) : spec;
+  const char *args = sep ? sep + 1 : NULL;
+
+  statcache.provider = ap_lookup_provider(AP_SOCACHE_PROVIDER_GROUP, name,
+                                          AP_SOCACHE_PROVIDER_VERSION);
+  if (!statcache.provider) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, s,
+                 "Socache provider '%s' is not available (is "
+                 "mod_socache_%s loaded?), not using the stat cache",
+                 name, name);
+    return OK;
+  }
+
+  apr_shm_t *shm = NULL;
+  apr_status_t status = apr_shm_create(
+      &shm, 2 * STATCACHE_EPOCHS * sizeof(apr_uint32_t), NULL, pconf);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not create shared memory for the stat cache");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  statcache.tree = apr_shm_baseaddr_get(shm);
+  statcache.node = statcache.tree + STATCACHE_EPOCHS;
+  memset((void *)statcache.tree, 0,
+         2 * STATCACHE_EPOCHS * sizeof(apr_uint32_t));
+
+  const char *err =
+      statcache.provider->create(&statcache.instance, args, ptemp, pconf);
+  if (err) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, s,
+                 "Could not create stat cache: %s", err);
+    statcache.instance = NULL;
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  struct ap_socache_hints hints = {
+      .avg_id_len = APR_SHA1_DIGESTSIZE,
+      .avg_obj_size = sizeof(statcache_entry_t),
+      .expiry_interval = apr_time_from_sec(60),
+  };
+
+  status = statcache.provider->init(
+      statcache.instance, DAVRODS_PROVIDER_NAME "-statcache", &hints, s, pconf);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not initialize stat cache");
+    statcache.instance = NULL;
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  apr_pool_cleanup_register(pconf, s, statcache_cleanup, apr_pool_cleanup_null);
+
+  if (statcache.provider->flags & AP_SOCACHE_FLAG_NOTMPSAFE) {
+    status = ap_global_mutex_create(&statcache.lock, NULL, STATCACHE_MUTEX_TYPE,
+                                    NULL, s, pconf, 0);
+    if (status != APR_SUCCESS) {
+      ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                   "Could not create stat cache mutex");
+      return HTTP_INTERNAL_SERVER_ERROR;
+    }
+  }
+
+  status = apr_generate_random_bytes(statcache.salt, sizeof(statcache.salt));
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not generate stat cache salt");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  return OK;
+}
+
+static void statcache_child_init(apr_pool_t *p, server_rec *s) {
+  if (!statcache.lock)
+    return;
+
+  apr_status_t status = apr_global_mutex_child_init(
+      &statcache.lock, apr_global_mutex_lockfile(statcache.lock), p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_CRIT, status, s,
+                 "Could not attach to stat cache mutex, disabling the stat "
+                 "cache");
+    statcache.instance = NULL;
+  }
+}
+
+void davrods_statcache_register(apr_pool_t *p) {
+  ap_hook_pre_config(statcache_pre_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_post_config(statcache_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_child_init(statcache_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,76 @@
+/**
+ * \file
+ * \brief     Stat results shared between child processes.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_STATCACHE_H
+#define _DAVRODS_STATCACHE_H
+
+#include "mod_davrods.h"
+
+#include <irods/rodsClient.h>
+
+/**
+ * \brief Get the invalidation epoch of a path.
+ *
+ * Must be called before asking iRODS about path, and passed to
+ * davrods_statcache_put(), so that a result that raced with a modification
+ * is never cached as current.
+ */
+apr_uint32_t davrods_statcache_epoch(const char *path);
+
+/**
+ * \brief Look up a stat result in the shared cache (DavrodsStatCache).
+ *
+ * Entries are specific to the session's user, zone and active ticket, as
+ * these determine what the session may see.
+ *
+ * \param[in]  r
+ * \param[in]  davrods_pool the session's davrods pool
+ * \param[in]  path         an iRODS path
+ * \param[out] stat         a result allocated from r's pool, or NULL if path
+ *                          did not exist
+ *
+ * \return whether a current result for path was found
+ */
+bool davrods_statcache_get(request_rec *r, apr_pool_t *davrods_pool,
+                           const char *path, rodsObjStat_t **stat);
+
+/**
+ * \brief Store a stat result in the shared cache.
+ *
+ * \param r
+ * \param davrods_pool
+ * \param path
+ * \param epoch        the epoch of path from before the stat call
+ * \param stat         the result, or NULL if path does not exist
+ */
+void davrods_statcache_put(request_rec *r, apr_pool_t *davrods_pool,
+                           const char *path, apr_uint32_t epoch,
+                           const rodsObjStat_t *stat);
+
+/**
+ * \brief Invalidate the cached results of path, everything below it, and
+ *        its parent collection, for all users and child processes.
+ */
+void davrods_statcache_invalidate(const char *path);
+
+void davrods_statcache_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_STATCACHE_H */
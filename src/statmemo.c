@@ -0,0 +1,233 @@
+/**
+ * \file
+ * \brief     Memoized iRODS stat results of a session.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "statmemo.h"
+#include "config.h"
+
+/// Results remembered per session. Entries are about 2.5 KiB each.
+#define STATMEMO_SIZE 8
+
+/// Missing paths remembered per session. Clients probe for many files that
+/// do not exist (.DS_Store, desktop.ini, ...), so these get their own, larger
+/// and cheaper set of entries that cannot push out existing paths.
+#define STATMEMO_MISSING_SIZE 32
+
+/// Longer missing paths are not remembered.
+#define STATMEMO_MISSING_PATH_LEN 256
+
+typedef struct {
+  char path[MAX_NAME_LEN];
+  rodsObjStat_t stat;
+  apr_time_t time; // 0 for an unused entry.
+} statmemo_entry_t;
+
+typedef struct {
+  char path[STATMEMO_MISSING_PATH_LEN];
+  apr_time_t time; // 0 for an unused entry.
+} statmemo_missing_t;
+
+typedef struct {
+  statmemo_entry_t entries[STATMEMO_SIZE];
+  int next; // The entry to replace when all are in use.
+
+  statmemo_missing_t missing[STATMEMO_MISSING_SIZE];
+  int next_missing;
+} statmemo_t;
+
+static apr_interval_time_t statmemo_ttl(request_rec *r) {
+  davrods_dir_conf_t *conf =
+      ap_get_module_config(r->per_dir_config, &davrods_module);
+  assert(conf);
+
+  int ttl = DAVRODS_CONF(conf, stat_memo_ttl);
+  return ttl > 0 ? apr_time_from_sec(ttl) : 0;
+}
+
+/**
+ * \brief Get the memo of a davrods pool.
+ *
+ * \param create whether to create a memo if the pool has none yet
+ */
+static statmemo_t *statmemo_of(apr_pool_t *davrods_pool, bool create) {
+  statmemo_t *memo = NULL;
+  apr_pool_userdata_get((void **)&memo, "stat_memo", davrods_pool);
+
+  if (!memo && create) {
+    memo = apr_pcalloc(davrods_pool, sizeof(statmemo_t));
+    apr_pool_userdata_set(memo, "stat_memo", apr_pool_cleanup_null,
+                          davrods_pool);
+  }
+  return memo;
+}
+
+/**
+ * \brief Check whether path is equal to or below a collection.
+ */
+static bool is_below(const char *path, const char *coll, size_t coll_len) {
+  return !strncmp(path, coll, coll_len) &&
+         (path[coll_len] == '\0' || path[coll_len] == '/');
+}
+
+static bool statmemo_get_missing(statmemo_t *memo, apr_interval_time_t ttl,
+                                 apr_time_t now, const char *path) {
+  for (int i = 0; i < STATMEMO_MISSING_SIZE; ++i) {
+    statmemo_missing_t *entry = &memo->missing[i];
+    if (!entry->time || strcmp(entry->path, path))
+      continue;
+
+    if (now - entry->time > ttl) {
+      entry->time = 0;
+      return false;
+    }
+
+    WHISPER("Absence of <%s> memoized %" APR_TIME_T_FMT " us ago\n", path,
+            now - entry->time);
+    return true;
+  }
+  return false;
+}
+
+static void statmemo_put_missing(statmemo_t *memo, apr_interval_time_t ttl,
+                                 apr_time_t now, const char *path) {
+  if (strlen(path) >= STATMEMO_MISSING_PATH_LEN)
+    return;
+
+  statmemo_missing_t *entry = NULL;
+  for (int i = 0; i < STATMEMO_MISSING_SIZE && !entry; ++i) {
+    if (now - memo->missing[i].time > ttl ||
+        !strcmp(memo->missing[i].path, path))
+      entry = &memo->missing[i];
+  }
+  if (!entry) {
+    entry = &memo->missing[memo->next_missing];
+    memo->next_missing = (memo->next_missing + 1) % STATMEMO_MISSING_SIZE;
+  }
+
+  strcpy(entry->path, path);
+  entry->time = now;
+}
+
+bool davrods_statmemo_get(request_rec *r, apr_pool_t *davrods_pool,
+                          const char *path, rodsObjStat_t **stat) {
+  apr_interval_time_t ttl = statmemo_ttl(r);
+  statmemo_t *memo = ttl ? statmemo_of(davrods_pool, false) : NULL;
+  if (!memo)
+    return false;
+
+  apr_time_t now = apr_time_now();
+
+  if (statmemo_get_missing(memo, ttl, now, path)) {
+    *stat = NULL;
+    return true;
+  }
+
+  for (int i = 0; i < STATMEMO_SIZE; ++i) {
+    statmemo_entry_t *entry = &memo->entries[i];
+    if (!entry->time || strcmp(entry->path, path))
+      continue;
+
+    if (now - entry->time > ttl) {
+      entry->time = 0;
+      return false;
+    }
+
+    *stat = apr_pmemdup(r->pool, &entry->stat, sizeof(rodsObjStat_t));
+
+    WHISPER("Stat of <%s> memoized %" APR_TIME_T_FMT " us ago\n", path,
+            now - entry->time);
+    return true;
+  }
+
+  return false;
+}
+
+void davrods_statmemo_put(request_rec *r, apr_pool_t *davrods_pool,
+                          const char *path, const rodsObjStat_t *stat) {
+  apr_interval_time_t ttl = statmemo_ttl(r);
+
+  // Special collections carry data that rcObjStat() allocated separately.
+  if (!ttl || (stat && stat->specColl) || strlen(path) >= MAX_NAME_LEN)
+    return;
+
+  statmemo_t *memo = statmemo_of(davrods_pool, true);
+  apr_time_t now = apr_time_now();
+
+  if (!stat) {
+    statmemo_put_missing(memo, ttl, now, path);
+    return;
+  }
+
+  // Prefer the entry of the same path, then an unused or expired one.
+  statmemo_entry_t *entry = NULL;
+  for (int i = 0; i < STATMEMO_SIZE && !entry; ++i) {
+    if (memo->entries[i].time && !strcmp(memo->entries[i].path, path))
+      entry = &memo->entries[i];
+  }
+  for (int i = 0; i < STATMEMO_SIZE && !entry; ++i) {
+    if (now - memo->entries[i].time > ttl)
+      entry = &memo->entries[i];
+  }
+  if (!entry) {
+    entry = &memo->entries[memo->next];
+    memo->next = (memo->next + 1) % STATMEMO_SIZE;
+  }
+
+  strcpy(entry->path, path);
+  entry->stat = *stat;
+  entry->time = now;
+}
+
+void davrods_statmemo_invalidate(apr_pool_t *davrods_pool,
+                                 const char *path) {
+  statmemo_t *memo = statmemo_of(davrods_pool, false);
+  if (!memo)
+    return;
+
+  size_t len = strlen(path);
+  const char *slash = strrchr(path, '/');
+  size_t parent_len = slash ? (slash == path ? 1 : slash - path) : 0;
+
+  for (int i = 0; i < STATMEMO_SIZE; ++i) {
+    statmemo_entry_t *entry = &memo->entries[i];
+    if (!entry->time)
+      continue;
+
+    bool parent = parent_len && strlen(entry->path) == parent_len &&
+                  !strncmp(entry->path, path, parent_len);
+
+    if (is_below(entry->path, path, len) || parent)
+      entry->time = 0;
+  }
+
+  // Anything that is created at or below path must no longer be reported
+  // missing.
+  for (int i = 0; i < STATMEMO_MISSING_SIZE; ++i) {
+    statmemo_missing_t *entry = &memo->missing[i];
+    if (entry->time && is_below(entry->path, path, len))
+      entry->time = 0;
+  }
+}
+
+void davrods_statmemo_clear(apr_pool_t *davrods_pool) {
+  statmemo_t *memo = statmemo_of(davrods_pool, false);
+  if (memo)
+    memset(memo, 0, sizeof(statmemo_t));
+}
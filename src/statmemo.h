@@ -0,0 +1,73 @@
+/**
+ * \file
+ * \brief     Memoized iRODS stat results of a session.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_STATMEMO_H
+#define _DAVRODS_STATMEMO_H
+
+#include "mod_davrods.h"
+
+#include <irods/rodsClient.h>
+
+/**
+ * \brief Look up a memoized rcObjStat() result.
+ *
+ * mod_dav looks up the same resources several times while handling a single
+ * request, and clients tend to ask about the same paths in consecutive
+ * requests. Stat results are therefore remembered in the davrods pool for a
+ * short while (DavrodsStatMemo).
+ *
+ * \param[in]  r
+ * \param[in]  davrods_pool
+ * \param[in]  path         an iRODS path
+ * \param[out] stat         a copy allocated from r's pool, or NULL if path
+ *                          did not exist
+ *
+ * \return whether a result for path was found
+ */
+bool davrods_statmemo_get(request_rec *r, apr_pool_t *davrods_pool,
+                          const char *path, rodsObjStat_t **stat);
+
+/**
+ * \brief Remember an rcObjStat() result.
+ *
+ * \param r
+ * \param davrods_pool
+ * \param path
+ * \param stat         the result, or NULL if path does not exist
+ */
+void davrods_statmemo_put(request_rec *r, apr_pool_t *davrods_pool,
+                          const char *path, const rodsObjStat_t *stat);
+
+/**
+ * \brief Forget what is known about a path that is being modified.
+ *
+ * This includes everything below path, and its parent collection, whose
+ * modification time changes along with its contents.
+ */
+void davrods_statmemo_invalidate(apr_pool_t *davrods_pool, const char *path);
+
+/**
+ * \brief Forget all memoized results, e.g. when access rights change
+ *        because another session ticket is activated.
+ */
+void davrods_statmemo_clear(apr_pool_t *davrods_pool);
+
+#endif /* _DAVRODS_STATMEMO_H */
@@ -0,0 +1,162 @@
+/**
+ * \file
+ * \brief     Shared-memory statistics counters.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "stats.h"
+
+#include <apr_atomic.h>
+#include <apr_shm.h>
+#include <mod_status.h>
+
+APLOG_USE_MODULE(davrods);
+
+/// Counter names as shown in server-status. Keep in sync with davrods_stat_t.
+static const char *const stat_names[DAVRODS_STAT_COUNT] = {
+    [DAVRODS_STAT_PAM_CACHE_HIT] = "PamCacheHits",
+    [DAVRODS_STAT_PAM_CACHE_MISS] = "PamCacheMisses",
+    [DAVRODS_STAT_PAM_CACHE_REJECTED] = "PamCacheRejected",
+    [DAVRODS_STAT_PROXY_VERIFY_HIT] = "ProxyVerifyCacheHits",
+    [DAVRODS_STAT_PROXY_VERIFY_MISS] = "ProxyVerifyCacheMisses",
+    [DAVRODS_STAT_SESSION_RELEASED] = "IdleSessionsReleased",
+    [DAVRODS_STAT_SESSION_RESUMED] = "IdleSessionsResumed",
+    [DAVRODS_STAT_STALE_CONNECTION] = "StaleConnectionsDetected",
+    [DAVRODS_STAT_OPERATION_RETRIED] = "OperationsRetried",
+    [DAVRODS_STAT_LOGIN_BACKOFF] = "FailedLoginsRefused",
+    [DAVRODS_STAT_LOGIN_SOURCE_LIMITED] = "FailedLoginsRateLimited",
+    [DAVRODS_STAT_ADMISSION_QUEUED] = "ConnectionRequestsQueued",
+    [DAVRODS_STAT_ADMISSION_REFUSED] = "ConnectionRequestsRefused",
+    [DAVRODS_STAT_ADMISSION_WAIT_MSEC] = "ConnectionQueueWaitMilliseconds",
+    [DAVRODS_STAT_TICKET_CONNECTION_REUSED] = "TicketConnectionsReused",
+    [DAVRODS_STAT_TICKET_SUBMITTED] = "SessionTicketsSubmitted",
+    [DAVRODS_STAT_STREAM_CONNECTION_SHARED] = "StreamConnectionsShared",
+    [DAVRODS_STAT_TLS_FULL_HANDSHAKE] = "TlsFullHandshakes",
+    [DAVRODS_STAT_TLS_SESSION_RESUMED] = "TlsSessionsResumed",
+    [DAVRODS_STAT_STAT_CALL_AVOIDED] = "StatCallsAvoided",
+    [DAVRODS_STAT_STAT_CACHE_HIT] = "StatCacheHits",
+    [DAVRODS_STAT_STAT_CACHE_MISS] = "StatCacheMisses",
+    [DAVRODS_STAT_JUNK_PATH] = "JunkPathLookups",
+    [DAVRODS_STAT_METAINDEX_HIT] = "IndexedListingsUsed",
+    [DAVRODS_STAT_METAINDEX_MISS] = "IndexedListingsMissed",
+    [DAVRODS_STAT_LOOKUP_COALESCED] = "CoalescedLookups",
+};
+
+// Anonymous shared memory is created before forking, so that all child
+// processes share the same counters.
+static volatile apr_uint32_t *counters = NULL;
+
+void davrods_stats_inc(davrods_stat_t stat) {
+  assert(stat < DAVRODS_STAT_COUNT);
+  if (counters)
+    apr_atomic_inc32(&counters[stat]);
+}
+
+void davrods_stats_add(davrods_stat_t stat, apr_uint32_t value) {
+  assert(stat < DAVRODS_STAT_COUNT);
+  if (counters)
+    apr_atomic_add32(&counters[stat], value);
+}
+
+apr_uint32_t davrods_stats_get(davrods_stat_t stat) {
+  assert(stat < DAVRODS_STAT_COUNT);
+  return counters ? apr_atomic_read32(&counters[stat]) : 0;
+}
+
+static int stats_status_hook(request_rec *r, int flags) {
+  if (!counters)
+    return OK;
+
+  if (flags & AP_STATUS_SHORT) {
+    for (int i = 0; i < DAVRODS_STAT_COUNT; ++i)
+      ap_rprintf(r, "Davrods%s: %u\n", stat_names[i],
+                 davrods_stats_get((davrods_stat_t)i));
+  } else {
+    ap_rputs("<hr />\n<h2>Davrods statistics</h2>\n<table>\n", r);
+    for (int i = 0; i < DAVRODS_STAT_COUNT; ++i)
+      ap_rprintf(r, "<tr><td>%s</td><td>%u</td></tr>\n", stat_names[i],
+                 davrods_stats_get((davrods_stat_t)i));
+    ap_rputs("</table>\n", r);
+  }
+
+  return OK;
+}
+
+#if APR_POOL_DEBUG
+/**
+ * \brief Report the memory held by the request pool and the davrods pool at
+ * the end of each request.
+ *
+ * APR can only count pool allocations when it is built with pool debugging
+ * (--enable-pool-debug). The figures are logged at debug level and kept in
+ * the "davrods-request-bytes" and "davrods-session-bytes" notes, which can be
+ * logged with LogFormat's %{...}n.
+ */
+static int stats_log_transaction(request_rec *r) {
+  apr_pool_t *davrods_pool = NULL;
+  apr_pool_userdata_get((void **)&davrods_pool, "davrods_pool",
+                        r->connection->pool);
+  if (!davrods_pool)
+    return DECLINED;
+
+  apr_size_t request_bytes = apr_pool_num_bytes(r->pool, 1);
+  apr_size_t session_bytes = apr_pool_num_bytes(davrods_pool, 1);
+
+  apr_table_set(r->notes, "davrods-request-bytes",
+                apr_psprintf(r->pool, "%" APR_SIZE_T_FMT, request_bytes));
+  apr_table_set(r->notes, "davrods-session-bytes",
+                apr_psprintf(r->pool, "%" APR_SIZE_T_FMT, session_bytes));
+
+  ap_log_rerror(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, r,
+                "Memory allocated: %" APR_SIZE_T_FMT
+                " bytes in the request pool, %" APR_SIZE_T_FMT
+                " bytes in the davrods pool",
+                request_bytes, session_bytes);
+
+  return DECLINED;
+}
+#endif
+
+static int stats_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+                             apr_pool_t *ptemp, server_rec *s) {
+  counters = NULL;
+
+  apr_shm_t *shm = NULL;
+  apr_status_t status = apr_shm_create(
+      &shm, DAVRODS_STAT_COUNT * sizeof(apr_uint32_t), NULL, pconf);
+  if (status != APR_SUCCESS) {
+    // Statistics are not essential, carry on without them.
+    ap_log_error(APLOG_MARK, APLOG_WARNING, status, s,
+                 "Could not create shared memory for Davrods statistics");
+    return OK;
+  }
+
+  counters = apr_shm_baseaddr_get(shm);
+  memset((void *)counters, 0, DAVRODS_STAT_COUNT * sizeof(apr_uint32_t));
+
+  return OK;
+}
+
+void davrods_stats_register(apr_pool_t *p) {
+  ap_hook_post_config(stats_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+#if APR_POOL_DEBUG
+  ap_hook_log_transaction(stats_log_transaction, NULL, NULL, APR_HOOK_MIDDLE);
+#endif
+  APR_OPTIONAL_HOOK(ap, status_hook, stats_status_hook, NULL, NULL,
+                    APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,80 @@
+/**
+ * \file
+ * \brief     Shared-memory statistics counters.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_STATS_H
+#define _DAVRODS_STATS_H
+
+#include "mod_davrods.h"
+
+/**
+ * \brief Statistics counters, shared by all Apache child processes.
+ *
+ * Counters are reported on the mod_status page (server-status), if
+ * mod_status is loaded.
+ */
+typedef enum {
+  DAVRODS_STAT_PAM_CACHE_HIT = 0,
+  DAVRODS_STAT_PAM_CACHE_MISS,
+  DAVRODS_STAT_PAM_CACHE_REJECTED,
+  DAVRODS_STAT_PROXY_VERIFY_HIT,
+  DAVRODS_STAT_PROXY_VERIFY_MISS,
+  DAVRODS_STAT_SESSION_RELEASED,
+  DAVRODS_STAT_SESSION_RESUMED,
+  DAVRODS_STAT_STALE_CONNECTION,
+  DAVRODS_STAT_OPERATION_RETRIED,
+  DAVRODS_STAT_LOGIN_BACKOFF,
+  DAVRODS_STAT_LOGIN_SOURCE_LIMITED,
+  DAVRODS_STAT_ADMISSION_QUEUED,
+  DAVRODS_STAT_ADMISSION_REFUSED,
+  DAVRODS_STAT_ADMISSION_WAIT_MSEC,
+  DAVRODS_STAT_TICKET_CONNECTION_REUSED,
+  DAVRODS_STAT_TICKET_SUBMITTED,
+  DAVRODS_STAT_STREAM_CONNECTION_SHARED,
+  DAVRODS_STAT_TLS_FULL_HANDSHAKE,
+  DAVRODS_STAT_TLS_SESSION_RESUMED,
+  DAVRODS_STAT_STAT_CALL_AVOIDED,
+  DAVRODS_STAT_STAT_CACHE_HIT,
+  DAVRODS_STAT_STAT_CACHE_MISS,
+  DAVRODS_STAT_JUNK_PATH,
+  DAVRODS_STAT_METAINDEX_HIT,
+  DAVRODS_STAT_METAINDEX_MISS,
+  DAVRODS_STAT_LOOKUP_COALESCED,
+
+  DAVRODS_STAT_COUNT // Must be last.
+} davrods_stat_t;
+
+/**
+ * \brief Increment a statistics counter.
+ *
+ * This is a no-op if shared memory could not be set up.
+ */
+void davrods_stats_inc(davrods_stat_t stat);
+
+/**
+ * \brief Add a value to a statistics counter.
+ */
+void davrods_stats_add(davrods_stat_t stat, apr_uint32_t value);
+
+apr_uint32_t davrods_stats_get(davrods_stat_t stat);
+
+void davrods_stats_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_STATS_H */
@@ -0,0 +1,370 @@
+/**
+ * \file
+ * \brief     TLS for PAM authentication over plain iRODS connections.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tls.h"
+#include "config.h"
+#include "env.h"
+#include "stats.h"
+
+#include <apr_atomic.h>
+#include <apr_hash.h>
+#include <apr_strings.h>
+#include <apr_thread_mutex.h>
+
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <irods/sslSockComm.h>
+
+APLOG_USE_MODULE(davrods);
+
+/* With the PAM auth scheme, a connection that negotiated plain TCP is
+ * switched to SSL for the duration of the login. The iRODS client's
+ * sslStart() does that with a fresh SSL context, which means reading the CA
+ * certificates and a full handshake for every new iRODS connection.
+ *
+ * Instead, connections share one SSL context per set of SSL settings in
+ * each child process, and the client side of the last TLS session with each
+ * iRODS server is remembered. Offering that session on the next connection
+ * to the same server allows an abbreviated handshake, if the server still
+ * knows the session.
+ *
+ * A resumed session is not verified again, so sessions are only offered to
+ * connections with the same SSL settings as the connection that created
+ * them.
+ */
+
+typedef struct {
+  SSL_SESSION *session; // Our reference, or NULL.
+} tls_peer_t;
+
+static struct {
+  bool enabled;
+  apr_pool_t *pool;     // Guarded by lock.
+  apr_hash_t *contexts; // SSL settings -> SSL_CTX.
+  apr_hash_t *peers;    // SSL settings and host:port -> tls_peer_t.
+  volatile apr_uint32_t handshakes; // In this child process.
+  volatile apr_uint32_t resumed;
+#if APR_HAS_THREADS
+  apr_thread_mutex_t *lock;
+#endif
+} tls;
+
+static void tls_lock(void) {
+#if APR_HAS_THREADS
+  apr_thread_mutex_lock(tls.lock);
+#endif
+}
+
+static void tls_unlock(void) {
+#if APR_HAS_THREADS
+  apr_thread_mutex_unlock(tls.lock);
+#endif
+}
+
+static const char *verify_mode(const rodsEnv *env) {
+  return *env->irodsSSLVerifyServer ? env->irodsSSLVerifyServer : "hostname";
+}
+
+/**
+ * \brief Remember a new client session of a connection.
+ *
+ * Called by OpenSSL when the server hands out a session, which (with TLS
+ * 1.3) may be after the handshake.
+ */
+static int tls_new_session(SSL *ssl, SSL_SESSION *session) {
+  tls_peer_t *peer = SSL_get_app_data(ssl);
+  if (!peer)
+    return 0;
+
+  tls_lock();
+  if (!tls.peers) {
+    // The child is exiting.
+    tls_unlock();
+    return 0;
+  }
+  SSL_SESSION *old = peer->session;
+  peer->session = session;
+  tls_unlock();
+
+  if (old)
+    SSL_SESSION_free(old);
+
+  return 1; // Keep the reference.
+}
+
+static SSL_CTX *tls_create_context(const davrods_login_t *login,
+                                   const rodsEnv *env) {
+  SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+  if (!ctx)
+    return NULL;
+
+  SSL_CTX_set_options(ctx, SSL_OP_ALL | SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+
+  const char *ca_file = env->irodsSSLCACertificateFile;
+  const char *ca_path = env->irodsSSLCACertificatePath;
+  int loaded = 0;
+  if (*ca_file || *ca_path)
+    loaded = SSL_CTX_load_verify_locations(ctx, *ca_file ? ca_file : NULL,
+                                           *ca_path ? ca_path : NULL);
+  else
+    loaded = SSL_CTX_set_default_verify_paths(ctx);
+  if (loaded != 1) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "Could not load CA certificates for SSL (file <%s>, "
+                 "path <%s>)",
+                 ca_file, ca_path);
+    SSL_CTX_free(ctx);
+    return NULL;
+  }
+
+  SSL_CTX_set_verify(ctx,
+                     strcmp(verify_mode(env), "none") ? SSL_VERIFY_PEER
+                                                      : SSL_VERIFY_NONE,
+                     NULL);
+  SSL_CTX_set_verify_depth(ctx, 4);
+
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+                                          SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, tls_new_session);
+
+  return ctx;
+}
+
+/**
+ * \brief Get the shared SSL context for env's SSL settings, and the peer
+ *        entry of the connection's server.
+ *
+ * \return a context without an extra reference, or NULL on failure
+ */
+static SSL_CTX *tls_get_context(const davrods_login_t *login,
+                                const rodsEnv *env, const rcComm_t *rods_conn,
+                                tls_peer_t **peer) {
+  tls_lock();
+
+  if (!tls.contexts) {
+    tls_unlock();
+    return NULL;
+  }
+
+  const char *settings =
+      apr_pstrcat(login->pool, verify_mode(env), "\n",
+                  env->irodsSSLCACertificateFile, "\n",
+                  env->irodsSSLCACertificatePath, NULL);
+
+  SSL_CTX *ctx = apr_hash_get(tls.contexts, settings, APR_HASH_KEY_STRING);
+  if (!ctx) {
+    ctx = tls_create_context(login, env);
+    if (!ctx) {
+      tls_unlock();
+      return NULL;
+    }
+    apr_hash_set(tls.contexts, apr_pstrdup(tls.pool, settings),
+                 APR_HASH_KEY_STRING, ctx);
+  }
+
+  const char *name = apr_psprintf(login->pool, "%s\n%s:%d", settings,
+                                  rods_conn->host, rods_conn->portNum);
+
+  *peer = apr_hash_get(tls.peers, name, APR_HASH_KEY_STRING);
+  if (!*peer) {
+    *peer = apr_pcalloc(tls.pool, sizeof(tls_peer_t));
+    apr_hash_set(tls.peers, apr_pstrdup(tls.pool, name), APR_HASH_KEY_STRING,
+                 *peer);
+  }
+
+  tls_unlock();
+  return ctx;
+}
+
+/**
+ * \brief Check the server certificate the way sslStart() does.
+ */
+static bool tls_check_peer(const davrods_login_t *login, SSL *ssl,
+                           const rodsEnv *env, const char *host) {
+  const char *mode = verify_mode(env);
+  if (!strcmp(mode, "none"))
+    return true;
+
+  X509 *cert = SSL_get_peer_certificate(ssl);
+  if (!cert) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "iRODS server <%s> did not present a certificate", host);
+    return false;
+  }
+
+  long result = SSL_get_verify_result(ssl);
+  bool ok = result == X509_V_OK;
+  if (!ok)
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "Could not verify the certificate of iRODS server <%s>: %s",
+                 host, X509_verify_cert_error_string(result));
+
+  if (ok && strcmp(mode, "cert")) {
+    ok = X509_check_host(cert, host, 0, 0, NULL) == 1;
+    if (!ok)
+      ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                   "The certificate of iRODS server <%s> does not match its "
+                   "host name",
+                   host);
+  }
+
+  X509_free(cert);
+  return ok;
+}
+
+int davrods_tls_start(const davrods_login_t *login, rcComm_t *rods_conn) {
+  if (rods_conn->ssl_on)
+    return 0;
+
+  rodsEnv *env = davrods_env_get(login->conf);
+  tls_peer_t *peer = NULL;
+  SSL_CTX *ctx = NULL;
+
+  if (tls.enabled && env)
+    ctx = tls_get_context(login, env, rods_conn, &peer);
+
+  if (!ctx)
+    return sslStart(rods_conn);
+
+  // Ask the server to switch to SSL.
+  sslStartInp_t start_inp;
+  memset(&start_inp, 0, sizeof(start_inp));
+  int status = rcSslStart(rods_conn, &start_inp);
+  if (status < 0)
+    return status;
+
+  SSL *ssl = SSL_new(ctx);
+  if (!ssl || SSL_set_fd(ssl, rods_conn->sock) != 1) {
+    if (ssl)
+      SSL_free(ssl);
+    return SSL_INIT_ERROR;
+  }
+  SSL_set_app_data(ssl, peer);
+
+  tls_lock();
+  SSL_SESSION *session = peer->session;
+  if (session)
+    SSL_SESSION_up_ref(session);
+  tls_unlock();
+
+  if (session) {
+    SSL_set_session(ssl, session);
+    SSL_SESSION_free(session);
+  }
+
+  if (SSL_connect(ssl) != 1) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, APR_SUCCESS, login->server,
+                 "SSL handshake with iRODS server <%s> failed",
+                 rods_conn->host);
+    SSL_free(ssl);
+    return SSL_HANDSHAKE_ERROR;
+  }
+
+  if (!tls_check_peer(login, ssl, env, rods_conn->host)) {
+    SSL_free(ssl);
+    return SSL_CERT_ERROR;
+  }
+
+  bool resumed = SSL_session_reused(ssl);
+  davrods_stats_inc(resumed ? DAVRODS_STAT_TLS_SESSION_RESUMED
+                            : DAVRODS_STAT_TLS_FULL_HANDSHAKE);
+
+  apr_uint32_t handshakes = apr_atomic_inc32(&tls.handshakes) + 1;
+  apr_uint32_t resumed_total = resumed ? apr_atomic_inc32(&tls.resumed) + 1
+                                       : apr_atomic_read32(&tls.resumed);
+
+  ap_log_error(APLOG_MARK, APLOG_DEBUG, APR_SUCCESS, login->server,
+               "%s TLS handshake with iRODS server <%s> (%u of %u resumed "
+               "in this process)",
+               resumed ? "Abbreviated" : "Full", rods_conn->host,
+               resumed_total, handshakes);
+
+  // The connection holds its own reference to the context, and frees both
+  // in sslEnd() or rcDisconnect().
+  SSL_CTX_up_ref(ctx);
+  rods_conn->ssl_ctx = ctx;
+  rods_conn->ssl = ssl;
+  rods_conn->ssl_on = 1;
+  snprintf(rods_conn->negotiation_results,
+           sizeof(rods_conn->negotiation_results), "%s", "CS_NEG_USE_SSL");
+
+  return 0;
+}
+
+static apr_status_t tls_cleanup(void *data) {
+  tls_lock();
+
+  if (tls.peers) {
+    for (apr_hash_index_t *hi = apr_hash_first(NULL, tls.peers); hi;
+         hi = apr_hash_next(hi)) {
+      tls_peer_t *peer = apr_hash_this_val(hi);
+      if (peer->session)
+        SSL_SESSION_free(peer->session);
+      peer->session = NULL;
+    }
+    tls.peers = NULL;
+  }
+
+  if (tls.contexts) {
+    // Contexts still used by open connections are freed with them.
+    for (apr_hash_index_t *hi = apr_hash_first(NULL, tls.contexts); hi;
+         hi = apr_hash_next(hi))
+      SSL_CTX_free(apr_hash_this_val(hi));
+    tls.contexts = NULL;
+  }
+
+  tls_unlock();
+  return APR_SUCCESS;
+}
+
+static void tls_child_init(apr_pool_t *p, server_rec *s) {
+  davrods_server_conf_t *conf =
+      ap_get_module_config(s->module_config, &davrods_module);
+  assert(conf);
+
+  tls.enabled = DAVRODS_SERVER_CONF(conf, tls_session_cache) ==
+                DAVRODS_TLS_SESSION_CACHE_ON;
+  if (!tls.enabled)
+    return;
+
+#if APR_HAS_THREADS
+  apr_status_t status =
+      apr_thread_mutex_create(&tls.lock, APR_THREAD_MUTEX_DEFAULT, p);
+  if (status != APR_SUCCESS) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, status, s,
+                 "Could not create TLS session cache mutex, disabling TLS "
+                 "session resumption");
+    tls.enabled = false;
+    return;
+  }
+#endif
+
+  tls.pool = p;
+  tls.contexts = apr_hash_make(p);
+  tls.peers = apr_hash_make(p);
+
+  apr_pool_cleanup_register(p, NULL, tls_cleanup, apr_pool_cleanup_null);
+}
+
+void davrods_tls_register(apr_pool_t *p) {
+  ap_hook_child_init(tls_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+}
@@ -0,0 +1,49 @@
+/**
+ * \file
+ * \brief     TLS for PAM authentication over plain iRODS connections.
+ * \author    Utrecht University Yoda Team
+ * \copyright Copyright (c) 2026, Utrecht University
+ *
+ * This file is part of Davrods.
+ *
+ * Davrods is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Davrods is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Davrods.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _DAVRODS_TLS_H
+#define _DAVRODS_TLS_H
+
+#include "config.h"
+#include "mod_davrods.h"
+
+#include <irods/rodsClient.h>
+
+/**
+ * \brief Turn on SSL for a connection that negotiated plain TCP.
+ *
+ * This is a replacement for the iRODS client's sslStart(), used to protect
+ * a PAM password. The TLS context is shared by all connections of the child
+ * process, and the TLS session of the previous connection to the same iRODS
+ * server is offered for resumption, to save a full handshake.
+ *
+ * Falls back to sslStart() when DavrodsTlsSessionCache is Off.
+ *
+ * \param login     the login the connection is made for
+ * \param rods_conn a connected iRODS connection without SSL
+ *
+ * \return 0 on success, or an iRODS error code
+ */
+int davrods_tls_start(const davrods_login_t *login, rcComm_t *rods_conn);
+
+void davrods_tls_register(apr_pool_t *p);
+
+#endif /* _DAVRODS_TLS_H */
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Benchmark collection listings with and without DavrodsPagedListings.
+
+Davrods lists collections for PROPFIND and HTML listings either with
+rclOpenCollection()/rclReadCollection(), or with paged catalog queries
+(DavrodsPagedListings On). This script compares both on collections of
+various sizes. It needs two Davrods locations that expose the same
+collections, one with paged listings off and one with them on, e.g.:
+
+    <Location /rcl>
+        ...
+        DavrodsPagedListings Off
+    </Location>
+    <Location /paged>
+        ...
+        DavrodsPagedListings On
+    </Location>
+
+Test collections named bench-<size> are created with --populate, which
+uploads empty data objects through the first location. For 100k entries,
+creating them with iCommands (e.g. a loop around itouch) is faster.
+
+    ./paged_listing.py --url-rcl https://data.davrods/rcl \\
+        --url-paged https://data.davrods/paged --user rods --password rods \\
+        --sizes 10000 100000 --populate --insecure
+"""
+
+__copyright__ = 'Copyright (c) 2026, Utrecht University'
+__license__   = 'GPLv3, see LICENSE'
+
+import argparse
+import concurrent.futures
+import statistics
+import sys
+import time
+
+import requests
+import urllib3
+
+PROPFIND_BODY = ('<?xml version="1.0" encoding="utf-8"?>'
+                 '<propfind xmlns="DAV:"><prop>'
+                 '<resourcetype/><getcontentlength/><getlastmodified/>'
+                 '<creationdate/></prop></propfind>')
+
+
+def count_members(session, url):
+    """Count the members of a collection, or return None if it is missing."""
+    response = session.request('PROPFIND', url + '/',
+                               headers={'Depth': '1'}, data=PROPFIND_BODY)
+    if response.status_code == 404:
+        return None
+    response.raise_for_status()
+    # One response for the collection itself.
+    return response.text.count('<D:response') - 1
+
+
+def populate(session, url, size, workers):
+    existing = count_members(session, url)
+    if existing is None:
+        session.request('MKCOL', url + '/').raise_for_status()
+        existing = 0
+    if existing >= size:
+        return
+
+    def put(i):
+        session.put('{}/file-{:06d}.dat'.format(url, i),
+                    data=b'').raise_for_status()
+
+    print('Creating {} data objects in {}'.format(size - existing, url),
+          file=sys.stderr)
+    with concurrent.futures.ThreadPoolExecutor(workers) as pool:
+        list(pool.map(put, range(existing, size)))
+
+
+def timed(session, method, url, **kwargs):
+    start = time.monotonic()
+    response = session.request(method, url, **kwargs)
+    elapsed = time.monotonic() - start
+    response.raise_for_status()
+    return elapsed
+
+
+def measure(session, url, repeat):
+    """Return the median PROPFIND Depth 1 and HTML listing times."""
+    propfind = [timed(session, 'PROPFIND', url + '/',
+                      headers={'Depth': '1'}, data=PROPFIND_BODY)
+                for _ in range(repeat)]
+    listing = [timed(session, 'GET', url + '/') for _ in range(repeat)]
+    return statistics.median(propfind), statistics.median(listing)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--url-rcl', required=True,
+                        help='location with DavrodsPagedListings Off')
+    parser.add_argument('--url-paged', required=True,
+                        help='location with DavrodsPagedListings On')
+    parser.add_argument('--user', required=True)
+    parser.add_argument('--password', required=True)
+    parser.add_argument('--sizes', type=int, nargs='+',
+                        default=[10000, 100000],
+                        help='numbers of collection members to test')
+    parser.add_argument('--repeat', type=int, default=5,
+                        help='requests per measurement (default: 5)')
+    parser.add_argument('--populate', action='store_true',
+                        help='create missing test collections first')
+    parser.add_argument('--workers', type=int, default=16,
+                        help='concurrent uploads when populating')
+    parser.add_argument('--insecure', action='store_true',
+                        help='do not verify the TLS certificate')
+    parser.add_argument('--output', help='also append results to this file')
+    args = parser.parse_args()
+
+    session = requests.Session()
+    session.auth = (args.user, args.password)
+    session.verify = not args.insecure
+    if args.insecure:
+        urllib3.disable_warnings(urllib3.exceptions.InsecureRequestWarning)
+
+    lines = ['{:>8} {:>10} {:>10} {:>10} {:>10}'.format(
+        'members', 'find_rcl', 'find_paged', 'html_rcl', 'html_paged')]
+    for size in args.sizes:
+        name = 'bench-{}'.format(size)
+        if args.populate:
+            populate(session, '{}/{}'.format(args.url_rcl, name), size,
+                     args.workers)
+
+        # Both paths must see the same collection.
+        for base in (args.url_rcl, args.url_paged):
+            members = count_members(session, '{}/{}'.format(base, name))
+            if members != size:
+                sys.exit('{}/{} has {} members, expected {}'.format(
+                    base, name, members, size))
+
+        rcl = measure(session, '{}/{}'.format(args.url_rcl, name),
+                      args.repeat)
+        paged = measure(session, '{}/{}'.format(args.url_paged, name),
+                        args.repeat)
+        lines.append('{:>8} {:>9.2f}s {:>9.2f}s {:>9.2f}s {:>9.2f}s'.format(
+            size, rcl[0], paged[0], rcl[1], paged[1]))
+        print(lines[-1], file=sys.stderr)
+
+    report = '\n'.join(lines) + '\n(median wall time per request)\n'
+    print(report)
+    if args.output:
+        with open(args.output, 'a') as f:
+            f.write(report)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""Benchmark Davrods transfers with and without socket tuning.
+
+Davrods reads and writes data objects in chunks (DavrodsRxBufferKbs and
+DavrodsTxBufferKbs), each one an iRODS API request followed by a response.
+Over a distant link, the round trip time rather than the bandwidth can then
+limit transfers. This script uploads and downloads data objects through two
+Davrods locations that expose the same collections, one with the default
+socket options and one with tuned options, e.g.:
+
+    <Location /socket-tuned>
+        ...
+        DavrodsSocketBuffers Auto 1000
+        DavrodsSocketNoDelay On
+    </Location>
+
+Latency between Davrods and iRODS is simulated with netem on the network
+interface of the iRODS provider container, which delays everything the
+provider sends. This requires docker, the sch_netem kernel module on the
+docker host, and tc (iproute2) in the provider container. The qdisc is
+removed when the benchmark ends.
+
+Davrods measures the round trip time of a new iRODS connection, so
+Apache is restarted gracefully in the Davrods container after every
+change of latency, so that no pooled connection from an earlier
+measurement is reused. With the development containers:
+
+    ./socket_tuning.py --url-default https://data.davrods:8445 \\
+        --url-tuned https://data.davrods:8445/socket-tuned \\
+        --user researcher --password test --collection researcher \\
+        --rtt 0 2 10 30 --insecure --output ../../bench_output.txt
+"""
+
+__copyright__ = 'Copyright (c) 2026, Utrecht University'
+__license__   = 'GPLv3, see LICENSE'
+
+import argparse
+import statistics
+import subprocess
+import sys
+import time
+
+import requests
+import urllib3
+
+CHUNK_SIZE = 1024 * 1024
+
+
+def docker_exec(container, *command, check=True):
+    return subprocess.run(['docker', 'exec', '--privileged', container]
+                          + list(command),
+                          stderr=subprocess.DEVNULL, check=check)
+
+
+def set_rtt(container, interface, rtt_ms):
+    """Delay every packet that the container sends by the round trip time."""
+    docker_exec(container, 'tc', 'qdisc', 'del', 'dev', interface, 'root',
+                check=False)
+    if rtt_ms > 0:
+        docker_exec(container, 'tc', 'qdisc', 'add', 'dev', interface, 'root',
+                    'netem', 'delay', '{}ms'.format(rtt_ms), 'limit', '100000')
+
+
+def restart_davrods(container):
+    """Let new Apache children, with empty connection pools, take over."""
+    docker_exec(container, 'apachectl', '-k', 'graceful')
+    time.sleep(3)
+
+
+def upload(session, url, size):
+    def chunks():
+        data = bytes(CHUNK_SIZE)
+        for offset in range(0, size, CHUNK_SIZE):
+            yield data[:min(CHUNK_SIZE, size - offset)]
+
+    start = time.monotonic()
+    # A generator makes requests stream the body like a desktop client.
+    session.put(url, data=chunks()).raise_for_status()
+    return time.monotonic() - start
+
+
+def download(session, url, size):
+    start = time.monotonic()
+    received = 0
+    with session.get(url, stream=True) as response:
+        response.raise_for_status()
+        for chunk in response.iter_content(CHUNK_SIZE):
+            received += len(chunk)
+    elapsed = time.monotonic() - start
+    if received != size:
+        sys.exit('{} returned {} bytes, expected {}'.format(url, received,
+                                                            size))
+    return elapsed
+
+
+def measure(session, url, size, repeat):
+    """Return the median upload and download throughput in MiB/s."""
+    puts = [upload(session, url, size) for _ in range(repeat)]
+    gets = [download(session, url, size) for _ in range(repeat)]
+    session.delete(url)
+    mib = size / (1024 * 1024)
+    return mib / statistics.median(puts), mib / statistics.median(gets)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--url-default', required=True,
+                        help='location with the default socket options')
+    parser.add_argument('--url-tuned', required=True,
+                        help='location with tuned socket options')
+    parser.add_argument('--user', required=True)
+    parser.add_argument('--password', required=True)
+    parser.add_argument('--collection', required=True,
+                        help='writable collection below both locations')
+    parser.add_argument('--rtt', type=float, nargs='+', default=[0, 2, 10, 30],
+                        help='added round trip times in milliseconds')
+    parser.add_argument('--size-mb', type=int, default=256,
+                        help='size of the test data object (default: 256)')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='transfers per measurement (default: 3)')
+    parser.add_argument('--provider', default='provider.davrods',
+                        help='iRODS provider container to delay')
+    parser.add_argument('--interface', default='eth0',
+                        help='network interface in the provider container')
+    parser.add_argument('--davrods', default='data.davrods',
+                        help='Davrods container to restart')
+    parser.add_argument('--insecure', action='store_true',
+                        help='do not verify the TLS certificate')
+    parser.add_argument('--output', help='also append results to this file')
+    args = parser.parse_args()
+
+    if args.insecure:
+        urllib3.disable_warnings(urllib3.exceptions.InsecureRequestWarning)
+
+    size = args.size_mb * 1024 * 1024
+    lines = ['{:>8} {:>12} {:>12} {:>12} {:>12}'.format(
+        'rtt', 'put_default', 'put_tuned', 'get_default', 'get_tuned')]
+    try:
+        for rtt in args.rtt:
+            set_rtt(args.provider, args.interface, rtt)
+            restart_davrods(args.davrods)
+
+            results = []
+            for base in (args.url_default, args.url_tuned):
+                # A new HTTP connection gets a new iRODS connection.
+                with requests.Session() as session:
+                    session.auth = (args.user, args.password)
+                    session.verify = not args.insecure
+                    url = '{}/{}/bench-socket-tuning.dat'.format(
+                        base, args.collection.strip('/'))
+                    results.append(measure(session, url, size, args.repeat))
+
+            (put_default, get_default), (put_tuned, get_tuned) = results
+            lines.append('{:>6g}ms {:>7.1f}MiB/s {:>7.1f}MiB/s {:>7.1f}MiB/s '
+                         '{:>7.1f}MiB/s'.format(rtt, put_default, put_tuned,
+                                                 get_default, get_tuned))
+            print(lines[-1], file=sys.stderr)
+    finally:
+        set_rtt(args.provider, args.interface, 0)
+
+    report = '{}\n(median throughput, {} MiB data object)\n'.format(
+        '\n'.join(lines), args.size_mb)
+    print(report)
+    if args.output:
+        with open(args.output, 'a') as f:
+            f.write(report)
+
+
+if __name__ == '__main__':
+    main()
@@ -157,6 +157,13 @@ Feature: WebDAV interface
             | MKCOL    | researcher/wrong_creds'dir      |
             | DELETE   | researcher/testdata/lorem.txt   |
 
+    Scenario: A repeated invalid password is refused without asking iRODS
+        Given user researcher is authenticated
+        And the Davrods counter "FailedLoginsRefused" is known
+        When a WebDAV "PROPFIND" request for "researcher" is made twice with an invalid password
+        Then the WebDAV response status code is "401"
+        And the Davrods counter "FailedLoginsRefused" has increased
+
     Scenario Outline: Reject WebDAV operations performed with a nonexistent user name
         When a WebDAV "<method>" request for "<path>" is made with a nonexistent user name
         Then the WebDAV response status code is "401"
@@ -227,3 +234,219 @@ Feature: WebDAV interface
         Given user researcher is authenticated
         When a WebDAV "MKCOL" request for "researcher/nonexistent_parent/child" is made
         Then the WebDAV response status code is "409"
+
+    Scenario: A conditional PROPFIND of an unchanged collection is not answered with a listing
+        Given user researcher is authenticated
+        And a WebDAV test collection "webdav_test_tags" exists in collection "researcher"
+        And the change tags of WebDAV collection "researcher/webdav_test_tags" are known
+        When WebDAV collection "researcher/webdav_test_tags" is requested with its ETag in If-None-Match
+        Then the WebDAV response status code is "304"
+
+    Scenario: An upload to a subcollection changes the change tags of its parent
+        Given user researcher is authenticated
+        And a WebDAV test collection "webdav_test_tags" exists in collection "researcher"
+        And a WebDAV test collection "webdav_test_subdir" exists in collection "researcher/webdav_test_tags"
+        And the change tags of WebDAV collection "researcher/webdav_test_tags" are known
+        When data object "webdav_test_file.txt" is created in WebDAV collection "researcher/webdav_test_tags/webdav_test_subdir" with content "Hello WebDAV"
+        Then the WebDAV response status code is "201"
+        And the change tags of WebDAV collection "researcher/webdav_test_tags" have changed
+
+    Scenario Outline: Uploads of client metadata files are handled according to DavrodsJunkWrites
+        Given user researcher is authenticated
+        When data object "<objectname>" is created in WebDAV collection "<location>/researcher" with content "Hello WebDAV"
+        Then the WebDAV response status code is "<status>"
+
+        Examples:
+            | location     | objectname | status |
+            | junk-refuse  | .DS_Store  | 403    |
+            | junk-refuse  | ~$x.docx   | 403    |
+            | junk-discard | .DS_Store  | 201    |
+            | junk-discard | ~$x.docx   | 201    |
+            | junk-store   | .DS_Store  | 201    |
+            | junk-store   | ~$x.docx   | 201    |
+
+    Scenario Outline: Refused and discarded client metadata files cannot be read back
+        Given user researcher is authenticated
+        When data object "<objectname>" is created in WebDAV collection "<location>/researcher" with content "Hello WebDAV"
+        Then WebDAV data object "<location>/researcher/<objectname>" does not exist
+        And WebDAV collection "researcher" does not list data object "<objectname>"
+
+        Examples:
+            | location     | objectname |
+            | junk-refuse  | .DS_Store  |
+            | junk-refuse  | ~$x.docx   |
+            | junk-discard | .DS_Store  |
+            | junk-discard | ~$x.docx   |
+
+    Scenario Outline: Stored client metadata files can be read back
+        Given user researcher is authenticated
+        When data object "<objectname>" is created in WebDAV collection "junk-store/researcher" with content "Hello WebDAV"
+        Then data object "<objectname>" in WebDAV collection "junk-store/researcher" has content "Hello WebDAV"
+        And WebDAV collection "researcher" does not list data object "<objectname>"
+
+        Examples:
+            | objectname |
+            | .DS_Store  |
+            | ~$x.docx   |
+
+    Scenario Outline: Client metadata files that were never uploaded do not exist
+        Given user researcher is authenticated
+        Then WebDAV data object "<location>/researcher/Thumbs.db" does not exist
+
+        Examples:
+            | location     |
+            | junk-refuse  |
+            | junk-discard |
+            | junk-store   |
+
+    Scenario Outline: Stored client metadata files cannot be read by other users
+        Given user researcher is authenticated
+        And a WebDAV test data object "<objectname>" exists in collection "junk-store/researcher"
+        When user viewer requests WebDAV data object "junk-store/researcher/<objectname>"
+        Then the WebDAV response status code is "404"
+
+        Examples:
+            | objectname |
+            | .DS_Store  |
+            | ~$x.docx   |
+
+    Scenario Outline: Stored client metadata files cannot be read with a ticket
+        Given user researcher is authenticated
+        And a WebDAV test data object "<objectname>" exists in collection "junk-store/researcher"
+        When WebDAV data object "junk-store/researcher/<objectname>" is requested with ticket "davrods-test-ticket-a"
+        Then the WebDAV response status code is "404"
+
+        Examples:
+            | objectname |
+            | .DS_Store  |
+            | ~$x.docx   |
+
+    Scenario Outline: Client metadata files larger than DavrodsJunkStoreLimits are refused
+        Given user researcher is authenticated
+        When a <size> kilobyte data object ".DS_Store" is <how> to WebDAV collection "junk-store/researcher"
+        Then the WebDAV response status code is "<status>"
+
+        Examples:
+            | size | how      | status |
+            | 32   | uploaded | 201    |
+            | 32   | streamed | 201    |
+            | 128  | uploaded | 413    |
+            | 128  | streamed | 413    |
+
+    Scenario Outline: Refused oversized client metadata files are not stored
+        Given user researcher is authenticated
+        When a 128 kilobyte data object ".DS_Store" is <how> to WebDAV collection "junk-store/researcher"
+        Then WebDAV data object "junk-store/researcher/.DS_Store" does not exist
+
+        Examples:
+            | how      |
+            | uploaded |
+            | streamed |
+
+    Scenario: An upload is visible right away with the stat cache and metadata index
+        Given user researcher is authenticated
+        And a WebDAV test collection "webdav_test_index" exists in collection "indexed/researcher"
+        And WebDAV collection "indexed/researcher/webdav_test_index" has been listed
+        And WebDAV data object "indexed/researcher/webdav_test_index/webdav_test_file.txt" has been requested
+        When data object "webdav_test_file.txt" is created in WebDAV collection "indexed/researcher/webdav_test_index" with content "Hello WebDAV"
+        Then the WebDAV response status code is "201"
+        And data object "webdav_test_file.txt" in WebDAV collection "indexed/researcher/webdav_test_index" has content "Hello WebDAV"
+        And WebDAV collection "indexed/researcher/webdav_test_index" lists data object "webdav_test_file.txt"
+
+    Scenario: A rename is visible right away with the stat cache and metadata index
+        Given user researcher is authenticated
+        And a WebDAV test collection "webdav_test_index" exists in collection "indexed/researcher"
+        And a WebDAV test data object "webdav_test_file.txt" exists in collection "indexed/researcher/webdav_test_index"
+        And WebDAV collection "indexed/researcher/webdav_test_index" has been listed
+        And WebDAV data object "indexed/researcher/webdav_test_index/webdav_test_file.txt" has been requested
+        And WebDAV data object "indexed/researcher/webdav_test_index/webdav_test_file_renamed.txt" has been requested
+        When WebDAV data object "indexed/researcher/webdav_test_index/webdav_test_file.txt" is renamed to "indexed/researcher/webdav_test_index/webdav_test_file_renamed.txt"
+        Then the WebDAV response status code is "201"
+        And WebDAV data object "indexed/researcher/webdav_test_index/webdav_test_file.txt" does not exist
+        And data object "webdav_test_file_renamed.txt" in WebDAV collection "indexed/researcher/webdav_test_index" has content "test data"
+        And WebDAV collection "indexed/researcher/webdav_test_index" lists data object "webdav_test_file_renamed.txt"
+        And WebDAV collection "indexed/researcher/webdav_test_index" does not list data object "webdav_test_file.txt"
+
+    Scenario: A removal is visible right away with the stat cache and metadata index
+        Given user researcher is authenticated
+        And a WebDAV test collection "webdav_test_index" exists in collection "indexed/researcher"
+        And a WebDAV test data object "webdav_test_file.txt" exists in collection "indexed/researcher/webdav_test_index"
+        And WebDAV collection "indexed/researcher/webdav_test_index" has been listed
+        And WebDAV data object "indexed/researcher/webdav_test_index/webdav_test_file.txt" has been requested
+        When WebDAV data object "indexed/researcher/webdav_test_index/webdav_test_file.txt" is removed
+        Then the WebDAV response status code is "204"
+        And WebDAV data object "indexed/researcher/webdav_test_index/webdav_test_file.txt" does not exist
+        And WebDAV collection "indexed/researcher/webdav_test_index" does not list data object "webdav_test_file.txt"
+
+    Scenario: Proxied requests act with the permissions of the HTTP user
+        Given user viewer is authenticated
+        And user viewer has logged in to WebDAV location "proxied"
+        And the Davrods counter "ProxyVerifyCacheHits" is known
+        When a WebDAV "PUT" request for "proxied/researcher/proxy_file.txt" is made
+        Then the WebDAV response status code is "403"
+        And the Davrods counter "ProxyVerifyCacheHits" has increased
+
+    Scenario: A proxied user can write to their own collection
+        Given user researcher is authenticated
+        And user researcher has logged in to WebDAV location "proxied"
+        When data object "proxy_file.txt" is created in WebDAV collection "proxied/researcher" with content "Hello WebDAV"
+        Then data object "proxy_file.txt" in WebDAV collection "proxied/researcher" has content "Hello WebDAV"
+
+    Scenario: An invalid password is refused in proxy mode while another one is verified
+        Given user researcher is authenticated
+        And user researcher has logged in to WebDAV location "proxied"
+        When a WebDAV "PROPFIND" request for "proxied/researcher" is made with an invalid password
+        Then the WebDAV response status code is "401"
+
+    Scenario: An invalid password is refused in proxy mode after the verification expired
+        Given user researcher is authenticated
+        And user researcher has logged in to WebDAV location "proxied"
+        And the proxy verification of user researcher has expired
+        When a WebDAV "PROPFIND" request for "proxied/researcher" is made with an invalid password
+        Then the WebDAV response status code is "401"
+
+    Scenario: Users do not share pooled proxied connections
+        Given user viewer is authenticated
+        And user researcher has logged in to WebDAV location "proxied"
+        And user viewer has logged in to WebDAV location "proxied"
+        When a WebDAV "PUT" request for "proxied/researcher/proxy_file.txt" is made
+        Then the WebDAV response status code is "403"
+
+    Scenario: Alternating tickets on one connection grant only their own collection
+        Given user researcher is authenticated
+        When WebDAV data objects "rods/ticket-a/ticket-a.txt" and "rods/ticket-b/ticket-b.txt" are requested alternately with tickets "davrods-test-ticket-a" and "davrods-test-ticket-b"
+        Then every WebDAV request sees only what its ticket grants
+
+    Scenario Outline: Paged listings have the same members as listings by the client library
+        Given user researcher is authenticated
+        When WebDAV collection "<collection>" is listed in locations "root-rcl" and "root-paged"
+        Then both WebDAV listings have the same members
+
+        Examples:
+            | collection               |
+            | /                        |
+            | tempZone                 |
+            | tempZone/home            |
+            | tempZone/home/rods/paged |
+
+    Scenario: The ETag of a data object with a checksum is its checksum
+        Given user researcher is authenticated
+        Then the ETag of WebDAV data object "checksums/rods/checksums/with-checksum.txt" is the checksum of its content
+
+    Scenario: The checksum ETag changes when a data object is overwritten within a second
+        Given user researcher is authenticated
+        When WebDAV data object "checksums/researcher/checksummed-overwrite.txt" is overwritten with content of the same size within a second
+        Then the ETags of both versions are the checksums of their content
+
+    Scenario: A data object without a checksum keeps the size and modification time ETag
+        Given user researcher is authenticated
+        Then the ETag of WebDAV data object "checksums/rods/checksums/without-checksum.txt" is made of its size and modification time
+
+    Scenario Outline: Listed data objects have the same ETag as when requested
+        Given user researcher is authenticated
+        Then WebDAV data object "<path>" has the same ETag when listed
+
+        Examples:
+            | path                                          |
+            | checksums/rods/checksums/with-checksum.txt    |
+            | checksums/rods/checksums/without-checksum.txt |
@@ -4,6 +4,10 @@
 __copyright__ = 'Copyright (c) 2026, Utrecht University'
 __license__   = 'GPLv3, see LICENSE'
 
+import base64
+import hashlib
+import re
+import time
 import urllib.parse
 from xml.etree import ElementTree
 
@@ -25,6 +29,12 @@ scenarios('../../features/webdav/webdav.feature')
 # WebDAV elements live in the "DAV:" XML namespace.
 DAV_NS = "DAV:"
 
+# Namespace of the getctag property of collections.
+CS_NS = "http://calendarserver.org/ns/"
+
+# DavrodsProxyVerifyTTL of the proxied location in the development vhost.
+PROXY_VERIFY_TTL = 5
+
 
 def _dav(name):
     """Return a namespace-qualified WebDAV element tag, e.g. {DAV:}multistatus."""
@@ -175,6 +185,16 @@ def webdav_request_invalid_password(user, method, path):
     )
 
 
+@when(
+    parsers.parse('a WebDAV "{method}" request for "{path}" is made twice with an invalid password'),
+    target_fixture="webdav_response",
+)
+def webdav_request_invalid_password_twice(user, method, path):
+    # The second request follows within the failed login backoff of the first.
+    webdav_request_invalid_password(user, method, path)
+    return webdav_request_invalid_password(user, method, path)
+
+
 @when(
     parsers.parse('a WebDAV "{method}" request for "{path}" is made with a nonexistent user name'),
     target_fixture="webdav_response",
@@ -430,6 +450,25 @@ def webdav_create_data_object(webdav_session, webdav_cleanup_paths, name, parent
     return webdav_session.request("PUT", url, data=content.encode("utf-8"), timeout=60)
 
 
+@when(
+    parsers.parse('a {size:d} kilobyte data object "{name}" is {how:w} to WebDAV collection "{parent}"'),
+    target_fixture="webdav_response",
+)
+def webdav_upload_sized_data_object(webdav_session, webdav_cleanup_paths, size, name, how, parent):
+    url = webdav_collection_url(parent) + urllib.parse.quote(name)
+    webdav_cleanup_paths.add(url)
+
+    data = b"x" * (size * 1024)
+    if how == "streamed":
+        # A generator makes requests send the body chunked, without a
+        # Content-Length header.
+        data = (data[i:i + 4096] for i in range(0, len(data), 4096))
+    else:
+        assert how == "uploaded"
+
+    return webdav_session.request("PUT", url, data=data, timeout=60)
+
+
 @when(
     parsers.parse('WebDAV data object "{source}" is renamed to "{destination}"'),
     target_fixture="webdav_response",
@@ -694,3 +733,372 @@ def webdav_overwrite_with_lock_token(webdav_session, webdav_lock_token, path, co
         headers={"If": "({})".format(webdav_lock_token)},
         timeout=60,
     )
+
+
+def get_collection_tags(webdav_session, path):
+    """Return the ETag and CS:getctag properties of a collection.
+
+    :param webdav_session: session to send the PROPFIND with
+    :param path:           path of the collection
+
+    :returns: tuple of (getetag, getctag), either of which may be None
+    """
+    body = (
+        '<?xml version="1.0" encoding="utf-8"?>\n'
+        '<D:propfind xmlns:D="DAV:" xmlns:CS="{}">'
+        '<D:prop><D:getetag/><CS:getctag/></D:prop></D:propfind>'.format(CS_NS)
+    )
+    response = webdav_session.request(
+        "PROPFIND",
+        webdav_collection_url(path),
+        data=body.encode("utf-8"),
+        headers={"Depth": "0", "Content-Type": "application/xml"},
+        timeout=60,
+    )
+    assert response.status_code == 207, \
+        "PROPFIND on '{}' returned {}".format(path, response.status_code)
+
+    root = ElementTree.fromstring(response.content)
+    etag = root.findtext(".//" + _dav("getetag"))
+    ctag = root.findtext(".//{%s}getctag" % CS_NS)
+    return etag, ctag
+
+
+@given(
+    parsers.parse('the change tags of WebDAV collection "{path}" are known'),
+    target_fixture="webdav_tags",
+)
+def webdav_collection_tags_known(webdav_session, path):
+    etag, ctag = get_collection_tags(webdav_session, path)
+    assert etag, "Collection '{}' has no ETag".format(path)
+    assert ctag, "Collection '{}' has no change tag".format(path)
+    return etag, ctag
+
+
+@when(
+    parsers.parse('WebDAV collection "{path}" is requested with its ETag in If-None-Match'),
+    target_fixture="webdav_response",
+)
+def webdav_request_collection_if_none_match(webdav_session, webdav_tags, path):
+    etag, _ = webdav_tags
+    return webdav_session.request(
+        "PROPFIND",
+        webdav_collection_url(path),
+        headers={"Depth": "1", "If-None-Match": etag},
+        timeout=60,
+    )
+
+
+@then(parsers.parse('the change tags of WebDAV collection "{path}" have changed'))
+def webdav_collection_tags_changed(webdav_session, webdav_tags, path):
+    old_etag, old_ctag = webdav_tags
+    etag, ctag = get_collection_tags(webdav_session, path)
+    assert etag != old_etag, \
+        "ETag of '{}' is still {}".format(path, etag)
+    assert ctag != old_ctag, \
+        "Change tag of '{}' is still {}".format(path, ctag)
+
+
+@then(parsers.parse('WebDAV data object "{path}" does not exist'))
+def webdav_data_object_does_not_exist(webdav_session, path):
+    for method in ("GET", "PROPFIND"):
+        response = webdav_session.request(
+            method,
+            webdav_object_url(path),
+            headers={"Depth": "0"},
+            timeout=60,
+        )
+        assert response.status_code == 404, \
+            "{} of '{}' returned {}, expected 404".format(method, path, response.status_code)
+
+
+@when(
+    parsers.parse('user {other:w} requests WebDAV data object "{path}"'),
+    target_fixture="webdav_response",
+)
+def webdav_request_as_other_user(other, path):
+    # A separate session, so that the request is authenticated as the other
+    # user instead of reusing the scenario's connection.
+    assert other in roles
+    urllib3.disable_warnings(urllib3.exceptions.InsecureRequestWarning)
+    return requests.get(
+        webdav_object_url(path),
+        auth=(roles[other]["username"], roles[other]["password"]),
+        verify=False,
+        timeout=60,
+    )
+
+
+@given(parsers.parse('WebDAV collection "{path}" has been listed'))
+def webdav_collection_listed(webdav_session, path):
+    # Fills the stat cache and the metadata index, if enabled.
+    list_data_objects(webdav_session, path)
+
+
+@given(parsers.parse('WebDAV data object "{path}" has been requested'))
+def webdav_data_object_requested(webdav_session, path):
+    # Fills the stat cache, if enabled. Missing objects are fine.
+    response = webdav_session.get(webdav_object_url(path), timeout=60)
+    assert response.status_code in (200, 404), \
+        "GET of '{}' returned {}".format(path, response.status_code)
+
+
+@when(
+    parsers.parse('WebDAV data object "{path}" is requested with ticket "{ticket}"'),
+    target_fixture="webdav_response",
+)
+def webdav_request_with_ticket(webdav_session, path, ticket):
+    # The ticket is passed on to Davrods by the vhost's rewrite rule.
+    return webdav_session.get(
+        webdav_object_url(path),
+        headers={"X-Davrods-Ticket": ticket},
+        timeout=60,
+    )
+
+
+def get_davrods_counter(webdav_session, name):
+    """Return the value of a Davrods counter on the server-status page.
+
+    :param webdav_session: session to request the page with
+    :param name:           counter name, without the "Davrods" prefix
+
+    :returns: counter value
+    """
+    response = webdav_session.get(webdav_url() + "/server-status?auto", timeout=60)
+    assert response.status_code == 200, \
+        "server-status returned {}".format(response.status_code)
+
+    for line in response.text.splitlines():
+        key, _, value = line.partition(":")
+        if key == "Davrods" + name:
+            return int(value)
+
+    raise AssertionError("server-status does not show counter {}".format(name))
+
+
+@given(
+    parsers.parse('the Davrods counter "{name}" is known'),
+    target_fixture="davrods_counter",
+)
+def davrods_counter_known(webdav_session, name):
+    return get_davrods_counter(webdav_session, name)
+
+
+@then(parsers.parse('the Davrods counter "{name}" has increased'))
+def davrods_counter_increased(webdav_session, davrods_counter, name):
+    value = get_davrods_counter(webdav_session, name)
+    assert value > davrods_counter, \
+        "Counter {} is still {}".format(name, value)
+
+
+@given(parsers.parse('user {other:w} has logged in to WebDAV location "{location}"'))
+def webdav_logged_in_to_location(other, location):
+    # Two connections of their own: in proxy mode, the first verifies the
+    # password with a regular login, and the second is opened through the
+    # service account. Closing it hands its iRODS connection to the pool.
+    assert other in roles
+    urllib3.disable_warnings(urllib3.exceptions.InsecureRequestWarning)
+    for _ in range(2):
+        with requests.Session() as session:
+            response = session.request(
+                "PROPFIND",
+                webdav_collection_url(location + "/" + roles[other]["username"]),
+                auth=(roles[other]["username"], roles[other]["password"]),
+                headers={"Depth": "0"},
+                verify=False,
+                timeout=60,
+            )
+        assert response.status_code == 207, \
+            "PROPFIND in '{}' as {} returned {}".format(location, other, response.status_code)
+
+
+@given(parsers.parse('the proxy verification of user {other:w} has expired'))
+def webdav_proxy_verification_expired(other):
+    time.sleep(PROXY_VERIFY_TTL + 1)
+
+
+@when(
+    parsers.parse('WebDAV data objects "{first}" and "{second}" are requested alternately with tickets "{first_ticket}" and "{second_ticket}"'),
+    target_fixture="webdav_ticket_responses",
+)
+def webdav_request_alternating_tickets(webdav_session, first, second, first_ticket, second_ticket):
+    # All requests share the scenario's connection, so Davrods switches the
+    # ticket of one session back and forth, also to no ticket at all.
+    paths = (first, second)
+    tickets = (first_ticket, second_ticket, None)
+    responses = []
+    for _ in range(3):
+        for ticket in tickets:
+            headers = {"X-Davrods-Ticket": ticket} if ticket else {}
+            for path in paths:
+                parent = path.rsplit("/", 1)[0]
+                listing = webdav_session.request(
+                    "PROPFIND",
+                    webdav_collection_url(parent),
+                    headers=dict(headers, Depth="1"),
+                    timeout=60,
+                )
+                data = webdav_session.get(webdav_object_url(path), headers=headers, timeout=60)
+                granted = ticket is not None and tickets.index(ticket) == paths.index(path)
+                responses.append((ticket, path, granted, listing, data))
+    return responses
+
+
+@then("every WebDAV request sees only what its ticket grants")
+def webdav_ticket_responses_granted(webdav_ticket_responses):
+    for ticket, path, granted, listing, data in webdav_ticket_responses:
+        name = path.rsplit("/", 1)[-1]
+        if granted:
+            assert listing.status_code == 207, \
+                "Listing of '{}' with ticket {} returned {}".format(path, ticket, listing.status_code)
+            assert name in parse_content_lengths(listing), \
+                "Listing with ticket {} does not show '{}'".format(ticket, path)
+            assert data.status_code == 200, \
+                "GET of '{}' with ticket {} returned {}".format(path, ticket, data.status_code)
+        else:
+            assert listing.status_code in (403, 404), \
+                "Listing of '{}' with ticket {} returned {}".format(path, ticket, listing.status_code)
+            assert data.status_code in (403, 404), \
+                "GET of '{}' with ticket {} returned {}".format(path, ticket, data.status_code)
+
+
+def parse_listing(response):
+    """Parse a PROPFIND multistatus response into a mapping of member name to
+    its type, size and times, leaving out the listed collection itself.
+
+    :param response: requests.Response of a PROPFIND Depth 1 request
+
+    :returns: dict mapping entry name to a tuple of properties
+    """
+    root = ElementTree.fromstring(response.content)
+    assert root.tag == _dav("multistatus"), \
+        "Root element is {}, expected {}".format(root.tag, _dav("multistatus"))
+
+    members = {}
+    for resp in root.findall(_dav("response"))[1:]:
+        href = resp.findtext(_dav("href"))
+        name = urllib.parse.unquote(href).rstrip("/").rsplit("/", 1)[-1]
+        prop = resp.find(".//" + _dav("prop"))
+        assert prop is not None, "<response> for '{}' without <prop>".format(name)
+        members[name] = (
+            prop.find(".//" + _dav("collection")) is not None,
+            prop.findtext(_dav("getcontentlength")),
+            prop.findtext(_dav("getlastmodified")),
+            prop.findtext(_dav("creationdate")),
+        )
+    return members
+
+
+@when(
+    parsers.parse('WebDAV collection "{path}" is listed in locations "{first}" and "{second}"'),
+    target_fixture="webdav_listings",
+)
+def webdav_list_in_locations(webdav_session, path, first, second):
+    listings = []
+    for location in (first, second):
+        response = webdav_session.request(
+            "PROPFIND",
+            webdav_collection_url(location + "/" + path.strip("/")),
+            headers={"Depth": "1"},
+            timeout=60,
+        )
+        assert response.status_code == 207, \
+            "PROPFIND of '{}' in '{}' returned {}".format(path, location, response.status_code)
+        listings.append(parse_listing(response))
+    return listings
+
+
+@then("both WebDAV listings have the same members")
+def webdav_listings_same(webdav_listings):
+    first, second = webdav_listings
+    assert first, "The listing is empty"
+    assert first == second, \
+        "Listings differ: {} versus {}".format(sorted(first.items()), sorted(second.items()))
+
+
+def checksum_of(content):
+    """Return the checksum iRODS computes for content with its default hash
+    scheme, SHA256, e.g. "sha2:<base64 digest>"."""
+    return "sha2:" + base64.b64encode(hashlib.sha256(content).digest()).decode()
+
+
+def get_data_object(webdav_session, path):
+    response = webdav_session.get(webdav_object_url(path), timeout=60)
+    assert response.status_code == 200, \
+        "GET of '{}' returned {}".format(path, response.status_code)
+    return response
+
+
+@then(parsers.parse('the ETag of WebDAV data object "{path}" is the checksum of its content'))
+def webdav_etag_is_checksum(webdav_session, path):
+    response = get_data_object(webdav_session, path)
+    expected = '"{}"'.format(checksum_of(response.content))
+    assert response.headers.get("ETag") == expected, \
+        "ETag of '{}' is {}, expected {}".format(path, response.headers.get("ETag"), expected)
+
+
+@then(parsers.parse('the ETag of WebDAV data object "{path}" is made of its size and modification time'))
+def webdav_etag_is_size_and_time(webdav_session, path):
+    response = get_data_object(webdav_session, path)
+    etag = response.headers.get("ETag", "")
+    match = re.fullmatch(r'"([0-9a-f]+)-([0-9]+)"', etag)
+    assert match, "ETag of '{}' is {}, expected size and modification time".format(path, etag)
+    assert int(match.group(1), 16) == len(response.content), \
+        "ETag of '{}' is {}, but the size is {}".format(path, etag, len(response.content))
+
+
+@when(
+    parsers.parse('WebDAV data object "{path}" is overwritten with content of the same size within a second'),
+    target_fixture="webdav_versions",
+)
+def webdav_overwrite_same_second(webdav_session, webdav_cleanup_paths, path):
+    url = webdav_object_url(path)
+    webdav_cleanup_paths.add(url)
+
+    # iRODS timestamps have a resolution of one second. Try again in the
+    # unlikely case that the second write happened in the next second.
+    for _ in range(3):
+        versions = []
+        for content in (b"first version", b"other version"):
+            response = webdav_session.request("PUT", url, data=content, timeout=60)
+            assert response.status_code in (201, 204), \
+                "PUT of '{}' returned {}".format(path, response.status_code)
+            versions.append(get_data_object(webdav_session, path))
+        if versions[0].headers.get("Last-Modified") == versions[1].headers.get("Last-Modified"):
+            return versions
+    pytest.fail("Could not overwrite '{}' within a second".format(path))
+
+
+@then("the ETags of both versions are the checksums of their content")
+def webdav_versions_etags(webdav_versions):
+    etags = [response.headers.get("ETag") for response in webdav_versions]
+    assert etags[0] != etags[1], "Both versions have ETag {}".format(etags[0])
+    for response, etag in zip(webdav_versions, etags):
+        expected = '"{}"'.format(checksum_of(response.content))
+        assert etag == expected, "ETag is {}, expected {}".format(etag, expected)
+
+
+@then(parsers.parse('WebDAV data object "{path}" has the same ETag when listed'))
+def webdav_listed_etag_same(webdav_session, path):
+    # List the parent before requesting the data object, so that the listed
+    # ETag does not come from a stat of the data object in this session.
+    parent, name = path.strip("/").rsplit("/", 1)
+    listing = webdav_session.request(
+        "PROPFIND",
+        webdav_collection_url(parent),
+        headers={"Depth": "1"},
+        timeout=60,
+    )
+    assert listing.status_code == 207, \
+        "PROPFIND of '{}' returned {}".format(parent, listing.status_code)
+
+    listed = None
+    for resp in ElementTree.fromstring(listing.content).findall(_dav("response")):
+        href = resp.findtext(_dav("href"))
+        if urllib.parse.unquote(href).rstrip("/").rsplit("/", 1)[-1] == name:
+            listed = resp.findtext(".//" + _dav("getetag"))
+    assert listed, "'{}' is not listed with an ETag in '{}'".format(name, parent)
+
+    etag = get_data_object(webdav_session, path).headers.get("ETag")
+    assert listed == etag, \
+        "Listed ETag of '{}' is {}, but its ETag is {}".format(path, listed, etag)